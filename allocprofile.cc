@@ -0,0 +1,279 @@
+#include "allocprofile.h"
+
+#include <atomic>
+#include <cstdlib>
+#include <mutex>
+#include <new>
+
+namespace allocprofile {
+namespace {
+
+#ifdef HURDLE_ALLOC_PROFILE
+constexpr bool kEnabled = true;
+#else
+constexpr bool kEnabled = false;
+#endif
+
+// Names beyond the first kMaxNames of a dimension are counted under "none".
+constexpr size_t kMaxNames = 64;
+constexpr size_t kStripes = 16;
+constexpr size_t kDimensions = 2;
+
+// Every thread adds to its own stripe, like the metrics counters, so
+// allocating threads never write to the same cache line.
+struct alignas(64) Stripe {
+  std::atomic<uint64_t> allocations[kDimensions][kMaxNames];
+  std::atomic<uint64_t> bytes[kDimensions][kMaxNames];
+};
+Stripe stripes[kStripes];
+
+// Slot 0 of each dimension is "none". Names are only ever appended, so
+// they can be read without the lock up to `name_count`.
+std::atomic<const char*> names[kDimensions][kMaxNames];
+std::atomic<size_t> name_count[kDimensions] = {{1}, {1}};
+std::mutex names_mutex;
+
+// Only trivial thread_locals are used, since operator new reads them and
+// must not run any initializer that could allocate.
+thread_local size_t current_slot[kDimensions] = {0, 0};
+thread_local Counts thread_counts;
+thread_local size_t thread_stripe = kStripes;
+
+size_t ThreadStripe() {
+  if (thread_stripe == kStripes) {
+    static std::atomic<size_t> next_stripe{0};
+    thread_stripe = next_stripe.fetch_add(1) % kStripes;
+  }
+  return thread_stripe;
+}
+
+const char* SlotName(size_t dimension, size_t slot) {
+  return slot == 0 ? "none" : names[dimension][slot].load();
+}
+
+size_t SlotFor(size_t dimension, const char* name) {
+  size_t count = name_count[dimension].load(std::memory_order_acquire);
+  for (size_t slot = 1; slot < count; slot++) {
+    if (names[dimension][slot].load(std::memory_order_relaxed) == name) {
+      return slot;
+    }
+  }
+  // The same name may come from several call sites with distinct pointers;
+  // it gets a slot per pointer and Totals merges them.
+  std::lock_guard<std::mutex> lock(names_mutex);
+  count = name_count[dimension].load();
+  for (size_t slot = 1; slot < count; slot++) {
+    if (names[dimension][slot].load() == name) {
+      return slot;
+    }
+  }
+  if (count == kMaxNames) {
+    return 0;
+  }
+  names[dimension][count].store(name);
+  name_count[dimension].store(count + 1, std::memory_order_release);
+  return count;
+}
+
+Counts SlotTotal(size_t dimension, size_t slot) {
+  Counts counts;
+  for (const Stripe& stripe : stripes) {
+    counts.allocations +=
+        stripe.allocations[dimension][slot].load(std::memory_order_relaxed);
+    counts.bytes +=
+        stripe.bytes[dimension][slot].load(std::memory_order_relaxed);
+  }
+  return counts;
+}
+
+}  // namespace
+
+// Called by the replacement operator new for every allocation. Not in the
+// header, since nothing else should record allocations.
+void Record(size_t size);
+
+void Record(size_t size) {
+  thread_counts.allocations++;
+  thread_counts.bytes += size;
+  Stripe& stripe = stripes[ThreadStripe()];
+  for (size_t dimension = 0; dimension < kDimensions; dimension++) {
+    const size_t slot = current_slot[dimension];
+    stripe.allocations[dimension][slot].fetch_add(1,
+                                                  std::memory_order_relaxed);
+    stripe.bytes[dimension][slot].fetch_add(size, std::memory_order_relaxed);
+  }
+}
+
+bool Enabled() {
+  return kEnabled;
+}
+
+Counts ThreadCounts() {
+  return thread_counts;
+}
+
+Counts TotalCounts() {
+  // Every allocation has exactly one route slot, "none" included.
+  Counts total;
+  const size_t count = name_count[0].load(std::memory_order_acquire);
+  for (size_t slot = 0; slot < count; slot++) {
+    const Counts counts = SlotTotal(0, slot);
+    total.allocations += counts.allocations;
+    total.bytes += counts.bytes;
+  }
+  return total;
+}
+
+std::vector<std::pair<std::string, Counts>> Totals(Dimension dimension) {
+  const size_t d = static_cast<size_t>(dimension);
+  std::vector<std::pair<std::string, Counts>> totals;
+  const size_t count = name_count[d].load(std::memory_order_acquire);
+  for (size_t slot = 0; slot < count; slot++) {
+    const std::string name = SlotName(d, slot);
+    const Counts counts = SlotTotal(d, slot);
+    auto it = totals.begin();
+    while (it != totals.end() && it->first != name) {
+      ++it;
+    }
+    if (it == totals.end()) {
+      totals.emplace_back(name, counts);
+    } else {
+      it->second.allocations += counts.allocations;
+      it->second.bytes += counts.bytes;
+    }
+  }
+  return totals;
+}
+
+Counts Total(Dimension dimension, const std::string& name) {
+  for (const auto& [total_name, counts] : Totals(dimension)) {
+    if (total_name == name) {
+      return counts;
+    }
+  }
+  return Counts();
+}
+
+size_t Enter(Dimension dimension, const char* name) {
+  if (!kEnabled) {
+    return 0;
+  }
+  const size_t d = static_cast<size_t>(dimension);
+  const size_t previous = current_slot[d];
+  current_slot[d] = SlotFor(d, name);
+  return previous;
+}
+
+void Leave(Dimension dimension, size_t previous) {
+  if (kEnabled) {
+    current_slot[static_cast<size_t>(dimension)] = previous;
+  }
+}
+
+}  // namespace allocprofile
+
+#ifdef HURDLE_ALLOC_PROFILE
+
+namespace {
+
+// Allocates like the default operator new: retries through the new handler
+// until it succeeds, and throws std::bad_alloc if there is none.
+void* Allocate(std::size_t size, std::size_t alignment) {
+  allocprofile::Record(size);
+  if (size == 0) {
+    size = 1;
+  }
+  while (true) {
+    // aligned_alloc needs the size to be a multiple of the alignment.
+    void* p = alignment <= alignof(std::max_align_t)
+                  ? std::malloc(size)
+                  : std::aligned_alloc(alignment, (size + alignment - 1) /
+                                                      alignment * alignment);
+    if (p != nullptr) {
+      return p;
+    }
+    std::new_handler handler = std::get_new_handler();
+    if (handler == nullptr) {
+      throw std::bad_alloc();
+    }
+    handler();
+  }
+}
+
+void* AllocateNoThrow(std::size_t size, std::size_t alignment) noexcept {
+  try {
+    return Allocate(size, alignment);
+  } catch (const std::bad_alloc&) {
+    return nullptr;
+  }
+}
+
+}  // namespace
+
+void* operator new(std::size_t size) {
+  return Allocate(size, 0);
+}
+void* operator new[](std::size_t size) {
+  return Allocate(size, 0);
+}
+void* operator new(std::size_t size, const std::nothrow_t&) noexcept {
+  return AllocateNoThrow(size, 0);
+}
+void* operator new[](std::size_t size, const std::nothrow_t&) noexcept {
+  return AllocateNoThrow(size, 0);
+}
+void* operator new(std::size_t size, std::align_val_t alignment) {
+  return Allocate(size, static_cast<std::size_t>(alignment));
+}
+void* operator new[](std::size_t size, std::align_val_t alignment) {
+  return Allocate(size, static_cast<std::size_t>(alignment));
+}
+void* operator new(std::size_t size, std::align_val_t alignment,
+                   const std::nothrow_t&) noexcept {
+  return AllocateNoThrow(size, static_cast<std::size_t>(alignment));
+}
+void* operator new[](std::size_t size, std::align_val_t alignment,
+                     const std::nothrow_t&) noexcept {
+  return AllocateNoThrow(size, static_cast<std::size_t>(alignment));
+}
+
+void operator delete(void* p) noexcept {
+  std::free(p);
+}
+void operator delete[](void* p) noexcept {
+  std::free(p);
+}
+void operator delete(void* p, std::size_t) noexcept {
+  std::free(p);
+}
+void operator delete[](void* p, std::size_t) noexcept {
+  std::free(p);
+}
+void operator delete(void* p, const std::nothrow_t&) noexcept {
+  std::free(p);
+}
+void operator delete[](void* p, const std::nothrow_t&) noexcept {
+  std::free(p);
+}
+void operator delete(void* p, std::align_val_t) noexcept {
+  std::free(p);
+}
+void operator delete[](void* p, std::align_val_t) noexcept {
+  std::free(p);
+}
+void operator delete(void* p, std::size_t, std::align_val_t) noexcept {
+  std::free(p);
+}
+void operator delete[](void* p, std::size_t, std::align_val_t) noexcept {
+  std::free(p);
+}
+void operator delete(void* p, std::align_val_t,
+                     const std::nothrow_t&) noexcept {
+  std::free(p);
+}
+void operator delete[](void* p, std::align_val_t,
+                       const std::nothrow_t&) noexcept {
+  std::free(p);
+}
+
+#endif  // HURDLE_ALLOC_PROFILE
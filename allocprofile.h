@@ -0,0 +1,70 @@
+#include <cstddef>
+#include <cstdint>
+#include <string>
+#include <utility>
+#include <vector>
+
+#ifndef ALLOCPROFILE_H
+#define ALLOCPROFILE_H
+
+// Allocation profiling. Builds compiled with -DHURDLE_ALLOC_PROFILE (make
+// build_allocs, bench_allocs and test_allocations) replace operator new to
+// count every heap allocation and its size. Each allocation is attributed
+// to the route and to the phase active on the allocating thread, which
+// Scope sets. In other builds Scope only costs a branch and every count
+// stays 0.
+namespace allocprofile {
+
+struct Counts {
+  uint64_t allocations = 0;
+  uint64_t bytes = 0;
+};
+
+// Allocations are attributed along two independent dimensions: the route
+// of the request being handled, and the phase of the work within it.
+enum class Dimension { kRoute = 0, kPhase = 1 };
+
+// Returns true if operator new is instrumented in this build.
+bool Enabled();
+
+// Returns the allocations made by the calling thread since it started.
+Counts ThreadCounts();
+
+// Returns the allocations of every thread, summed.
+Counts TotalCounts();
+
+// Returns the allocations attributed to each name of `dimension`, summed
+// over every thread. Allocations made outside any scope are under "none".
+std::vector<std::pair<std::string, Counts>> Totals(Dimension dimension);
+
+// Returns the allocations attributed to `name`, or zeros if it never had
+// a scope.
+Counts Total(Dimension dimension, const std::string& name);
+
+// Attributes the calling thread's allocations to `name` until Leave is
+// called with the returned value, which restores the enclosing name.
+// `name` must stay valid for the life of the program. Enter and Leave are
+// for scopes that span two calls, like a middleware's before_handle and
+// after_handle; prefer Scope otherwise.
+size_t Enter(Dimension dimension, const char* name);
+void Leave(Dimension dimension, size_t previous);
+
+// Attributes the calling thread's allocations to `name` until the end of
+// the enclosing block.
+class Scope {
+ public:
+  Scope(Dimension dimension, const char* name)
+      : dimension_(dimension), previous_(Enter(dimension, name)) {}
+  ~Scope() { Leave(dimension_, previous_); }
+
+  Scope(const Scope&) = delete;
+  Scope& operator=(const Scope&) = delete;
+
+ private:
+  Dimension dimension_;
+  size_t previous_;
+};
+
+}  // namespace allocprofile
+
+#endif  // ALLOCPROFILE_H
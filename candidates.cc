@@ -0,0 +1,73 @@
+#include "candidates.h"
+
+#include <algorithm>
+
+CandidateSet::CandidateSet(size_t size)
+    : bits_((size + 63) / 64, ~uint64_t{0}), size_(size) {
+  if (size % 64 != 0) {
+    bits_.back() = (uint64_t{1} << (size % 64)) - 1;
+  }
+}
+
+size_t CandidateSet::Count() const {
+  size_t count = 0;
+  for (uint64_t word : bits_) {
+    count += __builtin_popcountll(word);
+  }
+  return count;
+}
+
+void CandidateSet::Intersect(const CandidateSet& other) {
+  for (size_t i = 0; i < bits_.size() && i < other.bits_.size(); i++) {
+    bits_[i] &= other.bits_[i];
+  }
+}
+
+std::vector<uint32_t> CandidateSet::Indices() const {
+  std::vector<uint32_t> indices;
+  indices.reserve(Count());
+  for (size_t i = 0; i < bits_.size(); i++) {
+    uint64_t word = bits_[i];
+    while (word != 0) {
+      indices.push_back(i * 64 + __builtin_ctzll(word));
+      word &= word - 1;
+    }
+  }
+  return indices;
+}
+
+CandidateIndex::CandidateIndex(const std::vector<std::string>& hurdles)
+    : hurdles_(PackWords(hurdles)), all_(hurdles.size()) {}
+
+std::shared_ptr<const CandidateSet> CandidateIndex::Mask(
+    const std::string& guess, Pattern pattern) {
+  const PackedWord packed = PackWord(guess);
+  uint32_t key = 0;
+  for (uint8_t letter : packed) {
+    key = key * 26 + letter;
+  }
+  key = key * kPatternCount + pattern;
+
+  {
+    std::lock_guard<std::mutex> lock(mutex_);
+    auto it = masks_.find(key);
+    if (it != masks_.end()) {
+      return it->second;
+    }
+  }
+
+  auto mask = std::make_shared<CandidateSet>(hurdles_.size());
+  std::fill(mask->bits_.begin(), mask->bits_.end(), 0);
+  for (size_t h = 0; h < hurdles_.size(); h++) {
+    if (ScorePattern(packed, hurdles_[h]) == pattern) {
+      mask->bits_[h / 64] |= uint64_t{1} << (h % 64);
+    }
+  }
+
+  std::lock_guard<std::mutex> lock(mutex_);
+  if (masks_.size() >= max_masks) {
+    masks_.clear();
+  }
+  masks_.emplace(key, mask);
+  return mask;
+}
@@ -0,0 +1,66 @@
+#include <cstdint>
+#include <memory>
+#include <mutex>
+#include <string>
+#include <unordered_map>
+#include <vector>
+
+#include "patterns.h"
+
+#ifndef CANDIDATES_H
+#define CANDIDATES_H
+
+// CandidateSet is a bitset over the hurdle list of a HurdleWords: bit i is
+// set while hurdle i is still a possible answer.
+class CandidateSet {
+ public:
+  CandidateSet() = default;
+  // Creates a set of `size` hurdles, all of them candidates.
+  explicit CandidateSet(size_t size);
+
+  size_t Size() const { return size_; }
+  // Returns the number of candidates left.
+  size_t Count() const;
+  bool Contains(size_t hurdle) const {
+    return (bits_[hurdle / 64] >> (hurdle % 64)) & 1;
+  }
+  // Keeps only the candidates that are also in `other`.
+  void Intersect(const CandidateSet& other);
+  // Returns the indices of the candidates, in increasing order.
+  std::vector<uint32_t> Indices() const;
+
+ private:
+  std::vector<uint64_t> bits_;
+  size_t size_ = 0;
+
+  friend class CandidateIndex;
+};
+
+// CandidateIndex maps a guess and its feedback pattern to the set of hurdles
+// that would give that feedback. Masks are built the first time a
+// (guess, pattern) pair is seen and then shared by every game, so narrowing
+// a game down after a guess is a single AND over the bitset.
+class CandidateIndex {
+ public:
+  explicit CandidateIndex(const std::vector<std::string>& hurdles);
+
+  // Returns the set of every hurdle.
+  const CandidateSet& All() const { return all_; }
+
+  // Returns the hurdles that give `pattern` for the five-letter `guess`.
+  std::shared_ptr<const CandidateSet> Mask(const std::string& guess,
+                                           Pattern pattern);
+
+  // Number of masks kept before the cache is cleared, which bounds its
+  // memory to about max_masks * hurdles / 8 bytes.
+  size_t max_masks = 1 << 16;
+
+ private:
+  std::vector<PackedWord> hurdles_;
+  CandidateSet all_;
+  std::mutex mutex_;
+  // Keyed by the packed guess followed by the pattern.
+  std::unordered_map<uint32_t, std::shared_ptr<const CandidateSet>> masks_;
+};
+
+#endif  // CANDIDATES_H
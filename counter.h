@@ -0,0 +1,47 @@
+#include <array>
+#include <atomic>
+#include <cstddef>
+#include <cstdint>
+
+#ifndef COUNTER_H
+#define COUNTER_H
+
+namespace metrics {
+
+// Counters and histograms are split into stripes, and each thread writes to
+// its own stripe, so recording is an uncontended relaxed increment on a
+// cache line no other thread writes. Reads add the stripes up.
+constexpr size_t kStripes = 16;
+
+inline size_t ThreadStripe() {
+  static std::atomic<size_t> next_stripe{0};
+  thread_local const size_t stripe = next_stripe.fetch_add(1) % kStripes;
+  return stripe;
+}
+
+}  // namespace metrics
+
+// A monotonically increasing count, e.g. of bytes or lookups.
+class Counter {
+ public:
+  void Add(uint64_t n = 1) {
+    stripes_[metrics::ThreadStripe()].value.fetch_add(
+        n, std::memory_order_relaxed);
+  }
+
+  uint64_t Value() const {
+    uint64_t value = 0;
+    for (const Stripe& stripe : stripes_) {
+      value += stripe.value.load(std::memory_order_relaxed);
+    }
+    return value;
+  }
+
+ private:
+  struct alignas(64) Stripe {
+    std::atomic<uint64_t> value{0};
+  };
+  std::array<Stripe, metrics::kStripes> stripes_;
+};
+
+#endif  // COUNTER_H
@@ -0,0 +1,102 @@
+#include "daily.h"
+
+#include <chrono>
+#include <cstdio>
+
+#include "random.h"
+
+namespace {
+
+constexpr int kFeistelRounds = 4;
+
+// Returns the days since 1970-01-01 of a date in the proleptic Gregorian
+// calendar (Howard Hinnant's days_from_civil).
+int64_t DaysFromCivil(int64_t year, unsigned month, unsigned day) {
+  year -= month <= 2;
+  const int64_t era = (year >= 0 ? year : year - 399) / 400;
+  const unsigned year_of_era = static_cast<unsigned>(year - era * 400);
+  const unsigned day_of_year =
+      (153 * (month > 2 ? month - 3 : month + 9) + 2) / 5 + day - 1;
+  const unsigned day_of_era =
+      year_of_era * 365 + year_of_era / 4 - year_of_era / 100 + day_of_year;
+  return era * 146097 + static_cast<int64_t>(day_of_era) - 719468;
+}
+
+bool IsLeapYear(int64_t year) {
+  return (year % 4 == 0 && year % 100 != 0) || year % 400 == 0;
+}
+
+}  // namespace
+
+DailySchedule::DailySchedule(const HurdleWords& words, uint64_t key)
+    : words_(words), key_(key), half_bits_(1) {
+  while ((uint64_t{1} << (2 * half_bits_)) < words_.Hurdles().size()) {
+    half_bits_++;
+  }
+}
+
+const std::string& DailySchedule::Hurdle(int64_t day,
+                                         const std::string& region) const {
+  const uint64_t n = words_.Hurdles().size();
+  if (n == 0) {
+    static const std::string kNoHurdle;
+    return kNoHurdle;
+  }
+  // Every pass through the list gets a new permutation.
+  int64_t cycle = day / static_cast<int64_t>(n);
+  int64_t position = day % static_cast<int64_t>(n);
+  if (position < 0) {
+    position += n;
+    cycle--;
+  }
+  const uint64_t key =
+      MixBits(key_ ^ MixBits(HashBytes(region)) ^
+              MixBits(static_cast<uint64_t>(cycle)));
+  // The network permutes a power-of-two range, so walk the cycle until the
+  // value lands back inside the list. This stays a permutation of [0, n).
+  uint64_t index = Feistel(position, key);
+  while (index >= n) {
+    index = Feistel(index, key);
+  }
+  return words_.Hurdles()[index];
+}
+
+uint64_t DailySchedule::Feistel(uint64_t x, uint64_t key) const {
+  const uint64_t mask = (uint64_t{1} << half_bits_) - 1;
+  uint64_t left = x >> half_bits_;
+  uint64_t right = x & mask;
+  for (int round = 0; round < kFeistelRounds; round++) {
+    const uint64_t round_key = key + round * 0x100000001b3ull;
+    const uint64_t next = left ^ (MixBits(round_key ^ right) & mask);
+    left = right;
+    right = next;
+  }
+  return (left << half_bits_) | right;
+}
+
+bool DailySchedule::ParseDate(const std::string& date, int64_t* day) {
+  int year;
+  unsigned month;
+  unsigned day_of_month;
+  char rest;
+  if (date.size() != 10 ||
+      std::sscanf(date.c_str(), "%4d-%2u-%2u%c", &year, &month, &day_of_month,
+                  &rest) != 3 ||
+      month < 1 || month > 12 || day_of_month < 1) {
+    return false;
+  }
+  static constexpr unsigned kDaysInMonth[12] = {31, 28, 31, 30, 31, 30,
+                                                31, 31, 30, 31, 30, 31};
+  const unsigned days_in_month =
+      kDaysInMonth[month - 1] + (month == 2 && IsLeapYear(year) ? 1 : 0);
+  if (day_of_month > days_in_month) {
+    return false;
+  }
+  *day = DaysFromCivil(year, month, day_of_month);
+  return true;
+}
+
+int64_t DailySchedule::Today() {
+  const auto now = std::chrono::system_clock::now().time_since_epoch();
+  return std::chrono::duration_cast<std::chrono::hours>(now).count() / 24;
+}
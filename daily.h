@@ -0,0 +1,40 @@
+#include <cstdint>
+#include <string>
+
+#include "hurdlewords.h"
+
+#ifndef DAILY_H
+#define DAILY_H
+
+// DailySchedule picks the daily hurdle of every region. Each region walks
+// through its own keyed permutation of the hurdle list, one hurdle a day, so
+// a hurdle comes back only after every other one has been played. The
+// hurdle only depends on the key, the date and the region, so every server
+// sharing the key agrees without talking to the others.
+class DailySchedule {
+ public:
+  DailySchedule(const HurdleWords& words, uint64_t key);
+
+  // Returns the hurdle of `day`, counted in days since 1970-01-01, in
+  // `region`, or an empty string if there are no hurdles.
+  const std::string& Hurdle(int64_t day, const std::string& region) const;
+
+  // Parses a "YYYY-MM-DD" date into days since 1970-01-01. Returns false if
+  // it is not a valid date.
+  static bool ParseDate(const std::string& date, int64_t* day);
+
+  // Returns the current day in UTC, in days since 1970-01-01.
+  static int64_t Today();
+
+ private:
+  HurdleWords words_;
+  uint64_t key_;
+  // Bits in each half of the Feistel network's domain.
+  int half_bits_;
+
+  // Maps `x` in [0, 2^(2 * half_bits_)) to another value in that range, one
+  // to one for a given `key`.
+  uint64_t Feistel(uint64_t x, uint64_t key) const;
+};
+
+#endif  // DAILY_H
@@ -0,0 +1,202 @@
+#include "difficulty.h"
+
+#include <algorithm>
+#include <cmath>
+#include <numeric>
+
+#include "patterns.h"
+#include "threadpool.h"
+
+namespace {
+
+// Sets sizes of at least this many hurdles are split on the thread pool.
+constexpr size_t kParallelSize = 256;
+
+// Tier weights are triangles over the difficulty percentile, peaking at
+// these centers and reaching zero kTierWidth away from them.
+constexpr double kTierCenters[3] = {1.0 / 6, 1.0 / 2, 5.0 / 6};
+constexpr double kTierWidth = 1.0 / 3;
+
+// ReferenceSolver plays every hurdle at once: at each node it picks the
+// candidate minimizing the sum of squared bucket sizes, i.e. the expected
+// number of hurdles left, and recurses into the buckets.
+class ReferenceSolver {
+ public:
+  ReferenceSolver(const std::vector<PackedWord>& hurdles, ThreadPool& pool,
+                  std::vector<uint8_t>* guesses, std::vector<uint32_t>* first)
+      : hurdles_(hurdles), pool_(pool), guesses_(*guesses), first_(*first) {}
+
+  void Solve(const std::vector<uint32_t>& set, int depth) {
+    if (set.size() == 1) {
+      guesses_[set[0]] = depth + 1;
+      return;
+    }
+    const uint32_t guess = PickGuess(set);
+
+    std::vector<uint32_t> counts(kPatternCount);
+    for (uint32_t h : set) {
+      counts[ScorePattern(hurdles_[guess], hurdles_[h])]++;
+    }
+    std::vector<std::vector<uint32_t>> buckets(kPatternCount);
+    for (uint32_t h : set) {
+      const Pattern pattern = ScorePattern(hurdles_[guess], hurdles_[h]);
+      if (depth == 0) {
+        // The size of a hurdle's bucket after the first guess breaks ties
+        // between hurdles that take as many guesses.
+        first_[h] = counts[pattern];
+      }
+      if (pattern == kAllGreen) {
+        guesses_[h] = depth + 1;
+      } else {
+        buckets[pattern].push_back(h);
+      }
+    }
+    auto solve = [&](size_t begin, size_t end) {
+      for (size_t p = begin; p < end; p++) {
+        if (!buckets[p].empty()) {
+          Solve(buckets[p], depth + 1);
+        }
+      }
+    };
+    if (set.size() >= kParallelSize) {
+      pool_.ParallelFor(0, kPatternCount, 1, solve);
+    } else {
+      solve(0, kPatternCount);
+    }
+  }
+
+ private:
+  const std::vector<PackedWord>& hurdles_;
+  ThreadPool& pool_;
+  std::vector<uint8_t>& guesses_;
+  std::vector<uint32_t>& first_;
+
+  uint32_t PickGuess(const std::vector<uint32_t>& set) {
+    std::vector<uint64_t> scores(set.size());
+    auto score = [&](size_t begin, size_t end) {
+      for (size_t i = begin; i < end; i++) {
+        uint16_t counts[kPatternCount] = {};
+        for (uint32_t h : set) {
+          counts[ScorePattern(hurdles_[set[i]], hurdles_[h])]++;
+        }
+        uint64_t sum = 0;
+        for (int p = 0; p < kPatternCount; p++) {
+          sum += counts[p] * counts[p];
+        }
+        scores[i] = sum;
+      }
+    };
+    if (set.size() >= kParallelSize) {
+      pool_.ParallelFor(0, set.size(), 16, score);
+    } else {
+      score(0, set.size());
+    }
+    return set[std::min_element(scores.begin(), scores.end()) -
+               scores.begin()];
+  }
+};
+
+}  // namespace
+
+bool ParseDifficulty(const std::string& name, Difficulty* difficulty) {
+  if (name == "any") {
+    *difficulty = Difficulty::kAny;
+  } else if (name == "easy") {
+    *difficulty = Difficulty::kEasy;
+  } else if (name == "medium") {
+    *difficulty = Difficulty::kMedium;
+  } else if (name == "hard") {
+    *difficulty = Difficulty::kHard;
+  } else {
+    return false;
+  }
+  return true;
+}
+
+DifficultyIndex::DifficultyIndex(const std::vector<std::string>& hurdles)
+    : hurdles_(hurdles) {}
+
+void DifficultyIndex::Compute(ThreadPool& pool) {
+  std::call_once(computed_, [&] {
+    const size_t n = hurdles_.size();
+    if (n == 0) {
+      return;
+    }
+    guesses_.assign(n, 0);
+    std::vector<uint32_t> first(n, 1);
+    std::vector<uint32_t> all(n);
+    std::iota(all.begin(), all.end(), 0);
+    const std::vector<PackedWord> packed = PackWords(hurdles_);
+    ReferenceSolver(packed, pool, &guesses_, &first).Solve(all, 0);
+
+    // Rank the hurdles from easiest to hardest.
+    std::sort(all.begin(), all.end(), [&](uint32_t a, uint32_t b) {
+      if (guesses_[a] != guesses_[b]) {
+        return guesses_[a] < guesses_[b];
+      }
+      if (first[a] != first[b]) {
+        return first[a] < first[b];
+      }
+      return a < b;
+    });
+    for (int tier = 0; tier < 3; tier++) {
+      std::vector<double> weights(n);
+      for (size_t rank = 0; rank < n; rank++) {
+        const double percentile = n > 1 ? static_cast<double>(rank) / (n - 1)
+                                        : kTierCenters[tier];
+        weights[all[rank]] = std::max(
+            0.0, 1 - std::abs(percentile - kTierCenters[tier]) / kTierWidth);
+      }
+      tiers_[tier] = BuildAliasTable(weights);
+    }
+    ready_.store(true, std::memory_order_release);
+  });
+}
+
+uint8_t DifficultyIndex::Guesses(size_t hurdle) const {
+  return Ready() ? guesses_[hurdle] : 0;
+}
+
+size_t DifficultyIndex::Sample(Difficulty difficulty, size_t index,
+                               uint32_t coin) const {
+  if (difficulty == Difficulty::kAny || !Ready()) {
+    return index;
+  }
+  const AliasTable& table = tiers_[static_cast<int>(difficulty) - 1];
+  return coin < table.threshold[index] ? index : table.alias[index];
+}
+
+DifficultyIndex::AliasTable DifficultyIndex::BuildAliasTable(
+    const std::vector<double>& weights) {
+  const size_t n = weights.size();
+  const double total = std::accumulate(weights.begin(), weights.end(), 0.0);
+  AliasTable table;
+  table.threshold.assign(n, UINT32_MAX);
+  table.alias.resize(n);
+  std::iota(table.alias.begin(), table.alias.end(), 0);
+  if (total <= 0) {
+    return table;
+  }
+
+  std::vector<double> scaled(n);
+  std::vector<uint32_t> small;
+  std::vector<uint32_t> large;
+  for (size_t i = 0; i < n; i++) {
+    scaled[i] = weights[i] * n / total;
+    (scaled[i] < 1 ? small : large).push_back(i);
+  }
+  while (!small.empty() && !large.empty()) {
+    const uint32_t s = small.back();
+    small.pop_back();
+    const uint32_t l = large.back();
+    table.threshold[s] = static_cast<uint32_t>(scaled[s] * 4294967296.0);
+    table.alias[s] = l;
+    scaled[l] -= 1 - scaled[s];
+    if (scaled[l] < 1) {
+      large.pop_back();
+      small.push_back(l);
+    }
+  }
+  // Whatever is left has a probability of 1 up to rounding errors.
+  return table;
+}
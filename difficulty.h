@@ -0,0 +1,59 @@
+#include <atomic>
+#include <cstdint>
+#include <mutex>
+#include <string>
+#include <vector>
+
+#ifndef DIFFICULTY_H
+#define DIFFICULTY_H
+
+class ThreadPool;
+
+enum class Difficulty { kAny, kEasy, kMedium, kHard };
+
+// Parses "any", "easy", "medium" or "hard". Returns false otherwise.
+bool ParseDifficulty(const std::string& name, Difficulty* difficulty);
+
+// DifficultyIndex scores every hurdle by the number of guesses a reference
+// solver needs to find it, and keeps one alias table per difficulty tier so
+// a hurdle of a tier is sampled in constant time. The reference solver
+// always guesses the remaining hurdle that leaves the fewest others
+// expected, which is cheap enough to score the whole list at startup.
+class DifficultyIndex {
+ public:
+  explicit DifficultyIndex(const std::vector<std::string>& hurdles);
+
+  // Scores every hurdle on `pool` and builds the tier tables. Only the first
+  // call does any work.
+  void Compute(ThreadPool& pool);
+  bool Ready() const { return ready_.load(std::memory_order_acquire); }
+
+  // Returns the number of guesses the reference solver needs for `hurdle`,
+  // or 0 before Compute.
+  uint8_t Guesses(size_t hurdle) const;
+
+  // Returns the index of a hurdle drawn from `difficulty`, given a uniformly
+  // random `index` below the number of hurdles and 32 random bits in `coin`.
+  // Tiers overlap a little, with most of their weight on the easiest, middle
+  // and hardest third of the hurdles. Before Compute, or for kAny, this is
+  // `index`.
+  size_t Sample(Difficulty difficulty, size_t index, uint32_t coin) const;
+
+ private:
+  // Vose's alias table: draw index i uniformly, then keep it if a random
+  // 32-bit number is below threshold[i], else take alias[i].
+  struct AliasTable {
+    std::vector<uint32_t> threshold;
+    std::vector<uint32_t> alias;
+  };
+
+  std::vector<std::string> hurdles_;
+  std::vector<uint8_t> guesses_;
+  AliasTable tiers_[3];
+  std::once_flag computed_;
+  std::atomic<bool> ready_{false};
+
+  static AliasTable BuildAliasTable(const std::vector<double>& weights);
+};
+
+#endif  // DIFFICULTY_H
@@ -0,0 +1,76 @@
+#include "hardmode.h"
+
+#include <cctype>
+
+namespace {
+
+const char* const kOrdinals[kWordLength] = {"1st", "2nd", "3rd", "4th", "5th"};
+
+bool IsLetter(char c) {
+  return c >= 'a' && c <= 'z';
+}
+
+}  // namespace
+
+void HardModeRules::Clear() {
+  green_positions_ = 0;
+  required_.fill(0);
+  required_letters_ = 0;
+}
+
+void HardModeRules::AddRow(const std::string& guess,
+                           const std::string& colors) {
+  std::array<uint8_t, 26> revealed{};
+  for (int i = 0; i < kWordLength && i < static_cast<int>(guess.size()) &&
+                  i < static_cast<int>(colors.size());
+       i++) {
+    if (!IsLetter(guess[i]) || colors[i] == 'B') {
+      continue;
+    }
+    if (colors[i] == 'G') {
+      greens_[i] = guess[i];
+      green_positions_ |= 1u << i;
+    }
+    revealed[guess[i] - 'a']++;
+  }
+  // A letter shown twice in one row must appear at least twice from now on.
+  for (int l = 0; l < 26; l++) {
+    if (revealed[l] > required_[l]) {
+      required_[l] = revealed[l];
+      required_letters_ |= 1u << l;
+    }
+  }
+}
+
+std::string HardModeRules::Violation(const std::string& guess) const {
+  for (uint32_t positions = green_positions_; positions != 0;
+       positions &= positions - 1) {
+    const int i = __builtin_ctz(positions);
+    if (i >= static_cast<int>(guess.size()) || guess[i] != greens_[i]) {
+      return std::string(kOrdinals[i]) + " letter must be " +
+             static_cast<char>(std::toupper(greens_[i]));
+    }
+  }
+  if (required_letters_ == 0) {
+    return "";
+  }
+  std::array<uint8_t, 26> counts{};
+  for (char c : guess) {
+    if (IsLetter(c)) {
+      counts[c - 'a']++;
+    }
+  }
+  for (uint32_t letters = required_letters_; letters != 0;
+       letters &= letters - 1) {
+    const int l = __builtin_ctz(letters);
+    if (counts[l] < required_[l]) {
+      std::string reason = std::string("Guess must contain ") +
+                           static_cast<char>(std::toupper('a' + l));
+      if (required_[l] > 1) {
+        reason += " " + std::to_string(required_[l]) + " times";
+      }
+      return reason;
+    }
+  }
+  return "";
+}
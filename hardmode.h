@@ -0,0 +1,36 @@
+#include <array>
+#include <cstdint>
+#include <string>
+
+#include "patterns.h"
+
+#ifndef HARDMODE_H
+#define HARDMODE_H
+
+// HardModeRules holds what the submitted rows of a board have revealed: the
+// letter fixed at each green position, and how many times each green or
+// yellow letter must appear. Rows are compiled in as they are submitted, so
+// checking a guess never rescans the board.
+class HardModeRules {
+ public:
+  // Forgets every row.
+  void Clear();
+
+  // Adds the letters revealed by `colors` for `guess`.
+  void AddRow(const std::string& guess, const std::string& colors);
+
+  // Returns why `guess` breaks the rules, or an empty string if it doesn't.
+  std::string Violation(const std::string& guess) const;
+
+ private:
+  // greens_[i] is the letter required at position i, if bit i of
+  // green_positions_ is set.
+  std::array<char, kWordLength> greens_{};
+  uint32_t green_positions_ = 0;
+  // required_[l] is the number of times letter l must appear, for every
+  // letter l set in required_letters_.
+  std::array<uint8_t, 26> required_{};
+  uint32_t required_letters_ = 0;
+};
+
+#endif  // HARDMODE_H
@@ -0,0 +1,185 @@
+#include "hint.h"
+
+#include <algorithm>
+#include <atomic>
+#include <cmath>
+#include <unordered_map>
+
+HintEngine::HintEngine(const HurdleWords& words, ThreadPool& pool)
+    : words_(words),
+      pool_(pool),
+      guesses_(PackWords(words.Guesses())),
+      hurdles_(PackWords(words.Hurdles())) {
+  std::unordered_map<std::string, uint32_t> guess_index;
+  for (size_t i = 0; i < words.Guesses().size(); i++) {
+    guess_index[words.Guesses()[i]] = i;
+  }
+  for (const std::string& hurdle : words.Hurdles()) {
+    auto it = guess_index.find(hurdle);
+    hurdle_guess_index_.push_back(it != guess_index.end() ? it->second : 0);
+  }
+  xlogx_.resize(hurdles_.size() + 1);
+  for (size_t n = 1; n < xlogx_.size(); n++) {
+    xlogx_[n] = n * std::log2(static_cast<double>(n));
+  }
+}
+
+std::vector<uint32_t> HintEngine::FilterCandidates(
+    const std::vector<std::string>& guesses,
+    const std::vector<std::string>& colors) const {
+  CandidateIndex& index = words_.Candidates();
+  CandidateSet candidates = index.All();
+  for (size_t i = 0; i < guesses.size() && i < colors.size(); i++) {
+    Pattern pattern;
+    if (guesses[i].size() == kWordLength && words_.IsGuessValid(guesses[i]) &&
+        PatternFromColors(colors[i], &pattern)) {
+      candidates.Intersect(*index.Mask(guesses[i], pattern));
+    }
+  }
+  return candidates.Indices();
+}
+
+Hint HintEngine::HintFor(const std::vector<std::string>& guesses,
+                         const std::vector<std::string>& colors) {
+  const auto deadline = std::chrono::steady_clock::now() + budget;
+  Hint hint;
+  if (FromStrategy(guesses, colors, &hint)) {
+    return hint;
+  }
+  return HintForIndices(FilterCandidates(guesses, colors), deadline);
+}
+
+Hint HintEngine::HintFor(const std::vector<std::string>& guesses,
+                         const std::vector<std::string>& colors,
+                         const CandidateSet& candidates) {
+  Hint hint;
+  if (FromStrategy(guesses, colors, &hint)) {
+    return hint;
+  }
+  return HintFor(candidates);
+}
+
+bool HintEngine::FromStrategy(const std::vector<std::string>& guesses,
+                              const std::vector<std::string>& colors,
+                              Hint* hint) const {
+  if (strategy == nullptr) {
+    return false;
+  }
+  const StrategyNode* node = strategy->Lookup(guesses, colors);
+  if (node == nullptr) {
+    return false;
+  }
+  hint->guess = strategy->Guess(*node);
+  hint->expected_info = node->expected_info;
+  hint->candidates = node->candidates;
+  hint->complete = true;
+  hint->expected_guesses = node->expected_guesses;
+  return true;
+}
+
+Hint HintEngine::HintFor(const CandidateSet& candidates) {
+  const auto deadline = std::chrono::steady_clock::now() + budget;
+  return HintForIndices(candidates.Indices(), deadline);
+}
+
+Hint HintEngine::HintForIndices(
+    const std::vector<uint32_t>& candidates,
+    std::chrono::steady_clock::time_point deadline) {
+  if (candidates.size() == hurdles_.size()) {
+    std::lock_guard<std::mutex> lock(opening_mutex_);
+    if (opening_) {
+      return *opening_;
+    }
+  }
+  return BestGuess(candidates, deadline);
+}
+
+void HintEngine::Warm() {
+  std::vector<uint32_t> all(hurdles_.size());
+  for (uint32_t h = 0; h < all.size(); h++) {
+    all[h] = h;
+  }
+  Hint hint = BestGuess(all, std::chrono::steady_clock::time_point::max());
+  std::lock_guard<std::mutex> lock(opening_mutex_);
+  opening_ = hint;
+}
+
+Hint HintEngine::BestGuess(const std::vector<uint32_t>& candidates,
+                           std::chrono::steady_clock::time_point deadline) {
+  Hint best;
+  best.candidates = candidates.size();
+  if (candidates.empty()) {
+    return best;
+  }
+  if (candidates.size() <= 2) {
+    // Guessing a candidate can win outright and scores as well as anything.
+    best.guess = words_.Hurdles()[candidates[0]];
+    best.expected_info = candidates.size() == 2 ? 1 : 0;
+    return best;
+  }
+
+  // Score the candidates themselves first: they are usually among the best
+  // guesses late in a game, so they make a good answer if time runs out.
+  std::vector<uint32_t> order;
+  order.reserve(guesses_.size());
+  std::vector<bool> queued(guesses_.size(), false);
+  for (uint32_t h : candidates) {
+    const uint32_t g = hurdle_guess_index_[h];
+    if (!queued[g]) {
+      queued[g] = true;
+      order.push_back(g);
+    }
+  }
+  for (uint32_t g = 0; g < guesses_.size(); g++) {
+    if (!queued[g]) {
+      order.push_back(g);
+    }
+  }
+
+  const double n = candidates.size();
+  std::mutex best_mutex;
+  double best_score = -1;
+  uint32_t best_guess = order[0];
+  std::atomic<bool> complete{true};
+  pool_.ParallelFor(0, order.size(), 256, [&](size_t begin, size_t end) {
+    if (std::chrono::steady_clock::now() > deadline) {
+      complete = false;
+      return;
+    }
+    double local_score = -1;
+    uint32_t local_guess = 0;
+    for (size_t i = begin; i < end; i++) {
+      const PackedWord& guess = guesses_[order[i]];
+      uint16_t counts[kPatternCount] = {};
+      for (uint32_t h : candidates) {
+        counts[ScorePattern(guess, hurdles_[h])]++;
+      }
+      double sum = 0;
+      for (int p = 0; p < kPatternCount; p++) {
+        sum += xlogx_[counts[p]];
+      }
+      // A guess that may be the answer wins ties.
+      double score = std::log2(n) - sum / n;
+      if (counts[kAllGreen] > 0) {
+        score += 1e-9;
+      }
+      if (score > local_score) {
+        local_score = score;
+        local_guess = order[i];
+      }
+    }
+    // Ties between chunks go to the earlier guess, so hints don't depend on
+    // which thread finishes first.
+    std::lock_guard<std::mutex> lock(best_mutex);
+    if (local_score > best_score ||
+        (local_score == best_score && local_guess < best_guess)) {
+      best_score = local_score;
+      best_guess = local_guess;
+    }
+  });
+
+  best.guess = words_.Guesses()[best_guess];
+  best.expected_info = std::max(0.0, best_score);
+  best.complete = complete;
+  return best;
+}
@@ -0,0 +1,93 @@
+#include <chrono>
+#include <cstdint>
+#include <mutex>
+#include <optional>
+#include <string>
+#include <vector>
+
+#include "candidates.h"
+#include "hurdlewords.h"
+#include "patterns.h"
+#include "strategy.h"
+#include "threadpool.h"
+
+#ifndef HINT_H
+#define HINT_H
+
+struct Hint {
+  // The suggested guess, or empty if no hurdle fits the board.
+  std::string guess;
+  // Expected information of the guess, in bits.
+  double expected_info = 0;
+  // Number of hurdles still consistent with the board.
+  size_t candidates = 0;
+  // False if the latency budget ran out before every guess was scored, in
+  // which case `guess` is the best one found so far.
+  bool complete = true;
+  // Expected number of guesses left, including this one, when the hint
+  // comes from a strategy table. 0 otherwise.
+  double expected_guesses = 0;
+};
+
+// HintEngine suggests the guess that maximizes the expected information
+// (the entropy of the feedback pattern) over the hurdles still consistent
+// with a board. Guesses are scored in parallel chunks on a ThreadPool, and
+// scoring stops at a deadline with the best guess found so far. Boards that
+// followed a precomputed strategy table are answered from the table instead.
+class HintEngine {
+ public:
+  HintEngine(const HurdleWords& words, ThreadPool& pool);
+
+  // Time allowed for one hint.
+  std::chrono::milliseconds budget = std::chrono::milliseconds(150);
+  // Strategy table to look boards up in first, if any.
+  const StrategyTable* strategy = nullptr;
+
+  // Returns the indices into HurdleWords::Hurdles() of the hurdles that give
+  // `colors[i]` for every complete, valid `guesses[i]`.
+  std::vector<uint32_t> FilterCandidates(
+      const std::vector<std::string>& guesses,
+      const std::vector<std::string>& colors) const;
+
+  // Returns the best guess for a board, within `budget`.
+  Hint HintFor(const std::vector<std::string>& guesses,
+               const std::vector<std::string>& colors);
+  // Returns the best guess against the hurdles in `candidates`, such as
+  // HurdleGame::Candidates(), within `budget`.
+  Hint HintFor(const CandidateSet& candidates);
+  // Returns the best guess for a board whose remaining hurdles are already
+  // known to be `candidates`.
+  Hint HintFor(const std::vector<std::string>& guesses,
+               const std::vector<std::string>& colors,
+               const CandidateSet& candidates);
+
+  // Returns the best guess against `candidates`, scoring guesses until
+  // `deadline`.
+  Hint BestGuess(const std::vector<uint32_t>& candidates,
+                 std::chrono::steady_clock::time_point deadline);
+
+  // Computes the hint for an empty board without a deadline and caches it,
+  // since every game starts from that board.
+  void Warm();
+
+ private:
+  HurdleWords words_;
+  ThreadPool& pool_;
+  std::vector<PackedWord> guesses_;
+  std::vector<PackedWord> hurdles_;
+  // hurdle_guess_index_[h] is the index of hurdle h in the guess list.
+  std::vector<uint32_t> hurdle_guess_index_;
+  // xlogx_[n] is n * log2(n).
+  std::vector<double> xlogx_;
+
+  std::mutex opening_mutex_;
+  std::optional<Hint> opening_;
+
+  // Returns true and sets `hint` if the board is in the strategy table.
+  bool FromStrategy(const std::vector<std::string>& guesses,
+                    const std::vector<std::string>& colors, Hint* hint) const;
+  Hint HintForIndices(const std::vector<uint32_t>& candidates,
+                      std::chrono::steady_clock::time_point deadline);
+};
+
+#endif  // HINT_H
@@ -1,25 +1,50 @@
 #include "hurdle.h"
 
+#include "allocprofile.h"
+#include "phase.h"
+
 HurdleGame:: HurdleGame(HurdleWords words) : hurdle_words_(words) {
   NewHurdle();
 }
 
-void HurdleGame::NewHurdle() {
-  std::string new_hurdle = hurdle_words_.GetRandomHurdle();
-  hurdle_state_.SetHurdle(new_hurdle);
+void HurdleGame::NewHurdle(Difficulty difficulty) {
+  StartHurdle(hurdle_words_.GetRandomHurdle(difficulty));
+}
+
+void HurdleGame::StartHurdle(const std::string& hurdle) {
+  PhaseScope phase("HurdleGame::StartHurdle");
+  if (!finished_ && submitted_rows_ > 0) {
+    for (HurdleObserver* observer : observers_) {
+      observer->GameAbandoned(player_, hurdle_state_, submitted_rows_);
+    }
+  }
+  finished_ = false;
+  state_version_++;
+  hurdle_state_.SetHurdle(hurdle);
   hurdle_state_.ClearGuesses();
   hurdle_state_.SetColors({});
   hurdle_state_.SetErrorMessage("");
+  ResetSubmittedRows();
   UpdateStatus();
 }
 
 void HurdleGame::LetterEntered(char key) {
+  PhaseScope phase("HurdleGame::LetterEntered");
+  state_version_++;
   hurdle_state_.SetErrorMessage("");
   std::vector<std::string>& guesses = hurdle_state_.GetMutableGuesses();
   std::vector<std::string>& colors = hurdle_state_.GetMutableColors();
 
   if (guesses.empty() || guesses.back().size() == 5) {
-    // Start a new word if no words exist or the current word is completed
+    // Start a new word if no words exist or the current word is completed.
+    // A completed word that was not accepted yet is submitted first, and
+    // one that is rejected must be edited before the board moves on.
+    if (!guesses.empty()) {
+      if (!AcceptLastRow()) {
+        return;
+      }
+      UpdateStatus();
+    }
     guesses.push_back("");
     colors.push_back("");
   }
@@ -39,33 +64,55 @@ void HurdleGame::LetterEntered(char key) {
 
 
 void HurdleGame::WordSubmitted() {
-  std::vector<std::string>& guesses = hurdle_state_.GetMutableGuesses();
-  std::vector<std::string>& colors = hurdle_state_.GetMutableColors();
-
-  if (!guesses.empty()) {
-    std::string guess = guesses.back();
-    if (guess.length() != 5) {
-      hurdle_state_.SetErrorMessage("Not Enough Letters");
-      UpdateStatus();
-      return;
-    }
-    if (!hurdle_words_.IsGuessValid(guess)) {
-      hurdle_state_.SetErrorMessage("Not a valid guess");
-      UpdateStatus();
-      return;
-    }
+  PhaseScope phase("HurdleGame::WordSubmitted");
+  state_version_++;
+  // A rejected guess leaves the status as it was.
+  if (!hurdle_state_.GetGuesses().empty() && !AcceptLastRow()) {
+    return;
   }
   hurdle_state_.SetErrorMessage("");
   UpdateStatus();
 }
 
+bool HurdleGame::AcceptLastRow() {
+  const std::vector<std::string>& guesses = hurdle_state_.GetGuesses();
+  if (submitted_rows_ >= guesses.size()) {
+    return true;
+  }
+  const std::string& guess = guesses.back();
+  if (guess.length() != 5) {
+    hurdle_state_.SetErrorMessage("Not Enough Letters");
+    return false;
+  }
+  if (!hurdle_words_.IsGuessValid(guess)) {
+    hurdle_state_.SetErrorMessage("Not a valid guess");
+    return false;
+  }
+  if (hard_mode_) {
+    std::string violation = hard_mode_rules_.Violation(guess);
+    if (!violation.empty()) {
+      hurdle_state_.SetErrorMessage("Hard mode: " + violation);
+      return false;
+    }
+  }
+  ApplySubmittedRows(guesses.size(), true);
+  return true;
+}
+
 void HurdleGame::LetterDeleted() {
+  PhaseScope phase("HurdleGame::LetterDeleted");
+  state_version_++;
   hurdle_state_.SetErrorMessage("");
   std::vector<std::string>& guesses = hurdle_state_.GetMutableGuesses();
   std::vector<std::string>& colors = hurdle_state_.GetMutableColors();
   if (!guesses.empty()) {
     std::string& last_guess = guesses.back();
     if (!last_guess.empty()) {
+      if (guesses.size() <= submitted_rows_) {
+        // Editing a submitted row: start over from the rows above it.
+        ResetSubmittedRows();
+        ApplySubmittedRows(guesses.size() - 1, false);
+      }
       last_guess.pop_back();
       colors.back().pop_back();
     } else {
@@ -84,6 +131,7 @@ void HurdleGame::LetterDeleted() {
 }
 
 crow::json::wvalue HurdleGame::JsonFromHurdleState() {
+  PhaseScope phase("HurdleGame::JsonFromHurdleState");
   crow::json::wvalue hurdle_state_json({});
 
   hurdle_state_json["answer"] = hurdle_state_.GetHurdle();
@@ -91,32 +139,183 @@ crow::json::wvalue HurdleGame::JsonFromHurdleState() {
   hurdle_state_json["guessedWords"] = hurdle_state_.GetGuesses();
   hurdle_state_json["gameStatus"] = hurdle_state_.GetStatus();
   hurdle_state_json["errorMessage"] = hurdle_state_.GetErrorMessage();
+  hurdle_state_json["remainingHurdles"] = candidates_.Count();
+  hurdle_state_json["hardMode"] = hard_mode_;
 
   return hurdle_state_json;
 }
 
+const HurdleState& HurdleGame::GetHurdleState() const {
+  return hurdle_state_;
+}
+
+const CandidateSet& HurdleGame::Candidates() const {
+  return candidates_;
+}
+
+std::vector<std::string> HurdleGame::SubmittedGuesses() const {
+  std::vector<std::string> guesses = hurdle_state_.GetGuesses();
+  guesses.resize(std::min(submitted_rows_, guesses.size()));
+  return guesses;
+}
+
+std::vector<std::string> HurdleGame::SubmittedColors() const {
+  std::vector<std::string> colors = hurdle_state_.GetColors();
+  colors.resize(std::min(submitted_rows_, colors.size()));
+  return colors;
+}
+
+void HurdleGame::SetHardMode(bool hard_mode) {
+  state_version_++;
+  hard_mode_ = hard_mode;
+}
+
+bool HurdleGame::HardMode() const {
+  return hard_mode_;
+}
+
+void HurdleGame::AddObserver(HurdleObserver* observer) {
+  observers_.push_back(observer);
+}
+
+void HurdleGame::SetPlayer(const std::string& player) {
+  player_ = player;
+}
+
+const std::string& HurdleGame::Player() const {
+  return player_;
+}
+
+uint64_t HurdleGame::StateVersion() const {
+  return state_version_;
+}
+
+const std::string& HurdleGame::SerializedHurdleState() {
+  // Version 0 is never current, since the constructor starts a new hurdle.
+  if (serialized_version_ != state_version_) {
+    PhaseScope phase("HurdleGame::SerializedHurdleState");
+    serialized_state_ = JsonFromHurdleState().dump();
+    serialized_version_ = state_version_;
+  }
+  return serialized_state_;
+}
+
+namespace {
+
+// Empty strings are written as "-" so every field is a single token.
+std::string EncodeField(const std::string& field) {
+  return field.empty() ? "-" : field;
+}
+
+std::string DecodeField(const std::string& field) {
+  return field == "-" ? "" : field;
+}
+
+}  // namespace
+
+void HurdleGame::SaveState(std::ostream& out) const {
+  const std::vector<std::string>& guesses = hurdle_state_.GetGuesses();
+  const std::vector<std::string>& colors = hurdle_state_.GetColors();
+  out << state_version_ << ' ' << EncodeField(hurdle_state_.GetHurdle()) << ' '
+      << EncodeField(hurdle_state_.GetStatus()) << ' ' << guesses.size();
+  for (size_t i = 0; i < guesses.size(); i++) {
+    out << ' ' << EncodeField(guesses[i]) << ' '
+        << EncodeField(i < colors.size() ? colors[i] : "");
+  }
+  out << ' ' << hard_mode_ << ' ' << EncodeField(player_) << ' '
+      << std::min(submitted_rows_, guesses.size());
+}
+
+bool HurdleGame::LoadState(std::istream& in) {
+  uint64_t version;
+  std::string hurdle;
+  std::string status;
+  size_t rows;
+  if (!(in >> version >> hurdle >> status >> rows) || rows > 64) {
+    return false;
+  }
+  std::vector<std::string> guesses(rows);
+  std::vector<std::string> colors(rows);
+  for (size_t i = 0; i < rows; i++) {
+    if (!(in >> guesses[i] >> colors[i])) {
+      return false;
+    }
+    guesses[i] = DecodeField(guesses[i]);
+    colors[i] = DecodeField(colors[i]);
+  }
+  bool hard_mode = false;
+  std::string player = "-";
+  size_t submitted_rows;
+  if (!(in >> hard_mode >> player >> submitted_rows)) {
+    // Games saved without the number of submitted rows count a complete last
+    // row as submitted, as its colors are already on the board.
+    submitted_rows = rows > 0 && guesses.back().size() < 5 ? rows - 1 : rows;
+  }
+
+  hurdle_state_.SetHurdle(DecodeField(hurdle));
+  hurdle_state_.SetStatus(DecodeField(status));
+  hurdle_state_.SetGuesses(guesses);
+  hurdle_state_.SetColors(colors);
+  hurdle_state_.SetErrorMessage("");
+  hard_mode_ = hard_mode;
+  player_ = DecodeField(player);
+  finished_ = hurdle_state_.GetStatus() != "active";
+  state_version_ = version;
+  serialized_version_ = 0;
+  ResetSubmittedRows();
+  ApplySubmittedRows(std::min(submitted_rows, rows), false);
+  return true;
+}
+
+void HurdleGame::ResetSubmittedRows() {
+  candidates_ = hurdle_words_.Candidates().All();
+  hard_mode_rules_.Clear();
+  submitted_rows_ = 0;
+}
+
+void HurdleGame::ApplySubmittedRows(size_t rows, bool accepted) {
+  const std::vector<std::string>& guesses = hurdle_state_.GetMutableGuesses();
+  const std::vector<std::string>& colors = hurdle_state_.GetMutableColors();
+  for (size_t i = submitted_rows_; i < rows && i < guesses.size(); i++) {
+    Pattern pattern;
+    if (guesses[i].size() == kWordLength &&
+        (accepted || hurdle_words_.IsGuessValid(guesses[i])) &&
+        i < colors.size() && PatternFromColors(colors[i], &pattern)) {
+      candidates_.Intersect(
+          *hurdle_words_.Candidates().Mask(guesses[i], pattern));
+      hard_mode_rules_.AddRow(guesses[i], colors[i]);
+    }
+  }
+  submitted_rows_ = std::max(submitted_rows_, rows);
+}
+
 void HurdleGame::UpdateStatus() {
+  // Only accepted rows count, so a rejected or unfinished row never ends
+  // the game.
   const std::vector<std::string>& guesses = hurdle_state_.GetGuesses();
   const std::string& hurdle = hurdle_state_.GetHurdle();
-  
-  if (guesses.empty()) {
-    hurdle_state_.SetStatus("active");
-    return;
-  }
-  
-  if (std::find(guesses.begin(), guesses.end(), hurdle) != guesses.end()) {
+  const size_t accepted = std::min(submitted_rows_, guesses.size());
+  const auto accepted_end = guesses.begin() + accepted;
+
+  if (std::find(guesses.begin(), accepted_end, hurdle) != accepted_end) {
     hurdle_state_.SetStatus("win");
-    return;
-  }
-  
-  if (guesses.size() >= 6) {
+  } else if (accepted >= 6) {
     hurdle_state_.SetStatus("lose");
   } else {
     hurdle_state_.SetStatus("active");
+    return;
+  }
+  if (!finished_) {
+    finished_ = true;
+    for (HurdleObserver* observer : observers_) {
+      observer->GameFinished(player_, hurdle_state_);
+    }
   }
 }
 
-std::string HurdleGame::CalculateColors(const std::string& guess) {
+std::string HurdleGame::CalculateColors(const std::string& guess) const {
+  allocprofile::Scope alloc_scope(allocprofile::Dimension::kPhase,
+                                  "HurdleGame::CalculateColors");
   const std::string hurdle = hurdle_state_.GetHurdle();
   std::string colors(guess.length(), 'B');
 
@@ -1,6 +1,10 @@
+#include <cstdint>
+#include <iostream>
 #include <string>
 #include <vector>
 
+#include "candidates.h"
+#include "hardmode.h"
 #include "hurdlewords.h"
 #include "hurdlestate.h"
 #include "server_utils/crow_all.h"
@@ -8,22 +12,115 @@
 #ifndef HURDLE_H
 #define HURDLE_H
 
+// HurdleObserver is told when a game ends. It is called on the thread that
+// handles the game's request, so it must return quickly. `player` is the id
+// set with HurdleGame::SetPlayer, empty for anonymous games.
+class HurdleObserver {
+ public:
+  virtual ~HurdleObserver() = default;
+  // Called once per game, when an accepted guess takes its status from
+  // active to win or lose.
+  virtual void GameFinished(const std::string& player,
+                            const HurdleState& state) = 0;
+  // Called when a game with at least one submitted guess is replaced by a
+  // new one before it finished. `submitted_rows` is the number of guesses
+  // that were submitted.
+  virtual void GameAbandoned(const std::string& player,
+                             const HurdleState& state,
+                             size_t submitted_rows) = 0;
+};
+
 class HurdleGame {
  public:
   HurdleGame(HurdleWords words);
 
-  void NewHurdle();
+  // Starts a new game with a random hurdle of the given difficulty.
+  void NewHurdle(Difficulty difficulty = Difficulty::kAny);
+  // Starts a new game with `hurdle` as the answer, e.g. the daily hurdle.
+  void StartHurdle(const std::string& hurdle);
   void LetterEntered(char key);
   void WordSubmitted();
   void LetterDeleted();
   crow::json::wvalue JsonFromHurdleState();
 
+  // Returns the colors ('G', 'Y' or 'B' per letter) of `guess` against the
+  // current hurdle.
+  std::string CalculateColors(const std::string& guess) const;
+
+  const HurdleState& GetHurdleState() const;
+
+  // Returns the hurdles still consistent with the colors of every submitted
+  // guess. The set is narrowed down as guesses are submitted, rather than
+  // recomputed from the board.
+  const CandidateSet& Candidates() const;
+
+  // Return the guesses and colors of the submitted rows only. A row still
+  // being typed, or one hard mode rejected, is left out, though its colors
+  // are already on the board.
+  std::vector<std::string> SubmittedGuesses() const;
+  std::vector<std::string> SubmittedColors() const;
+
+  // In hard mode, a submitted guess must reuse every green letter in place
+  // and contain every yellow letter revealed so far.
+  void SetHardMode(bool hard_mode);
+  bool HardMode() const;
+
+  // Reports the end of every game from now on to `observer`, which must
+  // outlive this game.
+  void AddObserver(HurdleObserver* observer);
+
+  // Sets the id of the player the following games are reported for.
+  void SetPlayer(const std::string& player);
+  const std::string& Player() const;
+
+  // Returns a counter that changes every time the game state is mutated.
+  // Clients can use it to tell whether a previously fetched state is stale.
+  uint64_t StateVersion() const;
+
+  // Returns the serialized JSON of JsonFromHurdleState(). The body is cached
+  // and only rebuilt after the next mutation.
+  const std::string& SerializedHurdleState();
+
+  // Writes the game on a single line, so it can be handed over to another
+  // server process. The error message is transient and not written.
+  // The hard mode flag, the player id and the number of submitted rows come
+  // last and are optional when loading.
+  void SaveState(std::ostream& out) const;
+  // Restores a game written by SaveState. Returns false if the input is
+  // malformed, in which case the game is left unchanged.
+  bool LoadState(std::istream& in);
+
  private:
   HurdleState hurdle_state_;
   HurdleWords hurdle_words_;
+  uint64_t state_version_ = 0;
+  // serialized_state_ holds the dump of the state at serialized_version_.
+  std::string serialized_state_;
+  uint64_t serialized_version_ = 0;
+  CandidateSet candidates_;
+  // Number of rows, from the top of the board, already applied to
+  // candidates_.
+  size_t submitted_rows_ = 0;
+  bool hard_mode_ = false;
+  // Compiled from the same rows as candidates_.
+  HardModeRules hard_mode_rules_;
+  std::vector<HurdleObserver*> observers_;
+  std::string player_;
+  // Set once the current game has been reported as finished, so a win that
+  // is edited away and won again is only counted once.
+  bool finished_ = false;
 
   void UpdateStatus();
-  std::string CalculateColors(const std::string& guess);
+  // Checks the last row as a submitted guess. Accepted rows are applied;
+  // a rejected row sets the error message and returns false. Every row
+  // above the last one has been accepted, since a new row is only started
+  // once the one before it is.
+  bool AcceptLastRow();
+  void ResetSubmittedRows();
+  // Narrows candidates_ down and adds to hard_mode_rules_ every complete,
+  // valid row below `rows` that has not been applied yet. Rows AcceptLastRow
+  // has just `accepted` are not looked up in the dictionary again.
+  void ApplySubmittedRows(size_t rows, bool accepted);
 };
 
 #endif  // HURDLE_H
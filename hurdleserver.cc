@@ -0,0 +1,709 @@
+#include "hurdleserver.h"
+
+#include <algorithm>
+#include <cctype>
+#include <chrono>
+#include <cstdlib>
+#include <memory>
+#include <string>
+#include <string_view>
+#include <thread>
+#include <utility>
+#include <vector>
+
+#include "allocprofile.h"
+
+bool ETagMatches(const std::string& if_none_match, const std::string& etag) {
+  size_t start = 0;
+  while (start < if_none_match.size()) {
+    size_t end = if_none_match.find(',', start);
+    if (end == std::string::npos) {
+      end = if_none_match.size();
+    }
+    std::string_view tag(if_none_match.data() + start, end - start);
+    while (!tag.empty() && (tag.front() == ' ' || tag.front() == '\t')) {
+      tag.remove_prefix(1);
+    }
+    while (!tag.empty() && (tag.back() == ' ' || tag.back() == '\t')) {
+      tag.remove_suffix(1);
+    }
+    if (tag == "*") {
+      return true;
+    }
+    if (tag.substr(0, 2) == "W/") {
+      tag.remove_prefix(2);
+    }
+    if (tag == etag) {
+      return true;
+    }
+    start = end + 1;
+  }
+  return false;
+}
+
+namespace {
+
+// Builds the response carrying the state of the session's game. The ETag is
+// derived from the session token and the game's state version, so a client
+// that already holds the current state gets a 304 without the state being
+// serialized again. Bodies above the compressor's threshold are compressed
+// with the encoding negotiated from Accept-Encoding, and the compressed body
+// is reused until the game changes. The size of every state sent, before
+// compression, is added to `state_bytes`.
+crow::response GameStateResponse(const crow::request& req,
+                                 GameMiddleware::context& ctx,
+                                 ResponseCompressor& compressor,
+                                 Counter& state_bytes) {
+  GameSession& session = ctx.GetData();
+  HurdleGame& game = session.game;
+  const std::string& body = game.SerializedHurdleState();
+  ContentEncoding encoding =
+      ResponseCompressor::Negotiate(req.get_header_value("Accept-Encoding"));
+  if (!compressor.ShouldCompress(body.size(), encoding)) {
+    encoding = ContentEncoding::kIdentity;
+  }
+
+  std::string etag = "\"" + ctx.GetSession()->token + "-" +
+                     std::to_string(game.StateVersion());
+  if (encoding != ContentEncoding::kIdentity) {
+    etag += std::string("-") + ResponseCompressor::EncodingName(encoding);
+  }
+  etag += "\"";
+
+  crow::response res;
+  res.set_header("ETag", etag);
+  res.set_header("Cache-Control", "no-cache");
+  res.set_header("Vary", "Accept-Encoding");
+  if (ETagMatches(req.get_header_value("If-None-Match"), etag)) {
+    res.code = 304;
+    return res;
+  }
+  state_bytes.Add(body.size());
+  res.set_header("Content-Type", "application/json");
+  if (encoding != ContentEncoding::kIdentity) {
+    crow::trace_span span("ResponseCompressor::CompressCached");
+    const std::string* compressed = compressor.CompressCached(
+        body, encoding, game.StateVersion(), session.compressed_bodies);
+    if (compressed != nullptr) {
+      res.body = *compressed;
+      res.set_header("Content-Encoding",
+                     ResponseCompressor::EncodingName(encoding));
+      return res;
+    }
+  }
+  res.body = body;
+  return res;
+}
+
+// Whether `player` can be used as a player id: a single word of printable
+// characters, so that it is saved with the session as one field.
+bool IsValidPlayer(const std::string& player) {
+  return player.size() <= 64 && player != "-" &&
+         std::all_of(player.begin(), player.end(), [](unsigned char c) {
+           return std::isgraph(c);
+         });
+}
+
+// Returns the session's game, with its results recorded for the player id
+// sent in the X-Hurdle-Player-ID header. A session is bound to the first id
+// it sends, and returns nullptr for requests sending another one or an
+// invalid one, so every game of the session is credited to the same player.
+// Games of sessions without an id are anonymous.
+//
+// Player ids are not secret: anyone who knows an id can bind a session of
+// their own to it and play as that player. They keep the records of honest
+// players apart, and are no proof of identity.
+HurdleGame* PlayerGame(const crow::request& req,
+                       GameMiddleware::context& ctx) {
+  HurdleGame& game = ctx.GetData().game;
+  const std::string& player = req.get_header_value("X-Hurdle-Player-ID");
+  if (!IsValidPlayer(player)) {
+    return nullptr;
+  }
+  if (game.Player().empty()) {
+    game.SetPlayer(player);
+  } else if (!player.empty() && player != game.Player()) {
+    return nullptr;
+  }
+  return &game;
+}
+
+// The response to a request whose player id is invalid or differs from its
+// session's.
+crow::response PlayerMismatchResponse() {
+  return crow::response(
+      403, "X-Hurdle-Player-ID is invalid or does not match the session");
+}
+
+// Returns the allocation counts, or bytes, of every name of `dimension` as
+// metric values labelled `label`.
+std::vector<std::pair<std::string, double>> AllocationValues(
+    allocprofile::Dimension dimension, const std::string& label, bool bytes) {
+  std::vector<std::pair<std::string, double>> values;
+  for (const auto& [name, counts] : allocprofile::Totals(dimension)) {
+    values.emplace_back(label + "=\"" + name + "\"",
+                        bytes ? counts.bytes : counts.allocations);
+  }
+  return values;
+}
+
+}  // namespace
+
+HurdleServer::HurdleServer(HurdleWords& hurdlewords, uint64_t daily_key,
+                           StartupTimer& startup)
+    : hurdlewords_(hurdlewords),
+      startup_(startup),
+      stats_(hurdlewords),
+      daily_(hurdlewords, daily_key),
+      hint_engine_(hurdlewords, pool_) {
+  ConfigureMiddlewares();
+  RegisterMetrics();
+  RegisterRoutes();
+
+  // Every game reports how it ended to the statistics, which are merged in
+  // the background and served by /stats, and to the leaderboard.
+  stats_.Start();
+
+  // Hints are scored on the thread pool. The hint for an empty board is the
+  // same for every game, so it is computed once in the background, as are
+  // the difficulty tiers of the hurdles. The server is not ready until both
+  // are done: new games would not honor ?difficulty=, and the first hints
+  // would be slow.
+  startup_.Begin("difficulty tiers");
+  startup_.Begin("hint warmup");
+  pool_.Submit([this] {
+    hurdlewords_.Difficulties().Compute(pool_);
+    startup_.End("difficulty tiers");
+  });
+  pool_.Submit([this] {
+    hint_engine_.Warm();
+    startup_.End("hint warmup");
+  });
+}
+
+HurdleServer::~HurdleServer() {
+  StopProfiling();
+  if (profile_thread_.joinable()) {
+    profile_thread_.join();
+  }
+}
+
+void HurdleServer::DisableClientRateLimits() {
+  auto& rate_limit_middleware = app.get_middleware<RateLimitMiddleware>();
+  rate_limit_middleware.ip_rate = rate_limit_middleware.ip_burst = 1e9;
+  rate_limit_middleware.session_rate = rate_limit_middleware.session_burst =
+      1e9;
+  rate_limit_middleware.new_session_rate =
+      rate_limit_middleware.new_session_burst = 1e9;
+}
+
+void HurdleServer::StopProfiling() {
+  {
+    std::lock_guard<std::mutex> lock(profile_mutex_);
+    profiling_stopped_ = true;
+  }
+  profile_wake_.notify_all();
+}
+
+bool HurdleServer::LoadStrategy(const std::string& path) {
+  if (!strategy_.Open(path, hurdlewords_)) {
+    return false;
+  }
+  hint_engine_.strategy = &strategy_;
+  return true;
+}
+
+void HurdleServer::ConfigureMiddlewares() {
+  // Initialize Cross-Origin Resource Sharing (CORS) to allow the frontend to
+  // access the server.
+  auto& cors_middleware = app.get_middleware<crow::CORSHandler>();
+  cors_middleware.global().origin("*");
+  cors_middleware.global().max_age(7200);  // Chrome's maximum
+  // Pages of other origins must not read the diagnostic routes, even from
+  // the browser of an operator on the server's host.
+  for (const std::string& prefix :
+       app.get_middleware<DiagnosticsMiddleware>().prefixes) {
+    cors_middleware.prefix(prefix).ignore();
+  }
+
+  // Initialize the session middleware to allow the server to keep track of
+  // multiple games.
+  auto& session_middleware = app.get_middleware<GameMiddleware>();
+  session_middleware.header_name = "X-Hurdle-Game-ID";
+  session_middleware.constructor = [this]() {
+    HurdleGame game(hurdlewords_);
+    game.AddObserver(&stats_);
+    game.AddObserver(&leaderboard_);
+    return GameSession(std::move(game));
+  };
+  app.get_middleware<CaptureMiddleware>().session_header =
+      session_middleware.header_name;
+
+  // Limit how fast a single client can send keystrokes or create games.
+  // Requests with a token that is not a live session create a game too.
+  auto& rate_limit_middleware = app.get_middleware<RateLimitMiddleware>();
+  rate_limit_middleware.header_name = session_middleware.header_name;
+  rate_limit_middleware.is_live_session =
+      [&session_middleware](const std::string& token) {
+        return session_middleware.Has(token);
+      };
+  // Profiles and hints are answered from other threads without holding up
+  // the worker, and a profile waits for its whole duration, so their
+  // latency would only skew the one that load shedding watches.
+  rate_limit_middleware.unmeasured_prefixes = {"/debug/", "/hint"};
+
+  // Answer preflights with the same CORS policy from a prebuilt response, and
+  // let the frontend read the session header.
+  auto& preflight_middleware = app.get_middleware<PreflightMiddleware>();
+  preflight_middleware.origin("*").max_age(7200);
+  preflight_middleware.expose(session_middleware.header_name);
+
+  // In allocation profiling builds, attribute allocations to the route of
+  // the request and to the session middleware's phases.
+  if (allocprofile::Enabled()) {
+    using allocprofile::Dimension;
+    auto& route_scope = app.get_middleware<MetricsMiddleware>().route_scope;
+    route_scope.enter = [](const char* name) {
+      return allocprofile::Enter(Dimension::kRoute, name);
+    };
+    route_scope.leave = [](size_t previous) {
+      allocprofile::Leave(Dimension::kRoute, previous);
+    };
+    session_middleware.phase_scope.enter = [](const char* name) {
+      return allocprofile::Enter(Dimension::kPhase, name);
+    };
+    session_middleware.phase_scope.leave = [](size_t previous) {
+      allocprofile::Leave(Dimension::kPhase, previous);
+    };
+  }
+
+  // Compress game states that are large enough to benefit from it. Boards
+  // with fewer than four rows barely shrink once gzip's framing is added.
+  compressor_.min_size = 160;
+}
+
+void HurdleServer::RegisterMetrics() {
+  auto& sessions = app.get_middleware<GameMiddleware>();
+  auto& rate_limits = app.get_middleware<RateLimitMiddleware>();
+  app.get_middleware<MetricsMiddleware>().Register(
+      metrics, {"/wordle_key_pressed", "/enter_pressed", "/delete_pressed",
+                "/new_game", "/daily", "/toggle_hard_mode", "/hint",
+                "/search", "/leaderboard", "/stats", "/game", "/metrics",
+                "/trace", "/ready", "/debug"});
+  sessions.cleanup_latency = &metrics.AddHistogram(
+      "hurdle_session_cleanup_duration_seconds",
+      "Time to sweep the sessions for expired ones, once per request.");
+  metrics.AddGauge("hurdle_sessions", "Live sessions.",
+                   [&sessions] { return sessions.SessionCount(); });
+  metrics.AddCounterFunc(
+      "hurdle_sessions_created_total", "Sessions created.",
+      [&sessions] { return sessions.CreatedCount(); });
+  metrics.AddCounterFunc(
+      "hurdle_sessions_expired_total", "Sessions removed after max_age.",
+      [&sessions] { return sessions.ExpiredCount(); });
+  metrics.AddGauge(
+      "hurdle_startup_seconds",
+      "Time the server took to become ready, 0 until it is.",
+      [this] {
+        return std::chrono::duration<double>(startup_.TimeToReady()).count();
+      });
+  state_bytes_ = &metrics.AddCounter(
+      "hurdle_state_bytes_total",
+      "Bytes of serialized game state sent, before compression.");
+  metrics.AddCounterFunc(
+      "hurdle_dictionary_lookups_total", "Guesses looked up in the dictionary.",
+      [this] { return hurdlewords_.LookupCount(); });
+  metrics.AddCounterFunc(
+      "hurdle_compressed_responses_total", "Bodies compressed.",
+      [this] { return compressor_.CompressedCount(); });
+  metrics.AddCounterFunc(
+      "hurdle_compression_cache_hits_total", "Compressed bodies reused.",
+      [this] { return compressor_.CacheHits(); });
+  metrics.AddCounterFunc(
+      "hurdle_compression_saved_bytes_total", "Bytes saved by compression.",
+      [this] { return compressor_.BytesSaved(); });
+  metrics.AddCounterFunc(
+      "hurdle_compression_seconds_total", "CPU time spent compressing.",
+      [this] { return compressor_.CpuNanos() / 1e9; });
+  metrics.AddCounterFunc(
+      "hurdle_rate_limited_total", "Requests rejected with 429.",
+      [&rate_limits] { return rate_limits.RateLimitedCount(); });
+  metrics.AddCounterFunc(
+      "hurdle_shed_total", "Requests rejected with 503 under load.",
+      [&rate_limits] { return rate_limits.ShedCount(); });
+  metrics.AddGauge("hurdle_requests_in_flight", "Requests being handled.",
+                   [&rate_limits] { return rate_limits.InFlight(); });
+  // Servers built with make build_allocs count heap allocations by route
+  // and by phase.
+  if (allocprofile::Enabled()) {
+    using allocprofile::Dimension;
+    metrics.AddCounterFamily(
+        "hurdle_route_allocations_total", "Heap allocations, by route.",
+        [] { return AllocationValues(Dimension::kRoute, "route", false); });
+    metrics.AddCounterFamily(
+        "hurdle_route_allocated_bytes_total", "Bytes allocated, by route.",
+        [] { return AllocationValues(Dimension::kRoute, "route", true); });
+    metrics.AddCounterFamily(
+        "hurdle_phase_allocations_total", "Heap allocations, by phase.",
+        [] { return AllocationValues(Dimension::kPhase, "phase", false); });
+    metrics.AddCounterFamily(
+        "hurdle_phase_allocated_bytes_total", "Bytes allocated, by phase.",
+        [] { return AllocationValues(Dimension::kPhase, "phase", true); });
+  }
+}
+
+void HurdleServer::RegisterRoutes() {
+  // Every time a letter is pressed on the Hurdle frontend, that letter
+  // is passed to this function, which is passed to LetterEntered. A letter
+  // typed past a complete row submits it, so it can end the game too.
+  CROW_ROUTE(app, "/wordle_key_pressed/<string>")
+  ([this](const crow::request& req, std::string s) {
+    auto& ctx = app.get_context<GameMiddleware>(req);
+    HurdleGame* game = PlayerGame(req, ctx);
+    if (game == nullptr) {
+      return PlayerMismatchResponse();
+    }
+    game->LetterEntered(s.at(0));
+    return GameStateResponse(req, ctx, compressor_, *state_bytes_);
+  });
+
+  // Every time the enter key is pressed on the Hurdle frontend,
+  // the WordSubmitted function is called.
+  CROW_ROUTE(app, "/enter_pressed")
+  ([this](const crow::request& req) {
+    auto& ctx = app.get_context<GameMiddleware>(req);
+    HurdleGame* game = PlayerGame(req, ctx);
+    if (game == nullptr) {
+      return PlayerMismatchResponse();
+    }
+    game->WordSubmitted();
+    return GameStateResponse(req, ctx, compressor_, *state_bytes_);
+  });
+
+  // Every time the backspace key is pressed on the Hurdle frontend,
+  // the LetterDeleted function is called.
+  CROW_ROUTE(app, "/delete_pressed")
+  ([this](const crow::request& req) {
+    auto& ctx = app.get_context<GameMiddleware>(req);
+    ctx.GetData().game.LetterDeleted();
+    return GameStateResponse(req, ctx, compressor_, *state_bytes_);
+  });
+
+  // Every time the "Next Hurdle" button is pressed on the Hurdle frontend,
+  // the NewHurdle function is called. An optional ?difficulty=easy, medium
+  // or hard picks the tier of the new hurdle.
+  CROW_ROUTE(app, "/new_game")
+  ([this](const crow::request& req) {
+    auto& ctx = app.get_context<GameMiddleware>(req);
+    Difficulty difficulty = Difficulty::kAny;
+    if (const char* name = req.url_params.get("difficulty")) {
+      ParseDifficulty(name, &difficulty);
+    }
+    HurdleGame* game = PlayerGame(req, ctx);
+    if (game == nullptr) {
+      return PlayerMismatchResponse();
+    }
+    game->NewHurdle(difficulty);
+    return GameStateResponse(req, ctx, compressor_, *state_bytes_);
+  });
+
+  // Starts the daily hurdle. ?date=YYYY-MM-DD defaults to today in UTC, and
+  // ?region= lets regions play different puzzles on the same day.
+  CROW_ROUTE(app, "/daily")
+  ([this](const crow::request& req) {
+    int64_t day = DailySchedule::Today();
+    if (const char* date = req.url_params.get("date")) {
+      if (!DailySchedule::ParseDate(date, &day)) {
+        return crow::response(400, "Expected date=YYYY-MM-DD");
+      }
+    }
+    const char* region = req.url_params.get("region");
+    const std::string& hurdle = daily_.Hurdle(day, region ? region : "");
+    if (hurdle.empty()) {
+      return crow::response(503, "No daily hurdle");
+    }
+    auto& ctx = app.get_context<GameMiddleware>(req);
+    HurdleGame* game = PlayerGame(req, ctx);
+    if (game == nullptr) {
+      return PlayerMismatchResponse();
+    }
+    game->StartHurdle(hurdle);
+    return GameStateResponse(req, ctx, compressor_, *state_bytes_);
+  });
+
+  // Turns hard mode on or off for the current game.
+  CROW_ROUTE(app, "/toggle_hard_mode")
+  ([this](const crow::request& req) {
+    auto& ctx = app.get_context<GameMiddleware>(req);
+    HurdleGame& game = ctx.GetData().game;
+    game.SetHardMode(!game.HardMode());
+    return GameStateResponse(req, ctx, compressor_, *state_bytes_);
+  });
+
+  // Suggests the guess expected to narrow down the remaining hurdles the
+  // most, given the feedback on the submitted guesses. The search runs on the
+  // thread pool, from a copy of the board, and the response is sent from
+  // there, so the worker keeps serving meanwhile. Requests replayed
+  // in-process have no connection to send it on, so theirs are searched
+  // at once.
+  CROW_ROUTE(app, "/hint")
+  ([this](const crow::request& req, crow::response& res) {
+    auto& game = app.get_context<GameMiddleware>(req).GetData().game;
+    auto send_hint = [](const Hint& hint, crow::response& res) {
+      crow::json::wvalue hint_json({});
+      hint_json["hint"] = hint.guess;
+      hint_json["expectedInfo"] = hint.expected_info;
+      hint_json["candidates"] = hint.candidates;
+      hint_json["complete"] = hint.complete;
+      hint_json["expectedGuesses"] = hint.expected_guesses;
+      res.set_header("Content-Type", "application/json");
+      res.body = hint_json.dump();
+      res.end();
+    };
+    if (req.io_service == nullptr) {
+      send_hint(hint_engine_.HintFor(game.SubmittedGuesses(),
+                                     game.SubmittedColors(), game.Candidates()),
+                res);
+      return;
+    }
+    pool_.Submit([this, &res, send_hint, poster = req.poster(),
+                  guesses = game.SubmittedGuesses(),
+                  colors = game.SubmittedColors(),
+                  candidates = game.Candidates()] {
+      Hint hint = hint_engine_.HintFor(guesses, colors, candidates);
+      poster.post([&res, send_hint, hint = std::move(hint)] {
+        send_hint(hint, res);
+      });
+    });
+  });
+
+  // Lists the valid guesses matching ?pattern= (e.g. ?a??e) that contain the
+  // letters of ?include= and none of ?exclude=. ?limit= caps the number of
+  // words returned, 100 by default; count is the total number of matches.
+  CROW_ROUTE(app, "/search")
+  ([this](const crow::request& req) {
+    auto param = [&](const char* name) {
+      const char* value = req.url_params.get(name);
+      return std::string(value ? value : "");
+    };
+    std::vector<uint32_t> matches;
+    if (!hurdlewords_.Search().Search(param("pattern"), param("include"),
+                                     param("exclude"), &matches)) {
+      return crow::response(400, "Expected pattern=?a??e, include= and "
+                                 "exclude= letters");
+    }
+    size_t limit = 100;
+    if (const char* value = req.url_params.get("limit")) {
+      limit = std::strtoul(value, nullptr, 10);
+    }
+    std::vector<crow::json::wvalue> words;
+    for (size_t i = 0; i < matches.size() && i < limit; i++) {
+      words.push_back(hurdlewords_.Guesses()[matches[i]]);
+    }
+    crow::json::wvalue search_json({});
+    search_json["count"] = matches.size();
+    search_json["words"] = std::move(words);
+    return crow::response(search_json);
+  });
+
+  // Serves the statistics as of the last aggregation: win rate, guess
+  // distribution, abandoned games and the most common first guesses, over
+  // every game or, with ?hurdle=, over the games of one hurdle.
+  CROW_ROUTE(app, "/stats")
+  ([this](const crow::request& req) {
+    std::shared_ptr<const StatsSnapshot> snapshot = stats_.Snapshot();
+    const GameCounts* counts = &snapshot->total;
+    crow::json::wvalue stats_json({});
+    if (const char* hurdle = req.url_params.get("hurdle")) {
+      const int index = stats_.HurdleIndex(hurdle);
+      if (index < 0) {
+        return crow::response(404, "Unknown hurdle");
+      }
+      counts = &snapshot->hurdles[index];
+      stats_json["hurdle"] = hurdle;
+    }
+    stats_json["generation"] = snapshot->generation;
+    stats_json["wins"] = counts->Wins();
+    stats_json["losses"] = counts->losses;
+    stats_json["abandoned"] = counts->abandoned;
+    stats_json["winRate"] = counts->WinRate();
+    std::vector<crow::json::wvalue> distribution;
+    for (uint64_t count : counts->guesses) {
+      distribution.push_back(count);
+    }
+    stats_json["guessDistribution"] = std::move(distribution);
+    if (counts == &snapshot->total) {
+      std::vector<crow::json::wvalue> first_guesses;
+      for (const auto& [guess, count] : snapshot->first_guesses) {
+        crow::json::wvalue entry({});
+        entry["guess"] = guess;
+        entry["count"] = count;
+        first_guesses.push_back(std::move(entry));
+      }
+      stats_json["firstGuesses"] = std::move(first_guesses);
+    }
+    return crow::response(stats_json);
+  });
+
+  // Lists the best players by current streak, or with ?by=average by average
+  // guesses per win. ?count= defaults to 10. The record of the player in the
+  // X-Hurdle-Player-ID header, if any, is added as "you".
+  CROW_ROUTE(app, "/leaderboard")
+  ([this](const crow::request& req) {
+    Leaderboard::Ranking ranking = Leaderboard::Ranking::kStreak;
+    if (const char* by = req.url_params.get("by")) {
+      if (std::string(by) == "average") {
+        ranking = Leaderboard::Ranking::kAverageGuesses;
+      } else if (std::string(by) != "streak") {
+        return crow::response(400, "Expected by=streak or by=average");
+      }
+    }
+    size_t count = 10;
+    if (const char* value = req.url_params.get("count")) {
+      count = std::strtoul(value, nullptr, 10);
+    }
+    auto record_json = [](const PlayerRecord& record) {
+      crow::json::wvalue json({});
+      json["player"] = record.player;
+      json["streak"] = record.streak;
+      json["bestStreak"] = record.best_streak;
+      json["played"] = record.played;
+      json["wins"] = record.wins;
+      json["averageGuesses"] = record.AverageGuesses();
+      return json;
+    };
+    std::vector<crow::json::wvalue> players;
+    for (const PlayerRecord& record : leaderboard_.Top(ranking, count)) {
+      players.push_back(record_json(record));
+    }
+    crow::json::wvalue leaderboard_json({});
+    leaderboard_json["players"] = std::move(players);
+    const std::string& player = req.get_header_value("X-Hurdle-Player-ID");
+    if (!player.empty()) {
+      leaderboard_json["you"] = record_json(leaderboard_.Find(player));
+    }
+    return crow::response(leaderboard_json);
+  });
+
+  // Returns the spans traced so far in the Chrome trace event format, for
+  // chrome://tracing or ui.perfetto.dev.
+  CROW_ROUTE(app, "/trace")
+  ([this] {
+    crow::response res(tracer.ChromeTrace());
+    res.set_header("Content-Type", "application/json");
+    return res;
+  });
+
+  // Answers 200 once the server is ready for its share of the traffic, and
+  // 503 while it is still starting up or once it is draining. The body lists
+  // the startup phases and how long each took.
+  CROW_ROUTE(app, "/ready")
+  ([this] {
+    const bool ready = startup_.Ready() &&
+                       !app.get_middleware<DrainMiddleware>().Draining();
+    auto millis = [](std::chrono::steady_clock::duration duration) {
+      return std::chrono::duration<double, std::milli>(duration).count();
+    };
+    std::vector<crow::json::wvalue> phases;
+    for (const StartupTimer::Phase& phase : startup_.Phases()) {
+      crow::json::wvalue phase_json({});
+      phase_json["name"] = phase.name;
+      phase_json["startMs"] = millis(phase.start);
+      phase_json["durationMs"] = millis(phase.duration);
+      phase_json["done"] = phase.done;
+      phases.push_back(std::move(phase_json));
+    }
+    crow::json::wvalue ready_json({});
+    ready_json["ready"] = ready;
+    ready_json["readyMs"] = millis(startup_.TimeToReady());
+    ready_json["phases"] = std::move(phases);
+    crow::response res(ready_json);
+    res.code = ready ? 200 : 503;
+    return res;
+  });
+
+  // Profiles the CPU of the whole server for ?seconds= (10 by default, at
+  // most 60) at ?hz= samples per second of CPU time (99 by default), and
+  // returns the sampled stacks folded for flamegraph.pl or speedscope. The
+  // response is sent from another thread once the profile is done, so the
+  // worker keeps serving meanwhile, unless the client has gone by then. One
+  // profile runs at a time, and StopProfiling ends it early.
+  CROW_ROUTE(app, "/debug/pprof/profile")
+  ([this](const crow::request& req, crow::response& res) {
+    auto param = [&](const char* name, int fallback, int max) {
+      const char* value = req.url_params.get(name);
+      return std::clamp(value ? std::atoi(value) : fallback, 1, max);
+    };
+    const int seconds = param("seconds", 10, 60);
+    const int hz = param("hz", 99, 1000);
+    if (req.io_service == nullptr) {
+      res.code = 501;
+      res.body = "Profiling needs a connection";
+      res.end();
+      return;
+    }
+    if (profiling_.exchange(true)) {
+      res.code = 409;
+      res.body = "Another profile is running";
+      res.end();
+      return;
+    }
+    const size_t max_samples =
+        std::min<size_t>(static_cast<size_t>(seconds) * hz *
+                             std::max(1u, std::thread::hardware_concurrency()),
+                         1 << 15);
+    const std::string error = sampler_.Start(hz, max_samples);
+    if (!error.empty()) {
+      profiling_ = false;
+      res.code = 503;
+      res.body = "Profiling is unavailable: " + error;
+      res.end();
+      return;
+    }
+    // The previous profile's thread has finished, since profiling_ was
+    // false.
+    if (profile_thread_.joinable()) {
+      profile_thread_.join();
+    }
+    profile_thread_ = std::thread([this, &res, poster = req.poster(),
+                                   seconds] {
+      {
+        std::unique_lock<std::mutex> lock(profile_mutex_);
+        profile_wake_.wait_for(lock, std::chrono::seconds(seconds),
+                               [this] { return profiling_stopped_; });
+      }
+      const std::vector<profiler::Stack> stacks = sampler_.Stop();
+      if (!symbolizer_) {
+        symbolizer_ = std::make_unique<profiler::Symbolizer>();
+      }
+      std::string folded = profiler::FoldStacks(stacks, *symbolizer_);
+      const uint64_t dropped = sampler_.Dropped();
+      poster.post([&res, folded = std::move(folded), samples = stacks.size(),
+                   dropped]() mutable {
+        res.set_header("Content-Type", "text/plain");
+        res.set_header("X-Profile-Samples", std::to_string(samples));
+        res.set_header("X-Profile-Dropped", std::to_string(dropped));
+        res.body = std::move(folded);
+        res.end();
+      });
+      profiling_ = false;
+    });
+  });
+
+  // Exports every metric in the Prometheus text format.
+  CROW_ROUTE(app, "/metrics")
+  ([this] {
+    crow::response res(metrics.Export());
+    res.set_header("Content-Type", "text/plain; version=0.0.4");
+    return res;
+  });
+
+  // When the Hurdle frontend is loaded, the GetGameState function is called to
+  // load the initial state of the game that's currently stored. Polling
+  // clients that send back the ETag get a 304 until the game changes.
+  CROW_ROUTE(app, "/game")
+  ([this](const crow::request& req) {
+    auto& ctx = app.get_context<GameMiddleware>(req);
+    return GameStateResponse(req, ctx, compressor_, *state_bytes_);
+  });
+}
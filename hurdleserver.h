@@ -0,0 +1,130 @@
+#include <atomic>
+#include <condition_variable>
+#include <cstdint>
+#include <memory>
+#include <mutex>
+#include <string>
+#include <thread>
+#include <utility>
+
+#include "daily.h"
+#include "hint.h"
+#include "hurdle.h"
+#include "hurdlewords.h"
+#include "leaderboard.h"
+#include "server_utils/capture.h"
+#include "server_utils/compression.h"
+#include "server_utils/crow_all.h"
+#include "server_utils/diagnostics.h"
+#include "server_utils/handoff.h"
+#include "server_utils/metrics.h"
+#include "server_utils/preflight.h"
+#include "server_utils/profiler.h"
+#include "server_utils/ratelimit.h"
+#include "server_utils/routemetrics.h"
+#include "server_utils/sessions.h"
+#include "server_utils/startup.h"
+#include "server_utils/tracing.h"
+#include "stats.h"
+#include "strategy.h"
+#include "threadpool.h"
+
+#ifndef HURDLESERVER_H
+#define HURDLESERVER_H
+
+// The data kept for each session: its game, and the compressed bodies of the
+// game's state, which are reused until the game changes.
+struct GameSession {
+  explicit GameSession(HurdleGame game) : game(std::move(game)) {}
+
+  HurdleGame game;
+  CompressedBodyCache compressed_bodies;
+};
+
+typedef SessionMiddleware<GameSession> GameMiddleware;
+
+// Returns true if the If-None-Match header `if_none_match` lists `etag`, or
+// is "*". Tags are compared weakly, i.e. a W/ prefix is ignored, as RFC 7232
+// requires for If-None-Match.
+bool ETagMatches(const std::string& if_none_match, const std::string& etag);
+
+// The Crow app of the Hurdle backend. MetricsMiddleware comes first so it
+// times every other middleware too, and CaptureMiddleware next so it records
+// every response as sent. PreflightMiddleware comes next so CORS preflights
+// are answered before routing and the session middleware, then
+// DiagnosticsMiddleware turns away remote clients of the diagnostic routes,
+// and RateLimitMiddleware rejects floods before any session is created.
+// DrainMiddleware tracks the requests in flight for graceful shutdown.
+typedef crow::App<MetricsMiddleware, CaptureMiddleware, PreflightMiddleware,
+                  DiagnosticsMiddleware, DrainMiddleware, crow::CORSHandler,
+                  RateLimitMiddleware, GameMiddleware>
+    HurdleApp;
+
+// HurdleServer is the Hurdle backend: the app, with its middlewares and
+// routes, and the services the routes share. main serves it over HTTP, and
+// tools/replay drives it in-process.
+class HurdleServer {
+ public:
+  // Configures the middlewares and registers every route and metric.
+  // `daily_key` picks the daily hurdles, see DailySchedule. The background
+  // work the server needs before it is ready is timed as phases of
+  // `startup`, whose readiness /ready reports.
+  HurdleServer(HurdleWords& hurdlewords, uint64_t daily_key,
+               StartupTimer& startup);
+
+  // Stops a running profile and waits for its thread.
+  ~HurdleServer();
+
+  HurdleServer(const HurdleServer&) = delete;
+  HurdleServer& operator=(const HurdleServer&) = delete;
+
+  // Lifts the per-client rate limits, for load tests and replays, which
+  // look like a single client. Load shedding stays on.
+  void DisableClientRateLimits();
+
+  // Answers hints for boards that follow the precomputed strategy at `path`
+  // (see make strategy) from the table, without searching. Returns false if
+  // there is no usable table there.
+  bool LoadStrategy(const std::string& path);
+
+  // Ends a running profile early, and any later one at once, with the
+  // samples taken so far, so profiles do not hold up a drain.
+  void StopProfiling();
+
+  HurdleApp app;
+  // Telemetry exported on /metrics. Metrics may be added until the server
+  // starts.
+  MetricsRegistry metrics;
+  // Request tracing, served on /trace. Off until its hooks are installed.
+  Tracer tracer;
+
+ private:
+  HurdleWords& hurdlewords_;
+  StartupTimer& startup_;
+  GameStats stats_;
+  Leaderboard leaderboard_;
+  ResponseCompressor compressor_;
+  Counter* state_bytes_ = nullptr;
+  DailySchedule daily_;
+  HintEngine hint_engine_;
+  StrategyTable strategy_;
+  profiler::StackSampler sampler_;
+  // Loaded by the first profile.
+  std::unique_ptr<profiler::Symbolizer> symbolizer_;
+  // The thread that ends the running profile and sends it. It waits on
+  // profile_wake_, so StopProfiling can cut the profile short.
+  std::thread profile_thread_;
+  std::atomic<bool> profiling_{false};
+  std::mutex profile_mutex_;
+  std::condition_variable profile_wake_;
+  bool profiling_stopped_ = false;
+  // Declared last so it is destroyed first: its destructor runs the tasks
+  // still queued, which use the members above.
+  ThreadPool pool_;
+
+  void ConfigureMiddlewares();
+  void RegisterMetrics();
+  void RegisterRoutes();
+};
+
+#endif  // HURDLESERVER_H
@@ -1,35 +1,194 @@
 #include "hurdlewords.h"
 
-#include <cstdlib>
-#include <ctime>
-#include <fstream>
+#include <fcntl.h>
+#include <sys/stat.h>
+#include <unistd.h>
+
+#include <algorithm>
+#include <functional>
+#include <iterator>
 #include <string>
+#include <string_view>
 
-HurdleWords::HurdleWords(const std::string& valid_hurdles_filename,
-                       const std::string& valid_guesses_filename) {
-  // Read from the file containing all valid secret
-  // hurdles, and insert them into the valid_hurdles_ vector.
-  std::ifstream hurdles_file(valid_hurdles_filename);
-  std::string word;
-  while (hurdles_file >> word) {
-    valid_hurdles_.push_back(word);
+#include "random.h"
+#include "threadpool.h"
+
+namespace {
+
+// Reads the whole file at `path` with a single read where the kernel allows
+// it. Returns an empty string if the file cannot be read.
+std::string ReadWholeFile(const std::string& path) {
+  std::string data;
+  const int fd = open(path.c_str(), O_RDONLY);
+  if (fd < 0) {
+    return data;
+  }
+  struct stat info;
+  if (fstat(fd, &info) == 0 && info.st_size > 0) {
+    data.resize(info.st_size);
+    size_t read_bytes = 0;
+    while (read_bytes < data.size()) {
+      const ssize_t n =
+          read(fd, &data[read_bytes], data.size() - read_bytes);
+      if (n <= 0) {
+        break;
+      }
+      read_bytes += n;
+    }
+    data.resize(read_bytes);
   }
+  close(fd);
+  return data;
+}
+
+// The characters >> skips between words in the "C" locale.
+bool IsSpace(char c) {
+  return c == ' ' || c == '\n' || c == '\r' || c == '\t' || c == '\v' ||
+         c == '\f';
+}
 
-  // Read from the file containing all valid guesses,
-  // and insert them into the valid_guesses_ set.
-  std::ifstream guesses_file(valid_guesses_filename);
-  while (guesses_file >> word) {
-    valid_guesses_.insert(word);
+// Appends the whitespace-separated words of `text` to `words`, as reading
+// them with >> would, without the stream's locale lookups.
+void SplitWords(std::string_view text, std::vector<std::string>* words) {
+  size_t i = 0;
+  while (i < text.size()) {
+    while (i < text.size() && IsSpace(text[i])) {
+      i++;
+    }
+    const size_t begin = i;
+    while (i < text.size() && !IsSpace(text[i])) {
+      i++;
+    }
+    if (i > begin) {
+      words->emplace_back(text.substr(begin, i - begin));
+    }
   }
-  // Use the current time as a seed for the random number generator.
-  srand(time(nullptr));
+}
+
+// A piece of a word file, parsed on its own. Pieces end at whitespace, so
+// no word straddles two of them.
+struct Chunk {
+  std::string_view text;
+  std::vector<std::string> words;
+};
+
+// Files are split into chunks of about this many bytes.
+constexpr size_t kChunkSize = 16 << 10;
+
+void AddChunks(std::string_view text, std::vector<Chunk>* chunks) {
+  while (!text.empty()) {
+    size_t end = std::min(kChunkSize, text.size());
+    while (end < text.size() && !IsSpace(text[end])) {
+      end++;
+    }
+    chunks->push_back({text.substr(0, end), {}});
+    text.remove_prefix(end);
+  }
+}
+
+// Moves the words of `chunks`, in order, to the end of `words`.
+void JoinChunks(std::vector<Chunk>::iterator begin,
+                std::vector<Chunk>::iterator end,
+                std::vector<std::string>* words) {
+  size_t count = words->size();
+  for (auto chunk = begin; chunk != end; ++chunk) {
+    count += chunk->words.size();
+  }
+  words->reserve(count);
+  for (auto chunk = begin; chunk != end; ++chunk) {
+    std::move(chunk->words.begin(), chunk->words.end(),
+              std::back_inserter(*words));
+  }
+}
+
+}  // namespace
+
+HurdleWords::HurdleWords(const std::string& valid_hurdles_filename,
+                       const std::string& valid_guesses_filename)
+    : valid_hurdles_(std::make_shared<std::vector<std::string>>()),
+      valid_guesses_(std::make_shared<std::unordered_set<std::string>>()),
+      guess_list_(std::make_shared<std::vector<std::string>>()),
+      lookups_(std::make_shared<Counter>()) {
+  // Startup waits on the word lists, so each file is read in one go and
+  // parsed in chunks in parallel.
+  ThreadPool pool;
+  const std::string hurdles_text = ReadWholeFile(valid_hurdles_filename);
+  const std::string guesses_text = ReadWholeFile(valid_guesses_filename);
+  std::vector<Chunk> chunks;
+  AddChunks(hurdles_text, &chunks);
+  const size_t hurdle_chunks = chunks.size();
+  AddChunks(guesses_text, &chunks);
+  pool.ParallelFor(0, chunks.size(), 1, [&](size_t begin, size_t end) {
+    for (size_t i = begin; i < end; i++) {
+      SplitWords(chunks[i].text, &chunks[i].words);
+    }
+  });
+  JoinChunks(chunks.begin(), chunks.begin() + hurdle_chunks,
+             valid_hurdles_.get());
+  std::vector<std::string> guesses;
+  JoinChunks(chunks.begin() + hurdle_chunks, chunks.end(), &guesses);
+
+  // The indexes over the hurdles do not depend on the guesses, so they are
+  // built while the guesses are deduplicated and indexed.
+  const std::function<void()> builds[] = {
+      [&] {
+        valid_guesses_->reserve(guesses.size());
+        for (std::string& word : guesses) {
+          if (valid_guesses_->insert(word).second) {
+            guess_list_->push_back(std::move(word));
+          }
+        }
+        word_search_ = std::make_shared<WordSearch>(*guess_list_);
+      },
+      [&] {
+        candidate_index_ = std::make_shared<CandidateIndex>(*valid_hurdles_);
+      },
+      [&] {
+        difficulty_index_ = std::make_shared<DifficultyIndex>(*valid_hurdles_);
+      },
+  };
+  pool.ParallelFor(0, std::size(builds), 1, [&](size_t begin, size_t end) {
+    for (size_t i = begin; i < end; i++) {
+      builds[i]();
+    }
+  });
 }
 
 bool HurdleWords::IsGuessValid(const std::string& word) const {
-  return valid_guesses_.count(word) > 0;
+  lookups_->Add();
+  return valid_guesses_->count(word) > 0;
+}
+
+uint64_t HurdleWords::LookupCount() const {
+  return lookups_->Value();
 }
 
 const std::string& HurdleWords::GetRandomHurdle() const {
-  int index = rand() % valid_hurdles_.size();
-  return valid_hurdles_[index];
-}
\ No newline at end of file
+  return (*valid_hurdles_)[RandomBelow(valid_hurdles_->size())];
+}
+
+const std::string& HurdleWords::GetRandomHurdle(Difficulty difficulty) const {
+  const size_t index = RandomBelow(valid_hurdles_->size());
+  const uint32_t coin = RandomBits();
+  return (*valid_hurdles_)[difficulty_index_->Sample(difficulty, index, coin)];
+}
+
+const std::vector<std::string>& HurdleWords::Hurdles() const {
+  return *valid_hurdles_;
+}
+
+const std::vector<std::string>& HurdleWords::Guesses() const {
+  return *guess_list_;
+}
+
+CandidateIndex& HurdleWords::Candidates() const {
+  return *candidate_index_;
+}
+
+DifficultyIndex& HurdleWords::Difficulties() const {
+  return *difficulty_index_;
+}
+
+const WordSearch& HurdleWords::Search() const {
+  return *word_search_;
+}
@@ -1,7 +1,14 @@
+#include <cstdint>
+#include <memory>
 #include <string>
 #include <unordered_set>
 #include <vector>
 
+#include "candidates.h"
+#include "counter.h"
+#include "difficulty.h"
+#include "wordsearch.h"
+
 #ifndef HURDLEWORDS_H
 #define HURDLEWORDS_H
 
@@ -14,18 +21,50 @@ class HurdleWords {
   // according to the words in this class.
   bool IsGuessValid(const std::string &word) const;
 
+  // Returns the number of IsGuessValid calls, on this object and every copy.
+  uint64_t LookupCount() const;
+
   // Returns a random hurdle from the list of valid
   // hurdles (secret words) stored in the words in this class.
   const std::string &GetRandomHurdle() const;
 
+  // Returns a random hurdle of the given difficulty. Every hurdle is equally
+  // likely until Difficulties().Compute has run.
+  const std::string &GetRandomHurdle(Difficulty difficulty) const;
+
+  // Returns every valid hurdle, in file order.
+  const std::vector<std::string> &Hurdles() const;
+
+  // Returns every valid guess, in file order.
+  const std::vector<std::string> &Guesses() const;
+
+  // Returns the (guess, pattern) masks over Hurdles(), shared by every copy.
+  CandidateIndex &Candidates() const;
+
+  // Returns the difficulty scores of Hurdles(), shared by every copy.
+  DifficultyIndex &Difficulties() const;
+
+  // Returns the pattern search index over Guesses(), shared by every copy.
+  const WordSearch &Search() const;
+
  private:
+  // The word lists are shared between copies, since every game holds a copy
+  // of the HurdleWords it was created with.
+  //
   // valid_hurdles_ is a list of valid words from which the
   // secret hurdle may be chosen.
-  std::vector<std::string> valid_hurdles_;
+  std::shared_ptr<std::vector<std::string>> valid_hurdles_;
   // valid_guesses_ is a list of valid words that are considered
   // acceptable gueses a user can submit. We use a set here because
   // checking if a word is in a set is more time efficient than a vector.
-  std::unordered_set<std::string> valid_guesses_;
+  std::shared_ptr<std::unordered_set<std::string>> valid_guesses_;
+  // guess_list_ holds the same words as valid_guesses_, in file order, for
+  // code that iterates over every guess.
+  std::shared_ptr<std::vector<std::string>> guess_list_;
+  std::shared_ptr<CandidateIndex> candidate_index_;
+  std::shared_ptr<DifficultyIndex> difficulty_index_;
+  std::shared_ptr<const WordSearch> word_search_;
+  std::shared_ptr<Counter> lookups_;
 };
 
-#endif  // HURDLEWORDS_H
\ No newline at end of file
+#endif  // HURDLEWORDS_H
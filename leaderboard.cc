@@ -0,0 +1,158 @@
+#include "leaderboard.h"
+
+#include <algorithm>
+#include <functional>
+#include <queue>
+
+namespace {
+
+constexpr size_t kStreak = static_cast<size_t>(Leaderboard::Ranking::kStreak);
+constexpr size_t kAverageGuesses =
+    static_cast<size_t>(Leaderboard::Ranking::kAverageGuesses);
+
+}  // namespace
+
+double PlayerRecord::AverageGuesses() const {
+  return wins == 0 ? 0 : static_cast<double>(guesses) / wins;
+}
+
+Leaderboard::Leaderboard() {
+  for (Shard& shard : shards_) {
+    for (size_t ranking = 0; ranking < kRankings; ranking++) {
+      shard.top[ranking] = std::make_shared<const TopList>();
+    }
+  }
+}
+
+void Leaderboard::GameFinished(const std::string& player,
+                               const HurdleState& state) {
+  Record(player, state.GetStatus() == "win", state.GetGuesses().size());
+}
+
+void Leaderboard::GameAbandoned(const std::string& player, const HurdleState&,
+                                size_t) {
+  Record(player, false, 0);
+}
+
+std::vector<PlayerRecord> Leaderboard::Top(Ranking ranking,
+                                           size_t count) const {
+  const size_t index = static_cast<size_t>(ranking);
+  std::shared_ptr<const TopList> tops[kShards];
+  for (size_t i = 0; i < kShards; i++) {
+    tops[i] = std::atomic_load(&shards_[i].top[index]);
+  }
+
+  // Every shard's list is sorted, so merge them through a heap holding the
+  // next entry of each shard.
+  typedef std::pair<size_t, size_t> Cursor;  // (shard, position)
+  auto worse = [&](const Cursor& a, const Cursor& b) {
+    return (*tops[a.first])[a.second].key > (*tops[b.first])[b.second].key;
+  };
+  std::priority_queue<Cursor, std::vector<Cursor>, decltype(worse)> heap(
+      worse);
+  for (size_t i = 0; i < kShards; i++) {
+    if (!tops[i]->empty()) {
+      heap.emplace(i, 0);
+    }
+  }
+  std::vector<PlayerRecord> records;
+  count = std::min(count, top_k);
+  while (records.size() < count && !heap.empty()) {
+    const Cursor next = heap.top();
+    heap.pop();
+    records.push_back((*tops[next.first])[next.second].record);
+    if (next.second + 1 < tops[next.first]->size()) {
+      heap.emplace(next.first, next.second + 1);
+    }
+  }
+  return records;
+}
+
+PlayerRecord Leaderboard::Find(const std::string& player) const {
+  const Shard& shard = shards_[std::hash<std::string>()(player) % kShards];
+  std::lock_guard<std::mutex> lock(shard.mutex);
+  auto it = shard.players.find(player);
+  if (it == shard.players.end()) {
+    PlayerRecord record;
+    record.player = player;
+    return record;
+  }
+  return it->second;
+}
+
+void Leaderboard::Record(const std::string& player, bool won, size_t guesses) {
+  if (player.empty() || player.size() > kMaxPlayerLength) {
+    return;
+  }
+  Shard& shard = shards_[std::hash<std::string>()(player) % kShards];
+  std::lock_guard<std::mutex> lock(shard.mutex);
+  PlayerRecord& record = shard.players[player];
+  record.player = player;
+
+  RankKey old_keys[kRankings];
+  bool was_ranked[kRankings];
+  for (size_t ranking = 0; ranking < kRankings; ranking++) {
+    was_ranked[ranking] = Key(record, ranking, &old_keys[ranking]);
+  }
+
+  record.played++;
+  if (won) {
+    record.wins++;
+    record.guesses += guesses;
+    record.streak++;
+    record.best_streak = std::max(record.best_streak, record.streak);
+  } else {
+    record.streak = 0;
+  }
+
+  for (size_t ranking = 0; ranking < kRankings; ranking++) {
+    RankKey new_key;
+    const bool ranked = Key(record, ranking, &new_key);
+    if (was_ranked[ranking]) {
+      shard.ranked[ranking].erase(old_keys[ranking]);
+    }
+    if (ranked) {
+      shard.ranked[ranking].insert(new_key);
+    }
+    // Only republish when the player was or is among the published ones.
+    const std::shared_ptr<const TopList> top =
+        std::atomic_load(&shard.top[ranking]);
+    auto published = [&](const RankKey& key) {
+      return top->size() < top_k || key <= top->back().key;
+    };
+    if ((was_ranked[ranking] && published(old_keys[ranking])) ||
+        (ranked && published(new_key))) {
+      Publish(shard, ranking);
+    }
+  }
+}
+
+bool Leaderboard::Key(const PlayerRecord& record, size_t ranking,
+                      RankKey* key) const {
+  if (ranking == kStreak) {
+    if (record.streak == 0) {
+      return false;
+    }
+    *key = RankKey(-static_cast<double>(record.streak),
+                   record.AverageGuesses(), record.player);
+    return true;
+  }
+  if (ranking == kAverageGuesses && record.wins >= min_wins) {
+    *key = RankKey(record.AverageGuesses(), -static_cast<double>(record.wins),
+                   record.player);
+    return true;
+  }
+  return false;
+}
+
+void Leaderboard::Publish(Shard& shard, size_t ranking) {
+  auto top = std::make_shared<TopList>();
+  for (const RankKey& key : shard.ranked[ranking]) {
+    if (top->size() == top_k) {
+      break;
+    }
+    top->push_back({key, shard.players[std::get<2>(key)]});
+  }
+  std::atomic_store(&shard.top[ranking],
+                    std::shared_ptr<const TopList>(std::move(top)));
+}
@@ -0,0 +1,98 @@
+#include <array>
+#include <cstdint>
+#include <memory>
+#include <mutex>
+#include <set>
+#include <string>
+#include <tuple>
+#include <unordered_map>
+#include <vector>
+
+#include "hurdle.h"
+
+#ifndef LEADERBOARD_H
+#define LEADERBOARD_H
+
+// The results of one player.
+struct PlayerRecord {
+  std::string player;
+  // Consecutive wins up to the last game, and the longest such run.
+  uint32_t streak = 0;
+  uint32_t best_streak = 0;
+  uint64_t played = 0;
+  uint64_t wins = 0;
+  // Sum of the number of guesses of every win.
+  uint64_t guesses = 0;
+
+  // Average number of guesses per win, 0 before the first win.
+  double AverageGuesses() const;
+};
+
+// Leaderboard ranks players by their current winning streak and by their
+// average number of guesses per win. Players are split into shards by a
+// hash of their id, so a game's result only locks the shard of its player.
+// Every shard republishes its own top players whenever a result changes
+// them, and a read merges those published lists without taking any lock.
+class Leaderboard : public HurdleObserver {
+ public:
+  enum class Ranking { kStreak, kAverageGuesses };
+
+  Leaderboard();
+
+  void GameFinished(const std::string& player,
+                    const HurdleState& state) override;
+  // Abandoning a game ends the player's streak, like a loss.
+  void GameAbandoned(const std::string& player, const HurdleState& state,
+                     size_t submitted_rows) override;
+
+  // Returns up to `count` of the best players, best first. By streak,
+  // players without a streak are left out, and ties go to the lower average.
+  // By average guesses, only players with at least min_wins wins are
+  // ranked, and ties go to the player with more wins. `count` is capped at
+  // top_k.
+  std::vector<PlayerRecord> Top(Ranking ranking, size_t count) const;
+
+  // Returns the record of `player`, or a record with no games if unknown.
+  PlayerRecord Find(const std::string& player) const;
+
+  // Number of players each shard publishes per ranking, and so the most a
+  // read can return. Must be set before the first game is recorded.
+  size_t top_k = 100;
+  // Wins needed to be ranked by average guesses.
+  uint64_t min_wins = 5;
+  // Player ids that are empty or longer than this are not recorded.
+  static constexpr size_t kMaxPlayerLength = 64;
+
+ private:
+  static constexpr size_t kShards = 16;
+  static constexpr size_t kRankings = 2;
+
+  // Players sort by increasing key: the negated streak or the average, then
+  // the other criterion, then the id.
+  typedef std::tuple<double, double, std::string> RankKey;
+
+  struct Entry {
+    RankKey key;
+    PlayerRecord record;
+  };
+  typedef std::vector<Entry> TopList;
+
+  struct Shard {
+    mutable std::mutex mutex;
+    std::unordered_map<std::string, PlayerRecord> players;
+    // Keys of the ranked players, per ranking.
+    std::set<RankKey> ranked[kRankings];
+    // The first top_k players of `ranked`, replaced as a whole on change and
+    // read with std::atomic_load.
+    std::shared_ptr<const TopList> top[kRankings];
+  };
+
+  std::array<Shard, kShards> shards_;
+
+  void Record(const std::string& player, bool won, size_t guesses);
+  // Returns whether `record` is ranked in `ranking`, and its key if so.
+  bool Key(const PlayerRecord& record, size_t ranking, RankKey* key) const;
+  void Publish(Shard& shard, size_t ranking);
+};
+
+#endif  // LEADERBOARD_H
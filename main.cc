@@ -1,71 +1,302 @@
-#include "hurdle.h"
-#include "server_utils/crow_all.h"
-#include "server_utils/sessions.h"
+#include <pthread.h>
+#include <signal.h>
+#include <sys/socket.h>
+#include <unistd.h>
 
-typedef SessionMiddleware<HurdleGame> GameMiddleware;
+#include <atomic>
+#include <cstdio>
+#include <cstdlib>
+#include <fstream>
+#include <mutex>
+#include <sstream>
+#include <thread>
+
+#include "hurdleserver.h"
+#include "hurdlewords.h"
+
+// Returns the value of the environment variable `name`, or `fallback` if it
+// is not set.
+std::string EnvOr(const char* name, const std::string& fallback) {
+  const char* value = std::getenv(name);
+  return value != nullptr ? value : fallback;
+}
 
 int main() {
+  // Crow's own signal handling stops the server abruptly, so block the
+  // signals in every thread and wait for them in a dedicated one instead.
+  // Threads inherit the mask, so this comes before any thread is started.
+  sigset_t shutdown_signals;
+  sigemptyset(&shutdown_signals);
+  sigaddset(&shutdown_signals, SIGTERM);
+  sigaddset(&shutdown_signals, SIGINT);
+  pthread_sigmask(SIG_BLOCK, &shutdown_signals, nullptr);
+
+  // Every phase of the startup is logged with its duration, and /ready
+  // answers 200 once the server can take traffic.
+  StartupTimer startup;
+
   // Load the Hurdle words from the data/ folder.
   HurdleWords hurdlewords("data/valid_hurdles.txt", "data/valid_guesses.txt");
+  startup.Mark("load words");
 
-  // Initialize the Crow HTTP server.
-  crow::App<crow::CORSHandler, GameMiddleware> app;
+  // The daily hurdle depends only on the date, the region and this key, so
+  // servers sharing the key serve the same puzzle without coordinating.
+  HurdleServer backend(
+      hurdlewords,
+      std::strtoull(EnvOr("HURDLE_DAILY_KEY", "0x6875726466c6521").c_str(),
+                    nullptr, 0),
+      startup);
+  startup.Mark("create server");
+  HurdleApp& app = backend.app;
+  auto& session_middleware = app.get_middleware<GameMiddleware>();
 
-  // Initialize Cross-Origin Resource Sharing (CORS) to allow the frontend to
-  // access the server.
-  auto& cors_middleware = app.get_middleware<crow::CORSHandler>();
-  cors_middleware.global().origin("*");
-  cors_middleware.global().max_age(7200);  // Chrome's maximum
+  // A load test from one machine looks like a single client, so
+  // HURDLE_RATE_LIMIT=0 lifts the per-client limits. Load shedding stays on.
+  if (EnvOr("HURDLE_RATE_LIMIT", "1") == "0") {
+    backend.DisableClientRateLimits();
+  }
 
-  // Initialize the session middleware to allow the server to keep track of
-  // multiple games.
-  auto& session_middleware = app.get_middleware<GameMiddleware>();
-  session_middleware.header_name = "X-Hurdle-Game-ID";
-  session_middleware.constructor = [&]() { return HurdleGame(hurdlewords); };
-
-  // Every time a letter is pressed on the Hurdle frontend, that letter
-  // is passed to this function, which is passed to LetterEntered.
-  CROW_ROUTE(app, "/wordle_key_pressed/<string>")
-  ([&](const crow::request& req, std::string s) {
-    auto& game = app.get_context<GameMiddleware>(req).GetData();
-    game.LetterEntered(s.at(0));
-    return game.JsonFromHurdleState();
-  });
+  // /metrics, /trace and /debug/ are served to loopback clients, and to
+  // remote ones sending HURDLE_DEBUG_TOKEN as a bearer token, if it is set.
+  app.get_middleware<DiagnosticsMiddleware>().token =
+      EnvOr("HURDLE_DEBUG_TOKEN", "");
 
-  // Every time the enter key is pressed on the Hurdle frontend,
-  // the WordSubmitted function is called.
-  CROW_ROUTE(app, "/enter_pressed")
-  ([&](const crow::request& req) {
-    auto& game = app.get_context<GameMiddleware>(req).GetData();
-    game.WordSubmitted();
-    return game.JsonFromHurdleState();
-  });
+  const std::string strategy_file =
+      EnvOr("HURDLE_STRATEGY_FILE", "data/strategy.bin");
+  if (backend.LoadStrategy(strategy_file)) {
+    CROW_LOG_INFO << "Loaded strategy table " << strategy_file;
+  } else {
+    CROW_LOG_INFO << "No usable strategy table at " << strategy_file
+                  << ", hints will be searched";
+  }
+  startup.Mark("load strategy");
 
-  // Every time the backspace key is pressed on the Hurdle frontend,
-  // the LetterDeleted function is called.
-  CROW_ROUTE(app, "/delete_pressed")
-  ([&](const crow::request& req) {
-    auto& game = app.get_context<GameMiddleware>(req).GetData();
-    game.LetterDeleted();
-    return game.JsonFromHurdleState();
-  });
+  // HURDLE_PERF_COUNTERS=1 adds the hardware counters of each route, from
+  // which IPC and cache miss rates follow. Hosts that forbid perf events
+  // only lose these metrics.
+  if (EnvOr("HURDLE_PERF_COUNTERS", "0") == "1") {
+    const std::string error =
+        app.get_middleware<MetricsMiddleware>().EnablePerfCounters(
+            backend.metrics);
+    if (!error.empty()) {
+      CROW_LOG_WARNING << "Hardware counters are unavailable: " << error;
+    }
+  }
 
-  // Every time the "Next Hurdle" button is pressed on the Hurdle frontend,
-  // the NewHurdle function is called.
-  CROW_ROUTE(app, "/new_game")
-  ([&](const crow::request& req) {
-    auto& game = app.get_context<GameMiddleware>(req).GetData();
-    game.NewHurdle();
-    return game.JsonFromHurdleState();
-  });
+  // HURDLE_TRACE_FILE turns on tracing of a sample of the requests, phase by
+  // phase: parsing, each middleware, the handler, the game method, the
+  // serialization and the response write. The trace is written to that file
+  // at shutdown, and /trace serves it meanwhile.
+  Tracer& tracer = backend.tracer;
+  const std::string trace_file = EnvOr("HURDLE_TRACE_FILE", "");
+  tracer.sample_rate =
+      std::strtod(EnvOr("HURDLE_TRACE_RATE", "0.01").c_str(), nullptr);
+  if (!trace_file.empty() && tracer.sample_rate > 0) {
+    crow::trace_hooks.begin = [&] { return tracer.BeginRequest(); };
+    crow::trace_hooks.span = [&](uint64_t id, const char* name,
+                                 std::chrono::steady_clock::time_point start,
+                                 std::chrono::steady_clock::time_point end) {
+      tracer.Record(id, name, start, end);
+    };
+  }
+
+  // HURDLE_CAPTURE_FILE records every request to that file, for
+  // tools/replay. A server started with HURDLE_REPLAY_SEEDS=1 draws the
+  // hurdles a replayed request asks for, so an HTTP replay against it gets
+  // the captured responses.
+  auto& capture_middleware = app.get_middleware<CaptureMiddleware>();
+  capture_middleware.accept_replay_seeds =
+      EnvOr("HURDLE_REPLAY_SEEDS", "0") == "1";
+  const std::string capture_file = EnvOr("HURDLE_CAPTURE_FILE", "");
+  if (!capture_file.empty()) {
+    if (capture_middleware.Start(capture_file)) {
+      CROW_LOG_INFO << "Capturing requests to " << capture_file;
+    } else {
+      CROW_LOG_ERROR << "Could not capture requests to " << capture_file;
+    }
+  }
+
+  // HURDLE_PORT lets load tests run their server next to another one.
+  const std::string port = EnvOr("HURDLE_PORT", "18080");
+
+  // On SIGTERM or SIGINT the server stops accepting connections, finishes
+  // the requests in flight and saves the sessions to handoff_file, which the
+  // next server loads on startup. A new server started on the same port
+  // while this one runs takes over instead: it connects to handoff_socket,
+  // receives the listening socket and serves on it at once, and merges the
+  // sessions once this server has drained, so neither connections nor games
+  // are lost during a rollout. Both paths include the port, so servers on
+  // other ports are left alone. The socket lives in the user's private
+  // runtime directory when there is one; either way each end refuses a peer
+  // running as another user.
+  const std::string runtime_dir = EnvOr("XDG_RUNTIME_DIR", "/tmp");
+  const std::string handoff_socket =
+      EnvOr("HURDLE_HANDOFF_SOCKET",
+            runtime_dir + "/hurdle-handoff-" + port + ".sock");
+  const std::string handoff_file =
+      EnvOr("HURDLE_HANDOFF_FILE", "hurdle-sessions-" + port + ".txt");
+  auto& drain_middleware = app.get_middleware<DrainMiddleware>();
+  auto load_game = [](std::istream& in, GameSession& session) {
+    return session.game.LoadState(in);
+  };
+  auto save_game = [](const GameSession& session, std::ostream& out) {
+    session.game.SaveState(out);
+  };
+
+  app.signal_clear();
 
-  // When the Hurdle frontend is loaded, the GetGameState function is called to
-  // load the initial state of the game that's currently stored.
-  CROW_ROUTE(app, "/game")
-  ([&](const crow::request& req) {
-    auto& game = app.get_context<GameMiddleware>(req).GetData();
-    return game.JsonFromHurdleState();
+  int predecessor = handoff::Connect(handoff_socket);
+  if (predecessor >= 0) {
+    int listen_fd = handoff::ReceiveFd(predecessor);
+    if (listen_fd >= 0) {
+      app.listen_handle(listen_fd);
+      // The sessions follow once the predecessor has drained. Until then,
+      // requests for sessions not handed over yet are asked to retry.
+      session_middleware.AwaitSessions();
+      startup.Begin("receive sessions");
+    } else {
+      // The predecessor shuts down on its own and saves its sessions to
+      // handoff_file for the next server.
+      CROW_LOG_ERROR << "Could not take over the predecessor's socket";
+      close(predecessor);
+      predecessor = -1;
+    }
+  }
+  if (predecessor < 0) {
+    if (std::ifstream in(handoff_file); in) {
+      size_t loaded = session_middleware.LoadSessions(in, load_game);
+      std::remove(handoff_file.c_str());
+      CROW_LOG_INFO << "Loaded " << loaded << " sessions from "
+                    << handoff_file;
+    }
+  }
+  startup.Mark("load sessions");
+
+  auto server = app.port(std::atoi(port.c_str())).concurrency(1).run_async();
+  app.wait_for_server_start();
+  startup.Serving("start listening");
+
+  std::thread session_receiver;
+  if (predecessor >= 0) {
+    session_receiver = std::thread([&, predecessor] {
+      std::string sessions;
+      const bool received = handoff::ReceiveAll(predecessor, &sessions);
+      close(predecessor);
+      // A predecessor that could not send its sessions saves them to
+      // handoff_file before closing the socket.
+      if (std::ifstream file(handoff_file); file) {
+        sessions += std::string(std::istreambuf_iterator<char>(file), {});
+        std::remove(handoff_file.c_str());
+      } else if (!received || sessions.empty()) {
+        CROW_LOG_WARNING << "Received no sessions from predecessor";
+      }
+      std::istringstream in(sessions);
+      size_t loaded = session_middleware.LoadSessions(in, load_game);
+      CROW_LOG_INFO << "Took over " << loaded << " sessions from predecessor";
+      startup.End("receive sessions");
+    });
+  }
+
+  // Whichever comes first, a signal or a successor, drains and stops the
+  // server. successor is -1 when shutting down without one, or when the
+  // listening socket could not be passed to it.
+  std::once_flag shutdown_once;
+  int successor = -1;
+  bool successor_connected = false;
+  auto shutdown = [&](int successor_sock) {
+    std::call_once(shutdown_once, [&] {
+      if (successor_sock >= 0) {
+        successor_connected = true;
+        if (handoff::SendFd(successor_sock, app.listen_handle())) {
+          successor = successor_sock;
+        } else {
+          // Closing lets the successor stop waiting; it loads the sessions
+          // from handoff_file once this server has saved them.
+          close(successor_sock);
+        }
+      }
+      app.stop_accepting();
+      drain_middleware.StartDraining();
+      backend.StopProfiling();
+      drain_middleware.WaitUntilIdle(std::chrono::milliseconds(500),
+                                     std::chrono::seconds(10));
+      app.stop();
+    });
+  };
+  // Both waiting threads are woken once the server has stopped, whichever
+  // way it did, so they can be joined.
+  std::atomic<bool> stopped{false};
+  std::thread signal_waiter([&] {
+    int signal_number;
+    sigwait(&shutdown_signals, &signal_number);
+    if (stopped) {
+      return;
+    }
+    CROW_LOG_INFO << "Received signal " << signal_number << ", draining";
+    shutdown(-1);
   });
+  std::thread successor_waiter;
+  int handoff_listener = handoff::Listen(handoff_socket);
+  if (handoff_listener >= 0) {
+    successor_waiter = std::thread([&] {
+      while (true) {
+        int successor_sock = accept(handoff_listener, nullptr, nullptr);
+        if (successor_sock < 0) {
+          return;
+        }
+        if (!handoff::PeerIsSameUser(successor_sock)) {
+          CROW_LOG_WARNING << "Refused a handoff to another user";
+          close(successor_sock);
+          continue;
+        }
+        CROW_LOG_INFO << "Handing over to a successor, draining";
+        shutdown(successor_sock);
+        return;
+      }
+    });
+  }
+
+  server.wait();
+  stopped = true;
+  pthread_kill(signal_waiter.native_handle(), SIGTERM);
+  signal_waiter.join();
+  if (handoff_listener >= 0) {
+    ::shutdown(handoff_listener, SHUT_RDWR);
+    successor_waiter.join();
+    close(handoff_listener);
+  }
+  if (session_receiver.joinable()) {
+    session_receiver.join();
+  }
+  capture_middleware.Stop();
+
+  if (!trace_file.empty()) {
+    if (tracer.WriteChromeTrace(trace_file)) {
+      CROW_LOG_INFO << "Wrote the request trace to " << trace_file;
+    } else {
+      CROW_LOG_ERROR << "Could not write the request trace to " << trace_file;
+    }
+  }
 
-  app.port(18080).concurrency(1).run();
+  // The server has stopped, so the sessions can be read without racing
+  // request handlers.
+  std::ostringstream sessions;
+  session_middleware.SaveSessions(sessions, save_game);
+  if (successor >= 0 && handoff::SendAll(successor, sessions.str())) {
+    close(successor);
+    CROW_LOG_INFO << "Handed " << session_middleware.SessionCount()
+                  << " sessions to successor";
+  } else {
+    // A successor that connected listens on handoff_socket by now.
+    if (!successor_connected) {
+      unlink(handoff_socket.c_str());
+    }
+    std::ofstream(handoff_file) << sessions.str();
+    CROW_LOG_INFO << "Saved " << session_middleware.SessionCount()
+                  << " sessions to " << handoff_file;
+    // Closed only now, so a successor that received nothing finds the file.
+    if (successor >= 0) {
+      close(successor);
+    }
+  }
 }
@@ -0,0 +1,53 @@
+#include "patterns.h"
+
+PackedWord PackWord(const std::string& word) {
+  PackedWord packed{};
+  for (int i = 0; i < kWordLength && i < static_cast<int>(word.size()); i++) {
+    packed[i] = (word[i] - 'a') % 26;
+  }
+  return packed;
+}
+
+std::vector<PackedWord> PackWords(const std::vector<std::string>& words) {
+  std::vector<PackedWord> packed;
+  packed.reserve(words.size());
+  for (const std::string& word : words) {
+    packed.push_back(PackWord(word));
+  }
+  return packed;
+}
+
+bool PatternFromColors(const std::string& colors, Pattern* pattern) {
+  if (colors.size() != kWordLength) {
+    return false;
+  }
+  int result = 0;
+  int power = 1;
+  for (char color : colors) {
+    switch (color) {
+      case 'G':
+        result += 2 * power;
+        break;
+      case 'Y':
+        result += power;
+        break;
+      case 'B':
+        break;
+      default:
+        return false;
+    }
+    power *= 3;
+  }
+  *pattern = result;
+  return true;
+}
+
+std::string ColorsFromPattern(Pattern pattern) {
+  std::string colors(kWordLength, 'B');
+  for (int i = 0; i < kWordLength; i++) {
+    const int digit = pattern % 3;
+    colors[i] = digit == 2 ? 'G' : digit == 1 ? 'Y' : 'B';
+    pattern /= 3;
+  }
+  return colors;
+}
@@ -0,0 +1,57 @@
+#include <array>
+#include <cstdint>
+#include <string>
+#include <vector>
+
+#ifndef PATTERNS_H
+#define PATTERNS_H
+
+// A pattern is the color feedback of a guess against an answer, packed as a
+// base-3 number: position i contributes 3^i times 0 (B), 1 (Y) or 2 (G). An
+// all-green pattern is kAllGreen.
+typedef uint8_t Pattern;
+
+constexpr int kWordLength = 5;
+constexpr int kPatternCount = 243;  // 3^5
+constexpr Pattern kAllGreen = kPatternCount - 1;
+
+// A five-letter word stored as letter indices 0-25, which is what the
+// pattern kernel works on.
+typedef std::array<uint8_t, kWordLength> PackedWord;
+
+PackedWord PackWord(const std::string& word);
+std::vector<PackedWord> PackWords(const std::vector<std::string>& words);
+
+// Returns the feedback `guess` gets against `answer`. This gives the same
+// colors as HurdleGame::CalculateColors for five-letter words.
+inline Pattern ScorePattern(const PackedWord& guess, const PackedWord& answer) {
+  static constexpr uint8_t kPowers[kWordLength] = {1, 3, 9, 27, 81};
+  uint8_t unmatched[26] = {};
+  unsigned green = 0;
+  for (int i = 0; i < kWordLength; i++) {
+    if (guess[i] == answer[i]) {
+      green |= 1u << i;
+    } else {
+      unmatched[answer[i]]++;
+    }
+  }
+  int pattern = 0;
+  for (int i = 0; i < kWordLength; i++) {
+    if (green & (1u << i)) {
+      pattern += 2 * kPowers[i];
+    } else if (unmatched[guess[i]] > 0) {
+      unmatched[guess[i]]--;
+      pattern += kPowers[i];
+    }
+  }
+  return pattern;
+}
+
+// Converts a row of boardColors ("GYB..") to a pattern. Returns false if the
+// row is not five valid colors long.
+bool PatternFromColors(const std::string& colors, Pattern* pattern);
+
+// Converts a pattern back to a row of boardColors.
+std::string ColorsFromPattern(Pattern pattern);
+
+#endif  // PATTERNS_H
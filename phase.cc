@@ -0,0 +1,23 @@
+#include "phase.h"
+
+#include "allocprofile.h"
+#include "server_utils/crow_all.h"
+
+// The span is recorded as crow::trace_span records it, without holding one.
+PhaseScope::PhaseScope(const char* name)
+    : name_(name),
+      trace_id_(crow::detail::current_trace_id),
+      previous_phase_(allocprofile::Enter(allocprofile::Dimension::kPhase,
+                                          name)) {
+  if (trace_id_ != 0) {
+    start_ = std::chrono::steady_clock::now();
+  }
+}
+
+PhaseScope::~PhaseScope() {
+  allocprofile::Leave(allocprofile::Dimension::kPhase, previous_phase_);
+  if (trace_id_ != 0) {
+    crow::trace_hooks.span(trace_id_, name_, start_,
+                           std::chrono::steady_clock::now());
+  }
+}
@@ -0,0 +1,29 @@
+#include <chrono>
+#include <cstddef>
+#include <cstdint>
+
+#ifndef PHASE_H
+#define PHASE_H
+
+// PhaseScope marks the enclosing block as the phase `name` of the request
+// being handled: it is traced as a span of the request, if the request is
+// sampled, and the allocations made in it are counted under `name` by
+// allocation profiling builds. `name` must stay valid for the life of the
+// program, e.g. a string literal.
+class PhaseScope {
+ public:
+  explicit PhaseScope(const char* name);
+  ~PhaseScope();
+
+  PhaseScope(const PhaseScope&) = delete;
+  PhaseScope& operator=(const PhaseScope&) = delete;
+
+ private:
+  const char* name_;
+  // The trace id of the request, 0 if it is not sampled.
+  uint64_t trace_id_;
+  std::chrono::steady_clock::time_point start_;
+  size_t previous_phase_;
+};
+
+#endif  // PHASE_H
@@ -0,0 +1,81 @@
+#include "random.h"
+
+#include <chrono>
+#include <functional>
+#include <random>
+#include <thread>
+
+namespace {
+
+uint64_t RotateLeft(uint64_t x, int k) {
+  return (x << k) | (x >> (64 - k));
+}
+
+Xoshiro256& ThreadGenerator() {
+  thread_local Xoshiro256 generator(
+      (static_cast<uint64_t>(std::random_device()()) << 32) ^
+      std::hash<std::thread::id>()(std::this_thread::get_id()) ^
+      std::chrono::steady_clock::now().time_since_epoch().count());
+  return generator;
+}
+
+}  // namespace
+
+uint64_t MixBits(uint64_t x) {
+  x += 0x9e3779b97f4a7c15ull;
+  x = (x ^ (x >> 30)) * 0xbf58476d1ce4e5b9ull;
+  x = (x ^ (x >> 27)) * 0x94d049bb133111ebull;
+  return x ^ (x >> 31);
+}
+
+uint64_t HashBytes(std::string_view bytes) {
+  uint64_t hash = 14695981039346656037ull;
+  for (unsigned char c : bytes) {
+    hash = (hash ^ c) * 1099511628211ull;
+  }
+  return hash;
+}
+
+Xoshiro256::Xoshiro256(uint64_t seed) {
+  // Expand the seed with splitmix64, which never yields an all-zero state.
+  for (uint64_t& word : state_) {
+    seed += 0x9e3779b97f4a7c15ull;
+    word = MixBits(seed);
+  }
+}
+
+uint64_t Xoshiro256::Next() {
+  const uint64_t result = RotateLeft(state_[1] * 5, 7) * 9;
+  const uint64_t t = state_[1] << 17;
+  state_[2] ^= state_[0];
+  state_[3] ^= state_[1];
+  state_[1] ^= state_[2];
+  state_[0] ^= state_[3];
+  state_[2] ^= t;
+  state_[3] = RotateLeft(state_[3], 45);
+  return result;
+}
+
+uint64_t RandomBits() {
+  return ThreadGenerator().Next();
+}
+
+uint64_t RandomBelow(uint64_t n) {
+  Xoshiro256& generator = ThreadGenerator();
+  unsigned __int128 product =
+      static_cast<unsigned __int128>(generator.Next()) * n;
+  uint64_t low = static_cast<uint64_t>(product);
+  if (low < n) {
+    // Reject the few values that would make some results more likely.
+    const uint64_t threshold = -n % n;
+    while (low < threshold) {
+      product = static_cast<unsigned __int128>(generator.Next()) * n;
+      low = static_cast<uint64_t>(product);
+    }
+  }
+  return static_cast<uint64_t>(product >> 64);
+}
+
+void SeedThreadRandom(uint64_t seed) {
+  ThreadGenerator() = Xoshiro256(seed);
+}
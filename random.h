@@ -0,0 +1,40 @@
+#include <cstdint>
+#include <string_view>
+
+#ifndef RANDOM_H
+#define RANDOM_H
+
+// Xoshiro256 is the xoshiro256** generator: fast, small, and good enough for
+// picking hurdles, though not for anything security related.
+class Xoshiro256 {
+ public:
+  explicit Xoshiro256(uint64_t seed);
+
+  // Returns the next 64 random bits.
+  uint64_t Next();
+
+ private:
+  uint64_t state_[4];
+};
+
+// Returns 64 random bits from the calling thread's generator. Every thread
+// has its own generator, so callers never contend on shared state.
+uint64_t RandomBits();
+
+// Returns a uniformly distributed integer in [0, n), for n > 0. Uses
+// Lemire's multiply-and-reject method, which avoids both the bias of a plain
+// modulo and, almost always, a division.
+uint64_t RandomBelow(uint64_t n);
+
+// Reseeds the calling thread's generator, so a recorded session can be
+// replayed with the same random choices.
+void SeedThreadRandom(uint64_t seed);
+
+// Returns a well mixed 64-bit hash of `x` (the splitmix64 finalizer).
+uint64_t MixBits(uint64_t x);
+
+// Returns the 64-bit FNV-1a hash of `bytes`. Unlike std::hash, it is the same
+// with every standard library, so it can key what servers must agree on.
+uint64_t HashBytes(std::string_view bytes);
+
+#endif  // RANDOM_H
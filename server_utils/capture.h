@@ -0,0 +1,303 @@
+#include <algorithm>
+#include <atomic>
+#include <chrono>
+#include <cstdint>
+#include <cstdlib>
+#include <fstream>
+#include <iterator>
+#include <mutex>
+#include <string>
+#include <string_view>
+#include <vector>
+
+#include "../random.h"
+#include "crow_all.h"
+
+#ifndef CAPTURE_H
+#define CAPTURE_H
+
+// A request recorded by CaptureMiddleware, with a digest of its response.
+struct CapturedRequest {
+  // Time from the start of the capture to the request's arrival.
+  uint64_t arrival_ns = 0;
+  // The seed of the handling thread's random generator for this request, so
+  // a replay draws the same hurdles.
+  uint64_t seed = 0;
+  crow::HTTPMethod method = crow::HTTPMethod::Get;
+  // The URL as sent, with its query string.
+  std::string url;
+  // Request headers that change the response; empty if not sent.
+  std::string session;
+  std::string player;
+  std::string accept_encoding;
+  std::string if_none_match;
+  int status = 0;
+  uint64_t body_hash = 0;
+  // The session header of the response, if it differs from `session`, i.e.
+  // when the request started a session.
+  std::string response_session;
+};
+
+// The binary capture format: a magic string, then one record per request.
+// Integers are LEB128 varints, except the seed and the body hash, which are
+// random-looking and stored as 8 little-endian bytes; strings are a varint
+// length followed by the bytes. Arrival times are deltas from the previous
+// record.
+namespace capture {
+
+constexpr std::string_view kMagic = "HRDLCAP1";
+
+// Hashes a response body, to compare bodies without storing them.
+inline uint64_t HashBody(std::string_view body) { return HashBytes(body); }
+
+inline void PutVarint(uint64_t value, std::string* out) {
+  while (value >= 0x80) {
+    out->push_back(static_cast<char>(value | 0x80));
+    value >>= 7;
+  }
+  out->push_back(static_cast<char>(value));
+}
+
+inline void PutFixed64(uint64_t value, std::string* out) {
+  for (int i = 0; i < 8; i++) {
+    out->push_back(static_cast<char>(value >> (8 * i)));
+  }
+}
+
+inline void PutString(std::string_view value, std::string* out) {
+  PutVarint(value.size(), out);
+  out->append(value);
+}
+
+inline bool GetVarint(std::string_view* in, uint64_t* value) {
+  *value = 0;
+  for (int shift = 0; shift < 64 && !in->empty(); shift += 7) {
+    const unsigned char byte = in->front();
+    in->remove_prefix(1);
+    *value |= static_cast<uint64_t>(byte & 0x7f) << shift;
+    if (byte < 0x80) {
+      return true;
+    }
+  }
+  return false;
+}
+
+inline bool GetFixed64(std::string_view* in, uint64_t* value) {
+  if (in->size() < 8) {
+    return false;
+  }
+  *value = 0;
+  for (int i = 0; i < 8; i++) {
+    *value |= static_cast<uint64_t>(static_cast<unsigned char>((*in)[i]))
+              << (8 * i);
+  }
+  in->remove_prefix(8);
+  return true;
+}
+
+inline bool GetString(std::string_view* in, std::string* value) {
+  uint64_t size;
+  if (!GetVarint(in, &size) || size > in->size()) {
+    return false;
+  }
+  value->assign(in->data(), size);
+  in->remove_prefix(size);
+  return true;
+}
+
+// Appends `request` to `out`, `previous_ns` being the arrival time of the
+// record before it.
+inline void Encode(const CapturedRequest& request, uint64_t previous_ns,
+                   std::string* out) {
+  PutVarint(request.arrival_ns - previous_ns, out);
+  PutFixed64(request.seed, out);
+  PutVarint(static_cast<uint64_t>(request.method), out);
+  PutString(request.url, out);
+  PutString(request.session, out);
+  PutString(request.player, out);
+  PutString(request.accept_encoding, out);
+  PutString(request.if_none_match, out);
+  PutVarint(request.status, out);
+  PutFixed64(request.body_hash, out);
+  PutString(request.response_session, out);
+}
+
+// Decodes every record of a capture. Returns false if `data` is not a
+// capture or is truncated; the records before the damage are kept.
+inline bool Decode(std::string_view data,
+                   std::vector<CapturedRequest>* requests) {
+  if (data.substr(0, kMagic.size()) != kMagic) {
+    return false;
+  }
+  data.remove_prefix(kMagic.size());
+  uint64_t arrival_ns = 0;
+  while (!data.empty()) {
+    CapturedRequest request;
+    uint64_t delta, method, status;
+    if (!GetVarint(&data, &delta) || !GetFixed64(&data, &request.seed) ||
+        !GetVarint(&data, &method) || !GetString(&data, &request.url) ||
+        !GetString(&data, &request.session) ||
+        !GetString(&data, &request.player) ||
+        !GetString(&data, &request.accept_encoding) ||
+        !GetString(&data, &request.if_none_match) ||
+        !GetVarint(&data, &status) || !GetFixed64(&data, &request.body_hash) ||
+        !GetString(&data, &request.response_session)) {
+      return false;
+    }
+    arrival_ns += delta;
+    request.arrival_ns = arrival_ns;
+    request.method = static_cast<crow::HTTPMethod>(method);
+    request.status = static_cast<int>(status);
+    requests->push_back(std::move(request));
+  }
+  return true;
+}
+
+// Reads the capture at `path`.
+inline bool ReadFile(const std::string& path,
+                     std::vector<CapturedRequest>* requests) {
+  std::ifstream in(path, std::ios::binary);
+  if (!in) {
+    return false;
+  }
+  const std::string data((std::istreambuf_iterator<char>(in)),
+                         std::istreambuf_iterator<char>());
+  return Decode(data, requests);
+}
+
+}  // namespace capture
+
+// CaptureMiddleware records every request, with the status and a hash of the
+// body of its response, to a capture file that tools/replay re-drives. It
+// must come after MetricsMiddleware and before the middlewares that may
+// answer a request themselves, so its after_handle sees every response as
+// sent. While capturing, each request reseeds the handling thread's random
+// generator with a seed it records; a server that accepts replay seeds
+// reseeds it from the seed_header of the replayed request instead, so the
+// replay draws the same hurdles.
+struct CaptureMiddleware {
+  struct context {
+    bool captured = false;
+    CapturedRequest request;
+  };
+
+  // The session header, as set on SessionMiddleware.
+  std::string session_header = "X-Session-ID";
+  std::string player_header = "X-Hurdle-Player-ID";
+  std::string seed_header = "X-Hurdle-Replay-Seed";
+  // Paths that are not captured, e.g. telemetry scraped and readiness probed
+  // while capturing.
+  std::vector<std::string> excluded_paths = {"/metrics", "/trace", "/ready",
+                                             "/debug/pprof/profile"};
+  // Whether to honor seed_header. Only for servers that replays run against:
+  // it lets clients choose their hurdles.
+  bool accept_replay_seeds = false;
+
+  ~CaptureMiddleware() { Stop(); }
+
+  // Starts capturing to the file at `path`, replacing it. Must be called
+  // before the server starts. Returns false if the file cannot be written.
+  bool Start(const std::string& path) {
+    std::lock_guard<std::mutex> lock(mutex_);
+    out_.open(path, std::ios::binary | std::ios::trunc);
+    if (!out_) {
+      return false;
+    }
+    out_.write(capture::kMagic.data(), capture::kMagic.size());
+    start_ = std::chrono::steady_clock::now();
+    seed_base_ = MixBits(start_.time_since_epoch().count());
+    previous_ns_ = 0;
+    capturing_.store(true);
+    return true;
+  }
+
+  // Writes the requests captured so far and stops capturing.
+  void Stop() {
+    std::lock_guard<std::mutex> lock(mutex_);
+    if (!capturing_.exchange(false)) {
+      return;
+    }
+    Flush();
+    out_.close();
+  }
+
+  uint64_t CapturedCount() const { return captured_.load(); }
+
+  void before_handle(crow::request& req, crow::response&, context& ctx) {
+    if (!capturing_.load(std::memory_order_relaxed)) {
+      if (accept_replay_seeds) {
+        const std::string& seed = req.get_header_value(seed_header);
+        if (!seed.empty()) {
+          SeedThreadRandom(std::strtoull(seed.c_str(), nullptr, 10));
+        }
+      }
+      return;
+    }
+    for (const std::string& path : excluded_paths) {
+      if (req.url == path) {
+        return;
+      }
+    }
+    CapturedRequest& request = ctx.request;
+    ctx.captured = true;
+    request.arrival_ns = std::chrono::duration_cast<std::chrono::nanoseconds>(
+                             std::chrono::steady_clock::now() - start_)
+                             .count();
+    request.seed = MixBits(seed_base_ + sequence_.fetch_add(1));
+    SeedThreadRandom(request.seed);
+    request.method = req.method;
+    request.url = req.raw_url;
+    request.session = req.get_header_value(session_header);
+    request.player = req.get_header_value(player_header);
+    request.accept_encoding = req.get_header_value("Accept-Encoding");
+    request.if_none_match = req.get_header_value("If-None-Match");
+  }
+
+  void after_handle(crow::request&, crow::response& res, context& ctx) {
+    if (!ctx.captured) {
+      return;
+    }
+    CapturedRequest& request = ctx.request;
+    request.status = res.code;
+    request.body_hash = capture::HashBody(res.body);
+    const std::string& session = res.get_header_value(session_header);
+    if (session != request.session) {
+      request.response_session = session;
+    }
+    std::lock_guard<std::mutex> lock(mutex_);
+    if (!capturing_.load()) {
+      return;
+    }
+    // Requests are handled concurrently, so a record may arrive a little
+    // before the previous one; its delta is then 0.
+    request.arrival_ns = std::max(request.arrival_ns, previous_ns_);
+    capture::Encode(request, previous_ns_, &buffer_);
+    previous_ns_ = request.arrival_ns;
+    captured_.fetch_add(1);
+    if (buffer_.size() >= kFlushSize) {
+      Flush();
+    }
+  }
+
+ private:
+  static constexpr size_t kFlushSize = 1 << 16;
+
+  std::atomic<bool> capturing_{false};
+  std::atomic<uint64_t> sequence_{0};
+  std::atomic<uint64_t> captured_{0};
+  std::chrono::steady_clock::time_point start_;
+  uint64_t seed_base_ = 0;
+  // Guards the fields below.
+  std::mutex mutex_;
+  std::ofstream out_;
+  std::string buffer_;
+  uint64_t previous_ns_ = 0;
+
+  void Flush() {
+    out_.write(buffer_.data(), buffer_.size());
+    out_.flush();
+    buffer_.clear();
+  }
+};
+
+#endif  // CAPTURE_H
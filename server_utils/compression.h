@@ -0,0 +1,229 @@
+#include <time.h>
+#include <zlib.h>
+
+#include <atomic>
+#include <cstdint>
+#include <cstdlib>
+#include <string>
+
+#ifndef COMPRESSION_H
+#define COMPRESSION_H
+
+enum class ContentEncoding { kIdentity = -1, kGzip = 0, kDeflate = 1 };
+
+// CompressedBodyCache keeps the last compressed body for each encoding,
+// tagged with the state version it was produced from. Version 0 marks an
+// empty slot.
+struct CompressedBodyCache {
+  uint64_t version[2] = {0, 0};
+  std::string body[2];
+};
+
+// ResponseCompressor compresses response bodies with zlib. Each thread keeps
+// its own deflate streams, which are reset between responses rather than
+// initialized for every one of them.
+class ResponseCompressor {
+ public:
+  // Bodies smaller than this many bytes are sent uncompressed, since the
+  // framing overhead outweighs any savings on them.
+  size_t min_size = 256;
+  // zlib compression level used by the per-thread streams.
+  int level = Z_DEFAULT_COMPRESSION;
+
+  // Picks the encoding to use for a request's Accept-Encoding header. gzip is
+  // preferred over deflate, and encodings with q=0 are never picked. "*"
+  // only stands for the encodings the header does not name.
+  static ContentEncoding Negotiate(const std::string& accept_encoding) {
+    bool gzip = false;
+    bool deflate = false;
+    bool gzip_named = false;
+    bool deflate_named = false;
+    bool any = false;
+    size_t start = 0;
+    while (start < accept_encoding.size()) {
+      size_t end = accept_encoding.find(',', start);
+      if (end == std::string::npos) {
+        end = accept_encoding.size();
+      }
+      std::string coding = Trim(accept_encoding.substr(start, end - start));
+      bool accepted = true;
+      if (size_t semicolon = coding.find(';'); semicolon != std::string::npos) {
+        std::string params = coding.substr(semicolon + 1);
+        coding = Trim(coding.substr(0, semicolon));
+        if (size_t q = params.find("q="); q != std::string::npos) {
+          accepted = std::strtod(params.c_str() + q + 2, nullptr) > 0;
+        }
+      }
+      if (coding == "gzip" || coding == "x-gzip") {
+        gzip = gzip || accepted;
+        gzip_named = true;
+      } else if (coding == "deflate") {
+        deflate = deflate || accepted;
+        deflate_named = true;
+      } else if (coding == "*") {
+        any = any || accepted;
+      }
+      start = end + 1;
+    }
+    gzip = gzip || (any && !gzip_named);
+    deflate = deflate || (any && !deflate_named);
+    if (gzip) {
+      return ContentEncoding::kGzip;
+    }
+    if (deflate) {
+      return ContentEncoding::kDeflate;
+    }
+    return ContentEncoding::kIdentity;
+  }
+
+  static const char* EncodingName(ContentEncoding encoding) {
+    switch (encoding) {
+      case ContentEncoding::kGzip:
+        return "gzip";
+      case ContentEncoding::kDeflate:
+        return "deflate";
+      default:
+        return "identity";
+    }
+  }
+
+  // Returns true if a body of `size` bytes should be compressed with
+  // `encoding`.
+  bool ShouldCompress(size_t size, ContentEncoding encoding) const {
+    if (encoding == ContentEncoding::kIdentity) {
+      return false;
+    }
+    if (size < min_size) {
+      skipped_.fetch_add(1, std::memory_order_relaxed);
+      return false;
+    }
+    return true;
+  }
+
+  // Returns `body` compressed with `encoding`, reusing the copy stored in
+  // `cache` when it was produced from the same state `version`. Returns
+  // nullptr if zlib failed, in which case the body should be sent as is.
+  const std::string* CompressCached(const std::string& body,
+                                    ContentEncoding encoding, uint64_t version,
+                                    CompressedBodyCache& cache) {
+    const int slot = static_cast<int>(encoding);
+    if (cache.version[slot] == version) {
+      cache_hits_.fetch_add(1, std::memory_order_relaxed);
+      bytes_in_.fetch_add(body.size(), std::memory_order_relaxed);
+      bytes_out_.fetch_add(cache.body[slot].size(), std::memory_order_relaxed);
+      return &cache.body[slot];
+    }
+    if (!Compress(body, encoding, &cache.body[slot])) {
+      cache.version[slot] = 0;
+      return nullptr;
+    }
+    cache.version[slot] = version;
+    return &cache.body[slot];
+  }
+
+  // Compresses `body` into `out`. Returns false if zlib failed, in which case
+  // `out` is left unspecified.
+  bool Compress(const std::string& body, ContentEncoding encoding,
+                std::string* out) {
+    const uint64_t start = ThreadCpuNanos();
+    z_stream* stream = ThreadStream(encoding);
+    if (stream == nullptr) {
+      return false;
+    }
+    out->resize(deflateBound(stream, body.size()));
+    stream->next_in =
+        reinterpret_cast<Bytef*>(const_cast<char*>(body.data()));
+    stream->avail_in = body.size();
+    stream->next_out = reinterpret_cast<Bytef*>(&(*out)[0]);
+    stream->avail_out = out->size();
+    const int status = deflate(stream, Z_FINISH);
+    out->resize(out->size() - stream->avail_out);
+    deflateReset(stream);
+    if (status != Z_STREAM_END) {
+      return false;
+    }
+
+    compressed_.fetch_add(1, std::memory_order_relaxed);
+    bytes_in_.fetch_add(body.size(), std::memory_order_relaxed);
+    bytes_out_.fetch_add(out->size(), std::memory_order_relaxed);
+    cpu_nanos_.fetch_add(ThreadCpuNanos() - start, std::memory_order_relaxed);
+    return true;
+  }
+
+  // Number of bodies compressed, excluding cache hits.
+  uint64_t CompressedCount() const { return compressed_.load(); }
+  // Number of cached compressed bodies that were reused.
+  uint64_t CacheHits() const { return cache_hits_.load(); }
+  // Number of bodies sent uncompressed because they were below min_size.
+  uint64_t SkippedCount() const { return skipped_.load(); }
+  // Bytes not sent thanks to compression, including cache hits.
+  uint64_t BytesSaved() const {
+    const uint64_t in = bytes_in_.load();
+    const uint64_t out = bytes_out_.load();
+    return in > out ? in - out : 0;
+  }
+  // CPU time spent compressing, in nanoseconds. Time the compressing thread
+  // was preempted for is not counted.
+  uint64_t CpuNanos() const { return cpu_nanos_.load(); }
+
+ private:
+  std::atomic<uint64_t> compressed_{0};
+  std::atomic<uint64_t> cache_hits_{0};
+  mutable std::atomic<uint64_t> skipped_{0};
+  std::atomic<uint64_t> bytes_in_{0};
+  std::atomic<uint64_t> bytes_out_{0};
+  std::atomic<uint64_t> cpu_nanos_{0};
+
+  // ThreadStreams owns the deflate streams of one thread.
+  struct ThreadStreams {
+    z_stream streams[2];
+    bool initialized[2] = {false, false};
+
+    ~ThreadStreams() {
+      for (int i = 0; i < 2; i++) {
+        if (initialized[i]) {
+          deflateEnd(&streams[i]);
+        }
+      }
+    }
+  };
+
+  z_stream* ThreadStream(ContentEncoding encoding) {
+    thread_local ThreadStreams thread_streams;
+    const int slot = static_cast<int>(encoding);
+    if (slot < 0) {
+      return nullptr;
+    }
+    z_stream* stream = &thread_streams.streams[slot];
+    if (!thread_streams.initialized[slot]) {
+      *stream = z_stream{};
+      // Adding 16 to the window bits makes zlib write a gzip wrapper.
+      const int window_bits =
+          encoding == ContentEncoding::kGzip ? MAX_WBITS + 16 : MAX_WBITS;
+      if (deflateInit2(stream, level, Z_DEFLATED, window_bits, 8,
+                       Z_DEFAULT_STRATEGY) != Z_OK) {
+        return nullptr;
+      }
+      thread_streams.initialized[slot] = true;
+    }
+    return stream;
+  }
+
+  // Returns the CPU time consumed by the calling thread.
+  static uint64_t ThreadCpuNanos() {
+    timespec now;
+    clock_gettime(CLOCK_THREAD_CPUTIME_ID, &now);
+    return static_cast<uint64_t>(now.tv_sec) * 1000000000 + now.tv_nsec;
+  }
+
+  static std::string Trim(const std::string& s) {
+    const size_t first = s.find_first_not_of(" \t");
+    if (first == std::string::npos) {
+      return "";
+    }
+    const size_t last = s.find_last_not_of(" \t");
+    return s.substr(first, last - first + 1);
+  }
+};
+
+#endif  // COMPRESSION_H
@@ -31,6 +31,20 @@ OF THIS SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY OF SUCH DAMAGE.
 
 The Crow logo and other graphic material (excluding third party logos) used are under exclusive Copyright (c) 2021-2022, Farook Al-Sammarraie (The-EDev), All rights reserved.
 */
+/* Local changes: this copy of Crow carries patches for the Hurdle server,
+ * kept as server_utils/crow_all.patch against the upstream amalgamation.
+ * They add:
+ * - listen_handle and stop_accepting, and let a "Connection: close" set by a
+ *   handler override keep-alive, for handing the server over on restarts;
+ * - TCP_NODELAY on accepted connections;
+ * - trace_hooks around the phases of a request, and demangled type names in
+ *   the exception log (cxxabi);
+ * - handle_in_process, to replay captured requests without a socket;
+ * - connection_poster and request::poster(), to finish a response from
+ *   another thread, and a do_read close path that leaves the connection to
+ *   the pending handler instead of destroying it.
+ * Reapply the patch when updating Crow.
+ */
 #pragma once
 // settings for crow
 // TODO(ipkn) replace with runtime config. libucl?
@@ -2566,6 +2580,24 @@ namespace crow
         return empty;
     }
 
+    /// Posts handlers to the thread of the connection a request came from, where they run unless the connection has been freed by then.
+    ///
+    /// The response belongs to the connection, so a handler that completes it from another thread should go through this rather than request::post.
+    struct connection_poster
+    {
+        boost::asio::io_service* io_service{};
+        std::weak_ptr<void> connection_alive;
+
+        template<typename CompletionHandler>
+        void post(CompletionHandler handler) const
+        {
+            io_service->post([alive = connection_alive, handler = std::move(handler)]() mutable {
+                if (!alive.expired())
+                    handler();
+            });
+        }
+    };
+
     /// An HTTP request.
     struct request
     {
@@ -2582,6 +2614,7 @@ namespace crow
         void* middleware_context{};
         void* middleware_container{};
         boost::asio::io_service* io_service{};
+        std::weak_ptr<void> connection_alive; ///< Expires once the connection the request came from is freed.
 
         /// Construct an empty request. (sets the method to `GET`)
         request():
@@ -2621,6 +2654,12 @@ namespace crow
         {
             io_service->dispatch(handler);
         }
+
+        /// Get a poster for completing the response later, from another thread.
+        connection_poster poster() const
+        {
+            return {io_service, connection_alive};
+        }
     };
 } // namespace crow
 
@@ -3361,6 +3400,13 @@ namespace crow
 #include <type_traits>
 #include <iostream>
 #include <utility>
+#include <chrono>
+#include <cstdint>
+#include <cstdlib>
+#include <functional>
+#include <string>
+#include <typeinfo>
+#include <cxxabi.h>
 
 namespace crow
 {
@@ -3371,8 +3417,69 @@ namespace crow
         using call_global = std::false_type;
     };
 
+    /// Hooks for tracing the phases of requests, set by the application before the server starts.
+    /// `begin` is called once a request has been parsed and returns a nonzero id if the request is sampled.
+    /// `span` then receives the parsing, each middleware, the handler and the response write of that
+    /// request, along with every trace_span opened while handling it.
+    struct request_trace_hooks
+    {
+        std::function<uint64_t()> begin;
+        std::function<void(uint64_t id, const char* name, std::chrono::steady_clock::time_point start, std::chrono::steady_clock::time_point end)> span;
+    };
+
+    inline request_trace_hooks trace_hooks;
+
+    namespace detail
+    {
+        /// Id of the sampled request being handled on this thread, or 0.
+        inline thread_local uint64_t current_trace_id = 0;
+    } // namespace detail
+
+    /// Times the enclosing scope as a span of the request handled on this thread, if it is sampled.
+    /// `name` must outlive the trace, e.g. a string literal.
+    class trace_span
+    {
+    public:
+        explicit trace_span(const char* name):
+          id_(detail::current_trace_id), name_(name)
+        {
+            if (id_ != 0)
+                start_ = std::chrono::steady_clock::now();
+        }
+
+        ~trace_span()
+        {
+            if (id_ != 0)
+                trace_hooks.span(id_, name_, start_, std::chrono::steady_clock::now());
+        }
+
+        trace_span(const trace_span&) = delete;
+        trace_span& operator=(const trace_span&) = delete;
+
+    private:
+        uint64_t id_;
+        const char* name_;
+        std::chrono::steady_clock::time_point start_;
+    };
+
     namespace detail
     {
+        /// Span name of a middleware's before_handle or after_handle, demangled once.
+        template<typename MW>
+        const char* middleware_trace_name(bool before)
+        {
+            static const std::string type_name = [] {
+                int status = 0;
+                char* demangled = abi::__cxa_demangle(typeid(MW).name(), nullptr, nullptr, &status);
+                std::string name = status == 0 ? demangled : typeid(MW).name();
+                std::free(demangled);
+                return name;
+            }();
+            static const std::string before_name = type_name + "::before_handle";
+            static const std::string after_name = type_name + "::after_handle";
+            return before ? before_name.c_str() : after_name.c_str();
+        }
+
         template<typename MW>
         struct check_before_handle_arity_3_const
         {
@@ -3449,6 +3556,7 @@ namespace crow
         typename std::enable_if<!is_before_handle_arity_3_impl<MW>::value>::type
           before_handler_call(MW& mw, request& req, response& res, Context& ctx, ParentContext& /*parent_ctx*/)
         {
+            trace_span span(middleware_trace_name<MW>(true));
             mw.before_handle(req, res, ctx.template get<MW>(), ctx);
         }
 
@@ -3456,6 +3564,7 @@ namespace crow
         typename std::enable_if<is_before_handle_arity_3_impl<MW>::value>::type
           before_handler_call(MW& mw, request& req, response& res, Context& ctx, ParentContext& /*parent_ctx*/)
         {
+            trace_span span(middleware_trace_name<MW>(true));
             mw.before_handle(req, res, ctx.template get<MW>());
         }
 
@@ -3463,6 +3572,7 @@ namespace crow
         typename std::enable_if<!is_after_handle_arity_3_impl<MW>::value>::type
           after_handler_call(MW& mw, request& req, response& res, Context& ctx, ParentContext& /*parent_ctx*/)
         {
+            trace_span span(middleware_trace_name<MW>(false));
             mw.after_handle(req, res, ctx.template get<MW>(), ctx);
         }
 
@@ -3470,6 +3580,7 @@ namespace crow
         typename std::enable_if<is_after_handle_arity_3_impl<MW>::value>::type
           after_handler_call(MW& mw, request& req, response& res, Context& ctx, ParentContext& /*parent_ctx*/)
         {
+            trace_span span(middleware_trace_name<MW>(false));
             mw.after_handle(req, res, ctx.template get<MW>());
         }
 
@@ -11308,6 +11419,15 @@ namespace crow
             bool is_invalid_request = false;
             add_keep_alive_ = false;
 
+            trace_id_ = 0;
+            if (trace_hooks.begin)
+            {
+                trace_id_ = trace_hooks.begin();
+                if (trace_id_ != 0)
+                    trace_hooks.span(trace_id_, "crow::parse", read_start_, std::chrono::steady_clock::now());
+            }
+            detail::current_trace_id = trace_id_;
+
             req_ = std::move(parser_.to_request());
             request& req = req_;
 
@@ -11355,6 +11475,7 @@ namespace crow
                 req.middleware_context = static_cast<void*>(&ctx_);
                 req.middleware_container = static_cast<void*>(middlewares_);
                 req.io_service = &adaptor_.get_io_service();
+                req.connection_alive = alive_;
 
                 detail::middleware_call_helper<detail::middleware_call_criteria_only_global,
                                                0, decltype(ctx_), decltype(*middlewares_)>(*middlewares_, req, res, ctx_);
@@ -11365,7 +11486,10 @@ namespace crow
                         this->complete_request();
                     };
                     need_to_call_after_handlers_ = true;
-                    handler_->handle(req, res);
+                    {
+                        trace_span span("crow::handle");
+                        handler_->handle(req, res);
+                    }
                     if (add_keep_alive_)
                         res.set_header("connection", "Keep-Alive");
                 }
@@ -11378,6 +11502,7 @@ namespace crow
             {
                 complete_request();
             }
+            detail::current_trace_id = 0;
         }
 
         /// Call the after handle middleware and send the write the response to the connection.
@@ -11396,6 +11521,13 @@ namespace crow
                   decltype(ctx_),
                   decltype(*middlewares_)>(*middlewares_, ctx_, req_, res);
             }
+
+            // A handler or middleware asking to close the connection overrides keep-alive.
+            if (res.get_header_value("connection") == "close")
+            {
+                close_connection_ = true;
+                add_keep_alive_ = false;
+            }
 #ifdef CROW_ENABLE_COMPRESSION
             if (handler_->compression_used())
             {
@@ -11437,6 +11569,8 @@ namespace crow
                 res.set_header("location", location);
             }
 
+            if (trace_id_ != 0)
+                write_start_ = std::chrono::steady_clock::now();
             prepare_buffers();
 
             if (res.is_static_type())
@@ -11663,6 +11797,8 @@ namespace crow
               boost::asio::buffer(buffer_),
               [this](const boost::system::error_code& ec, std::size_t bytes_transferred) {
                   bool error_while_reading = true;
+                  if (trace_hooks.begin)
+                      read_start_ = std::chrono::steady_clock::now();
                   if (!ec)
                   {
                       bool ret = parser_.feed(buffer_.data(), bytes_transferred);
@@ -11687,7 +11823,9 @@ namespace crow
                       cancel_deadline_timer();
                       parser_.done();
                       is_reading = false;
-                      check_destroy();
+                      // A response the user completes later is still to be written
+                      if (!need_to_call_after_handlers_)
+                          check_destroy();
                       // adaptor will close after write
                   }
                   else if (!need_to_call_after_handlers_)
@@ -11711,6 +11849,11 @@ namespace crow
               adaptor_.socket(), buffers_,
               [&](const boost::system::error_code& ec, std::size_t /*bytes_transferred*/) {
                   is_writing = false;
+                  if (trace_id_ != 0)
+                  {
+                      trace_hooks.span(trace_id_, "crow::write", write_start_, std::chrono::steady_clock::now());
+                      trace_id_ = 0;
+                  }
                   res.clear();
                   res_body_copy_.clear();
                   parser_.clear();
@@ -11807,6 +11950,14 @@ namespace crow
         bool is_writing{};
         bool need_to_call_after_handlers_{};
         bool need_to_start_read_after_complete_{};
+        // Shared with the requests as connection_alive, so late completions can tell the connection is gone.
+        std::shared_ptr<void> alive_ = std::make_shared<char>();
+
+        // Tracing of the current request; trace_id_ is 0 unless it is sampled.
+        uint64_t trace_id_{};
+        std::chrono::steady_clock::time_point read_start_;
+        std::chrono::steady_clock::time_point write_start_;
+
         bool add_keep_alive_{};
 
         std::tuple<Middlewares...>* middlewares_;
@@ -11856,8 +12007,8 @@ namespace crow
     class Server
     {
     public:
-        Server(Handler* handler, std::string bindaddr, uint16_t port, std::string server_name = std::string("Crow/") + VERSION, std::tuple<Middlewares...>* middlewares = nullptr, uint16_t concurrency = 1, uint8_t timeout = 5, typename Adaptor::context* adaptor_ctx = nullptr):
-          acceptor_(io_service_, tcp::endpoint(boost::asio::ip::address::from_string(bindaddr), port)),
+        Server(Handler* handler, std::string bindaddr, uint16_t port, std::string server_name = std::string("Crow/") + VERSION, std::tuple<Middlewares...>* middlewares = nullptr, uint16_t concurrency = 1, uint8_t timeout = 5, typename Adaptor::context* adaptor_ctx = nullptr, int listen_handle = -1):
+          acceptor_(io_service_),
           signals_(io_service_),
           tick_timer_(io_service_),
           handler_(handler),
@@ -11869,7 +12020,21 @@ namespace crow
           task_queue_length_pool_(concurrency_ - 1),
           middlewares_(middlewares),
           adaptor_ctx_(adaptor_ctx)
-        {}
+        {
+            tcp::endpoint endpoint(boost::asio::ip::address::from_string(bindaddr), port);
+            if (listen_handle >= 0)
+            {
+                // Adopt a socket that is already listening, e.g. one handed over by another process.
+                acceptor_.assign(endpoint.protocol(), listen_handle);
+            }
+            else
+            {
+                acceptor_.open(endpoint.protocol());
+                acceptor_.set_option(tcp::acceptor::reuse_address(true));
+                acceptor_.bind(endpoint);
+                acceptor_.listen();
+            }
+        }
 
         void set_tick_function(std::chrono::milliseconds d, std::function<void()> f)
         {
@@ -12006,6 +12171,21 @@ namespace crow
             signals_.add(signal_number);
         }
 
+        /// The native handle of the listening socket.
+        int listen_handle()
+        {
+            return acceptor_.native_handle();
+        }
+
+        /// Stop accepting new connections while still serving the open ones.
+        void stop_accepting()
+        {
+            io_service_.post([this] {
+                boost::system::error_code ec;
+                acceptor_.close(ec);
+            });
+        }
+
     private:
         uint16_t pick_io_service_idx()
         {
@@ -12037,6 +12217,10 @@ namespace crow
               [this, p, &is, service_idx](boost::system::error_code ec) {
                   if (!ec)
                   {
+                      // Responses are written as soon as they are ready, so Nagle's algorithm
+                      // only holds a keep-alive response back until the client's delayed ACK.
+                      boost::system::error_code nodelay_ec;
+                      p->socket().set_option(tcp::no_delay(true), nodelay_ec);
                       is.post(
                         [p] {
                             p->start();
@@ -12048,7 +12232,8 @@ namespace crow
                       CROW_LOG_DEBUG << &is << " {" << service_idx << "} queue length: " << task_queue_length_pool_[service_idx];
                       delete p;
                   }
-                  do_accept();
+                  if (acceptor_.is_open())
+                      do_accept();
               });
         }
 
@@ -12166,6 +12351,26 @@ namespace crow
             router_.handle(req, res);
         }
 
+        /// Process the request through the global middlewares and the router, as a connection would, but without one
+        ///
+        /// Used to replay requests in-process. Call validate() first. Handlers must complete the response before returning.
+        void handle_in_process(request& req, response& res)
+        {
+            detail::context<Middlewares...> ctx;
+            req.middleware_context = static_cast<void*>(&ctx);
+            req.middleware_container = static_cast<void*>(&middlewares_);
+            if (detail::middleware_call_helper<detail::middleware_call_criteria_only_global,
+                                               0, decltype(ctx), decltype(middlewares_)>(middlewares_, req, res, ctx))
+            {
+                // A middleware completed the response, and the after handlers of those before it have run.
+                return;
+            }
+            router_.handle(req, res);
+            detail::after_handlers_call_helper<detail::middleware_call_criteria_only_global,
+                                               (static_cast<int>(sizeof...(Middlewares)) - 1),
+                                               decltype(ctx), decltype(middlewares_)>(middlewares_, ctx, req, res);
+        }
+
         /// Create a dynamic route using a rule (**Use CROW_ROUTE instead**)
         DynamicRule& route_dynamic(std::string&& rule)
         {
@@ -12241,6 +12446,25 @@ namespace crow
             return *this;
         }
 
+        /// Serve on an already listening socket instead of binding the port
+        self_t& listen_handle(int handle)
+        {
+            listen_handle_ = handle;
+            return *this;
+        }
+
+        /// Get the native handle of the listening socket (-1 before the server is started)
+        int listen_handle()
+        {
+            return server_ ? server_->listen_handle() : -1;
+        }
+
+        /// Stop accepting new connections, but keep serving the open ones
+        void stop_accepting()
+        {
+            if (server_) { server_->stop_accepting(); }
+        }
+
         /// Run the server on multiple threads using all available threads
         self_t& multithreaded()
         {
@@ -12389,7 +12613,7 @@ namespace crow
             else
 #endif
             {
-                server_ = std::move(std::unique_ptr<server_t>(new server_t(this, bindaddr_, port_, server_name_, &middlewares_, concurrency_, timeout_, nullptr)));
+                server_ = std::move(std::unique_ptr<server_t>(new server_t(this, bindaddr_, port_, server_name_, &middlewares_, concurrency_, timeout_, nullptr, listen_handle_)));
                 server_->set_tick_function(tick_interval_, tick_function_);
                 server_->signal_clear();
                 for (auto snum : signals_)
@@ -12556,6 +12780,7 @@ namespace crow
         bool validated_ = false;
         std::string server_name_ = std::string("Crow/") + VERSION;
         std::string bindaddr_ = "0.0.0.0";
+        int listen_handle_ = -1;
         size_t res_stream_threshold_ = 1048576;
         Router router_;
 
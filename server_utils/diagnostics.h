@@ -0,0 +1,71 @@
+#include <string>
+#include <vector>
+
+#include "crow_all.h"
+
+#ifndef DIAGNOSTICS_H
+#define DIAGNOSTICS_H
+
+// DiagnosticsMiddleware keeps the routes that expose the server's internals
+// (its metrics, traces and profiles) to operators. Requests for them are
+// answered only from the loopback interface, e.g. a local scraper or an SSH
+// tunnel, or with an "Authorization: Bearer" header carrying `token`, if one
+// is set. Other clients get a 403 before routing. Behind a reverse proxy on
+// the same host every client comes from loopback, so the proxy must not
+// forward these paths.
+struct DiagnosticsMiddleware {
+  struct context {};
+
+  void before_handle(crow::request& req, crow::response& res, context&) {
+    if (!Guarded(req.url) || IsLoopback(req.remote_ip_address) ||
+        HasToken(req)) {
+      return;
+    }
+    res.code = 403;
+    res.body = "Diagnostics are only served locally";
+    res.end();
+  }
+
+  void after_handle(crow::request&, crow::response&, context&) {}
+
+  // Path prefixes of the guarded routes.
+  std::vector<std::string> prefixes = {"/metrics", "/trace", "/debug/"};
+  // Bearer token that opens the guarded routes to remote clients. Empty
+  // keeps them local.
+  std::string token;
+
+ private:
+  bool Guarded(const std::string& url) const {
+    for (const std::string& prefix : prefixes) {
+      if (url.compare(0, prefix.size(), prefix) == 0) {
+        return true;
+      }
+    }
+    return false;
+  }
+
+  static bool IsLoopback(const std::string& ip) {
+    return ip.rfind("127.", 0) == 0 || ip == "::1" ||
+           ip.rfind("::ffff:127.", 0) == 0;
+  }
+
+  // Compares in constant time, so the time taken does not tell how much of
+  // a guess matched.
+  bool HasToken(const crow::request& req) const {
+    if (token.empty()) {
+      return false;
+    }
+    const std::string expected = "Bearer " + token;
+    const std::string& header = req.get_header_value("Authorization");
+    if (header.size() != expected.size()) {
+      return false;
+    }
+    unsigned char difference = 0;
+    for (size_t i = 0; i < header.size(); i++) {
+      difference |= header[i] ^ expected[i];
+    }
+    return difference == 0;
+  }
+};
+
+#endif  // DIAGNOSTICS_H
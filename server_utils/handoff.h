@@ -0,0 +1,212 @@
+#include <sys/socket.h>
+#include <sys/un.h>
+#include <unistd.h>
+
+#include <atomic>
+#include <chrono>
+#include <cstring>
+#include <string>
+#include <thread>
+
+#include "crow_all.h"
+
+#ifndef HANDOFF_H
+#define HANDOFF_H
+
+// DrainMiddleware counts the requests in flight so the server can be stopped
+// without cutting any of them off. Once draining, every response asks the
+// client to close its connection, so keep-alive clients reconnect to whichever
+// process is accepting connections next.
+struct DrainMiddleware {
+  struct context {
+    bool counted = false;
+  };
+
+  void before_handle(crow::request&, crow::response&, context& ctx) {
+    in_flight_.fetch_add(1);
+    ctx.counted = true;
+    Touch();
+  }
+
+  void after_handle(crow::request&, crow::response& res, context& ctx) {
+    if (!ctx.counted) {
+      return;
+    }
+    if (draining_.load()) {
+      res.set_header("Connection", "close");
+    }
+    Touch();
+    in_flight_.fetch_sub(1);
+  }
+
+  void StartDraining() { draining_.store(true); }
+  bool Draining() const { return draining_.load(); }
+
+  // Blocks until no request has been in flight for `quiet`, or until
+  // `timeout` has passed. Returns true if the server went idle.
+  bool WaitUntilIdle(std::chrono::milliseconds quiet,
+                     std::chrono::milliseconds timeout) {
+    const auto deadline = std::chrono::steady_clock::now() + timeout;
+    while (std::chrono::steady_clock::now() < deadline) {
+      const auto idle = std::chrono::steady_clock::now().time_since_epoch() -
+                        std::chrono::nanoseconds(last_activity_ns_.load());
+      if (in_flight_.load() == 0 && idle >= quiet) {
+        return true;
+      }
+      std::this_thread::sleep_for(std::chrono::milliseconds(10));
+    }
+    return false;
+  }
+
+ private:
+  std::atomic<int64_t> in_flight_{0};
+  std::atomic<int64_t> last_activity_ns_{0};
+  std::atomic<bool> draining_{false};
+
+  void Touch() {
+    last_activity_ns_.store(
+        std::chrono::duration_cast<std::chrono::nanoseconds>(
+            std::chrono::steady_clock::now().time_since_epoch())
+            .count());
+  }
+};
+
+// Helpers for handing a running server over to its successor through a Unix
+// domain socket: the listening socket is passed as a file descriptor, then
+// the serialized sessions follow as a byte stream.
+namespace handoff {
+
+inline bool MakeAddress(const std::string& path, sockaddr_un* addr) {
+  std::memset(addr, 0, sizeof(*addr));
+  addr->sun_family = AF_UNIX;
+  if (path.size() >= sizeof(addr->sun_path)) {
+    return false;
+  }
+  std::strcpy(addr->sun_path, path.c_str());
+  return true;
+}
+
+// Listens for a successor on the socket file at `path`, replacing any stale
+// one. Returns the listening descriptor, or -1 on failure.
+inline int Listen(const std::string& path) {
+  sockaddr_un addr;
+  if (!MakeAddress(path, &addr)) {
+    return -1;
+  }
+  int sock = socket(AF_UNIX, SOCK_STREAM, 0);
+  if (sock < 0) {
+    return -1;
+  }
+  unlink(path.c_str());
+  if (bind(sock, reinterpret_cast<sockaddr*>(&addr), sizeof(addr)) != 0 ||
+      listen(sock, 1) != 0) {
+    close(sock);
+    return -1;
+  }
+  return sock;
+}
+
+// Returns true if the process at the other end of the Unix domain socket
+// `sock` runs as the same user as this one. The socket file may live in a
+// directory other users can write to, so either end checks the other before
+// handing over a listening socket or sessions.
+inline bool PeerIsSameUser(int sock) {
+  ucred peer{};
+  socklen_t size = sizeof(peer);
+  return getsockopt(sock, SOL_SOCKET, SO_PEERCRED, &peer, &size) == 0 &&
+         peer.uid == getuid();
+}
+
+// Connects to a running predecessor at `path`. Returns -1 if there is none,
+// or if it runs as another user.
+inline int Connect(const std::string& path) {
+  sockaddr_un addr;
+  if (!MakeAddress(path, &addr)) {
+    return -1;
+  }
+  int sock = socket(AF_UNIX, SOCK_STREAM, 0);
+  if (sock < 0) {
+    return -1;
+  }
+  if (connect(sock, reinterpret_cast<sockaddr*>(&addr), sizeof(addr)) != 0 ||
+      !PeerIsSameUser(sock)) {
+    close(sock);
+    return -1;
+  }
+  return sock;
+}
+
+// Sends the descriptor `fd` over `sock` as SCM_RIGHTS ancillary data. It
+// returns false rather than raise SIGPIPE if the peer is gone.
+inline bool SendFd(int sock, int fd) {
+  char byte = 'F';
+  iovec iov{&byte, 1};
+  char control[CMSG_SPACE(sizeof(int))] = {};
+  msghdr msg{};
+  msg.msg_iov = &iov;
+  msg.msg_iovlen = 1;
+  msg.msg_control = control;
+  msg.msg_controllen = sizeof(control);
+  cmsghdr* cmsg = CMSG_FIRSTHDR(&msg);
+  cmsg->cmsg_level = SOL_SOCKET;
+  cmsg->cmsg_type = SCM_RIGHTS;
+  cmsg->cmsg_len = CMSG_LEN(sizeof(int));
+  std::memcpy(CMSG_DATA(cmsg), &fd, sizeof(int));
+  return sendmsg(sock, &msg, MSG_NOSIGNAL) == 1;
+}
+
+// Receives a descriptor sent with SendFd. Returns -1 on failure.
+inline int ReceiveFd(int sock) {
+  char byte;
+  iovec iov{&byte, 1};
+  char control[CMSG_SPACE(sizeof(int))] = {};
+  msghdr msg{};
+  msg.msg_iov = &iov;
+  msg.msg_iovlen = 1;
+  msg.msg_control = control;
+  msg.msg_controllen = sizeof(control);
+  if (recvmsg(sock, &msg, 0) != 1) {
+    return -1;
+  }
+  cmsghdr* cmsg = CMSG_FIRSTHDR(&msg);
+  if (cmsg == nullptr || cmsg->cmsg_type != SCM_RIGHTS) {
+    return -1;
+  }
+  int fd;
+  std::memcpy(&fd, CMSG_DATA(cmsg), sizeof(int));
+  return fd;
+}
+
+// Writes all of `data` to `sock`. Like SendFd, it returns false rather than
+// raise SIGPIPE if the peer is gone.
+inline bool SendAll(int sock, const std::string& data) {
+  size_t sent = 0;
+  while (sent < data.size()) {
+    ssize_t n =
+        send(sock, data.data() + sent, data.size() - sent, MSG_NOSIGNAL);
+    if (n <= 0) {
+      return false;
+    }
+    sent += n;
+  }
+  return true;
+}
+
+// Reads from `sock` until the other end closes it.
+inline bool ReceiveAll(int sock, std::string* data) {
+  char buffer[1 << 16];
+  while (true) {
+    ssize_t n = read(sock, buffer, sizeof(buffer));
+    if (n < 0) {
+      return false;
+    }
+    if (n == 0) {
+      return true;
+    }
+    data->append(buffer, n);
+  }
+}
+
+}  // namespace handoff
+
+#endif  // HANDOFF_H
@@ -0,0 +1,247 @@
+#include <algorithm>
+#include <array>
+#include <atomic>
+#include <chrono>
+#include <cstdint>
+#include <cstdio>
+#include <functional>
+#include <memory>
+#include <string>
+#include <utility>
+#include <vector>
+
+#include "../counter.h"
+
+#ifndef METRICS_H
+#define METRICS_H
+
+// Hooks that attribute the work done between enter and leave to a name, e.g.
+// the allocations of a route for an allocation profiler. enter returns what
+// leave needs to restore the enclosing name. Unset hooks do nothing.
+struct ScopeHooks {
+  std::function<size_t(const char* name)> enter;
+  std::function<void(size_t previous)> leave;
+
+  size_t Enter(const char* name) const { return enter ? enter(name) : 0; }
+  void Leave(size_t previous) const {
+    if (leave) {
+      leave(previous);
+    }
+  }
+};
+
+// Enters `name` with `hooks` until the end of the enclosing block.
+class HookScope {
+ public:
+  HookScope(const ScopeHooks& hooks, const char* name)
+      : hooks_(hooks), previous_(hooks.Enter(name)) {}
+  ~HookScope() { hooks_.Leave(previous_); }
+
+  HookScope(const HookScope&) = delete;
+  HookScope& operator=(const HookScope&) = delete;
+
+ private:
+  const ScopeHooks& hooks_;
+  size_t previous_;
+};
+
+// LatencyHistogram counts durations in log-linear buckets of microseconds:
+// below 4 us one bucket per microsecond, then 4 buckets per power of two, up
+// to about 67 s. Every bucket is at most 25% wide, which bounds the error
+// of any quantile estimated from the histogram.
+class LatencyHistogram {
+ public:
+  static constexpr size_t kBuckets = 101;
+
+  void Record(std::chrono::nanoseconds latency) {
+    const uint64_t micros = std::max<int64_t>(0, latency.count() / 1000);
+    Stripe& stripe = stripes_[metrics::ThreadStripe()];
+    stripe.buckets[Bucket(micros)].fetch_add(1, std::memory_order_relaxed);
+    stripe.sum_nanos.fetch_add(latency.count(), std::memory_order_relaxed);
+  }
+
+  // Returns the count of every bucket and the sum of every latency in
+  // nanoseconds.
+  void Collect(std::array<uint64_t, kBuckets>* buckets,
+               uint64_t* sum_nanos) const {
+    buckets->fill(0);
+    *sum_nanos = 0;
+    for (const Stripe& stripe : stripes_) {
+      for (size_t i = 0; i < kBuckets; i++) {
+        (*buckets)[i] += stripe.buckets[i].load(std::memory_order_relaxed);
+      }
+      *sum_nanos += stripe.sum_nanos.load(std::memory_order_relaxed);
+    }
+  }
+
+  static size_t Bucket(uint64_t micros) {
+    if (micros < 4) {
+      return micros;
+    }
+    const int magnitude = 63 - __builtin_clzll(micros);
+    const size_t bucket =
+        4 + (magnitude - 2) * 4 + ((micros >> (magnitude - 2)) & 3);
+    return std::min(bucket, kBuckets - 1);
+  }
+
+  // Returns the exclusive upper bound of `bucket` in microseconds, i.e. the
+  // Prometheus "le" of the bucket. The last bucket has no bound.
+  static uint64_t UpperBoundMicros(size_t bucket) {
+    if (bucket < 4) {
+      return bucket + 1;
+    }
+    const int magnitude = (bucket - 4) / 4 + 2;
+    const uint64_t low = (4 + (bucket - 4) % 4) << (magnitude - 2);
+    return low + (uint64_t{1} << (magnitude - 2));
+  }
+
+ private:
+  struct alignas(64) Stripe {
+    std::array<std::atomic<uint64_t>, kBuckets> buckets{};
+    std::atomic<uint64_t> sum_nanos{0};
+  };
+  std::array<Stripe, metrics::kStripes> stripes_;
+};
+
+// MetricsRegistry owns named metrics and writes them in the Prometheus text
+// exposition format. Metrics must all be registered before the server
+// starts; recording into them and exporting are then thread-safe.
+class MetricsRegistry {
+ public:
+  // Registers a counter. `labels` is either empty or a Prometheus label
+  // list such as `route="/hint"`; metrics may share a name if their labels
+  // differ.
+  Counter& AddCounter(const std::string& name, const std::string& help,
+                      const std::string& labels = "") {
+    Entry& entry = Add(name, help, "counter", labels);
+    entry.counter = std::make_unique<Counter>();
+    return *entry.counter;
+  }
+
+  LatencyHistogram& AddHistogram(const std::string& name,
+                                 const std::string& help,
+                                 const std::string& labels = "") {
+    Entry& entry = Add(name, help, "histogram", labels);
+    entry.histogram = std::make_unique<LatencyHistogram>();
+    return *entry.histogram;
+  }
+
+  // Registers a counter or gauge whose value is read from `read` when
+  // exported, for values that are already counted elsewhere.
+  void AddCounterFunc(const std::string& name, const std::string& help,
+                      std::function<double()> read,
+                      const std::string& labels = "") {
+    Add(name, help, "counter", labels).read = std::move(read);
+  }
+  void AddGauge(const std::string& name, const std::string& help,
+                std::function<double()> read, const std::string& labels = "") {
+    Add(name, help, "gauge", labels).read = std::move(read);
+  }
+
+  // Registers a counter whose label sets are only known at export time.
+  // `read` returns a value for each label list, e.g. {`phase="parse"`, 3}.
+  void AddCounterFamily(
+      const std::string& name, const std::string& help,
+      std::function<std::vector<std::pair<std::string, double>>()> read) {
+    Add(name, help, "counter", "").read_family = std::move(read);
+  }
+
+  // Returns every metric in the Prometheus text format, version 0.0.4.
+  std::string Export() const {
+    std::string out;
+    std::vector<bool> written(entries_.size());
+    for (size_t i = 0; i < entries_.size(); i++) {
+      if (written[i]) {
+        continue;
+      }
+      const Entry& first = *entries_[i];
+      out += "# HELP " + first.name + " " + first.help + "\n";
+      out += "# TYPE " + first.name + " " + first.type + "\n";
+      for (size_t j = i; j < entries_.size(); j++) {
+        if (entries_[j]->name == first.name) {
+          Write(*entries_[j], &out);
+          written[j] = true;
+        }
+      }
+    }
+    return out;
+  }
+
+ private:
+  struct Entry {
+    std::string name;
+    std::string help;
+    std::string type;
+    std::string labels;
+    std::unique_ptr<Counter> counter;
+    std::unique_ptr<LatencyHistogram> histogram;
+    std::function<double()> read;
+    std::function<std::vector<std::pair<std::string, double>>()> read_family;
+  };
+  std::vector<std::unique_ptr<Entry>> entries_;
+
+  Entry& Add(const std::string& name, const std::string& help,
+             const std::string& type, const std::string& labels) {
+    entries_.push_back(std::make_unique<Entry>());
+    Entry& entry = *entries_.back();
+    entry.name = name;
+    entry.help = help;
+    entry.type = type;
+    entry.labels = labels;
+    return entry;
+  }
+
+  static std::string Number(double value) {
+    char buffer[32];
+    std::snprintf(buffer, sizeof(buffer), "%.9g", value);
+    return buffer;
+  }
+
+  static std::string Labels(const std::string& labels,
+                            const std::string& extra = "") {
+    if (labels.empty() && extra.empty()) {
+      return "";
+    }
+    if (labels.empty() || extra.empty()) {
+      return "{" + labels + extra + "}";
+    }
+    return "{" + labels + "," + extra + "}";
+  }
+
+  static void Write(const Entry& entry, std::string* out) {
+    if (entry.counter != nullptr) {
+      *out += entry.name + Labels(entry.labels) + " " +
+              std::to_string(entry.counter->Value()) + "\n";
+    } else if (entry.read) {
+      *out += entry.name + Labels(entry.labels) + " " + Number(entry.read()) +
+              "\n";
+    } else if (entry.read_family) {
+      for (const auto& [labels, value] : entry.read_family()) {
+        *out += entry.name + Labels(labels) + " " + Number(value) + "\n";
+      }
+    } else if (entry.histogram != nullptr) {
+      std::array<uint64_t, LatencyHistogram::kBuckets> buckets;
+      uint64_t sum_nanos;
+      entry.histogram->Collect(&buckets, &sum_nanos);
+      // Prometheus buckets are cumulative, and every bound is written so the
+      // set of buckets never changes between scrapes.
+      uint64_t cumulative = 0;
+      for (size_t i = 0; i + 1 < buckets.size(); i++) {
+        cumulative += buckets[i];
+        const double le = LatencyHistogram::UpperBoundMicros(i) / 1e6;
+        *out += entry.name + "_bucket" +
+                Labels(entry.labels, "le=\"" + Number(le) + "\"") + " " +
+                std::to_string(cumulative) + "\n";
+      }
+      cumulative += buckets.back();
+      *out += entry.name + "_bucket" + Labels(entry.labels, "le=\"+Inf\"") +
+              " " + std::to_string(cumulative) + "\n";
+      *out += entry.name + "_sum" + Labels(entry.labels) + " " +
+              Number(sum_nanos / 1e9) + "\n";
+      *out += entry.name + "_count" + Labels(entry.labels) + " " +
+              std::to_string(cumulative) + "\n";
+    }
+  }
+};
+
+#endif  // METRICS_H
@@ -0,0 +1,136 @@
+#include <linux/perf_event.h>
+#include <sys/ioctl.h>
+#include <sys/syscall.h>
+#include <unistd.h>
+
+#include <array>
+#include <cerrno>
+#include <cstdint>
+#include <cstring>
+#include <string>
+
+#ifndef PERFCOUNTERS_H
+#define PERFCOUNTERS_H
+
+// Hardware performance counters of the calling thread, read through Linux's
+// perf_event_open. Each thread opens its own group of counters on first
+// use, counting user space only, so reading them is a single read() with no
+// cross-thread contention. Kernels that forbid perf events (e.g. containers
+// without CAP_PERFMON, or perf_event_paranoid above 2) make Open fail, and
+// the counters then stay unused.
+namespace perf {
+
+enum Event { kCycles = 0, kInstructions, kCacheMisses, kBranchMisses, kEvents };
+
+// The metric name and help of each event, in Event order.
+constexpr std::array<const char*, kEvents> kEventNames = {
+    "cpu_cycles", "instructions", "cache_misses", "branch_misses"};
+constexpr std::array<const char*, kEvents> kEventHelp = {
+    "CPU cycles", "Instructions retired", "Last level cache misses",
+    "Mispredicted branches"};
+
+using Sample = std::array<uint64_t, kEvents>;
+
+namespace detail {
+
+inline int OpenEvent(uint64_t config, int group) {
+  perf_event_attr attr;
+  std::memset(&attr, 0, sizeof(attr));
+  attr.size = sizeof(attr);
+  attr.type = PERF_TYPE_HARDWARE;
+  attr.config = config;
+  attr.exclude_kernel = 1;
+  attr.exclude_hv = 1;
+  attr.read_format = PERF_FORMAT_GROUP | PERF_FORMAT_TOTAL_TIME_ENABLED |
+                     PERF_FORMAT_TOTAL_TIME_RUNNING;
+  return static_cast<int>(
+      syscall(SYS_perf_event_open, &attr, 0, -1, group, PERF_FLAG_FD_CLOEXEC));
+}
+
+// The calling thread's group leader: 0 until opened, -1 if opening failed.
+inline int& ThreadGroup() {
+  thread_local int group = 0;
+  return group;
+}
+
+// Opens the calling thread's group. Returns the leader, or -1 with errno
+// set. The descriptors live as long as the thread's process.
+inline int OpenThreadGroup() {
+  constexpr std::array<uint64_t, kEvents> configs = {
+      PERF_COUNT_HW_CPU_CYCLES, PERF_COUNT_HW_INSTRUCTIONS,
+      PERF_COUNT_HW_CACHE_MISSES, PERF_COUNT_HW_BRANCH_MISSES};
+  std::array<int, kEvents> fds;
+  fds.fill(-1);
+  for (size_t i = 0; i < kEvents; i++) {
+    fds[i] = OpenEvent(configs[i], i == 0 ? -1 : fds[0]);
+    if (fds[i] < 0) {
+      const int error = errno;
+      for (size_t j = 0; j < i; j++) {
+        close(fds[j]);
+      }
+      errno = error;
+      return -1;
+    }
+  }
+  ioctl(fds[0], PERF_EVENT_IOC_RESET, PERF_IOC_FLAG_GROUP);
+  ioctl(fds[0], PERF_EVENT_IOC_ENABLE, PERF_IOC_FLAG_GROUP);
+  return fds[0];
+}
+
+}  // namespace detail
+
+// Opens the calling thread's counters. Returns an empty string on success,
+// or why the counters are unavailable.
+inline std::string Open() {
+  int& group = detail::ThreadGroup();
+  if (group == 0) {
+    group = detail::OpenThreadGroup();
+    if (group < 0) {
+      const int error = errno;
+      std::string reason = "perf_event_open: ";
+      reason += std::strerror(error);
+      if (error == EACCES || error == EPERM) {
+        reason += " (see /proc/sys/kernel/perf_event_paranoid)";
+      } else if (error == ENOENT || error == EOPNOTSUPP) {
+        reason += " (no hardware counters, e.g. in a virtual machine)";
+      }
+      return reason;
+    }
+  }
+  return group > 0 ? "" : "perf_event_open failed earlier on this thread";
+}
+
+// Reads the calling thread's counters into `sample`, opening them on first
+// use. When the kernel multiplexes more events than the CPU has counters,
+// values are scaled up to the whole time the events were enabled. Returns
+// false if the thread has no counters.
+inline bool Read(Sample* sample) {
+  int& group = detail::ThreadGroup();
+  if (group == 0) {
+    Open();
+  }
+  if (group < 0) {
+    return false;
+  }
+  // nr, time_enabled, time_running, then one value per event.
+  uint64_t data[3 + kEvents];
+  if (read(group, data, sizeof(data)) != static_cast<ssize_t>(sizeof(data)) ||
+      data[0] != kEvents) {
+    return false;
+  }
+  const uint64_t enabled = data[1];
+  const uint64_t running = data[2];
+  for (size_t i = 0; i < kEvents; i++) {
+    const uint64_t value = data[3 + i];
+    (*sample)[i] =
+        running == 0 || running == enabled
+            ? value
+            : static_cast<uint64_t>(static_cast<double>(value) * enabled /
+                                    running);
+  }
+  return true;
+}
+
+}  // namespace perf
+
+#endif  // PERFCOUNTERS_H
@@ -0,0 +1,93 @@
+#include <string>
+
+#include "crow_all.h"
+
+#ifndef PREFLIGHT_H
+#define PREFLIGHT_H
+
+// PreflightMiddleware answers CORS preflight (OPTIONS) requests from a
+// prebuilt response. It must come before crow::CORSHandler,
+// RateLimitMiddleware and the session middleware: completing the response in
+// before_handle skips routing and every later middleware, so a preflight is
+// neither rate limited nor given a session. It also owns the
+// Access-Control-Expose-Headers header of the other responses, which is built
+// once and set exactly once per response.
+struct PreflightMiddleware {
+  struct context {};
+
+  void before_handle(crow::request& req, crow::response& res, context&) {
+    if (req.method != crow::HTTPMethod::OPTIONS) {
+      return;
+    }
+    res.code = 204;
+    res.headers = preflight_headers_;
+    res.end();
+  }
+
+  void after_handle(crow::request& req, crow::response& res, context&) {
+    if (req.method == crow::HTTPMethod::OPTIONS || expose_headers_.empty()) {
+      return;
+    }
+    res.set_header("Access-Control-Expose-Headers", expose_headers_);
+  }
+
+  // Sets Access-Control-Allow-Origin. Default is "*".
+  PreflightMiddleware& origin(const std::string& origin) {
+    origin_ = origin;
+    Rebuild();
+    return *this;
+  }
+
+  // Sets Access-Control-Allow-Methods. Default is "*".
+  PreflightMiddleware& methods(const std::string& methods) {
+    methods_ = methods;
+    Rebuild();
+    return *this;
+  }
+
+  // Sets Access-Control-Allow-Headers. Default is "*".
+  PreflightMiddleware& headers(const std::string& headers) {
+    headers_ = headers;
+    Rebuild();
+    return *this;
+  }
+
+  // Sets Access-Control-Max-Age, in seconds. Default is none.
+  PreflightMiddleware& max_age(int max_age) {
+    max_age_ = std::to_string(max_age);
+    Rebuild();
+    return *this;
+  }
+
+  // Adds a response header that frontend scripts are allowed to read.
+  PreflightMiddleware& expose(const std::string& header) {
+    if (!expose_headers_.empty()) {
+      expose_headers_ += ", ";
+    }
+    expose_headers_ += header;
+    return *this;
+  }
+
+ private:
+  std::string origin_ = "*";
+  std::string methods_ = "*";
+  std::string headers_ = "*";
+  std::string max_age_;
+  std::string expose_headers_;
+  crow::ci_map preflight_headers_ = BuildHeaders();
+
+  crow::ci_map BuildHeaders() const {
+    crow::ci_map headers;
+    headers.emplace("Access-Control-Allow-Origin", origin_);
+    headers.emplace("Access-Control-Allow-Methods", methods_);
+    headers.emplace("Access-Control-Allow-Headers", headers_);
+    if (!max_age_.empty()) {
+      headers.emplace("Access-Control-Max-Age", max_age_);
+    }
+    return headers;
+  }
+
+  void Rebuild() { preflight_headers_ = BuildHeaders(); }
+};
+
+#endif  // PREFLIGHT_H
@@ -0,0 +1,392 @@
+#include <cxxabi.h>
+#include <dlfcn.h>
+#include <elf.h>
+#include <fcntl.h>
+#include <link.h>
+#include <signal.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <sys/time.h>
+#include <sys/uio.h>
+#include <ucontext.h>
+#include <unistd.h>
+
+#include <algorithm>
+#include <atomic>
+#include <cerrno>
+#include <chrono>
+#include <cstdint>
+#include <cstdio>
+#include <cstdlib>
+#include <cstring>
+#include <map>
+#include <memory>
+#include <string>
+#include <string_view>
+#include <thread>
+#include <unordered_map>
+#include <vector>
+
+#ifndef PROFILER_H
+#define PROFILER_H
+
+// A sampling CPU profiler for the live server. While it runs, the process's
+// ITIMER_PROF timer sends SIGPROF at a fixed rate of CPU time, to whichever
+// thread is running, so every busy thread is sampled: the Crow workers, the
+// thread pool and the background aggregators. The handler walks the frame
+// pointers of the interrupted thread's stack into a preallocated buffer,
+// reading each frame with process_vm_readv so a bad frame pointer ends the
+// walk instead of crashing the server. Code built without frame pointers,
+// such as the C library, shows up as its leaf function only, so the server
+// is built with -fno-omit-frame-pointer.
+namespace profiler {
+
+constexpr size_t kMaxDepth = 64;
+
+struct Stack {
+  uint32_t depth = 0;
+  // Program counters from the leaf outwards. All but the first are return
+  // addresses.
+  uintptr_t pcs[kMaxDepth];
+};
+
+class StackSampler;
+
+namespace detail {
+
+// The sampler SIGPROF records into, if any, and the number of handlers
+// running, so Stop can wait for them before reading the samples.
+inline std::atomic<StackSampler*> active{nullptr};
+inline std::atomic<int> handlers_running{0};
+
+// Reads the two words at `address`, failing instead of faulting if they are
+// not mapped. Async-signal-safe.
+inline bool ReadFrame(uintptr_t address, uintptr_t frame[2]) {
+  iovec local = {frame, 2 * sizeof(uintptr_t)};
+  iovec remote = {reinterpret_cast<void*>(address), 2 * sizeof(uintptr_t)};
+  return process_vm_readv(getpid(), &local, 1, &remote, 1, 0) ==
+         static_cast<ssize_t>(2 * sizeof(uintptr_t));
+}
+
+// Walks the frame pointers from the interrupted context `ucontext` into
+// `stack`. Frames must move up the stack, by less than kMaxFrame each.
+inline void Unwind(void* ucontext, Stack* stack) {
+  constexpr uintptr_t kMaxFrame = 1 << 20;
+  const mcontext_t& context = static_cast<ucontext_t*>(ucontext)->uc_mcontext;
+#if defined(__x86_64__)
+  uintptr_t pc = context.gregs[REG_RIP];
+  uintptr_t fp = context.gregs[REG_RBP];
+  uintptr_t sp = context.gregs[REG_RSP];
+#elif defined(__aarch64__)
+  uintptr_t pc = context.pc;
+  uintptr_t fp = context.regs[29];
+  uintptr_t sp = context.sp;
+#else
+  uintptr_t pc = 0;
+  uintptr_t fp = 0;
+  uintptr_t sp = 0;
+#endif
+  stack->depth = 0;
+  if (pc == 0) {
+    return;
+  }
+  stack->pcs[stack->depth++] = pc;
+  uintptr_t low = sp;
+  while (stack->depth < kMaxDepth) {
+    uintptr_t frame[2];
+    if (fp < low || fp - low > kMaxFrame || fp % sizeof(uintptr_t) != 0 ||
+        !ReadFrame(fp, frame) || frame[1] == 0) {
+      break;
+    }
+    stack->pcs[stack->depth++] = frame[1];
+    low = fp + 2 * sizeof(uintptr_t);
+    fp = frame[0];
+  }
+}
+
+inline void HandleSignal(int, siginfo_t*, void* ucontext);
+
+}  // namespace detail
+
+// StackSampler samples the stacks of every thread of the process. One
+// sampler runs at a time, since the timer and the signal are process-wide.
+class StackSampler {
+ public:
+  // Starts sampling at `hz` samples per second of CPU time, keeping at most
+  // `max_samples`. Returns an empty string, or why sampling cannot start.
+  std::string Start(int hz, size_t max_samples) {
+    uintptr_t probe[2] = {};
+    uintptr_t frame[2];
+    if (!detail::ReadFrame(reinterpret_cast<uintptr_t>(probe), frame)) {
+      return std::string("process_vm_readv failed: ") + std::strerror(errno);
+    }
+    StackSampler* idle = nullptr;
+    if (!detail::active.compare_exchange_strong(idle, this)) {
+      return "another profile is running";
+    }
+    stacks_.assign(max_samples, Stack());
+    next_.store(0);
+    dropped_.store(0);
+
+    struct sigaction action;
+    std::memset(&action, 0, sizeof(action));
+    action.sa_sigaction = detail::HandleSignal;
+    action.sa_flags = SA_SIGINFO | SA_RESTART;
+    sigemptyset(&action.sa_mask);
+    sigaction(SIGPROF, &action, &previous_action_);
+
+    const long period_us = std::max(1L, 1000000L / std::max(1, hz));
+    itimerval timer = {{0, period_us}, {0, period_us}};
+    if (setitimer(ITIMER_PROF, &timer, nullptr) != 0) {
+      const std::string error =
+          std::string("setitimer failed: ") + std::strerror(errno);
+      sigaction(SIGPROF, &previous_action_, nullptr);
+      detail::active.store(nullptr);
+      return error;
+    }
+    return "";
+  }
+
+  // Stops sampling and returns the stacks recorded.
+  std::vector<Stack> Stop() {
+    itimerval off = {};
+    setitimer(ITIMER_PROF, &off, nullptr);
+    detail::active.store(nullptr);
+    while (detail::handlers_running.load() > 0) {
+      std::this_thread::yield();
+    }
+    // A SIGPROF still pending must not kill the process, so the default
+    // action is replaced by ignoring it.
+    if (previous_action_.sa_handler == SIG_DFL) {
+      previous_action_.sa_handler = SIG_IGN;
+    }
+    sigaction(SIGPROF, &previous_action_, nullptr);
+    std::vector<Stack> stacks = std::move(stacks_);
+    stacks.resize(std::min(next_.load(), stacks.size()));
+    stacks_.clear();
+    return stacks;
+  }
+
+  // Returns true if some sampler is running.
+  static bool Running() { return detail::active.load() != nullptr; }
+
+  // Returns the samples lost to a full buffer during the last run.
+  uint64_t Dropped() const { return dropped_.load(); }
+
+  // Called by the SIGPROF handler. Async-signal-safe.
+  void Record(void* ucontext) {
+    const size_t index = next_.fetch_add(1, std::memory_order_relaxed);
+    if (index >= stacks_.size()) {
+      dropped_.fetch_add(1, std::memory_order_relaxed);
+      return;
+    }
+    detail::Unwind(ucontext, &stacks_[index]);
+  }
+
+ private:
+  std::vector<Stack> stacks_;
+  std::atomic<size_t> next_{0};
+  std::atomic<uint64_t> dropped_{0};
+  struct sigaction previous_action_;
+};
+
+inline void detail::HandleSignal(int, siginfo_t*, void* ucontext) {
+  const int saved_errno = errno;
+  handlers_running.fetch_add(1);
+  if (StackSampler* sampler = active.load()) {
+    sampler->Record(ucontext);
+  }
+  handlers_running.fetch_sub(1);
+  errno = saved_errno;
+}
+
+// Symbolizer names program counters. Functions of the executable, static
+// ones included, are looked up in its ELF symbol table; those of shared
+// libraries through dladdr, which only knows their exported symbols.
+class Symbolizer {
+ public:
+  Symbolizer() {
+    dl_iterate_phdr(
+        [](dl_phdr_info* info, size_t, void* data) {
+          // The executable comes first.
+          *static_cast<uintptr_t*>(data) = info->dlpi_addr;
+          return 1;
+        },
+        &bias_);
+    LoadExecutableSymbols();
+  }
+
+  // Returns the name of the function containing `pc`.
+  const std::string& Name(uintptr_t pc) {
+    auto it = cache_.find(pc);
+    if (it == cache_.end()) {
+      it = cache_.emplace(pc, Lookup(pc)).first;
+    }
+    return it->second;
+  }
+
+ private:
+  struct Symbol {
+    uintptr_t address;
+    uintptr_t size;
+    std::string name;
+  };
+
+  uintptr_t bias_ = 0;
+  // Sorted by address.
+  std::vector<Symbol> symbols_;
+  std::unordered_map<uintptr_t, std::string> cache_;
+
+  // Demangles `name` without its parameter list, which the symbol of an
+  // overload needs but a flame graph can do without.
+  static std::string Demangle(const char* name) {
+    int status = 0;
+    char* demangled = abi::__cxa_demangle(name, nullptr, nullptr, &status);
+    std::string result = status == 0 ? demangled : name;
+    std::free(demangled);
+    if (status != 0) {
+      return result;
+    }
+    constexpr std::string_view kConst = " const";
+    if (result.size() > kConst.size() &&
+        result.compare(result.size() - kConst.size(), kConst.size(),
+                       kConst) == 0) {
+      result.resize(result.size() - kConst.size());
+    }
+    int depth = 0;
+    for (size_t i = result.size(); i-- > 0;) {
+      if (result[i] == ')') {
+        depth++;
+      } else if (result[i] == '(' && --depth == 0) {
+        result.resize(i);
+        break;
+      }
+      if (depth == 0) {
+        break;
+      }
+    }
+    return result;
+  }
+
+  void LoadExecutableSymbols() {
+    const int fd = open("/proc/self/exe", O_RDONLY | O_CLOEXEC);
+    if (fd < 0) {
+      return;
+    }
+    struct stat info;
+    void* map = MAP_FAILED;
+    if (fstat(fd, &info) == 0 &&
+        static_cast<size_t>(info.st_size) >= sizeof(Elf64_Ehdr)) {
+      map = mmap(nullptr, info.st_size, PROT_READ, MAP_PRIVATE, fd, 0);
+    }
+    close(fd);
+    if (map == MAP_FAILED) {
+      return;
+    }
+    const char* base = static_cast<const char*>(map);
+    const size_t size = info.st_size;
+    const auto* header = reinterpret_cast<const Elf64_Ehdr*>(base);
+    if (std::memcmp(header->e_ident, ELFMAG, SELFMAG) == 0 &&
+        header->e_ident[EI_CLASS] == ELFCLASS64 &&
+        header->e_shoff + header->e_shnum * sizeof(Elf64_Shdr) <= size) {
+      const auto* sections =
+          reinterpret_cast<const Elf64_Shdr*>(base + header->e_shoff);
+      for (size_t i = 0; i < header->e_shnum; i++) {
+        const Elf64_Shdr& table = sections[i];
+        if (table.sh_type != SHT_SYMTAB || table.sh_link >= header->e_shnum) {
+          continue;
+        }
+        const Elf64_Shdr& strings = sections[table.sh_link];
+        if (table.sh_offset + table.sh_size > size ||
+            strings.sh_offset + strings.sh_size > size) {
+          continue;
+        }
+        const auto* entries =
+            reinterpret_cast<const Elf64_Sym*>(base + table.sh_offset);
+        for (size_t j = 0; j < table.sh_size / sizeof(Elf64_Sym); j++) {
+          const Elf64_Sym& symbol = entries[j];
+          if (ELF64_ST_TYPE(symbol.st_info) != STT_FUNC ||
+              symbol.st_value == 0 || symbol.st_name >= strings.sh_size) {
+            continue;
+          }
+          symbols_.push_back(
+              {bias_ + symbol.st_value, symbol.st_size,
+               Demangle(base + strings.sh_offset + symbol.st_name)});
+        }
+      }
+    }
+    munmap(map, size);
+    std::sort(symbols_.begin(), symbols_.end(),
+              [](const Symbol& a, const Symbol& b) {
+                return a.address < b.address;
+              });
+  }
+
+  std::string Lookup(uintptr_t pc) {
+    auto it = std::upper_bound(
+        symbols_.begin(), symbols_.end(), pc,
+        [](uintptr_t value, const Symbol& symbol) {
+          return value < symbol.address;
+        });
+    if (it != symbols_.begin()) {
+      --it;
+      if (pc < it->address + std::max<uintptr_t>(it->size, 1)) {
+        return it->name;
+      }
+    }
+    Dl_info info;
+    if (dladdr(reinterpret_cast<void*>(pc), &info) != 0) {
+      if (info.dli_sname != nullptr) {
+        return Demangle(info.dli_sname);
+      }
+      if (info.dli_fname != nullptr) {
+        const char* file = std::strrchr(info.dli_fname, '/');
+        char offset[32];
+        std::snprintf(offset, sizeof(offset), "+0x%zx",
+                      static_cast<size_t>(
+                          pc - reinterpret_cast<uintptr_t>(info.dli_fbase)));
+        return std::string(file != nullptr ? file + 1 : info.dli_fname) +
+               offset;
+      }
+    }
+    char unknown[32];
+    std::snprintf(unknown, sizeof(unknown), "0x%zx", static_cast<size_t>(pc));
+    return unknown;
+  }
+};
+
+// Returns `stacks` in the folded format of flamegraph.pl and speedscope: one
+// line per distinct stack, its frames from the outermost to the leaf joined
+// by ';', then a space and the number of samples.
+inline std::string FoldStacks(const std::vector<Stack>& stacks,
+                              Symbolizer& symbolizer) {
+  std::map<std::string, uint64_t> counts;
+  std::string line;
+  for (const Stack& stack : stacks) {
+    line.clear();
+    for (uint32_t i = stack.depth; i-- > 0;) {
+      // Return addresses point after the call, possibly into the next
+      // function, so the call itself is looked up.
+      const uintptr_t pc = i == 0 ? stack.pcs[i] : stack.pcs[i] - 1;
+      if (!line.empty()) {
+        line += ';';
+      }
+      line += symbolizer.Name(pc);
+    }
+    if (!line.empty()) {
+      counts[line]++;
+    }
+  }
+  std::string folded;
+  for (const auto& [stack, count] : counts) {
+    folded += stack;
+    folded += ' ';
+    folded += std::to_string(count);
+    folded += '\n';
+  }
+  return folded;
+}
+
+}  // namespace profiler
+
+#endif  // PROFILER_H
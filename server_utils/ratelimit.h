@@ -0,0 +1,239 @@
+#include <algorithm>
+#include <array>
+#include <atomic>
+#include <chrono>
+#include <cmath>
+#include <cstdint>
+#include <functional>
+#include <mutex>
+#include <string>
+#include <vector>
+
+#include "crow_all.h"
+
+#ifndef RATELIMIT_H
+#define RATELIMIT_H
+
+// BucketTable stores token buckets keyed by a string (an IP address or a
+// session token) in a fixed amount of memory. It is split into shards with a
+// lock each, and every shard is an open-addressing array. When a key's probe
+// window is full, the least recently used bucket in it is evicted, so a flood
+// of distinct keys can never grow memory.
+class BucketTable {
+ public:
+  BucketTable(size_t capacity = 1 << 16) { Resize(capacity); }
+
+  // Drops every bucket and sizes the table to hold about `capacity` keys.
+  void Resize(size_t capacity) {
+    const size_t per_shard = std::max<size_t>(kProbeWindow, capacity / kShards);
+    for (Shard& shard : shards_) {
+      std::lock_guard<std::mutex> lock(shard.mutex);
+      shard.buckets.assign(per_shard, Bucket{});
+    }
+  }
+
+  // Refills the bucket of `key` at `rate` tokens per second up to `burst`, and
+  // takes one token from it. Returns false if the bucket was empty.
+  bool TryTake(const std::string& key, double rate, double burst,
+               int64_t now_ns) {
+    const uint64_t hash = std::hash<std::string>()(key) | 1;
+    Shard& shard = shards_[(hash >> 32) % kShards];
+    std::lock_guard<std::mutex> lock(shard.mutex);
+
+    const size_t size = shard.buckets.size();
+    Bucket* victim = nullptr;
+    for (size_t i = 0; i < kProbeWindow; i++) {
+      Bucket& bucket = shard.buckets[(hash + i) % size];
+      if (bucket.key == hash) {
+        const double elapsed = (now_ns - bucket.last_ns) / 1e9;
+        bucket.tokens = std::min(burst, bucket.tokens + elapsed * rate);
+        bucket.last_ns = now_ns;
+        if (bucket.tokens < 1) {
+          return false;
+        }
+        bucket.tokens -= 1;
+        return true;
+      }
+      if (victim == nullptr || bucket.last_ns < victim->last_ns) {
+        victim = &bucket;
+      }
+    }
+    // First request from this key: start from a full bucket.
+    victim->key = hash;
+    victim->tokens = burst - 1;
+    victim->last_ns = now_ns;
+    return burst >= 1;
+  }
+
+ private:
+  static constexpr size_t kShards = 16;
+  static constexpr size_t kProbeWindow = 8;
+
+  // A key of 0 marks an empty bucket; hashed keys always have the low bit set.
+  struct Bucket {
+    uint64_t key = 0;
+    double tokens = 0;
+    int64_t last_ns = 0;
+  };
+
+  struct Shard {
+    std::mutex mutex;
+    std::vector<Bucket> buckets;
+  };
+
+  std::array<Shard, kShards> shards_;
+};
+
+// RateLimitMiddleware rejects requests before they reach SessionMiddleware,
+// so it must come before it in the app's middleware list. It keeps token
+// buckets per client IP and per session, a stricter per-IP bucket for
+// requests that would create a new session, and sheds load with a 503 once
+// too many requests are in flight or handlers have become too slow.
+struct RateLimitMiddleware {
+  struct context {
+    // Set when the request was admitted and counted as in flight.
+    bool admitted = false;
+    // Set when the request's latency counts towards the average.
+    bool measured = false;
+    std::chrono::steady_clock::time_point start;
+  };
+
+  void before_handle(crow::request& req, crow::response& res, context& ctx) {
+    if (req.method == crow::HTTPMethod::OPTIONS) {
+      return;
+    }
+    const auto now = std::chrono::steady_clock::now();
+    const int64_t now_ns =
+        std::chrono::duration_cast<std::chrono::nanoseconds>(
+            now.time_since_epoch())
+            .count();
+
+    if (Overloaded(now_ns)) {
+      shed_.fetch_add(1, std::memory_order_relaxed);
+      Reject(res, 503);
+      return;
+    }
+
+    // Requests whose token is not a live session, made up or expired, get a
+    // new session, so they are charged as new sessions.
+    const std::string& session_id = req.get_header_value(header_name);
+    const bool new_session =
+        session_id.empty() ||
+        (is_live_session && !is_live_session(session_id));
+    bool allowed = ip_buckets_.TryTake(req.remote_ip_address, ip_rate,
+                                       ip_burst, now_ns);
+    if (allowed && new_session) {
+      allowed = new_session_buckets_.TryTake(
+          req.remote_ip_address, new_session_rate, new_session_burst, now_ns);
+    } else if (allowed) {
+      allowed = session_buckets_.TryTake(session_id, session_rate,
+                                         session_burst, now_ns);
+    }
+    if (!allowed) {
+      rate_limited_.fetch_add(1, std::memory_order_relaxed);
+      Reject(res, 429);
+      return;
+    }
+
+    in_flight_.fetch_add(1, std::memory_order_relaxed);
+    ctx.admitted = true;
+    ctx.measured = std::none_of(
+        unmeasured_prefixes.begin(), unmeasured_prefixes.end(),
+        [&req](const std::string& prefix) {
+          return req.url.compare(0, prefix.size(), prefix) == 0;
+        });
+    ctx.start = now;
+  }
+
+  void after_handle(crow::request&, crow::response&, context& ctx) {
+    if (!ctx.admitted) {
+      return;
+    }
+    in_flight_.fetch_sub(1, std::memory_order_relaxed);
+    if (!ctx.measured) {
+      return;
+    }
+    const auto now = std::chrono::steady_clock::now();
+    const int64_t now_ns =
+        std::chrono::duration_cast<std::chrono::nanoseconds>(
+            now.time_since_epoch())
+            .count();
+    const double latency_ms =
+        std::chrono::duration<double, std::milli>(now - ctx.start).count();
+    // Exponentially weighted moving average over roughly the last 20
+    // requests. Races between threads only lose an update.
+    const double average = AverageLatencyMs(now_ns);
+    latency_ms_.store(average + (latency_ms - average) / 20,
+                      std::memory_order_relaxed);
+    latency_updated_ns_.store(now_ns, std::memory_order_relaxed);
+  }
+
+  // The session header checked by SessionMiddleware.
+  std::string header_name = "X-Session-ID";
+  // Requests per second and burst allowed from one client IP.
+  double ip_rate = 50;
+  double ip_burst = 100;
+  // Requests per second and burst allowed for one session.
+  double session_rate = 20;
+  double session_burst = 40;
+  // Requests without a live session, i.e. new sessions, allowed from one IP.
+  double new_session_rate = 1;
+  double new_session_burst = 10;
+  // Returns true if a token names a live session. Without it, only requests
+  // without a token are charged as new sessions.
+  std::function<bool(const std::string&)> is_live_session;
+  // Load shedding limits on concurrent requests and average handler latency.
+  int64_t max_in_flight = 256;
+  std::chrono::milliseconds max_latency = std::chrono::milliseconds(250);
+  // Time for the average latency to halve while no request completes.
+  std::chrono::milliseconds latency_half_life = std::chrono::seconds(1);
+  // Paths whose latency is left out of the average, for routes that are
+  // slow by design and do not hold up a worker while they wait, such as
+  // responses completed from another thread.
+  std::vector<std::string> unmeasured_prefixes;
+
+  // Number of requests rejected with 429 and 503.
+  uint64_t RateLimitedCount() const { return rate_limited_.load(); }
+  uint64_t ShedCount() const { return shed_.load(); }
+  int64_t InFlight() const { return in_flight_.load(); }
+
+ private:
+  BucketTable ip_buckets_;
+  BucketTable session_buckets_;
+  BucketTable new_session_buckets_;
+  std::atomic<int64_t> in_flight_{0};
+  std::atomic<double> latency_ms_{0};
+  std::atomic<int64_t> latency_updated_ns_{0};
+  std::atomic<uint64_t> rate_limited_{0};
+  std::atomic<uint64_t> shed_{0};
+
+  bool Overloaded(int64_t now_ns) const {
+    if (in_flight_.load(std::memory_order_relaxed) >= max_in_flight) {
+      return true;
+    }
+    return AverageLatencyMs(now_ns) > max_latency.count();
+  }
+
+  // Returns the average latency decayed by the time since a request last
+  // completed. Shed requests never complete, so without the decay a slow
+  // spell would shed requests forever.
+  double AverageLatencyMs(int64_t now_ns) const {
+    const double average = latency_ms_.load(std::memory_order_relaxed);
+    const int64_t idle_ns =
+        now_ns - latency_updated_ns_.load(std::memory_order_relaxed);
+    if (idle_ns <= 0) {
+      return average;
+    }
+    const double half_life_ns =
+        std::chrono::duration<double, std::nano>(latency_half_life).count();
+    return average * std::exp2(-idle_ns / half_life_ns);
+  }
+
+  static void Reject(crow::response& res, int code) {
+    res.code = code;
+    res.set_header("Retry-After", "1");
+    res.end();
+  }
+};
+
+#endif  // RATELIMIT_H
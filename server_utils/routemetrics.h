@@ -0,0 +1,139 @@
+#include <array>
+#include <chrono>
+#include <memory>
+#include <string>
+#include <string_view>
+#include <unordered_map>
+#include <vector>
+
+#include "crow_all.h"
+#include "metrics.h"
+#include "perfcounters.h"
+
+#ifndef ROUTEMETRICS_H
+#define ROUTEMETRICS_H
+
+// A route as attributed by MetricsMiddleware. The name is also the route's
+// scope for allocation profiling, so it must not move once registered.
+struct RouteMetrics {
+  std::string name;
+  LatencyHistogram* latency = nullptr;
+  // Hardware counters of the route's requests, once EnablePerfCounters is
+  // called.
+  std::array<Counter*, perf::kEvents> perf{};
+};
+
+// MetricsMiddleware times every request, from before the first middleware
+// to after the last one, so it must come first in the app's middleware
+// list. Requests are attributed to the route passed to Register that
+// matches the first segment of their path, and to "other" otherwise, which
+// bounds the number of label values.
+struct MetricsMiddleware {
+  struct context {
+    std::chrono::steady_clock::time_point start;
+    const RouteMetrics* route = nullptr;
+    size_t previous_scope = 0;
+    bool perf_started = false;
+    perf::Sample perf_start;
+  };
+
+  void before_handle(crow::request& req, crow::response&, context& ctx) {
+    ctx.start = std::chrono::steady_clock::now();
+    std::string_view path = req.url;
+    const size_t end = path.find('/', 1);
+    if (end != std::string_view::npos) {
+      path = path.substr(0, end);
+    }
+    auto it = routes_.find(path);
+    ctx.route = it != routes_.end() ? &it->second : &other_route_;
+    // Everything done until after_handle is attributed to the route.
+    ctx.previous_scope = route_scope.Enter(ctx.route->name.c_str());
+    // Read last, so the counters cover the other middlewares and the
+    // handler but little of this one.
+    if (perf_enabled_) {
+      ctx.perf_started = perf::Read(&ctx.perf_start);
+    }
+  }
+
+  void after_handle(crow::request&, crow::response& res, context& ctx) {
+    perf::Sample perf_end;
+    if (ctx.perf_started && perf::Read(&perf_end)) {
+      for (size_t i = 0; i < perf::kEvents; i++) {
+        // Scaled values of multiplexed events may step back slightly.
+        if (perf_end[i] > ctx.perf_start[i]) {
+          ctx.route->perf[i]->Add(perf_end[i] - ctx.perf_start[i]);
+        }
+      }
+    }
+    route_scope.Leave(ctx.previous_scope);
+    const auto latency = std::chrono::steady_clock::now() - ctx.start;
+    if (ctx.route != nullptr && ctx.route->latency != nullptr) {
+      ctx.route->latency->Record(latency);
+    }
+    const size_t code_class = static_cast<size_t>(res.code) / 100;
+    if (code_class >= 1 && code_class <= 5 && responses_[code_class - 1]) {
+      responses_[code_class - 1]->Add();
+    }
+  }
+
+  // Told the route of every request, from before_handle to after_handle.
+  ScopeHooks route_scope;
+
+  // Registers the request metrics in `registry`, with a latency histogram
+  // per route in `routes` (e.g. "/hint"; "/wordle_key_pressed" stands for
+  // every key).
+  void Register(MetricsRegistry& registry,
+                const std::vector<std::string>& routes) {
+    const char* name = "hurdle_http_request_duration_seconds";
+    const char* help = "Time to handle a request, including middlewares.";
+    for (const std::string& route : routes) {
+      route_names_.push_back(std::make_unique<std::string>(route));
+      RouteMetrics& entry = routes_[*route_names_.back()];
+      entry.name = route;
+      entry.latency =
+          &registry.AddHistogram(name, help, "route=\"" + route + "\"");
+    }
+    other_route_.latency =
+        &registry.AddHistogram(name, help, "route=\"other\"");
+    for (size_t i = 0; i < responses_.size(); i++) {
+      responses_[i] = &registry.AddCounter(
+          "hurdle_http_responses_total", "Responses sent, by status class.",
+          "code=\"" + std::to_string(i + 1) + "xx\"");
+    }
+  }
+
+  // Counts the cycles, instructions, cache misses and branch misses of each
+  // route's requests on the handling thread, in hurdle_route_<event>_total.
+  // Must be called after Register. Returns why hardware counters are
+  // unavailable, in which case nothing is registered, or an empty string.
+  std::string EnablePerfCounters(MetricsRegistry& registry) {
+    const std::string error = perf::Open();
+    if (!error.empty()) {
+      return error;
+    }
+    for (size_t i = 0; i < perf::kEvents; i++) {
+      const std::string name =
+          std::string("hurdle_route_") + perf::kEventNames[i] + "_total";
+      const std::string help =
+          std::string(perf::kEventHelp[i]) + " in user space, by route.";
+      for (auto& [path, route] : routes_) {
+        route.perf[i] =
+            &registry.AddCounter(name, help, "route=\"" + route.name + "\"");
+      }
+      other_route_.perf[i] =
+          &registry.AddCounter(name, help, "route=\"other\"");
+    }
+    perf_enabled_ = true;
+    return "";
+  }
+
+ private:
+  // Owns the route strings the keys of routes_ point into.
+  std::vector<std::unique_ptr<std::string>> route_names_;
+  std::unordered_map<std::string_view, RouteMetrics> routes_;
+  RouteMetrics other_route_{"other", nullptr};
+  std::array<Counter*, 5> responses_{};
+  bool perf_enabled_ = false;
+};
+
+#endif  // ROUTEMETRICS_H
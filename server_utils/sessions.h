@@ -2,14 +2,21 @@
 #include <chrono>
 #include <iostream>
 #include <memory>
+#include <mutex>
 #include <optional>
+#include <sstream>
 #include <string>
 #include <unordered_map>
 #include <utility>
 #include <vector>
 
 #include "crow_all.h"
+#include "metrics.h"
 
+// SessionMiddleware keeps a T for every client session, keyed by a token the
+// client sends back in header_name. Requests without a live session get a
+// new one. Sessions can be saved once the server has stopped, and loaded
+// while it serves, to hand them over from one process to the next.
 template <class T>
 struct SessionMiddleware {
   struct Session {
@@ -18,6 +25,11 @@ struct SessionMiddleware {
           time(std::chrono::system_clock::now()),
           data(std::move(new_data)) {}
 
+    Session(std::string token,
+            std::chrono::time_point<std::chrono::system_clock> time,
+            T data)
+        : token(std::move(token)), time(time), data(std::move(data)) {}
+
     void renew() { time = std::chrono::system_clock::now(); }
 
     const std::string token;
@@ -37,29 +49,39 @@ struct SessionMiddleware {
     friend struct SessionMiddleware;
   };
 
-  void before_handle(crow::request& req, crow::response&, context& ctx) {
+  void before_handle(crow::request& req, crow::response& res, context& ctx) {
     if (req.method == crow::HTTPMethod::OPTIONS) {
       // Ignore CORS preflight here.
       return;
     }
 
     const auto session_id = req.get_header_value(header_name);
+    std::lock_guard<std::mutex> lock(mutex_);
     if (auto it = sessions_.find(session_id); it != sessions_.end()) {
       ctx.s_ = it->second;
       ctx.s_->renew();
       return;
     }
+    if (!session_id.empty() && awaiting_sessions_.load()) {
+      // The session may be one of those still being handed over, so the
+      // client retries rather than losing its game to a new one.
+      res.code = 503;
+      res.set_header("Retry-After", "1");
+      res.end();
+      return;
+    }
 
+    HookScope scope(phase_scope, "SessionMiddleware::CreateSession");
     auto session = std::make_shared<Session>(constructor());
     sessions_[session->token] = session;
     ctx.s_ = session;
+    created_.Add();
   }
 
   void after_handle(crow::request&, crow::response& resp, context& ctx) {
+    // Access-Control-Expose-Headers for header_name is set once by
+    // PreflightMiddleware.
     if (ctx.s_ != nullptr) {
-      // TODO: it's better to make a middleware for this, since we should only
-      // have one of this header.
-      resp.add_header("Access-Control-Expose-Headers", header_name);
       resp.set_header(header_name, ctx.s_->token);
     }
 
@@ -70,22 +92,109 @@ struct SessionMiddleware {
   std::string header_name = "X-Session-ID";
   std::chrono::seconds max_age = std::chrono::hours(96);
   std::function<T()> constructor;
+  // If set, the duration of every sweep for expired sessions is recorded.
+  LatencyHistogram* cleanup_latency = nullptr;
+  // Told when sessions are created or swept.
+  ScopeHooks phase_scope;
+
+  // Writes every live session as a line "<token> <age in seconds> <data>",
+  // where the data is written by `save`. Must not run concurrently with
+  // requests, e.g. only once the server has stopped, since their handlers
+  // change the data without a lock.
+  void SaveSessions(std::ostream& out,
+                    const std::function<void(const T&, std::ostream&)>& save) {
+    CleanupSessions();
+    std::lock_guard<std::mutex> lock(mutex_);
+    const auto now = std::chrono::system_clock::now();
+    for (const auto& [token, session] : sessions_) {
+      const auto age = std::chrono::duration_cast<std::chrono::seconds>(
+          now - session->time);
+      out << token << ' ' << age.count() << ' ';
+      save(session->data, out);
+      out << '\n';
+    }
+  }
+
+  // Reads sessions written by SaveSessions, using `load` to restore each
+  // one's data into a freshly constructed T, and adds them to the live ones,
+  // which are kept if a token is both. Malformed lines are skipped. May run
+  // while requests are served. Ends AwaitSessions. Returns the number of
+  // sessions added.
+  size_t LoadSessions(std::istream& in,
+                      const std::function<bool(std::istream&, T&)>& load) {
+    const auto now = std::chrono::system_clock::now();
+    std::vector<std::shared_ptr<Session>> loaded;
+    std::string line;
+    while (std::getline(in, line)) {
+      std::istringstream fields(line);
+      std::string token;
+      int64_t age;
+      T data = constructor();
+      if (!(fields >> token >> age) || !load(fields, data)) {
+        continue;
+      }
+      loaded.push_back(std::make_shared<Session>(
+          token, now - std::chrono::seconds(age), std::move(data)));
+    }
+    size_t added = 0;
+    std::lock_guard<std::mutex> lock(mutex_);
+    for (auto& session : loaded) {
+      const std::string& token = session->token;
+      added += sessions_.emplace(token, std::move(session)).second;
+    }
+    awaiting_sessions_.store(false);
+    return added;
+  }
+
+  // Marks sessions as being handed over by another process until
+  // LoadSessions. Meanwhile requests with a token that is not live are
+  // answered 503 with Retry-After, instead of starting a new session.
+  void AwaitSessions() { awaiting_sessions_.store(true); }
+
+  // Returns true if `token` names a live session.
+  bool Has(const std::string& token) const {
+    std::lock_guard<std::mutex> lock(mutex_);
+    return sessions_.find(token) != sessions_.end();
+  }
+
+  // Returns the number of live sessions.
+  size_t SessionCount() const {
+    std::lock_guard<std::mutex> lock(mutex_);
+    return sessions_.size();
+  }
+  // Number of sessions created for requests without a live session, and
+  // number of sessions removed for being older than max_age.
+  uint64_t CreatedCount() const { return created_.Value(); }
+  uint64_t ExpiredCount() const { return expired_.Value(); }
 
  private:
+  // Guards sessions_, though not the sessions' data.
+  mutable std::mutex mutex_;
   std::unordered_map<std::string, std::shared_ptr<Session>> sessions_;
+  std::atomic<bool> awaiting_sessions_{false};
+  Counter created_;
+  Counter expired_;
 
   void CleanupSessions() {
+    crow::trace_span span("SessionMiddleware::CleanupSessions");
+    HookScope scope(phase_scope, "SessionMiddleware::CleanupSessions");
+    const auto start = std::chrono::steady_clock::now();
     const auto now = std::chrono::system_clock::now();
+    std::lock_guard<std::mutex> lock(mutex_);
     auto it = sessions_.begin();
     while (it != sessions_.end()) {
       // Check if the session's age is greater than the max age.
       if ((now - it->second->time) > max_age) {
         // erase will automatically grab the next valid iterator.
         it = sessions_.erase(it);
+        expired_.Add();
       } else {
         ++it;
       }
     }
+    if (cleanup_latency != nullptr) {
+      cleanup_latency->Record(std::chrono::steady_clock::now() - start);
+    }
   }
 
   static std::string GenerateToken() {
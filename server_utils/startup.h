@@ -0,0 +1,122 @@
+#include <chrono>
+#include <mutex>
+#include <string>
+#include <vector>
+
+#include "crow_all.h"
+
+#ifndef STARTUP_H
+#define STARTUP_H
+
+// StartupTimer times the phases of the server's startup, from its own
+// creation, and logs each phase as it ends. Phases on the startup thread end
+// one after the other with Mark; background phases, which the server is not
+// ready without, run between Begin and End. The server is ready once it is
+// serving and every background phase has ended, which /ready reports to load
+// balancers and autoscalers.
+class StartupTimer {
+ public:
+  struct Phase {
+    std::string name;
+    std::chrono::steady_clock::duration start{};
+    std::chrono::steady_clock::duration duration{};
+    bool done = false;
+  };
+
+  StartupTimer() : start_(std::chrono::steady_clock::now()) {}
+
+  StartupTimer(const StartupTimer&) = delete;
+  StartupTimer& operator=(const StartupTimer&) = delete;
+
+  // Ends the startup thread's current phase, which began with the previous
+  // Mark or with the timer, as `name`.
+  void Mark(const std::string& name) {
+    std::lock_guard<std::mutex> lock(mutex_);
+    const auto now = std::chrono::steady_clock::now() - start_;
+    phases_.push_back({name, last_mark_, now - last_mark_, true});
+    last_mark_ = now;
+    Log(phases_.back());
+  }
+
+  // Starts the background phase `name`.
+  void Begin(const std::string& name) {
+    std::lock_guard<std::mutex> lock(mutex_);
+    phases_.push_back({name, std::chrono::steady_clock::now() - start_});
+  }
+
+  // Ends the background phase `name`.
+  void End(const std::string& name) {
+    std::lock_guard<std::mutex> lock(mutex_);
+    const auto now = std::chrono::steady_clock::now() - start_;
+    for (Phase& phase : phases_) {
+      if (phase.name == name && !phase.done) {
+        phase.duration = now - phase.start;
+        phase.done = true;
+        Log(phase);
+        break;
+      }
+    }
+    CheckReady(now);
+  }
+
+  // Ends the startup thread's last phase as `name`, once the server accepts
+  // connections.
+  void Serving(const std::string& name) {
+    Mark(name);
+    std::lock_guard<std::mutex> lock(mutex_);
+    serving_ = true;
+    CheckReady(last_mark_);
+  }
+
+  bool Ready() const {
+    std::lock_guard<std::mutex> lock(mutex_);
+    return ready_;
+  }
+
+  // Returns the time from the timer's creation to readiness, or 0 if the
+  // server is not ready yet.
+  std::chrono::steady_clock::duration TimeToReady() const {
+    std::lock_guard<std::mutex> lock(mutex_);
+    return ready_at_;
+  }
+
+  std::vector<Phase> Phases() const {
+    std::lock_guard<std::mutex> lock(mutex_);
+    return phases_;
+  }
+
+ private:
+  const std::chrono::steady_clock::time_point start_;
+  // Guards the fields below.
+  mutable std::mutex mutex_;
+  std::vector<Phase> phases_;
+  std::chrono::steady_clock::duration last_mark_{};
+  std::chrono::steady_clock::duration ready_at_{};
+  bool serving_ = false;
+  bool ready_ = false;
+
+  static double Millis(std::chrono::steady_clock::duration duration) {
+    return std::chrono::duration<double, std::milli>(duration).count();
+  }
+
+  static void Log(const Phase& phase) {
+    CROW_LOG_INFO << "Startup: " << phase.name << " took "
+                  << Millis(phase.duration) << " ms";
+  }
+
+  void CheckReady(std::chrono::steady_clock::duration now) {
+    if (ready_ || !serving_) {
+      return;
+    }
+    for (const Phase& phase : phases_) {
+      if (!phase.done) {
+        return;
+      }
+    }
+    ready_ = true;
+    ready_at_ = now;
+    CROW_LOG_INFO << "Startup: ready after " << Millis(now) << " ms";
+  }
+};
+
+#endif  // STARTUP_H
@@ -0,0 +1,158 @@
+#include <algorithm>
+#include <atomic>
+#include <chrono>
+#include <cstdint>
+#include <cstdio>
+#include <fstream>
+#include <memory>
+#include <mutex>
+#include <string>
+#include <vector>
+
+#ifndef TRACING_H
+#define TRACING_H
+
+// Tracer keeps the spans of a sample of requests in a ring buffer per
+// thread, so recording never contends with other threads and memory stays
+// bounded: once a thread's ring is full, its oldest spans are overwritten.
+// The spans are exported in the Chrome trace event format, which
+// chrome://tracing and ui.perfetto.dev open.
+class Tracer {
+ public:
+  // Fraction of requests traced; 0 disables tracing. Requests are sampled
+  // evenly rather than at random, so tracing never draws from the game's
+  // random generators.
+  double sample_rate = 0.01;
+  // Spans kept per thread.
+  size_t ring_size = 1 << 14;
+
+  Tracer() : id_(NextTracerId()), epoch_(std::chrono::steady_clock::now()) {}
+
+  // Decides whether the request starting on this thread is traced. Returns
+  // the request's id, or 0 if it is not traced.
+  uint64_t BeginRequest() {
+    if (sample_rate <= 0) {
+      return 0;
+    }
+    thread_local double credit = 1;
+    credit += sample_rate;
+    if (credit < 1) {
+      return 0;
+    }
+    credit -= 1;
+    return next_request_.fetch_add(1, std::memory_order_relaxed);
+  }
+
+  // Records a span of the traced request `request`. `name` must outlive the
+  // tracer, e.g. a string literal.
+  void Record(uint64_t request, const char* name,
+              std::chrono::steady_clock::time_point start,
+              std::chrono::steady_clock::time_point end) {
+    Ring& ring = ThreadRing();
+    std::lock_guard<std::mutex> lock(ring.mutex);
+    ring.spans[ring.next % ring.spans.size()] = {
+        request, name, Nanos(start - epoch_), Nanos(end - start)};
+    ring.next++;
+  }
+
+  // Returns every span still in the rings as a Chrome trace event document.
+  std::string ChromeTrace() const {
+    std::string out = "{\"displayTimeUnit\":\"ns\",\"traceEvents\":[";
+    bool first = true;
+    std::lock_guard<std::mutex> rings_lock(rings_mutex_);
+    for (const std::unique_ptr<Ring>& ring : rings_) {
+      std::lock_guard<std::mutex> lock(ring->mutex);
+      const std::string tid = std::to_string(ring->thread);
+      out += first ? "" : ",";
+      first = false;
+      out += "{\"name\":\"thread_name\",\"ph\":\"M\",\"pid\":1,\"tid\":" + tid +
+             ",\"args\":{\"name\":\"worker " + tid + "\"}}";
+      const size_t size = ring->spans.size();
+      const size_t count = std::min<size_t>(ring->next, size);
+      for (size_t i = ring->next - count; i < ring->next; i++) {
+        const Span& span = ring->spans[i % size];
+        out += ",{\"name\":\"";
+        AppendEscaped(span.name, &out);
+        out += "\",\"cat\":\"request\",\"ph\":\"X\",\"ts\":" +
+               Micros(span.start_ns) + ",\"dur\":" + Micros(span.duration_ns) +
+               ",\"pid\":1,\"tid\":" + tid + ",\"args\":{\"request\":" +
+               std::to_string(span.request) + "}}";
+      }
+    }
+    out += "]}";
+    return out;
+  }
+
+  // Writes ChromeTrace() to the file at `path`. Returns false on failure.
+  bool WriteChromeTrace(const std::string& path) const {
+    std::ofstream out(path, std::ios::binary);
+    out << ChromeTrace();
+    return static_cast<bool>(out);
+  }
+
+ private:
+  struct Span {
+    uint64_t request = 0;
+    const char* name = nullptr;
+    int64_t start_ns = 0;
+    int64_t duration_ns = 0;
+  };
+
+  // The spans of one thread. The mutex is only contended while exporting.
+  struct Ring {
+    std::mutex mutex;
+    std::vector<Span> spans;
+    size_t next = 0;
+    uint64_t thread = 0;
+  };
+
+  const uint64_t id_;
+  const std::chrono::steady_clock::time_point epoch_;
+  std::atomic<uint64_t> next_request_{1};
+  mutable std::mutex rings_mutex_;
+  std::vector<std::unique_ptr<Ring>> rings_;
+
+  // Returns the calling thread's ring, creating it on first use. Tracers are
+  // told apart by id rather than address, which a later tracer may reuse.
+  Ring& ThreadRing() {
+    thread_local uint64_t owner = 0;
+    thread_local Ring* ring = nullptr;
+    if (owner != id_) {
+      std::lock_guard<std::mutex> lock(rings_mutex_);
+      rings_.push_back(std::make_unique<Ring>());
+      ring = rings_.back().get();
+      ring->spans.resize(std::max<size_t>(1, ring_size));
+      ring->thread = rings_.size();
+      owner = id_;
+    }
+    return *ring;
+  }
+
+  static uint64_t NextTracerId() {
+    static std::atomic<uint64_t> next_id{1};
+    return next_id.fetch_add(1);
+  }
+
+  static int64_t Nanos(std::chrono::steady_clock::duration duration) {
+    return std::chrono::duration_cast<std::chrono::nanoseconds>(duration)
+        .count();
+  }
+
+  // Chrome traces are in microseconds; nanoseconds are kept as decimals.
+  static std::string Micros(int64_t nanos) {
+    char buffer[32];
+    std::snprintf(buffer, sizeof(buffer), "%.3f", nanos / 1e3);
+    return buffer;
+  }
+
+  static void AppendEscaped(const char* text, std::string* out) {
+    for (; *text != '\0'; text++) {
+      if (*text == '"' || *text == '\\') {
+        out->push_back('\\');
+      }
+      out->push_back(*text);
+    }
+  }
+};
+
+#endif  // TRACING_H
@@ -0,0 +1,211 @@
+#include "stats.h"
+
+#include <algorithm>
+#include <functional>
+
+#include "random.h"
+
+namespace {
+
+// Increments a counter that only the calling thread writes. A load and a
+// store are enough, and avoid the locked read-modify-write of fetch_add.
+template <typename T>
+void Bump(std::atomic<T>& counter) {
+  counter.store(counter.load(std::memory_order_relaxed) + 1,
+                std::memory_order_relaxed);
+}
+
+std::atomic<uint64_t> next_stats_id{1};
+
+}  // namespace
+
+uint64_t GameCounts::Wins() const {
+  uint64_t wins = 0;
+  for (uint64_t count : guesses) {
+    wins += count;
+  }
+  return wins;
+}
+
+double GameCounts::WinRate() const {
+  const uint64_t finished = Finished();
+  return finished == 0 ? 0 : static_cast<double>(Wins()) / finished;
+}
+
+GameStats::ThreadCounters::ThreadCounters(size_t hurdles)
+    : counts(new std::atomic<uint64_t>[(hurdles + 1) * kFields]),
+      sketch(new std::atomic<uint32_t>[kSketchDepth * kSketchWidth]) {
+  for (size_t i = 0; i < (hurdles + 1) * kFields; i++) {
+    counts[i].store(0, std::memory_order_relaxed);
+  }
+  for (size_t i = 0; i < kSketchDepth * kSketchWidth; i++) {
+    sketch[i].store(0, std::memory_order_relaxed);
+  }
+}
+
+GameStats::GameStats(const HurdleWords& words)
+    : words_(words), id_(next_stats_id.fetch_add(1)) {
+  const std::vector<std::string>& hurdles = words_.Hurdles();
+  for (size_t i = 0; i < hurdles.size(); i++) {
+    hurdle_index_.emplace(hurdles[i], i);
+  }
+  auto empty = std::make_shared<StatsSnapshot>();
+  empty->hurdles.resize(hurdles.size());
+  snapshot_ = empty;
+}
+
+GameStats::~GameStats() { Stop(); }
+
+void GameStats::GameFinished(const std::string&, const HurdleState& state) {
+  const std::vector<std::string>& guesses = state.GetGuesses();
+  if (state.GetStatus() == "win" && guesses.size() >= 1 &&
+      guesses.size() <= 6) {
+    Count(state.GetHurdle(), guesses.size() - 1);
+  } else {
+    Count(state.GetHurdle(), kLosses);
+  }
+  if (!guesses.empty()) {
+    CountFirstGuess(guesses[0]);
+  }
+}
+
+void GameStats::GameAbandoned(const std::string&, const HurdleState& state,
+                              size_t submitted_rows) {
+  Count(state.GetHurdle(), kAbandoned);
+  if (submitted_rows > 0) {
+    CountFirstGuess(state.GetGuesses()[0]);
+  }
+}
+
+void GameStats::Start() {
+  std::lock_guard<std::mutex> lock(aggregator_mutex_);
+  if (aggregator_.joinable()) {
+    return;
+  }
+  stopping_ = false;
+  aggregator_ = std::thread([this] {
+    std::unique_lock<std::mutex> lock(aggregator_mutex_);
+    while (!aggregator_cv_.wait_for(lock, interval,
+                                    [this] { return stopping_; })) {
+      lock.unlock();
+      Aggregate();
+      lock.lock();
+    }
+  });
+}
+
+void GameStats::Stop() {
+  std::thread aggregator;
+  {
+    std::lock_guard<std::mutex> lock(aggregator_mutex_);
+    stopping_ = true;
+    aggregator = std::move(aggregator_);
+  }
+  aggregator_cv_.notify_all();
+  if (aggregator.joinable()) {
+    aggregator.join();
+  }
+}
+
+void GameStats::Aggregate() {
+  const size_t hurdles = words_.Hurdles().size();
+  std::vector<uint64_t> counts((hurdles + 1) * kFields);
+  std::vector<uint64_t> sketch(kSketchDepth * kSketchWidth);
+  {
+    std::lock_guard<std::mutex> lock(threads_mutex_);
+    for (const auto& thread : threads_) {
+      for (size_t i = 0; i < counts.size(); i++) {
+        counts[i] += thread->counts[i].load(std::memory_order_relaxed);
+      }
+      for (size_t i = 0; i < sketch.size(); i++) {
+        sketch[i] += thread->sketch[i].load(std::memory_order_relaxed);
+      }
+    }
+  }
+
+  auto snapshot = std::make_shared<StatsSnapshot>();
+  auto fill = [&](GameCounts* out, size_t slot) {
+    const uint64_t* fields = &counts[slot * kFields];
+    std::copy(fields, fields + 6, out->guesses);
+    out->losses = fields[kLosses];
+    out->abandoned = fields[kAbandoned];
+  };
+  fill(&snapshot->total, 0);
+  snapshot->hurdles.resize(hurdles);
+  for (size_t i = 0; i < hurdles; i++) {
+    fill(&snapshot->hurdles[i], i + 1);
+  }
+
+  // Sketches add up, so the merged sketch estimates the counts over every
+  // thread. Every first guess is a valid guess, so the guess list is the
+  // universe of keys to estimate.
+  for (const std::string& guess : words_.Guesses()) {
+    uint64_t estimate = UINT64_MAX;
+    for (size_t row = 0; row < kSketchDepth; row++) {
+      estimate = std::min(
+          estimate, sketch[row * kSketchWidth + SketchSlot(guess, row)]);
+    }
+    if (estimate > 0) {
+      snapshot->first_guesses.emplace_back(guess, estimate);
+    }
+  }
+  const size_t top =
+      std::min(top_first_guesses, snapshot->first_guesses.size());
+  std::partial_sort(
+      snapshot->first_guesses.begin(), snapshot->first_guesses.begin() + top,
+      snapshot->first_guesses.end(), [](const auto& a, const auto& b) {
+        return a.second != b.second ? a.second > b.second : a.first < b.first;
+      });
+  snapshot->first_guesses.resize(top);
+
+  std::lock_guard<std::mutex> lock(snapshot_mutex_);
+  snapshot->generation = ++generation_;
+  snapshot_ = std::move(snapshot);
+}
+
+std::shared_ptr<const StatsSnapshot> GameStats::Snapshot() const {
+  std::lock_guard<std::mutex> lock(snapshot_mutex_);
+  return snapshot_;
+}
+
+int GameStats::HurdleIndex(const std::string& hurdle) const {
+  auto it = hurdle_index_.find(hurdle);
+  return it == hurdle_index_.end() ? -1 : it->second;
+}
+
+GameStats::ThreadCounters& GameStats::Local() {
+  // Each thread caches the counters of the last GameStats it recorded into.
+  // A thread switching between instances registers again on every switch,
+  // which only tests do.
+  thread_local uint64_t cached_id = 0;
+  thread_local ThreadCounters* cached = nullptr;
+  if (cached_id != id_) {
+    std::lock_guard<std::mutex> lock(threads_mutex_);
+    threads_.push_back(
+        std::make_unique<ThreadCounters>(words_.Hurdles().size()));
+    cached = threads_.back().get();
+    cached_id = id_;
+  }
+  return *cached;
+}
+
+void GameStats::Count(const std::string& hurdle, size_t field) {
+  ThreadCounters& local = Local();
+  Bump(local.counts[field]);
+  const int index = HurdleIndex(hurdle);
+  if (index >= 0) {
+    Bump(local.counts[(index + 1) * kFields + field]);
+  }
+}
+
+void GameStats::CountFirstGuess(const std::string& guess) {
+  ThreadCounters& local = Local();
+  for (size_t row = 0; row < kSketchDepth; row++) {
+    Bump(local.sketch[row * kSketchWidth + SketchSlot(guess, row)]);
+  }
+}
+
+size_t GameStats::SketchSlot(const std::string& guess, size_t row) {
+  return MixBits(std::hash<std::string>()(guess) + row * 0x9e3779b97f4a7c15) %
+         kSketchWidth;
+}
@@ -0,0 +1,126 @@
+#include <atomic>
+#include <chrono>
+#include <condition_variable>
+#include <cstdint>
+#include <memory>
+#include <mutex>
+#include <string>
+#include <thread>
+#include <unordered_map>
+#include <utility>
+#include <vector>
+
+#include "hurdle.h"
+#include "hurdlewords.h"
+
+#ifndef STATS_H
+#define STATS_H
+
+// Outcomes of the games played with one hurdle, or with every hurdle.
+struct GameCounts {
+  // guesses[i] is the number of games won in i + 1 guesses.
+  uint64_t guesses[6] = {};
+  uint64_t losses = 0;
+  uint64_t abandoned = 0;
+
+  uint64_t Wins() const;
+  uint64_t Finished() const { return Wins() + losses; }
+  // Fraction of the finished games that were won, 0 if none finished.
+  double WinRate() const;
+};
+
+// A merged view of the statistics at one point in time.
+struct StatsSnapshot {
+  // Incremented by every aggregation, starting from 1.
+  uint64_t generation = 0;
+  GameCounts total;
+  // Indexed like HurdleWords::Hurdles().
+  std::vector<GameCounts> hurdles;
+  // The most common first guesses, by estimated count.
+  std::vector<std::pair<std::string, uint64_t>> first_guesses;
+};
+
+// GameStats collects the outcomes of every game it observes. Recording a
+// game only touches counters owned by the calling thread: plain relaxed
+// stores that no other thread writes, plus a count-min sketch of first
+// guesses. An aggregator merges every thread's counters into a snapshot
+// periodically, so readers never touch the game threads' cache lines.
+class GameStats : public HurdleObserver {
+ public:
+  explicit GameStats(const HurdleWords& words);
+  ~GameStats() override;
+  GameStats(const GameStats&) = delete;
+  GameStats& operator=(const GameStats&) = delete;
+
+  void GameFinished(const std::string& player,
+                    const HurdleState& state) override;
+  void GameAbandoned(const std::string& player, const HurdleState& state,
+                     size_t submitted_rows) override;
+
+  // Starts a background thread that calls Aggregate() every `interval`,
+  // until Stop() or destruction.
+  void Start();
+  void Stop();
+
+  // Merges the counters of every thread into a new snapshot.
+  void Aggregate();
+
+  // Returns the last snapshot. It is empty until the first aggregation.
+  std::shared_ptr<const StatsSnapshot> Snapshot() const;
+
+  // Returns the index of `hurdle` in the snapshot's hurdles, or -1 if it is
+  // not a known hurdle.
+  int HurdleIndex(const std::string& hurdle) const;
+
+  // Time between two aggregations of the background thread.
+  std::chrono::milliseconds interval = std::chrono::seconds(1);
+  // Number of first guesses kept in snapshots.
+  size_t top_first_guesses = 10;
+
+ private:
+  // The count-min sketch has kSketchDepth rows of kSketchWidth counters,
+  // each row indexed by an independent hash of the guess. A guess's count is
+  // overestimated by at most 2N / kSketchWidth, for N first guesses, with
+  // probability 1 - 2^-kSketchDepth.
+  static constexpr size_t kSketchDepth = 4;
+  static constexpr size_t kSketchWidth = 4096;
+  // Counters kept per hurdle: the 6 winning guess counts, losses and
+  // abandoned games, which fill exactly one cache line.
+  static constexpr size_t kFields = 8;
+  static constexpr size_t kLosses = 6;
+  static constexpr size_t kAbandoned = 7;
+
+  // The counters written by one thread. Index 0 of `counts` holds the
+  // totals, and index i + 1 the counts of hurdle i.
+  struct ThreadCounters {
+    explicit ThreadCounters(size_t hurdles);
+    std::unique_ptr<std::atomic<uint64_t>[]> counts;
+    std::unique_ptr<std::atomic<uint32_t>[]> sketch;
+  };
+
+  HurdleWords words_;
+  std::unordered_map<std::string, int> hurdle_index_;
+  // Distinguishes this instance in the threads' caches of their counters,
+  // which outlive it.
+  const uint64_t id_;
+
+  std::mutex threads_mutex_;
+  std::vector<std::unique_ptr<ThreadCounters>> threads_;
+
+  mutable std::mutex snapshot_mutex_;
+  std::shared_ptr<const StatsSnapshot> snapshot_;
+  uint64_t generation_ = 0;
+
+  std::mutex aggregator_mutex_;
+  std::condition_variable aggregator_cv_;
+  bool stopping_ = false;
+  std::thread aggregator_;
+
+  // Returns the calling thread's counters, registering them on first use.
+  ThreadCounters& Local();
+  void Count(const std::string& hurdle, size_t field);
+  void CountFirstGuess(const std::string& guess);
+  static size_t SketchSlot(const std::string& guess, size_t row);
+};
+
+#endif  // STATS_H
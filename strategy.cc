@@ -0,0 +1,142 @@
+#include "strategy.h"
+
+#include <fcntl.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <unistd.h>
+
+#include <algorithm>
+#include <cstring>
+
+uint64_t WordsChecksum(const HurdleWords& words) {
+  // FNV-1a over both lists, with a separator after every word.
+  uint64_t hash = 14695981039346656037ull;
+  auto add = [&hash](const std::string& word) {
+    for (char c : word) {
+      hash = (hash ^ static_cast<unsigned char>(c)) * 1099511628211ull;
+    }
+    hash = (hash ^ '\n') * 1099511628211ull;
+  };
+  for (const std::string& hurdle : words.Hurdles()) {
+    add(hurdle);
+  }
+  add("");
+  for (const std::string& guess : words.Guesses()) {
+    add(guess);
+  }
+  return hash;
+}
+
+StrategyTable::~StrategyTable() {
+  Close();
+}
+
+bool StrategyTable::Open(const std::string& path, const HurdleWords& words) {
+  Close();
+  int fd = open(path.c_str(), O_RDONLY);
+  if (fd < 0) {
+    return false;
+  }
+  struct stat info;
+  if (fstat(fd, &info) != 0 ||
+      static_cast<size_t>(info.st_size) < sizeof(StrategyHeader)) {
+    close(fd);
+    return false;
+  }
+  mapping_size_ = info.st_size;
+  mapping_ = mmap(nullptr, mapping_size_, PROT_READ, MAP_PRIVATE, fd, 0);
+  close(fd);
+  if (mapping_ == MAP_FAILED) {
+    mapping_ = nullptr;
+    return false;
+  }
+
+  const char* data = static_cast<const char*>(mapping_);
+  const auto* header = reinterpret_cast<const StrategyHeader*>(data);
+  const size_t expected_size = sizeof(StrategyHeader) +
+                               header->node_count * sizeof(StrategyNode) +
+                               header->edge_count * sizeof(StrategyEdge);
+  if (std::memcmp(header->magic, kStrategyMagic, sizeof(kStrategyMagic)) != 0 ||
+      header->version != kStrategyVersion || header->node_count == 0 ||
+      mapping_size_ != expected_size ||
+      header->hurdle_count != words.Hurdles().size() ||
+      header->guess_count != words.Guesses().size() ||
+      header->words_checksum != WordsChecksum(words)) {
+    Close();
+    return false;
+  }
+  const auto* nodes =
+      reinterpret_cast<const StrategyNode*>(data + sizeof(StrategyHeader));
+  const auto* edges = reinterpret_cast<const StrategyEdge*>(
+      nodes + header->node_count);
+
+  // Check every index once, so lookups can trust the table.
+  for (uint32_t n = 0; n < header->node_count; n++) {
+    const StrategyNode& node = nodes[n];
+    if (node.guess >= header->guess_count ||
+        node.first_edge > header->edge_count ||
+        node.edge_count > header->edge_count - node.first_edge) {
+      Close();
+      return false;
+    }
+  }
+  for (uint32_t e = 0; e < header->edge_count; e++) {
+    if (edges[e].child >= header->node_count ||
+        edges[e].pattern >= kPatternCount) {
+      Close();
+      return false;
+    }
+  }
+
+  words_.emplace(words);
+  header_ = header;
+  nodes_ = nodes;
+  edges_ = edges;
+  return true;
+}
+
+const StrategyNode* StrategyTable::Lookup(
+    const std::vector<std::string>& guesses,
+    const std::vector<std::string>& colors) const {
+  if (!Loaded()) {
+    return nullptr;
+  }
+  const StrategyNode* node = &nodes_[0];
+  for (size_t i = 0; i < guesses.size() && i < colors.size(); i++) {
+    Pattern pattern;
+    if (guesses[i].size() != kWordLength || !words_->IsGuessValid(guesses[i]) ||
+        !PatternFromColors(colors[i], &pattern)) {
+      continue;
+    }
+    if (guesses[i] != Guess(*node) || pattern == kAllGreen) {
+      return nullptr;
+    }
+    const StrategyEdge* begin = edges_ + node->first_edge;
+    const StrategyEdge* end = begin + node->edge_count;
+    const StrategyEdge* edge = std::lower_bound(
+        begin, end, pattern, [](const StrategyEdge& edge, uint32_t pattern) {
+          return edge.pattern < pattern;
+        });
+    if (edge == end || edge->pattern != pattern) {
+      return nullptr;
+    }
+    node = &nodes_[edge->child];
+  }
+  return node;
+}
+
+const std::string& StrategyTable::Guess(const StrategyNode& node) const {
+  return words_->Guesses()[node.guess];
+}
+
+void StrategyTable::Close() {
+  if (mapping_ != nullptr) {
+    munmap(mapping_, mapping_size_);
+  }
+  mapping_ = nullptr;
+  mapping_size_ = 0;
+  header_ = nullptr;
+  nodes_ = nullptr;
+  edges_ = nullptr;
+  words_.reset();
+}
@@ -0,0 +1,91 @@
+#include <cstddef>
+#include <cstdint>
+#include <optional>
+#include <string>
+#include <vector>
+
+#include "hurdlewords.h"
+#include "patterns.h"
+
+#ifndef STRATEGY_H
+#define STRATEGY_H
+
+// A strategy table is a decision tree precomputed by tools/solver: every node
+// holds the guess to play and one edge per feedback pattern that guess can
+// get. The file is laid out so it can be memory-mapped and walked as is:
+// a StrategyHeader, then header.node_count StrategyNodes, then
+// header.edge_count StrategyEdges. Node 0 is the opening.
+struct StrategyHeader {
+  char magic[8];
+  uint32_t version;
+  uint32_t node_count;
+  uint32_t edge_count;
+  uint32_t hurdle_count;
+  uint32_t guess_count;
+  uint32_t reserved;
+  // Fingerprint of the word lists the table was computed from.
+  uint64_t words_checksum;
+};
+
+struct StrategyNode {
+  // Index of the guess into HurdleWords::Guesses().
+  uint32_t guess;
+  // Edges [first_edge, first_edge + edge_count) are sorted by pattern.
+  uint32_t first_edge;
+  uint32_t edge_count;
+  // Number of hurdles still possible at this node.
+  uint32_t candidates;
+  // Expected information of the guess, in bits.
+  float expected_info;
+  // Expected number of guesses to finish from here, including this one.
+  float expected_guesses;
+};
+
+struct StrategyEdge {
+  uint32_t child;
+  uint32_t pattern;
+};
+
+constexpr char kStrategyMagic[8] = {'H', 'R', 'D', 'L', 'S', 'T', 'R', 'T'};
+constexpr uint32_t kStrategyVersion = 1;
+
+// Returns a fingerprint of the hurdle and guess lists, so a table computed
+// from other word lists is never used.
+uint64_t WordsChecksum(const HurdleWords& words);
+
+// StrategyTable maps a strategy file into memory. Looking up the next guess
+// costs one binary search over at most kPatternCount edges per row.
+class StrategyTable {
+ public:
+  StrategyTable() = default;
+  ~StrategyTable();
+
+  StrategyTable(const StrategyTable&) = delete;
+  StrategyTable& operator=(const StrategyTable&) = delete;
+
+  // Maps the table at `path`. Returns false if the file is missing,
+  // malformed, or was computed from word lists other than `words`.
+  bool Open(const std::string& path, const HurdleWords& words);
+
+  bool Loaded() const { return header_ != nullptr; }
+
+  // Follows the complete, valid rows of a board down the tree. Returns the
+  // node to play next, or nullptr if the board left the tree or is solved.
+  const StrategyNode* Lookup(const std::vector<std::string>& guesses,
+                             const std::vector<std::string>& colors) const;
+
+  // Returns the guess played at `node`.
+  const std::string& Guess(const StrategyNode& node) const;
+
+ private:
+  std::optional<HurdleWords> words_;
+  void* mapping_ = nullptr;
+  size_t mapping_size_ = 0;
+  const StrategyHeader* header_ = nullptr;
+  const StrategyNode* nodes_ = nullptr;
+  const StrategyEdge* edges_ = nullptr;
+
+  void Close();
+};
+
+#endif  // STRATEGY_H
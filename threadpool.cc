@@ -0,0 +1,128 @@
+#include "threadpool.h"
+
+#include <algorithm>
+
+ThreadPool::ThreadPool(size_t threads) {
+  if (threads == 0) {
+    threads = std::max(1u, std::thread::hardware_concurrency());
+  }
+  for (size_t i = 0; i < threads; i++) {
+    workers_.push_back(std::make_unique<Worker>());
+  }
+  for (size_t i = 0; i < threads; i++) {
+    threads_.emplace_back([this, i] { WorkerLoop(i); });
+  }
+}
+
+ThreadPool::~ThreadPool() {
+  {
+    std::lock_guard<std::mutex> lock(wake_mutex_);
+    stopping_ = true;
+  }
+  wake_.notify_all();
+  for (std::thread& thread : threads_) {
+    thread.join();
+  }
+}
+
+size_t ThreadPool::Size() const {
+  return workers_.size();
+}
+
+void ThreadPool::Submit(std::function<void()> task) {
+  Push(next_worker_++ % workers_.size(), std::move(task));
+}
+
+void ThreadPool::ParallelFor(size_t begin, size_t end, size_t grain,
+                             const std::function<void(size_t, size_t)>& fn) {
+  if (begin >= end) {
+    return;
+  }
+  grain = std::max<size_t>(grain, 1);
+  const size_t chunks = (end - begin + grain - 1) / grain;
+  if (chunks == 1) {
+    fn(begin, end);
+    return;
+  }
+
+  // Chunks are claimed in order by the calling thread and by helper tasks
+  // on the workers, so the caller only ever runs chunks of this batch, never
+  // unrelated tasks that could hold it up. Helpers that find every chunk
+  // claimed return without touching `fn`.
+  struct Batch {
+    std::atomic<size_t> next{0};
+    std::atomic<size_t> remaining;
+    std::mutex done_mutex;
+    std::condition_variable done;
+  };
+  auto batch = std::make_shared<Batch>();
+  batch->remaining = chunks;
+  auto run_chunks = [batch, begin, end, grain, chunks, &fn] {
+    for (size_t chunk = batch->next++; chunk < chunks;
+         chunk = batch->next++) {
+      const size_t chunk_begin = begin + chunk * grain;
+      fn(chunk_begin, std::min(end, chunk_begin + grain));
+      if (batch->remaining.fetch_sub(1) == 1) {
+        std::lock_guard<std::mutex> lock(batch->done_mutex);
+        batch->done.notify_all();
+      }
+    }
+  };
+  const size_t helpers = std::min(chunks - 1, workers_.size());
+  for (size_t i = 0; i < helpers; i++) {
+    Push(next_worker_++ % workers_.size(), run_chunks);
+  }
+
+  // Work on the batch instead of blocking, then wait for chunks still
+  // running on other threads.
+  run_chunks();
+  std::unique_lock<std::mutex> lock(batch->done_mutex);
+  batch->done.wait(lock, [&] { return batch->remaining.load() == 0; });
+}
+
+void ThreadPool::Push(size_t worker, std::function<void()> task) {
+  {
+    std::lock_guard<std::mutex> lock(workers_[worker]->mutex);
+    workers_[worker]->tasks.push_back(std::move(task));
+  }
+  {
+    std::lock_guard<std::mutex> lock(wake_mutex_);
+    pending_++;
+  }
+  wake_.notify_one();
+}
+
+bool ThreadPool::TryPop(size_t worker, std::function<void()>* task) {
+  for (size_t i = 0; i < workers_.size(); i++) {
+    Worker& victim = *workers_[(worker + i) % workers_.size()];
+    std::lock_guard<std::mutex> lock(victim.mutex);
+    if (victim.tasks.empty()) {
+      continue;
+    }
+    if (i == 0) {
+      *task = std::move(victim.tasks.back());
+      victim.tasks.pop_back();
+    } else {
+      *task = std::move(victim.tasks.front());
+      victim.tasks.pop_front();
+    }
+    pending_--;
+    return true;
+  }
+  return false;
+}
+
+void ThreadPool::WorkerLoop(size_t worker) {
+  std::function<void()> task;
+  while (true) {
+    if (TryPop(worker, &task)) {
+      task();
+      continue;
+    }
+    std::unique_lock<std::mutex> lock(wake_mutex_);
+    wake_.wait(lock, [this] { return stopping_ || pending_.load() > 0; });
+    if (stopping_ && pending_.load() == 0) {
+      return;
+    }
+  }
+}
@@ -0,0 +1,61 @@
+#include <atomic>
+#include <condition_variable>
+#include <cstddef>
+#include <deque>
+#include <functional>
+#include <memory>
+#include <mutex>
+#include <thread>
+#include <vector>
+
+#ifndef THREADPOOL_H
+#define THREADPOOL_H
+
+// ThreadPool runs tasks on a fixed set of worker threads. Every worker has its
+// own task deque: it takes work from the back of its own deque and, once that
+// is empty, steals from the front of the others'. Tasks submitted together are
+// spread over the deques, so an uneven batch gets balanced by stealing. The
+// destructor runs the tasks still queued before joining the workers.
+class ThreadPool {
+ public:
+  // Starts `threads` workers, or one per hardware thread if 0.
+  explicit ThreadPool(size_t threads = 0);
+  ~ThreadPool();
+
+  ThreadPool(const ThreadPool&) = delete;
+  ThreadPool& operator=(const ThreadPool&) = delete;
+
+  size_t Size() const;
+
+  // Calls fn(chunk_begin, chunk_end) over [begin, end) split into chunks of
+  // at most `grain` indices, and returns once every chunk has run. The
+  // calling thread works on chunks too, and only on this call's, so
+  // ParallelFor may be called from inside a task.
+  void ParallelFor(size_t begin, size_t end, size_t grain,
+                   const std::function<void(size_t, size_t)>& fn);
+
+  // Runs `task` on some worker without waiting for it.
+  void Submit(std::function<void()> task);
+
+ private:
+  struct Worker {
+    std::mutex mutex;
+    std::deque<std::function<void()>> tasks;
+  };
+
+  std::vector<std::unique_ptr<Worker>> workers_;
+  std::vector<std::thread> threads_;
+  std::mutex wake_mutex_;
+  std::condition_variable wake_;
+  std::atomic<size_t> pending_{0};
+  std::atomic<size_t> next_worker_{0};
+  bool stopping_ = false;
+
+  void Push(size_t worker, std::function<void()> task);
+  // Pops a task, preferring the back of `worker`'s own deque. Returns false
+  // if every deque is empty.
+  bool TryPop(size_t worker, std::function<void()>* task);
+  void WorkerLoop(size_t worker);
+};
+
+#endif  // THREADPOOL_H
@@ -0,0 +1,227 @@
+// Microbenchmarks of the game engine, built with Google Benchmark. Run them
+// with `make bench`, which writes the results as JSON to
+// tools/output/bench-<commit>.json, so that runs of two commits can be
+// compared. Must be run from the repository root, to find data/.
+//
+// `make bench_allocs` builds the suite with allocation profiling, and adds
+// the heap allocations and bytes per iteration of every benchmark to the
+// results.
+
+#include <benchmark/benchmark.h>
+
+#include <algorithm>
+#include <string>
+#include <vector>
+
+#include "../../allocprofile.h"
+#include "../../hurdle.h"
+#include "../../hurdlewords.h"
+#include "../../server_utils/metrics.h"
+#include "../../server_utils/routemetrics.h"
+
+namespace {
+
+const HurdleWords& Words() {
+  static const HurdleWords words("data/valid_hurdles.txt",
+                                 "data/valid_guesses.txt");
+  return words;
+}
+
+// Returns every `stride`th valid guess, for a mix of guesses that does not
+// depend on the size of the list.
+std::vector<std::string> SampleGuesses(size_t count) {
+  const std::vector<std::string>& guesses = Words().Guesses();
+  std::vector<std::string> sample;
+  const size_t stride = std::max<size_t>(1, guesses.size() / count);
+  for (size_t i = 0; i < guesses.size() && sample.size() < count;
+       i += stride) {
+    sample.push_back(guesses[i]);
+  }
+  return sample;
+}
+
+// Fills the board of `game` with `rows` guesses that miss the hurdle.
+void FillBoard(HurdleGame& game, size_t rows) {
+  const std::vector<std::string> guesses = SampleGuesses(6);
+  game.StartHurdle("light");
+  for (size_t row = 0; row < rows; row++) {
+    for (char letter : guesses[row]) {
+      game.LetterEntered(letter);
+    }
+    game.WordSubmitted();
+  }
+}
+
+void BM_CalculateColors(benchmark::State& state) {
+  HurdleGame game(Words());
+  game.StartHurdle("light");
+  const std::vector<std::string> guesses = SampleGuesses(1024);
+  size_t i = 0;
+  for (auto _ : state) {
+    benchmark::DoNotOptimize(game.CalculateColors(guesses[i]));
+    i = (i + 1) % guesses.size();
+  }
+  state.SetItemsProcessed(state.iterations());
+}
+BENCHMARK(BM_CalculateColors);
+
+// Arg 0 looks up valid guesses, arg 1 words that are not.
+void BM_IsGuessValid(benchmark::State& state) {
+  std::vector<std::string> words = SampleGuesses(1024);
+  if (state.range(0) == 1) {
+    for (std::string& word : words) {
+      word[0] = 'q';
+      word[4] = 'q';
+    }
+  }
+  size_t i = 0;
+  for (auto _ : state) {
+    benchmark::DoNotOptimize(Words().IsGuessValid(words[i]));
+    i = (i + 1) % words.size();
+  }
+  state.SetItemsProcessed(state.iterations());
+}
+BENCHMARK(BM_IsGuessValid)->Arg(0)->Arg(1);
+
+void BM_HurdleWordsConstruction(benchmark::State& state) {
+  for (auto _ : state) {
+    HurdleWords words("data/valid_hurdles.txt", "data/valid_guesses.txt");
+    benchmark::DoNotOptimize(words.Guesses().data());
+  }
+}
+BENCHMARK(BM_HurdleWordsConstruction)->Unit(benchmark::kMillisecond);
+
+// The arg is the number of rows on the board.
+void BM_JsonFromHurdleState(benchmark::State& state) {
+  HurdleGame game(Words());
+  FillBoard(game, state.range(0));
+  for (auto _ : state) {
+    benchmark::DoNotOptimize(game.JsonFromHurdleState());
+  }
+}
+BENCHMARK(BM_JsonFromHurdleState)->DenseRange(0, 6, 3);
+
+void BM_JsonFromHurdleStateDump(benchmark::State& state) {
+  HurdleGame game(Words());
+  FillBoard(game, state.range(0));
+  for (auto _ : state) {
+    benchmark::DoNotOptimize(game.JsonFromHurdleState().dump());
+  }
+}
+BENCHMARK(BM_JsonFromHurdleStateDump)->DenseRange(0, 6, 3);
+
+// Plays a whole losing game the way the routes do: every request is
+// followed by the serialized JSON of the new state.
+void BM_GameKeystrokesToJson(benchmark::State& state) {
+  HurdleGame game(Words());
+  const std::vector<std::string> guesses = SampleGuesses(6);
+  size_t requests = 0;
+  for (auto _ : state) {
+    game.StartHurdle("light");
+    benchmark::DoNotOptimize(game.SerializedHurdleState().data());
+    for (const std::string& guess : guesses) {
+      for (char letter : guess) {
+        game.LetterEntered(letter);
+        benchmark::DoNotOptimize(game.SerializedHurdleState().data());
+      }
+      game.WordSubmitted();
+      benchmark::DoNotOptimize(game.SerializedHurdleState().data());
+      requests += guess.size() + 1;
+    }
+    requests++;
+  }
+  state.SetItemsProcessed(requests);
+}
+BENCHMARK(BM_GameKeystrokesToJson);
+
+// Metrics are recorded on every request, so each of these must stay far
+// below the cost of handling one.
+void BM_CounterAdd(benchmark::State& state) {
+  static Counter counter;
+  for (auto _ : state) {
+    counter.Add();
+  }
+}
+BENCHMARK(BM_CounterAdd)->ThreadRange(1, 4);
+
+void BM_LatencyHistogramRecord(benchmark::State& state) {
+  static LatencyHistogram histogram;
+  std::chrono::nanoseconds latency(1);
+  for (auto _ : state) {
+    histogram.Record(latency);
+    latency = std::chrono::nanoseconds((latency.count() * 7) % 50000000 + 1);
+  }
+}
+BENCHMARK(BM_LatencyHistogramRecord)->ThreadRange(1, 4);
+
+// The whole per-request cost of MetricsMiddleware: reading the clock twice,
+// finding the route and recording into its histogram and status counter.
+void BM_MetricsMiddleware(benchmark::State& state) {
+  MetricsRegistry registry;
+  MetricsMiddleware middleware;
+  middleware.Register(registry, {"/wordle_key_pressed", "/enter_pressed",
+                                 "/delete_pressed", "/new_game", "/hint"});
+  crow::request req;
+  req.url = "/wordle_key_pressed/e";
+  crow::response res(200);
+  MetricsMiddleware::context ctx;
+  for (auto _ : state) {
+    middleware.before_handle(req, res, ctx);
+    middleware.after_handle(req, res, ctx);
+  }
+}
+BENCHMARK(BM_MetricsMiddleware);
+
+// Measures the allocations of a benchmark's extra memory run.
+class AllocationCounter : public benchmark::MemoryManager {
+ public:
+  void Start() override { start_ = allocprofile::TotalCounts(); }
+
+  void Stop(Result* result) override {
+    const allocprofile::Counts end = allocprofile::TotalCounts();
+    result->num_allocs = end.allocations - start_.allocations;
+    result->total_allocated_bytes = end.bytes - start_.bytes;
+  }
+
+ private:
+  allocprofile::Counts start_;
+};
+
+// Shows the allocation counts of each run next to its timings.
+class AllocationReporter : public benchmark::ConsoleReporter {
+ public:
+  void ReportRuns(const std::vector<Run>& runs) override {
+    std::vector<Run> reported = runs;
+    for (Run& run : reported) {
+      if (run.memory_result == nullptr) {
+        continue;
+      }
+      const int64_t allocations = run.memory_result->num_allocs;
+      run.counters["allocs/iter"] = run.allocs_per_iter;
+      run.counters["bytes/iter"] =
+          allocations == 0 ? 0
+                           : run.memory_result->total_allocated_bytes *
+                                 run.allocs_per_iter / allocations;
+    }
+    ConsoleReporter::ReportRuns(reported);
+  }
+};
+
+}  // namespace
+
+int main(int argc, char** argv) {
+  benchmark::Initialize(&argc, argv);
+  if (benchmark::ReportUnrecognizedArguments(argc, argv)) {
+    return 1;
+  }
+  if (!allocprofile::Enabled()) {
+    benchmark::RunSpecifiedBenchmarks();
+    return 0;
+  }
+  AllocationCounter allocation_counter;
+  benchmark::RegisterMemoryManager(&allocation_counter);
+  AllocationReporter reporter;
+  benchmark::RunSpecifiedBenchmarks(&reporter);
+  benchmark::RegisterMemoryManager(nullptr);
+  return 0;
+}
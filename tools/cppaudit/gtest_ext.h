@@ -372,3 +372,16 @@ template <typename T>
     } \
     if (::testing::Test::HasFatalFailure()) FAIL(); \
 }
+ 
+// Types a word into a Hurdle game one letter at a time, then submits it,
+// as a player on the frontend would
+//
+// @param game  game receiving the key presses
+// @param word  letters to type before pressing enter
+template <typename Game>
+void SubmitWord(Game& game, const std::string& word) {
+  for (char letter : word) {
+    game.LetterEntered(letter);
+  }
+  game.WordSubmitted();
+}
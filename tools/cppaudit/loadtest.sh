@@ -0,0 +1,55 @@
+#!/bin/bash
+# Serves the Hurdle backend SERVER on PORT and drives it for SECONDS with the
+# load generator, replaying self-play games that also ask for hints and read
+# the stats and leaderboard. Writes the load generator's results to JSON.
+# Both make build_pgo, to train the instrumented build, and make bench_builds
+# run it, from the repository root.
+#
+# Usage: loadtest.sh OUTPUT_PATH SERVER PORT SECONDS JSON
+OUTPUT_PATH=$1
+SERVER=$2
+PORT=$3
+DURATION=$4
+JSON=$5
+TRACE=$OUTPUT_PATH/loadtest.trace
+
+# The trace is generated once, with a fixed seed, so every run replays the
+# same games in the same order.
+if [ ! -f "$TRACE" ]; then
+  ./$OUTPUT_PATH/selfplay --games 300 --threads 1 --strategy entropy \
+    --typo-rate 0.05 --seed 1 --trace "$TRACE.games" > /dev/null || exit 1
+  awk '{ print }
+       $2 == "/new_game" { print $1 " /game" }
+       $2 == "/enter_pressed" && NR % 2 == 0 { print $1 " /hint" }
+       $2 == "/new_game" && $1 % 10 == 0 {
+         print $1 " /stats"; print $1 " /leaderboard"
+       }' "$TRACE.games" > "$TRACE"
+  rm -f "$TRACE.games"
+fi
+
+STATE=$(mktemp -d)
+trap 'rm -rf "$STATE"' EXIT
+HURDLE_PORT=$PORT HURDLE_RATE_LIMIT=0 \
+  HURDLE_HANDOFF_SOCKET=$STATE/handoff.sock \
+  HURDLE_HANDOFF_FILE=$STATE/sessions.txt \
+  "$SERVER" > "$STATE/server.log" 2>&1 &
+PID=$!
+# The load starts once /ready answers 200, so the warmup is not measured.
+for attempt in $(seq 300); do
+  (exec 3<> "/dev/tcp/127.0.0.1/$PORT" &&
+    printf "GET /ready HTTP/1.0\r\n\r\n" >&3 &&
+    head -n 1 <&3 | grep -q " 200 ") 2> /dev/null && break
+  if ! kill -0 $PID 2> /dev/null; then
+    echo "$SERVER exited on startup:"
+    cat "$STATE/server.log"
+    exit 1
+  fi
+  sleep 0.2
+done
+
+./$OUTPUT_PATH/loadgen --port "$PORT" --threads 2 --duration "$DURATION" \
+  --trace "$TRACE" --seed 1 --json "$JSON"
+STATUS=$?
+kill -TERM $PID
+wait $PID
+exit $STATUS
@@ -0,0 +1,287 @@
+#include <arpa/inet.h>
+#include <netdb.h>
+#include <netinet/in.h>
+#include <netinet/tcp.h>
+#include <sys/socket.h>
+#include <unistd.h>
+
+#include <algorithm>
+#include <cmath>
+#include <cstdint>
+#include <cstdio>
+#include <cstdlib>
+#include <cstring>
+#include <sstream>
+#include <string>
+#include <vector>
+
+#ifndef HTTPCLIENT_H
+#define HTTPCLIENT_H
+
+// The HTTP client and latency histogram of the load generator, shared with
+// the replay tool.
+
+// HdrHistogram keeps counts of values from 1 to `highest` with three
+// significant digits of precision, in a log-linear array of buckets: each
+// power of two range is split into 1024 linear sub-buckets.
+class HdrHistogram {
+ public:
+  explicit HdrHistogram(int64_t highest = int64_t{3600} * 1000 * 1000) {
+    int buckets = 1;
+    while ((kSubBuckets << (buckets - 1)) <= highest) {
+      buckets++;
+    }
+    counts_.assign((buckets + 1) * kHalfSubBuckets, 0);
+    highest_ = highest;
+  }
+
+  void Record(int64_t value) {
+    value = std::clamp<int64_t>(value, 0, highest_);
+    counts_[Index(value)]++;
+    total_++;
+    max_ = std::max(max_, value);
+    sum_ += value;
+  }
+
+  // Records `value`, and if it exceeds `expected_interval`, the values that
+  // requests sent every `expected_interval` would have seen while this one
+  // was stalled.
+  void RecordCorrected(int64_t value, int64_t expected_interval) {
+    Record(value);
+    if (expected_interval <= 0) {
+      return;
+    }
+    for (int64_t missing = value - expected_interval;
+         missing >= expected_interval; missing -= expected_interval) {
+      Record(missing);
+    }
+  }
+
+  void Add(const HdrHistogram& other) {
+    for (size_t i = 0; i < counts_.size() && i < other.counts_.size(); i++) {
+      counts_[i] += other.counts_[i];
+    }
+    total_ += other.total_;
+    max_ = std::max(max_, other.max_);
+    sum_ += other.sum_;
+  }
+
+  // Returns the highest value equivalent to the value at `percentile`, from
+  // 0 to 100.
+  int64_t ValueAtPercentile(double percentile) const {
+    if (total_ == 0) {
+      return 0;
+    }
+    const uint64_t target = std::max<uint64_t>(
+        1, static_cast<uint64_t>(std::ceil(percentile / 100 * total_)));
+    uint64_t seen = 0;
+    for (size_t i = 0; i < counts_.size(); i++) {
+      seen += counts_[i];
+      if (seen >= target) {
+        return std::min(HighestEquivalent(i), max_);
+      }
+    }
+    return max_;
+  }
+
+  uint64_t Count() const { return total_; }
+  int64_t Max() const { return max_; }
+  double Mean() const { return total_ == 0 ? 0 : sum_ / total_; }
+
+ private:
+  static constexpr int kHalfSubBucketsMagnitude = 10;
+  static constexpr int64_t kHalfSubBuckets = 1 << kHalfSubBucketsMagnitude;
+  static constexpr int64_t kSubBuckets = kHalfSubBuckets * 2;
+
+  std::vector<uint64_t> counts_;
+  int64_t highest_ = 0;
+  uint64_t total_ = 0;
+  int64_t max_ = 0;
+  double sum_ = 0;
+
+  static size_t Index(int64_t value) {
+    const int magnitude =
+        64 - __builtin_clzll(static_cast<uint64_t>(value) | (kSubBuckets - 1));
+    const int bucket = magnitude - (kHalfSubBucketsMagnitude + 1);
+    const int64_t sub_bucket = value >> bucket;
+    return ((bucket + 1) << kHalfSubBucketsMagnitude) +
+           (sub_bucket - kHalfSubBuckets);
+  }
+
+  static int64_t HighestEquivalent(size_t index) {
+    int bucket = static_cast<int>(index >> kHalfSubBucketsMagnitude) - 1;
+    int64_t sub_bucket = (index & (kHalfSubBuckets - 1)) + kHalfSubBuckets;
+    if (bucket < 0) {
+      sub_bucket -= kHalfSubBuckets;
+      bucket = 0;
+    }
+    return (sub_bucket << bucket) + (int64_t{1} << bucket) - 1;
+  }
+};
+
+struct Response {
+  int status = 0;
+  // The session header, if the response carried one.
+  std::string token;
+  std::string body;
+};
+
+// Connection sends requests over one keep-alive HTTP/1.1 connection,
+// reconnecting when the server closes it.
+class Connection {
+ public:
+  explicit Connection(const sockaddr_in& address) : address_(address) {}
+  ~Connection() { Close(); }
+
+  // Sends a GET for `path` in the session `token`, if any, and reads the
+  // whole response. Returns false on a network error or a malformed
+  // response.
+  bool Get(const std::string& path, const std::string& token,
+           Response* response) {
+    return Send("GET", path,
+                token.empty() ? "" : "X-Hurdle-Game-ID: " + token + "\r\n",
+                response);
+  }
+
+  // Sends a `method` request for `path` with `headers`, each followed by
+  // "\r\n", and reads the whole response.
+  bool Send(const std::string& method, const std::string& path,
+            const std::string& headers, Response* response) {
+    if (fd_ < 0 && !Open()) {
+      return false;
+    }
+    std::string request =
+        method + " " + path + " HTTP/1.1\r\nHost: localhost\r\n";
+    request += headers;
+    request += "\r\n";
+    if (!SendAll(request) || !ReadResponse(response)) {
+      Close();
+      return false;
+    }
+    return true;
+  }
+
+  uint64_t Reconnects() const { return connects_ > 0 ? connects_ - 1 : 0; }
+
+ private:
+  sockaddr_in address_;
+  int fd_ = -1;
+  std::string buffer_;
+  uint64_t connects_ = 0;
+
+  bool Open() {
+    fd_ = socket(AF_INET, SOCK_STREAM, 0);
+    if (fd_ < 0) {
+      return false;
+    }
+    int one = 1;
+    setsockopt(fd_, IPPROTO_TCP, TCP_NODELAY, &one, sizeof(one));
+    timeval timeout{5, 0};
+    setsockopt(fd_, SOL_SOCKET, SO_RCVTIMEO, &timeout, sizeof(timeout));
+    if (connect(fd_, reinterpret_cast<const sockaddr*>(&address_),
+                sizeof(address_)) != 0) {
+      Close();
+      return false;
+    }
+    buffer_.clear();
+    connects_++;
+    return true;
+  }
+
+  void Close() {
+    if (fd_ >= 0) {
+      close(fd_);
+      fd_ = -1;
+    }
+  }
+
+  bool SendAll(const std::string& data) {
+    size_t sent = 0;
+    while (sent < data.size()) {
+      ssize_t n = send(fd_, data.data() + sent, data.size() - sent,
+                       MSG_NOSIGNAL);
+      if (n <= 0) {
+        return false;
+      }
+      sent += n;
+    }
+    return true;
+  }
+
+  bool Fill() {
+    char chunk[16384];
+    ssize_t n = recv(fd_, chunk, sizeof(chunk), 0);
+    if (n <= 0) {
+      return false;
+    }
+    buffer_.append(chunk, n);
+    return true;
+  }
+
+  bool ReadResponse(Response* response) {
+    size_t header_end;
+    while ((header_end = buffer_.find("\r\n\r\n")) == std::string::npos) {
+      if (!Fill()) {
+        return false;
+      }
+    }
+    std::istringstream headers(buffer_.substr(0, header_end));
+    std::string line;
+    std::getline(headers, line);
+    if (std::sscanf(line.c_str(), "HTTP/%*d.%*d %d", &response->status) != 1) {
+      return false;
+    }
+    size_t content_length = 0;
+    bool close_after = false;
+    response->token.clear();
+    while (std::getline(headers, line)) {
+      const size_t colon = line.find(':');
+      if (colon == std::string::npos) {
+        continue;
+      }
+      std::string name = line.substr(0, colon);
+      std::transform(name.begin(), name.end(), name.begin(), ::tolower);
+      std::string value = line.substr(colon + 1);
+      value.erase(0, value.find_first_not_of(' '));
+      value.erase(value.find_last_not_of("\r ") + 1);
+      if (name == "content-length") {
+        content_length = std::strtoul(value.c_str(), nullptr, 10);
+      } else if (name == "connection") {
+        close_after = value == "close";
+      } else if (name == "x-hurdle-game-id") {
+        response->token = value;
+      }
+    }
+    const size_t body_start = header_end + 4;
+    while (buffer_.size() < body_start + content_length) {
+      if (!Fill()) {
+        return false;
+      }
+    }
+    response->body = buffer_.substr(body_start, content_length);
+    buffer_.erase(0, body_start + content_length);
+    if (close_after) {
+      Close();
+    }
+    return true;
+  }
+};
+
+// Resolves `host`, a name or an IPv4 address, into `address`.
+inline bool ResolveAddress(const std::string& host, int port,
+                           sockaddr_in* address) {
+  *address = sockaddr_in{};
+  address->sin_family = AF_INET;
+  address->sin_port = htons(port);
+  if (inet_pton(AF_INET, host.c_str(), &address->sin_addr) == 1) {
+    return true;
+  }
+  hostent* entry = gethostbyname(host.c_str());
+  if (entry == nullptr || entry->h_addrtype != AF_INET) {
+    return false;
+  }
+  std::memcpy(&address->sin_addr, entry->h_addr_list[0], entry->h_length);
+  return true;
+}
+
+#endif  // HTTPCLIENT_H
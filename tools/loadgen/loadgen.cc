@@ -0,0 +1,396 @@
+// Load generator for the Hurdle server. Every thread keeps one keep-alive
+// connection and plays as a simulated player: it creates a session, types
+// random valid guesses letter by letter, submits them, and starts a new game
+// once the game ends. Alternatively, --trace replays the requests recorded by
+// selfplay --trace.
+//
+// Usage: loadgen [--host H] [--port P] [--threads N] [--duration S]
+//                [--rate R] [--expected-interval-us U] [--trace FILE]
+//                [--words FILE] [--seed N] [--json FILE]
+//
+// Without --rate, the load is closed-loop: each thread sends its next
+// request as soon as the last one is answered. With --rate, it is open-loop:
+// requests are scheduled at R per second in total, and their latency is
+// measured from the time they were scheduled, so a stalled server is charged
+// for every request it delayed (coordinated omission). In closed-loop mode,
+// --expected-interval-us applies the same correction by backfilling the
+// requests a stall prevented, as HdrHistogram's recordValueWithExpectedInterval
+// does.
+//
+// Start the server with HURDLE_RATE_LIMIT=0, or every thread past the first
+// few is rate limited as coming from the same client.
+
+#include <algorithm>
+#include <atomic>
+#include <chrono>
+#include <cmath>
+#include <cstdio>
+#include <cstdlib>
+#include <cstring>
+#include <fstream>
+#include <iostream>
+#include <map>
+#include <memory>
+#include <sstream>
+#include <string>
+#include <thread>
+#include <vector>
+
+#include "../../random.h"
+#include "httpclient.h"
+
+namespace {
+
+typedef std::chrono::steady_clock Clock;
+
+struct Options {
+  std::string host = "127.0.0.1";
+  int port = 18080;
+  size_t threads = 8;
+  double duration = 10;
+  // Total requests per second in open-loop mode, 0 for closed-loop.
+  double rate = 0;
+  int64_t expected_interval_us = 0;
+  std::string trace_file;
+  std::string words_file = "data/valid_guesses.txt";
+  uint64_t seed = 1;
+  std::string json_file;
+};
+
+// A Script produces the requests of one thread.
+class Script {
+ public:
+  virtual ~Script() = default;
+  // Returns the path of the next request.
+  virtual std::string Next() = 0;
+  // Called with the response to the last request, or null on a network
+  // error.
+  virtual void Done(const Response* response) = 0;
+  uint64_t games = 0;
+};
+
+// SimulatedPlayer plays games with random valid guesses, starting a new
+// game when one is won or lost.
+class SimulatedPlayer : public Script {
+ public:
+  explicit SimulatedPlayer(const std::vector<std::string>& words)
+      : words_(words) {}
+
+  std::string Next() override {
+    if (new_game_) {
+      last_ = kNewGame;
+      return "/new_game";
+    }
+    if (typed_ < guess_.size()) {
+      last_ = kKey;
+      return std::string("/wordle_key_pressed/") + guess_[typed_++];
+    }
+    last_ = kEnter;
+    return "/enter_pressed";
+  }
+
+  void Done(const Response* response) override {
+    if (response == nullptr || response->status != 200) {
+      // Start over from a known state.
+      new_game_ = true;
+      return;
+    }
+    if (last_ == kNewGame) {
+      new_game_ = false;
+      NextGuess();
+    } else if (last_ == kEnter) {
+      if (response->body.find("\"gameStatus\":\"active\"") ==
+          std::string::npos) {
+        games++;
+        new_game_ = true;
+      } else {
+        NextGuess();
+      }
+    }
+  }
+
+ private:
+  enum Request { kNewGame, kKey, kEnter };
+  const std::vector<std::string>& words_;
+  bool new_game_ = true;
+  Request last_ = kNewGame;
+  std::string guess_;
+  size_t typed_ = 0;
+
+  void NextGuess() {
+    guess_ = words_[RandomBelow(words_.size())];
+    typed_ = 0;
+  }
+};
+
+// TraceReplay sends the paths of a trace in order, over and over.
+class TraceReplay : public Script {
+ public:
+  explicit TraceReplay(std::vector<std::string> paths)
+      : paths_(std::move(paths)) {}
+
+  std::string Next() override {
+    const std::string& path = paths_[next_];
+    next_ = (next_ + 1) % paths_.size();
+    if (path == "/new_game") {
+      games++;
+    }
+    return path;
+  }
+
+  void Done(const Response*) override {}
+
+ private:
+  std::vector<std::string> paths_;
+  size_t next_ = 0;
+};
+
+struct ThreadResult {
+  // Latency from the time a request was scheduled, in microseconds. Equal
+  // to service_us in closed-loop mode, unless corrected.
+  HdrHistogram latency_us;
+  // Time from sending a request to reading its response.
+  HdrHistogram service_us;
+  std::map<int, uint64_t> statuses;
+  uint64_t errors = 0;
+  uint64_t games = 0;
+  uint64_t reconnects = 0;
+};
+
+void RunThread(const Options& options, const sockaddr_in& address,
+               Script& script, size_t thread, ThreadResult* result) {
+  SeedThreadRandom(MixBits(options.seed + thread));
+  Connection connection(address);
+  std::string token;
+  const auto start = Clock::now();
+  const auto end = start + std::chrono::duration_cast<Clock::duration>(
+                               std::chrono::duration<double>(options.duration));
+  // In open-loop mode, the threads' schedules are staggered evenly.
+  const auto interval =
+      options.rate > 0
+          ? std::chrono::duration_cast<Clock::duration>(
+                std::chrono::duration<double>(options.threads / options.rate))
+          : Clock::duration::zero();
+  auto scheduled = start + interval * thread / options.threads;
+
+  Response response;
+  while (true) {
+    if (options.rate > 0) {
+      std::this_thread::sleep_until(scheduled);
+    }
+    const auto sent = Clock::now();
+    if (sent >= end) {
+      break;
+    }
+    const std::string path = script.Next();
+    const bool ok = connection.Get(path, token, &response);
+    const auto done = Clock::now();
+    auto micros = [](Clock::duration d) {
+      return std::chrono::duration_cast<std::chrono::microseconds>(d).count();
+    };
+    result->service_us.Record(micros(done - sent));
+    if (options.rate > 0) {
+      result->latency_us.Record(micros(done - scheduled));
+      scheduled += interval;
+    } else {
+      result->latency_us.RecordCorrected(micros(done - sent),
+                                         options.expected_interval_us);
+    }
+    if (!ok) {
+      result->errors++;
+      script.Done(nullptr);
+      continue;
+    }
+    result->statuses[response.status]++;
+    if (!response.token.empty()) {
+      token = response.token;
+    }
+    script.Done(&response);
+  }
+  result->games = script.games;
+  result->reconnects = connection.Reconnects();
+}
+
+bool ParseOptions(int argc, char** argv, Options* options) {
+  for (int i = 1; i < argc; i++) {
+    const std::string arg = argv[i];
+    if (i + 1 >= argc) {
+      return false;
+    }
+    const char* value = argv[++i];
+    if (arg == "--host") {
+      options->host = value;
+    } else if (arg == "--port") {
+      options->port = std::atoi(value);
+    } else if (arg == "--threads") {
+      options->threads = std::strtoul(value, nullptr, 10);
+    } else if (arg == "--duration") {
+      options->duration = std::strtod(value, nullptr);
+    } else if (arg == "--rate") {
+      options->rate = std::strtod(value, nullptr);
+    } else if (arg == "--expected-interval-us") {
+      options->expected_interval_us = std::strtoll(value, nullptr, 10);
+    } else if (arg == "--trace") {
+      options->trace_file = value;
+    } else if (arg == "--words") {
+      options->words_file = value;
+    } else if (arg == "--seed") {
+      options->seed = std::strtoull(value, nullptr, 10);
+    } else if (arg == "--json") {
+      options->json_file = value;
+    } else {
+      return false;
+    }
+  }
+  return options->threads > 0 && options->duration > 0;
+}
+
+// Splits the trace written by selfplay --trace into one list of paths per
+// thread, dealing its games out round robin.
+bool LoadTrace(const std::string& file, size_t threads,
+               std::vector<std::vector<std::string>>* paths) {
+  std::ifstream in(file);
+  if (!in) {
+    return false;
+  }
+  paths->assign(threads, {});
+  std::map<std::string, size_t> game_threads;
+  std::string game;
+  std::string path;
+  while (in >> game >> path) {
+    auto it = game_threads.emplace(game, game_threads.size() % threads).first;
+    (*paths)[it->second].push_back(path);
+  }
+  return std::all_of(paths->begin(), paths->end(),
+                     [](const auto& p) { return !p.empty(); });
+}
+
+void PrintHistogram(const char* name, const HdrHistogram& histogram) {
+  std::printf("%-8s p50 %8.3f  p90 %8.3f  p99 %8.3f  p99.9 %8.3f  max %8.3f"
+              "  mean %8.3f ms\n",
+              name, histogram.ValueAtPercentile(50) / 1e3,
+              histogram.ValueAtPercentile(90) / 1e3,
+              histogram.ValueAtPercentile(99) / 1e3,
+              histogram.ValueAtPercentile(99.9) / 1e3, histogram.Max() / 1e3,
+              histogram.Mean() / 1e3);
+}
+
+std::string HistogramJson(const HdrHistogram& histogram) {
+  std::ostringstream out;
+  out << "{\"p50\": " << histogram.ValueAtPercentile(50)
+      << ", \"p90\": " << histogram.ValueAtPercentile(90)
+      << ", \"p99\": " << histogram.ValueAtPercentile(99)
+      << ", \"p999\": " << histogram.ValueAtPercentile(99.9)
+      << ", \"max\": " << histogram.Max() << ", \"mean\": " << histogram.Mean()
+      << "}";
+  return out.str();
+}
+
+}  // namespace
+
+int main(int argc, char** argv) {
+  Options options;
+  if (!ParseOptions(argc, argv, &options)) {
+    std::cerr << "Usage: " << argv[0]
+              << " [--host H] [--port P] [--threads N] [--duration S]"
+                 " [--rate R] [--expected-interval-us U] [--trace FILE]"
+                 " [--words FILE] [--seed N] [--json FILE]"
+              << std::endl;
+    return 2;
+  }
+
+  sockaddr_in address;
+  if (!ResolveAddress(options.host, options.port, &address)) {
+    std::cerr << "Unknown host " << options.host << std::endl;
+    return 1;
+  }
+
+  std::vector<std::unique_ptr<Script>> scripts;
+  std::vector<std::string> words;
+  if (!options.trace_file.empty()) {
+    std::vector<std::vector<std::string>> paths;
+    if (!LoadTrace(options.trace_file, options.threads, &paths)) {
+      std::cerr << "Could not read at least one game per thread from "
+                << options.trace_file << std::endl;
+      return 1;
+    }
+    for (auto& thread_paths : paths) {
+      scripts.push_back(std::make_unique<TraceReplay>(std::move(thread_paths)));
+    }
+  } else {
+    std::ifstream in(options.words_file);
+    std::string word;
+    while (in >> word) {
+      words.push_back(word);
+    }
+    if (words.empty()) {
+      std::cerr << "Could not read any words from " << options.words_file
+                << std::endl;
+      return 1;
+    }
+    for (size_t i = 0; i < options.threads; i++) {
+      scripts.push_back(std::make_unique<SimulatedPlayer>(words));
+    }
+  }
+
+  std::vector<ThreadResult> results(options.threads);
+  std::vector<std::thread> threads;
+  const auto start = Clock::now();
+  for (size_t i = 0; i < options.threads; i++) {
+    threads.emplace_back(RunThread, std::cref(options), std::cref(address),
+                         std::ref(*scripts[i]), i, &results[i]);
+  }
+  for (std::thread& thread : threads) {
+    thread.join();
+  }
+  const double seconds =
+      std::chrono::duration<double>(Clock::now() - start).count();
+
+  ThreadResult total;
+  for (const ThreadResult& result : results) {
+    total.latency_us.Add(result.latency_us);
+    total.service_us.Add(result.service_us);
+    for (const auto& [status, count] : result.statuses) {
+      total.statuses[status] += count;
+    }
+    total.errors += result.errors;
+    total.games += result.games;
+    total.reconnects += result.reconnects;
+  }
+  const uint64_t requests = total.service_us.Count();
+
+  std::printf("%s load, %zu threads, %.1f s\n",
+              options.rate > 0 ? "open-loop" : "closed-loop", options.threads,
+              seconds);
+  std::printf("requests %llu (%.1f/s), games %llu, network errors %llu,"
+              " reconnects %llu\n",
+              static_cast<unsigned long long>(requests), requests / seconds,
+              static_cast<unsigned long long>(total.games),
+              static_cast<unsigned long long>(total.errors),
+              static_cast<unsigned long long>(total.reconnects));
+  std::printf("statuses");
+  for (const auto& [status, count] : total.statuses) {
+    std::printf(" %d:%llu", status, static_cast<unsigned long long>(count));
+  }
+  std::printf("\n");
+  PrintHistogram("latency", total.latency_us);
+  PrintHistogram("service", total.service_us);
+
+  if (!options.json_file.empty()) {
+    std::ofstream out(options.json_file);
+    out << "{\"mode\": \"" << (options.rate > 0 ? "open" : "closed")
+        << "\", \"threads\": " << options.threads
+        << ", \"seconds\": " << seconds << ", \"requests\": " << requests
+        << ", \"throughput\": " << requests / seconds
+        << ", \"games\": " << total.games << ", \"errors\": " << total.errors
+        << ", \"statuses\": {";
+    const char* separator = "";
+    for (const auto& [status, count] : total.statuses) {
+      out << separator << "\"" << status << "\": " << count;
+      separator = ", ";
+    }
+    out << "}, \"latency_us\": " << HistogramJson(total.latency_us)
+        << ", \"service_us\": " << HistogramJson(total.service_us) << "}\n";
+  }
+  return total.errors == requests ? 1 : 0;
+}
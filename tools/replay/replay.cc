@@ -0,0 +1,366 @@
+// Replays a capture recorded by a server run with HURDLE_CAPTURE_FILE, and
+// checks that every response matches the captured one.
+//
+// Usage: replay [--target in-process|HOST:PORT] [--speed S]
+//               [--unverified ROUTES] [--daily-key K] [--json FILE] CAPTURE
+//
+// In-process, the requests go through a fresh HurdleServer, middlewares
+// included, without any sockets. Against HOST:PORT they are sent over HTTP
+// to a server started with HURDLE_REPLAY_SEEDS=1 and HURDLE_RATE_LIMIT=0,
+// and with the same HURDLE_DAILY_KEY as the captured one. Each replayed
+// request carries its captured random seed, so the replay draws the same
+// hurdles, and the session tokens the replay gets are substituted for the
+// captured ones.
+//
+// --speed scales time: 1 (the default) sends the requests at their captured
+// arrival times, 10 ten times faster, and 0 as fast as possible. Latency is
+// measured from the time a request was due, so a server that falls behind
+// is charged for the wait, as well as from the time it was sent. Responses
+// that depend on timing rather than on the requests (by default those of
+// /stats, /leaderboard and /hint, whose search is time-bounded) are not
+// verified. Responses of /daily without ?date= only match on the captured
+// day.
+//
+// Exits with 1 if a verified response differs from the captured one.
+
+#include <algorithm>
+#include <chrono>
+#include <cstdio>
+#include <cstdlib>
+#include <fstream>
+#include <iostream>
+#include <map>
+#include <sstream>
+#include <string>
+#include <thread>
+#include <unordered_map>
+#include <vector>
+
+#include "../../hurdleserver.h"
+#include "../../hurdlewords.h"
+#include "../../server_utils/capture.h"
+#include "../loadgen/httpclient.h"
+
+namespace {
+
+typedef std::chrono::steady_clock Clock;
+
+const char* kSessionHeader = "X-Hurdle-Game-ID";
+
+struct Options {
+  // "in-process", or the HOST:PORT of a server.
+  std::string target = "in-process";
+  double speed = 1;
+  std::vector<std::string> unverified = {"/stats", "/leaderboard", "/hint"};
+  uint64_t daily_key = 0x6875726466c6521;
+  std::string json_file;
+  std::string capture_file;
+};
+
+// The response to a replayed request, as far as it is compared.
+struct Replayed {
+  bool ok = false;
+  int status = 0;
+  uint64_t body_hash = 0;
+  std::string session;
+};
+
+// A replayed request's headers, the session one already substituted.
+struct Headers {
+  std::string session;
+  std::string player;
+  std::string accept_encoding;
+  std::string if_none_match;
+  uint64_t seed = 0;
+};
+
+// Target sends replayed requests to a server.
+class Target {
+ public:
+  virtual ~Target() = default;
+  virtual Replayed Send(const CapturedRequest& request,
+                        const Headers& headers) = 0;
+};
+
+// InProcessTarget runs requests through a HurdleServer of its own.
+class InProcessTarget : public Target {
+ public:
+  explicit InProcessTarget(uint64_t daily_key)
+      : hurdlewords_("data/valid_hurdles.txt", "data/valid_guesses.txt"),
+        server_(hurdlewords_, daily_key, startup_) {
+    server_.DisableClientRateLimits();
+    server_.app.get_middleware<CaptureMiddleware>().accept_replay_seeds = true;
+    server_.app.validate();
+  }
+
+  Replayed Send(const CapturedRequest& captured,
+                const Headers& headers) override {
+    crow::request req;
+    req.method = captured.method;
+    req.raw_url = captured.url;
+    req.url = captured.url.substr(0, captured.url.find('?'));
+    req.url_params = crow::query_string(captured.url);
+    req.remote_ip_address = "127.0.0.1";
+    auto add = [&](const std::string& name, const std::string& value) {
+      if (!value.empty()) {
+        req.headers.emplace(name, value);
+      }
+    };
+    add(kSessionHeader, headers.session);
+    add("X-Hurdle-Player-ID", headers.player);
+    add("Accept-Encoding", headers.accept_encoding);
+    add("If-None-Match", headers.if_none_match);
+    add("X-Hurdle-Replay-Seed", std::to_string(headers.seed));
+    crow::response res;
+    server_.app.handle_in_process(req, res);
+    Replayed replayed;
+    replayed.ok = true;
+    replayed.status = res.code;
+    replayed.body_hash = capture::HashBody(res.body);
+    replayed.session = res.get_header_value(kSessionHeader);
+    return replayed;
+  }
+
+ private:
+  HurdleWords hurdlewords_;
+  StartupTimer startup_;
+  HurdleServer server_;
+};
+
+// HttpTarget sends requests over one keep-alive connection.
+class HttpTarget : public Target {
+ public:
+  explicit HttpTarget(const sockaddr_in& address) : connection_(address) {}
+
+  Replayed Send(const CapturedRequest& captured,
+                const Headers& headers) override {
+    std::string lines;
+    auto add = [&](const std::string& name, const std::string& value) {
+      if (!value.empty()) {
+        lines += name + ": " + value + "\r\n";
+      }
+    };
+    add(kSessionHeader, headers.session);
+    add("X-Hurdle-Player-ID", headers.player);
+    add("Accept-Encoding", headers.accept_encoding);
+    add("If-None-Match", headers.if_none_match);
+    add("X-Hurdle-Replay-Seed", std::to_string(headers.seed));
+    Response response;
+    Replayed replayed;
+    replayed.ok = connection_.Send(crow::method_name(captured.method),
+                                   captured.url, lines, &response);
+    replayed.status = response.status;
+    replayed.body_hash = capture::HashBody(response.body);
+    replayed.session = response.token;
+    return replayed;
+  }
+
+ private:
+  Connection connection_;
+};
+
+// Returns the route of `url` as MetricsMiddleware names it: its first path
+// segment.
+std::string Route(const std::string& url) {
+  const std::string path = url.substr(0, url.find('?'));
+  return path.substr(0, path.find('/', 1));
+}
+
+struct RouteResult {
+  uint64_t requests = 0;
+  uint64_t mismatches = 0;
+  bool verified = true;
+  HdrHistogram service_us;
+};
+
+bool ParseOptions(int argc, char** argv, Options* options) {
+  int i = 1;
+  for (; i + 1 < argc; i += 2) {
+    const std::string arg = argv[i];
+    const char* value = argv[i + 1];
+    if (arg == "--target") {
+      options->target = value;
+    } else if (arg == "--speed") {
+      options->speed = std::strtod(value, nullptr);
+    } else if (arg == "--unverified") {
+      options->unverified.clear();
+      std::istringstream routes(value);
+      std::string route;
+      while (std::getline(routes, route, ',')) {
+        options->unverified.push_back(route);
+      }
+    } else if (arg == "--daily-key") {
+      options->daily_key = std::strtoull(value, nullptr, 0);
+    } else if (arg == "--json") {
+      options->json_file = value;
+    } else {
+      return false;
+    }
+  }
+  if (i + 1 != argc) {
+    return false;
+  }
+  options->capture_file = argv[i];
+  return options->speed >= 0;
+}
+
+void PrintHistogram(const std::string& name, const HdrHistogram& histogram) {
+  std::printf("%-20s %8llu  p50 %8.3f  p99 %8.3f  max %8.3f ms\n",
+              name.c_str(),
+              static_cast<unsigned long long>(histogram.Count()),
+              histogram.ValueAtPercentile(50) / 1e3,
+              histogram.ValueAtPercentile(99) / 1e3, histogram.Max() / 1e3);
+}
+
+}  // namespace
+
+int main(int argc, char** argv) {
+  Options options;
+  if (!ParseOptions(argc, argv, &options)) {
+    std::cerr << "Usage: " << argv[0]
+              << " [--target in-process|HOST:PORT] [--speed S]"
+                 " [--unverified ROUTES] [--daily-key K] [--json FILE]"
+                 " CAPTURE"
+              << std::endl;
+    return 2;
+  }
+  std::vector<CapturedRequest> requests;
+  if (!capture::ReadFile(options.capture_file, &requests)) {
+    if (requests.empty()) {
+      std::cerr << "Could not read a capture from " << options.capture_file
+                << std::endl;
+      return 1;
+    }
+    std::cerr << "The capture is truncated, replaying its first "
+              << requests.size() << " requests" << std::endl;
+  }
+
+  std::unique_ptr<Target> target;
+  if (options.target == "in-process") {
+    target = std::make_unique<InProcessTarget>(options.daily_key);
+  } else {
+    const size_t colon = options.target.rfind(':');
+    sockaddr_in address;
+    if (colon == std::string::npos ||
+        !ResolveAddress(options.target.substr(0, colon),
+                        std::atoi(options.target.c_str() + colon + 1),
+                        &address)) {
+      std::cerr << "Expected --target HOST:PORT, not " << options.target
+                << std::endl;
+      return 2;
+    }
+    target = std::make_unique<HttpTarget>(address);
+  }
+
+  // Captured session tokens, by the tokens the replay got in their place.
+  std::unordered_map<std::string, std::string> tokens;
+  std::map<std::string, RouteResult> routes;
+  HdrHistogram latency_us;
+  HdrHistogram service_us;
+  uint64_t errors = 0;
+  auto micros = [](Clock::duration d) {
+    return std::chrono::duration_cast<std::chrono::microseconds>(d).count();
+  };
+  const auto start = Clock::now();
+  for (const CapturedRequest& request : requests) {
+    auto due = start;
+    if (options.speed > 0) {
+      due += std::chrono::duration_cast<Clock::duration>(
+          std::chrono::nanoseconds(request.arrival_ns) / options.speed);
+      std::this_thread::sleep_until(due);
+    }
+
+    Headers headers;
+    headers.session = request.session;
+    if (auto it = tokens.find(request.session); it != tokens.end()) {
+      headers.session = it->second;
+    }
+    headers.player = request.player;
+    headers.accept_encoding = request.accept_encoding;
+    headers.if_none_match = request.if_none_match;
+    if (!request.session.empty() && headers.session != request.session) {
+      for (size_t at = headers.if_none_match.find(request.session);
+           at != std::string::npos;
+           at = headers.if_none_match.find(request.session,
+                                           at + headers.session.size())) {
+        headers.if_none_match.replace(at, request.session.size(),
+                                      headers.session);
+      }
+    }
+    headers.seed = request.seed;
+
+    const auto sent = Clock::now();
+    const Replayed replayed = target->Send(request, headers);
+    const auto done = Clock::now();
+    if (options.speed == 0) {
+      due = sent;
+    }
+    latency_us.Record(micros(done - due));
+    service_us.Record(micros(done - sent));
+
+    const std::string route = Route(request.url);
+    RouteResult& result = routes[route];
+    result.requests++;
+    result.service_us.Record(micros(done - sent));
+    result.verified =
+        std::find(options.unverified.begin(), options.unverified.end(),
+                  route) == options.unverified.end();
+    if (!replayed.ok) {
+      errors++;
+      continue;
+    }
+    const std::string& captured_session = request.response_session.empty()
+                                              ? request.session
+                                              : request.response_session;
+    if (!captured_session.empty() && !replayed.session.empty()) {
+      tokens[captured_session] = replayed.session;
+    }
+    if (result.verified && (replayed.status != request.status ||
+                            replayed.body_hash != request.body_hash)) {
+      if (result.mismatches == 0) {
+        std::fprintf(stderr, "First mismatch on %s: status %d, captured %d\n",
+                     request.url.c_str(), replayed.status, request.status);
+      }
+      result.mismatches++;
+    }
+  }
+  const double seconds =
+      std::chrono::duration<double>(Clock::now() - start).count();
+  const double captured_seconds =
+      requests.empty() ? 0 : requests.back().arrival_ns / 1e9;
+
+  uint64_t mismatches = 0;
+  std::printf("replayed %zu requests in %.2f s (captured over %.2f s) to %s,"
+              " network errors %llu\n",
+              requests.size(), seconds, captured_seconds,
+              options.target.c_str(), static_cast<unsigned long long>(errors));
+  std::printf("%-20s %8s  %s\n", "route", "requests", "mismatches");
+  for (const auto& [route, result] : routes) {
+    mismatches += result.mismatches;
+    std::printf("%-20s %8llu  %s\n", route.c_str(),
+                static_cast<unsigned long long>(result.requests),
+                result.verified
+                    ? std::to_string(result.mismatches).c_str()
+                    : "unverified");
+  }
+  std::printf("\nservice time by route\n");
+  for (const auto& [route, result] : routes) {
+    PrintHistogram(route, result.service_us);
+  }
+  PrintHistogram("all, from send", service_us);
+  PrintHistogram("all, from due time", latency_us);
+
+  if (!options.json_file.empty()) {
+    std::ofstream out(options.json_file);
+    out << "{\"target\": \"" << options.target
+        << "\", \"speed\": " << options.speed
+        << ", \"requests\": " << requests.size()
+        << ", \"seconds\": " << seconds << ", \"errors\": " << errors
+        << ", \"mismatches\": " << mismatches
+        << ", \"latency_us\": {\"p50\": " << latency_us.ValueAtPercentile(50)
+        << ", \"p99\": " << latency_us.ValueAtPercentile(99)
+        << ", \"max\": " << latency_us.Max() << "}}\n";
+  }
+
+  return mismatches > 0 || errors > 0 ? 1 : 0;
+}
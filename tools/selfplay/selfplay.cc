@@ -0,0 +1,300 @@
+// Plays simulated Hurdle games against HurdleGame directly, driving it with
+// the same calls the routes make, and reports the engine's throughput.
+//
+// Usage: selfplay [--games N] [--threads N] [--strategy random|entropy|table]
+//                 [--seed N] [--typo-rate R] [--trace FILE]
+//                 [--strategy-file FILE]
+//
+// Strategies:
+//   random   guesses a random hurdle still consistent with the board.
+//   entropy  guesses what /hint suggests, searching every time.
+//   table    follows the strategy table (see make strategy), and searches
+//            like entropy once off the table.
+// With --typo-rate, a player mistypes a letter with that probability and
+// deletes it, so /delete_pressed shows up in the mix. With --trace, every
+// request a player would have sent is written as a line "<game> <path>",
+// which the load tests can replay.
+
+#include <algorithm>
+#include <atomic>
+#include <chrono>
+#include <cstdlib>
+#include <fstream>
+#include <iostream>
+#include <memory>
+#include <mutex>
+#include <string>
+#include <thread>
+#include <vector>
+
+#include "../../hint.h"
+#include "../../hurdle.h"
+#include "../../hurdlewords.h"
+#include "../../random.h"
+#include "../../strategy.h"
+#include "../../threadpool.h"
+
+namespace {
+
+struct Options {
+  uint64_t games = 100000;
+  size_t threads = 0;
+  std::string strategy = "random";
+  uint64_t seed = 1;
+  double typo_rate = 0;
+  std::string trace_file;
+  std::string strategy_file = "data/strategy.bin";
+};
+
+// A Strategy picks the next guess for a board. Every thread has its own
+// instance.
+class Strategy {
+ public:
+  virtual ~Strategy() = default;
+  // Returns the next guess, or an empty string to give up.
+  virtual std::string NextGuess(HurdleGame& game) = 0;
+};
+
+class RandomStrategy : public Strategy {
+ public:
+  explicit RandomStrategy(const HurdleWords& words) : words_(words) {}
+
+  std::string NextGuess(HurdleGame& game) override {
+    const std::vector<uint32_t> candidates = game.Candidates().Indices();
+    if (candidates.empty()) {
+      return "";
+    }
+    return words_.Hurdles()[candidates[RandomBelow(candidates.size())]];
+  }
+
+ private:
+  HurdleWords words_;
+};
+
+// Guesses what /hint would suggest. With a strategy table, boards on the
+// table are looked up instead of searched.
+class HintStrategy : public Strategy {
+ public:
+  explicit HintStrategy(HintEngine& engine) : engine_(engine) {}
+
+  std::string NextGuess(HurdleGame& game) override {
+    return engine_
+        .HintFor(game.SubmittedGuesses(), game.SubmittedColors(),
+                 game.Candidates())
+        .guess;
+  }
+
+ private:
+  HintEngine& engine_;
+};
+
+// Totals of the games played by one chunk, merged at the end.
+struct Totals {
+  uint64_t games = 0;
+  uint64_t wins = 0;
+  uint64_t given_up = 0;
+  uint64_t requests = 0;
+  // guess_counts[i] is the number of games won in i + 1 guesses.
+  uint64_t guess_counts[6] = {};
+
+  void Add(const Totals& other) {
+    games += other.games;
+    wins += other.wins;
+    given_up += other.given_up;
+    requests += other.requests;
+    for (int i = 0; i < 6; i++) {
+      guess_counts[i] += other.guess_counts[i];
+    }
+  }
+};
+
+// Player drives one HurdleGame the way the routes do, rendering the state
+// after every request like GameStateResponse.
+class Player {
+ public:
+  Player(const HurdleWords& words, Strategy& strategy, const Options& options,
+         std::string* trace)
+      : game_(words), strategy_(strategy), options_(options), trace_(trace) {}
+
+  void Play(uint64_t game_id, Totals* totals) {
+    game_id_ = game_id;
+    Request("/new_game", totals);
+    game_.NewHurdle();
+    game_.SerializedHurdleState();
+    while (game_.GetHurdleState().GetStatus() == "active") {
+      const std::string guess = strategy_.NextGuess(game_);
+      if (guess.size() != kWordLength) {
+        totals->given_up++;
+        break;
+      }
+      for (char letter : guess) {
+        if (options_.typo_rate > 0 &&
+            RandomBits() % 1000000 < options_.typo_rate * 1000000) {
+          Type('a' + RandomBelow(26), totals);
+          Request("/delete_pressed", totals);
+          game_.LetterDeleted();
+          game_.SerializedHurdleState();
+        }
+        Type(letter, totals);
+      }
+      Request("/enter_pressed", totals);
+      game_.WordSubmitted();
+      game_.SerializedHurdleState();
+    }
+
+    totals->games++;
+    const HurdleState& state = game_.GetHurdleState();
+    if (state.GetStatus() == "win") {
+      totals->wins++;
+      const size_t guesses = state.GetGuesses().size();
+      if (guesses >= 1 && guesses <= 6) {
+        totals->guess_counts[guesses - 1]++;
+      }
+    }
+  }
+
+ private:
+  HurdleGame game_;
+  Strategy& strategy_;
+  const Options& options_;
+  std::string* trace_;
+  uint64_t game_id_ = 0;
+
+  void Type(char letter, Totals* totals) {
+    Request(std::string("/wordle_key_pressed/") + letter, totals);
+    game_.LetterEntered(letter);
+    game_.SerializedHurdleState();
+  }
+
+  void Request(const std::string& path, Totals* totals) {
+    totals->requests++;
+    if (trace_ != nullptr) {
+      *trace_ += std::to_string(game_id_) + ' ' + path + '\n';
+    }
+  }
+};
+
+bool ParseOptions(int argc, char** argv, Options* options) {
+  for (int i = 1; i < argc; i++) {
+    const std::string arg = argv[i];
+    if (i + 1 >= argc) {
+      return false;
+    }
+    const char* value = argv[++i];
+    if (arg == "--games") {
+      options->games = std::strtoull(value, nullptr, 10);
+    } else if (arg == "--threads") {
+      options->threads = std::strtoul(value, nullptr, 10);
+    } else if (arg == "--strategy") {
+      options->strategy = value;
+    } else if (arg == "--seed") {
+      options->seed = std::strtoull(value, nullptr, 10);
+    } else if (arg == "--typo-rate") {
+      options->typo_rate = std::strtod(value, nullptr);
+    } else if (arg == "--trace") {
+      options->trace_file = value;
+    } else if (arg == "--strategy-file") {
+      options->strategy_file = value;
+    } else {
+      return false;
+    }
+  }
+  return options->strategy == "random" || options->strategy == "entropy" ||
+         options->strategy == "table";
+}
+
+}  // namespace
+
+int main(int argc, char** argv) {
+  Options options;
+  if (!ParseOptions(argc, argv, &options)) {
+    std::cerr << "Usage: " << argv[0]
+              << " [--games N] [--threads N]"
+                 " [--strategy random|entropy|table] [--seed N]"
+                 " [--typo-rate R] [--trace FILE] [--strategy-file FILE]"
+              << std::endl;
+    return 2;
+  }
+
+  HurdleWords words("data/valid_hurdles.txt", "data/valid_guesses.txt");
+  ThreadPool pool(options.threads);
+  HintEngine engine(words, pool);
+  // Self-play wants the same answer every time, not a fast one.
+  engine.budget = std::chrono::hours(1);
+  StrategyTable table;
+  if (options.strategy != "random") {
+    engine.Warm();
+  }
+  if (options.strategy == "table") {
+    if (!table.Open(options.strategy_file, words)) {
+      std::cerr << "Could not open the strategy table "
+                << options.strategy_file << std::endl;
+      return 1;
+    }
+    engine.strategy = &table;
+  }
+
+  std::ofstream trace;
+  if (!options.trace_file.empty()) {
+    trace.open(options.trace_file, std::ios::trunc);
+  }
+  std::mutex mutex;
+  Totals totals;
+
+  // Each chunk seeds its thread's generator from its first game, so a run
+  // with the same seed plays the same games whatever the thread count.
+  constexpr size_t kChunk = 64;
+  const auto start = std::chrono::steady_clock::now();
+  pool.ParallelFor(0, options.games, kChunk, [&](size_t begin, size_t end) {
+    SeedThreadRandom(MixBits(options.seed ^ begin));
+    std::unique_ptr<Strategy> strategy;
+    if (options.strategy == "random") {
+      strategy = std::make_unique<RandomStrategy>(words);
+    } else {
+      strategy = std::make_unique<HintStrategy>(engine);
+    }
+    std::string chunk_trace;
+    Player player(words, *strategy, options,
+                  trace.is_open() ? &chunk_trace : nullptr);
+    Totals chunk_totals;
+    for (size_t game = begin; game < end; game++) {
+      player.Play(game, &chunk_totals);
+    }
+    std::lock_guard<std::mutex> lock(mutex);
+    totals.Add(chunk_totals);
+    if (trace.is_open()) {
+      trace << chunk_trace;
+    }
+  });
+  const double seconds =
+      std::chrono::duration<double>(std::chrono::steady_clock::now() - start)
+          .count();
+
+  uint64_t total_guesses = 0;
+  for (int i = 0; i < 6; i++) {
+    total_guesses += (i + 1) * totals.guess_counts[i];
+  }
+  std::cout << "strategy: " << options.strategy << "\n"
+            << "games: " << totals.games << "\n"
+            << "wins: " << totals.wins << " ("
+            << 100.0 * totals.wins / std::max<uint64_t>(1, totals.games)
+            << "%)\n"
+            << "given up: " << totals.given_up << "\n"
+            << "average guesses per win: "
+            << static_cast<double>(total_guesses) /
+                   std::max<uint64_t>(1, totals.wins)
+            << "\n"
+            << "guess distribution:";
+  for (int i = 0; i < 6; i++) {
+    std::cout << ' ' << totals.guess_counts[i];
+  }
+  std::cout << "\n"
+            << "requests: " << totals.requests << "\n"
+            << "threads: " << pool.Size() << "\n"
+            << "seconds: " << seconds << "\n"
+            << "games/sec: " << totals.games / seconds << "\n"
+            << "games/sec/core: " << totals.games / seconds / pool.Size()
+            << "\n"
+            << "requests/sec: " << totals.requests / seconds << std::endl;
+  return 0;
+}
@@ -5,8 +5,26 @@ UTNAME_HURDLEWORDS		:= unittest_hurdlewords.cc
 UTNAME_ERRORMESSAGE	:= unittest_errormessage.cc
 UTNAME_GAMESTATUS	:= unittest_gamestatus.cc
 UTNAME_GUESSEDWORDS	:= unittest_guessedwords.cc
+UTNAME_HINT	:= unittest_hint.cc
+UTNAME_ALLOCATIONS	:= unittest_allocations.cc
+UTNAME_COMPRESSION	:= unittest_compression.cc
+UTNAME_RATELIMIT	:= unittest_ratelimit.cc
+UTNAME_SERVER	:= unittest_server.cc
+UTNAME_METRICS	:= unittest_metrics.cc
+UTNAME_CAPTURE	:= unittest_capture.cc
+UTNAME_SESSIONS	:= unittest_sessions.cc
 # Flags added to compilation step
 COMPILE_FLAGS		:=
+# Optimization flags of the server's release builds (make build, build_pgo).
+# Frame pointers let /debug/pprof/profile unwind the stacks it samples.
+RELEASE_FLAGS	:= -O2 -g -DNDEBUG -flto=auto -fno-omit-frame-pointer
+# Flags of the server's debug build (make build_debug)
+DEBUG_FLAGS	:= -g -O0
+# Port and duration of the load tests that train the profile-guided build
+# and compare the builds (make build_pgo, bench_builds)
+LOADTEST_PORT	:= 18090
+PGO_TRAIN_SECONDS	:= 30
+BENCH_BUILDS_SECONDS	:= 20
 # Flags added to unittest compilation step
 UT_COMPILE_FLAGS	:=
 # Flags added for mac compilation, if different from COMPILE_FLAGS
@@ -17,9 +35,34 @@ MAC_UT_COMPILE_FLAGS :=
 # checked, i.e. library definitions from cpputils.
 OTHER_IMPLEMS	:=
 # Space-separated list of header files (e.g., algebra.hpp)
-HEADERS      		:= hurdlewords.h hurdlestate.h hurdle.h
+HEADERS      		:= hurdlewords.h hurdlestate.h hurdle.h patterns.h candidates.h counter.h daily.h difficulty.h hardmode.h leaderboard.h random.h stats.h strategy.h threadpool.h hint.h wordsearch.h allocprofile.h phase.h hurdleserver.h
 # Space-separated list of implementation files (e.g., algebra.cpp)
-IMPLEMS       		:= hurdlewords.cc hurdlestate.cc hurdle.cc
+IMPLEMS       		:= hurdlewords.cc hurdlestate.cc hurdle.cc patterns.cc candidates.cc daily.cc difficulty.cc hardmode.cc leaderboard.cc random.cc stats.cc strategy.cc threadpool.cc hint.cc wordsearch.cc allocprofile.cc phase.cc
+# Sources of the offline strategy solver (make solver, make strategy)
+SOLVER_DRIVER	:= tools/solver/solver.cc
+SOLVER_IMPLEMS	:= hurdlewords.cc wordsearch.cc candidates.cc difficulty.cc patterns.cc random.cc threadpool.cc strategy.cc
+# Flags passed to the solver by make strategy
+SOLVER_FLAGS	:= --openings 8 --breadth 4
+# Driver of the self-play harness (make selfplay), linked with IMPLEMS
+SELFPLAY_DRIVER	:= tools/selfplay/selfplay.cc
+# Driver of the benchmark suite (make bench), linked with IMPLEMS at -O3
+BENCH_DRIVER	:= tools/bench/bench.cc
+# Extra flags passed to the benchmarks, e.g. --benchmark_filter=Json
+BENCH_FLAGS	:=
+# The HTTP load generator (make loadgen), which only needs the RNG
+LOADGEN_DRIVER	:= tools/loadgen/loadgen.cc
+LOADGEN_IMPLEMS	:= random.cc
+# The HTTP client of the load generator, also used by the replay tool
+HTTP_CLIENT	:= tools/loadgen/httpclient.h
+# Flags of the allocation profiling builds (make build_allocs, bench_allocs
+# and test_allocations), which count heap allocations by route and phase
+ALLOC_PROFILE_FLAGS	:= -DHURDLE_ALLOC_PROFILE
+# The HTTP server, shared by main and the replay tool
+SERVER_IMPLEMS	:= hurdleserver.cc
+# The capture replay tool (make replay), linked with IMPLEMS and SERVER_IMPLEMS
+REPLAY_DRIVER	:= tools/replay/replay.cc
+# Flags passed to the replay tool by make replay, e.g. --speed 10
+REPLAY_FLAGS	:=
 # File containing main (e.g., main.cpp)
 DRIVER        		:= main.cc
 # Expected name of executable file
@@ -4,6 +4,7 @@
 
 #include <algorithm>
 #include <memory>
+#include <sstream>
 #include <nlohmann/json.hpp>
 #include <string>
 #include <vector>
@@ -93,6 +94,79 @@ TEST(HurdleGame, JsonFromHurdleStateHasGuessedWordsWhenNewHurdle) {
       << "JsonFromHurdleState: guessedWords should be a vector.";
 }
 
+TEST(HurdleGame, StateVersionChangesWhenStateIsMutated) {
+  HurdleWords hurdlewords("data/valid_hurdles.txt", "data/valid_guesses.txt");
+  HurdleGame game(hurdlewords);
+  uint64_t version = game.StateVersion();
+  game.LetterEntered('a');
+  ASSERT_NE(game.StateVersion(), version)
+      << "LetterEntered should change the state version.";
+  version = game.StateVersion();
+  game.LetterDeleted();
+  ASSERT_NE(game.StateVersion(), version)
+      << "LetterDeleted should change the state version.";
+  version = game.StateVersion();
+  game.WordSubmitted();
+  ASSERT_NE(game.StateVersion(), version)
+      << "WordSubmitted should change the state version.";
+  version = game.StateVersion();
+  game.NewHurdle();
+  ASSERT_NE(game.StateVersion(), version)
+      << "NewHurdle should change the state version.";
+  version = game.StateVersion();
+  game.JsonFromHurdleState();
+  game.SerializedHurdleState();
+  ASSERT_EQ(game.StateVersion(), version)
+      << "Reading the state should not change the state version.";
+}
+
+TEST(HurdleGame, SerializedHurdleStateMatchesJsonFromHurdleState) {
+  HurdleWords hurdlewords("data/valid_hurdles.txt", "data/valid_guesses.txt");
+  HurdleGame game(hurdlewords);
+  ASSERT_EQ(game.SerializedHurdleState(), game.JsonFromHurdleState().dump());
+  const std::string* cached = &game.SerializedHurdleState();
+  ASSERT_EQ(&game.SerializedHurdleState(), cached)
+      << "SerializedHurdleState should reuse the cached body until the next "
+         "mutation.";
+  game.LetterEntered('h');
+  json game_state_json = json::parse(game.SerializedHurdleState());
+  ASSERT_EQ(game_state_json.at("guessedWords").size(), 1)
+      << "SerializedHurdleState should reflect the latest mutation.";
+  ASSERT_EQ(game.SerializedHurdleState(), game.JsonFromHurdleState().dump());
+}
+
+TEST(HurdleGame, LoadStateRestoresSavedGame) {
+  HurdleWords hurdlewords("data/valid_hurdles.txt", "data/valid_guesses.txt");
+  HurdleGame game(hurdlewords);
+  for (char c : std::string("hello")) {
+    game.LetterEntered(c);
+  }
+  game.WordSubmitted();
+  game.LetterEntered('w');
+  game.LetterEntered('o');
+  std::stringstream saved;
+  game.SaveState(saved);
+
+  HurdleGame restored(hurdlewords);
+  ASSERT_TRUE(restored.LoadState(saved))
+      << "LoadState should accept the output of SaveState.";
+  ASSERT_EQ(restored.SerializedHurdleState(), game.SerializedHurdleState())
+      << "A restored game should have the same state as the saved one.";
+  ASSERT_EQ(restored.StateVersion(), game.StateVersion())
+      << "A restored game should keep its state version.";
+}
+
+TEST(HurdleGame, LoadStateRejectsMalformedInput) {
+  HurdleWords hurdlewords("data/valid_hurdles.txt", "data/valid_guesses.txt");
+  HurdleGame game(hurdlewords);
+  const std::string before = game.SerializedHurdleState();
+  std::stringstream malformed("3 light active 2 hello");
+  ASSERT_FALSE(game.LoadState(malformed))
+      << "LoadState should reject a truncated game.";
+  ASSERT_EQ(game.SerializedHurdleState(), before)
+      << "A failed LoadState should leave the game unchanged.";
+}
+
 int main(int argc, char** argv) {
   testing::InitGoogleTest(&argc, argv);
   testing::UnitTest::GetInstance()->listeners().Append(new SkipListener());
@@ -0,0 +1,145 @@
+#include <gmock/gmock-matchers.h>
+#include <gmock/gmock.h>
+#include <gtest/gtest.h>
+
+#include <cstdint>
+#include <memory>
+#include <string>
+
+#include "../../allocprofile.h"
+#include "../../hurdle.h"
+#include "../../hurdlewords.h"
+#include "../cppaudit/gtest_ext.h"
+
+// Allocation budgets of the game's request paths. Each budget is a little
+// above what the path allocates today, so a change that adds heap churn to
+// one of them fails here. Counting needs the instrumented operator new, so
+// these only run in make test_allocations.
+
+// Keeps the allocations made by the tests from being optimized away.
+std::shared_ptr<std::string> sink;
+
+void AllocateSomething() {
+  sink = std::make_shared<std::string>(64, 'x');
+}
+
+// Returns the number of allocations made by `fn` on this thread.
+template <typename Fn>
+uint64_t AllocationsOf(Fn fn) {
+  const uint64_t before = allocprofile::ThreadCounts().allocations;
+  fn();
+  return allocprofile::ThreadCounts().allocations - before;
+}
+
+// Skips its tests unless operator new is instrumented.
+class AllocationProfile : public testing::Test {
+ protected:
+  void SetUp() override {
+    if (!allocprofile::Enabled()) {
+      GTEST_SKIP() << "Allocations are counted in make test_allocations";
+    }
+  }
+};
+
+class AllocationBudget : public AllocationProfile {
+ protected:
+  AllocationBudget()
+      : hurdlewords_("tools/settings/data/light.txt",
+                     "data/valid_guesses.txt"),
+        game_(hurdlewords_) {
+    game_.StartHurdle("light");
+    game_.SerializedHurdleState();
+  }
+
+  HurdleWords hurdlewords_;
+  HurdleGame game_;
+};
+
+TEST_F(AllocationBudget, Keystroke) {
+  const uint64_t allocations = AllocationsOf([&] {
+    game_.LetterEntered('c');
+    game_.SerializedHurdleState();
+  });
+  EXPECT_LE(allocations, 55u);
+}
+
+TEST_F(AllocationBudget, SubmittedGuess) {
+  for (char letter : std::string("crane")) {
+    game_.LetterEntered(letter);
+  }
+  game_.SerializedHurdleState();
+  const uint64_t allocations = AllocationsOf([&] {
+    game_.WordSubmitted();
+    game_.SerializedHurdleState();
+  });
+  EXPECT_LE(allocations, 50u);
+}
+
+TEST_F(AllocationBudget, UnchangedStateIsServedWithoutAllocating) {
+  EXPECT_EQ(AllocationsOf([&] { game_.SerializedHurdleState(); }), 0u);
+}
+
+TEST_F(AllocationBudget, CalculateColors) {
+  EXPECT_LE(AllocationsOf([&] { game_.CalculateColors("crane"); }), 20u);
+}
+
+TEST_F(AllocationProfile, AttributesAllocationsToTheInnermostPhase) {
+  using allocprofile::Dimension;
+  const uint64_t outer_before =
+      allocprofile::Total(Dimension::kPhase, "test outer").allocations;
+  const uint64_t inner_before =
+      allocprofile::Total(Dimension::kPhase, "test inner").allocations;
+  uint64_t outer_allocations = 0;
+  uint64_t inner_allocations = 0;
+  {
+    allocprofile::Scope outer(Dimension::kPhase, "test outer");
+    outer_allocations += AllocationsOf(AllocateSomething);
+    {
+      allocprofile::Scope inner(Dimension::kPhase, "test inner");
+      inner_allocations += AllocationsOf(AllocateSomething);
+    }
+    outer_allocations += AllocationsOf(AllocateSomething);
+  }
+  ASSERT_GT(inner_allocations, 0u);
+  EXPECT_EQ(allocprofile::Total(Dimension::kPhase, "test outer").allocations -
+                outer_before,
+            outer_allocations);
+  EXPECT_EQ(allocprofile::Total(Dimension::kPhase, "test inner").allocations -
+                inner_before,
+            inner_allocations);
+}
+
+TEST_F(AllocationProfile, AttributesAllocationsToRouteAndPhase) {
+  using allocprofile::Dimension;
+  const allocprofile::Counts route_before =
+      allocprofile::Total(Dimension::kRoute, "/test");
+  const allocprofile::Counts phase_before =
+      allocprofile::Total(Dimension::kPhase, "test phase");
+  const allocprofile::Counts total_before = allocprofile::TotalCounts();
+  const size_t previous = allocprofile::Enter(Dimension::kRoute, "/test");
+  uint64_t allocations;
+  {
+    allocprofile::Scope phase(Dimension::kPhase, "test phase");
+    allocations = AllocationsOf(AllocateSomething);
+  }
+  allocprofile::Leave(Dimension::kRoute, previous);
+  const allocprofile::Counts route =
+      allocprofile::Total(Dimension::kRoute, "/test");
+  const allocprofile::Counts phase =
+      allocprofile::Total(Dimension::kPhase, "test phase");
+  EXPECT_EQ(route.allocations - route_before.allocations, allocations);
+  EXPECT_EQ(phase.allocations - phase_before.allocations, allocations);
+  EXPECT_EQ(route.bytes - route_before.bytes, phase.bytes - phase_before.bytes);
+  EXPECT_GE(allocprofile::TotalCounts().allocations - total_before.allocations,
+            allocations);
+  // Outside the route, allocations are no longer attributed to it.
+  AllocateSomething();
+  EXPECT_EQ(allocprofile::Total(Dimension::kRoute, "/test").allocations,
+            route.allocations);
+}
+
+int main(int argc, char** argv) {
+  testing::InitGoogleTest(&argc, argv);
+  testing::UnitTest::GetInstance()->listeners().Append(new SkipListener());
+  return RUN_ALL_TESTS();
+}
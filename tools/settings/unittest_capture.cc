@@ -0,0 +1,122 @@
+#include <gmock/gmock-matchers.h>
+#include <gmock/gmock.h>
+#include <gtest/gtest.h>
+
+#include <cstdint>
+#include <string>
+#include <vector>
+
+#include "../../server_utils/capture.h"
+#include "../cppaudit/gtest_ext.h"
+
+// Returns a few requests that exercise every field, with values on both
+// sides of the varint byte boundaries.
+std::vector<CapturedRequest> SampleRequests() {
+  CapturedRequest first;
+  first.arrival_ns = 127;
+  first.seed = 0x0123456789abcdefULL;
+  first.url = "/new_game?difficulty=hard";
+  first.player = "alice";
+  first.accept_encoding = "gzip, deflate";
+  first.status = 200;
+  first.body_hash = capture::HashBody("{}");
+  first.response_session = "token-1";
+
+  CapturedRequest second;
+  second.arrival_ns = 128;
+  second.seed = UINT64_MAX;
+  second.url = "/wordle_key_pressed/a";
+  second.session = "token-1";
+  second.if_none_match = "\"token-1-3\"";
+  second.status = 304;
+
+  CapturedRequest third;
+  third.arrival_ns = 5000000000ULL;
+  third.method = crow::HTTPMethod::Options;
+  third.url = std::string(300, 'x');
+  third.status = 204;
+  third.body_hash = UINT64_MAX;
+  return {first, second, third};
+}
+
+// Encodes `requests` into a capture, as CaptureMiddleware writes it.
+std::string EncodeAll(const std::vector<CapturedRequest>& requests) {
+  std::string data(capture::kMagic);
+  uint64_t previous_ns = 0;
+  for (const CapturedRequest& request : requests) {
+    capture::Encode(request, previous_ns, &data);
+    previous_ns = request.arrival_ns;
+  }
+  return data;
+}
+
+void ExpectSameRequest(const CapturedRequest& actual,
+                       const CapturedRequest& expected) {
+  EXPECT_EQ(actual.arrival_ns, expected.arrival_ns);
+  EXPECT_EQ(actual.seed, expected.seed);
+  EXPECT_EQ(actual.method, expected.method);
+  EXPECT_EQ(actual.url, expected.url);
+  EXPECT_EQ(actual.session, expected.session);
+  EXPECT_EQ(actual.player, expected.player);
+  EXPECT_EQ(actual.accept_encoding, expected.accept_encoding);
+  EXPECT_EQ(actual.if_none_match, expected.if_none_match);
+  EXPECT_EQ(actual.status, expected.status);
+  EXPECT_EQ(actual.body_hash, expected.body_hash);
+  EXPECT_EQ(actual.response_session, expected.response_session);
+}
+
+TEST(Capture, VarintsRoundTrip) {
+  for (uint64_t value : {uint64_t{0}, uint64_t{127}, uint64_t{128},
+                         uint64_t{16383}, uint64_t{16384}, UINT64_MAX}) {
+    std::string data;
+    capture::PutVarint(value, &data);
+    std::string_view in = data;
+    uint64_t decoded;
+    ASSERT_TRUE(capture::GetVarint(&in, &decoded)) << value;
+    EXPECT_EQ(decoded, value);
+    EXPECT_TRUE(in.empty()) << value;
+  }
+}
+
+TEST(Capture, DecodesWhatWasEncoded) {
+  const std::vector<CapturedRequest> requests = SampleRequests();
+  std::vector<CapturedRequest> decoded;
+  ASSERT_TRUE(capture::Decode(EncodeAll(requests), &decoded));
+  ASSERT_EQ(decoded.size(), requests.size());
+  for (size_t i = 0; i < requests.size(); i++) {
+    SCOPED_TRACE("request " + std::to_string(i));
+    ExpectSameRequest(decoded[i], requests[i]);
+  }
+}
+
+TEST(Capture, TruncatedCaptureKeepsTheRecordsBeforeIt) {
+  const std::vector<CapturedRequest> requests = SampleRequests();
+  const std::string two = EncodeAll({requests[0], requests[1]});
+  const std::string all = EncodeAll(requests);
+  // Every cut inside the third record loses only that record.
+  for (size_t size = two.size() + 1; size < all.size(); size++) {
+    std::vector<CapturedRequest> decoded;
+    ASSERT_FALSE(capture::Decode(std::string_view(all).substr(0, size),
+                                 &decoded))
+        << "A capture cut to " << size << " bytes should be rejected.";
+    ASSERT_EQ(decoded.size(), 2) << "cut to " << size << " bytes";
+    ExpectSameRequest(decoded[1], requests[1]);
+  }
+}
+
+TEST(Capture, RejectsDataWithoutTheMagic) {
+  std::vector<CapturedRequest> decoded;
+  std::string data = EncodeAll(SampleRequests());
+  data[0] = 'X';
+  EXPECT_FALSE(capture::Decode(data, &decoded));
+  EXPECT_FALSE(capture::Decode("", &decoded));
+  EXPECT_TRUE(decoded.empty());
+  EXPECT_TRUE(capture::Decode(capture::kMagic, &decoded))
+      << "An empty capture is valid.";
+}
+
+int main(int argc, char** argv) {
+  testing::InitGoogleTest(&argc, argv);
+  testing::UnitTest::GetInstance()->listeners().Append(new SkipListener());
+  return RUN_ALL_TESTS();
+}
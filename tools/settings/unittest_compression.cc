@@ -0,0 +1,161 @@
+#include <gmock/gmock-matchers.h>
+#include <gmock/gmock.h>
+#include <gtest/gtest.h>
+#include <zlib.h>
+
+#include <string>
+
+#include "../../server_utils/compression.h"
+#include "../cppaudit/gtest_ext.h"
+
+// Returns `compressed` inflated, with zlib detecting a gzip or zlib wrapper.
+std::string Inflate(const std::string& compressed) {
+  z_stream stream{};
+  inflateInit2(&stream, MAX_WBITS + 32);
+  stream.next_in =
+      reinterpret_cast<Bytef*>(const_cast<char*>(compressed.data()));
+  stream.avail_in = compressed.size();
+  std::string out;
+  char buffer[4096];
+  int status = Z_OK;
+  while (status == Z_OK) {
+    stream.next_out = reinterpret_cast<Bytef*>(buffer);
+    stream.avail_out = sizeof(buffer);
+    status = inflate(&stream, Z_NO_FLUSH);
+    out.append(buffer, sizeof(buffer) - stream.avail_out);
+  }
+  inflateEnd(&stream);
+  return status == Z_STREAM_END ? out : "";
+}
+
+// A body well above any min_size the tests use.
+std::string LongBody() {
+  std::string body;
+  for (int i = 0; i < 50; i++) {
+    body += "{\"guess\":\"light\",\"colors\":\"BYGBB\"},";
+  }
+  return body;
+}
+
+TEST(ResponseCompressor, NegotiatePrefersGzip) {
+  EXPECT_EQ(ResponseCompressor::Negotiate("gzip, deflate, br"),
+            ContentEncoding::kGzip);
+  EXPECT_EQ(ResponseCompressor::Negotiate("deflate, gzip"),
+            ContentEncoding::kGzip);
+  EXPECT_EQ(ResponseCompressor::Negotiate("x-gzip"), ContentEncoding::kGzip);
+  EXPECT_EQ(ResponseCompressor::Negotiate("*"), ContentEncoding::kGzip);
+  EXPECT_EQ(ResponseCompressor::Negotiate("br, deflate"),
+            ContentEncoding::kDeflate);
+}
+
+TEST(ResponseCompressor, NegotiateHonorsQValues) {
+  EXPECT_EQ(ResponseCompressor::Negotiate("gzip;q=0, deflate"),
+            ContentEncoding::kDeflate);
+  EXPECT_EQ(ResponseCompressor::Negotiate("gzip ; q=0.5"),
+            ContentEncoding::kGzip);
+  EXPECT_EQ(ResponseCompressor::Negotiate("gzip;q=0, deflate;q=0.0"),
+            ContentEncoding::kIdentity);
+}
+
+TEST(ResponseCompressor, NegotiateWildcardSkipsNamedEncodings) {
+  EXPECT_EQ(ResponseCompressor::Negotiate("gzip;q=0, *"),
+            ContentEncoding::kDeflate)
+      << "* should not override an explicit refusal of gzip.";
+  EXPECT_EQ(ResponseCompressor::Negotiate("*, gzip;q=0, deflate;q=0"),
+            ContentEncoding::kIdentity);
+  EXPECT_EQ(ResponseCompressor::Negotiate("deflate, *;q=0"),
+            ContentEncoding::kDeflate);
+}
+
+TEST(ResponseCompressor, NegotiateWithoutCompressionIsIdentity) {
+  EXPECT_EQ(ResponseCompressor::Negotiate(""), ContentEncoding::kIdentity);
+  EXPECT_EQ(ResponseCompressor::Negotiate("identity"),
+            ContentEncoding::kIdentity);
+  EXPECT_EQ(ResponseCompressor::Negotiate("br, zstd"),
+            ContentEncoding::kIdentity);
+}
+
+TEST(ResponseCompressor, ShouldCompressBodiesAboveMinSize) {
+  ResponseCompressor compressor;
+  compressor.min_size = 100;
+  EXPECT_TRUE(compressor.ShouldCompress(100, ContentEncoding::kGzip));
+  EXPECT_TRUE(compressor.ShouldCompress(1000, ContentEncoding::kDeflate));
+  EXPECT_FALSE(compressor.ShouldCompress(1000, ContentEncoding::kIdentity));
+  EXPECT_EQ(compressor.SkippedCount(), 0);
+  EXPECT_FALSE(compressor.ShouldCompress(99, ContentEncoding::kGzip));
+  EXPECT_EQ(compressor.SkippedCount(), 1);
+}
+
+TEST(ResponseCompressor, CompressRoundTrips) {
+  ResponseCompressor compressor;
+  const std::string body = LongBody();
+  for (ContentEncoding encoding :
+       {ContentEncoding::kGzip, ContentEncoding::kDeflate}) {
+    std::string compressed;
+    ASSERT_TRUE(compressor.Compress(body, encoding, &compressed))
+        << ResponseCompressor::EncodingName(encoding);
+    EXPECT_LT(compressed.size(), body.size());
+    EXPECT_EQ(Inflate(compressed), body)
+        << ResponseCompressor::EncodingName(encoding);
+  }
+  // A gzip stream starts with its magic number, a zlib one does not.
+  std::string gzip;
+  ASSERT_TRUE(compressor.Compress(body, ContentEncoding::kGzip, &gzip));
+  EXPECT_EQ(gzip.substr(0, 2), "\x1f\x8b");
+  EXPECT_EQ(compressor.CompressedCount(), 3);
+  EXPECT_GT(compressor.BytesSaved(), 0);
+}
+
+TEST(ResponseCompressor, CacheHitsForTheSameVersion) {
+  ResponseCompressor compressor;
+  CompressedBodyCache cache;
+  const std::string body = LongBody();
+  const std::string* first =
+      compressor.CompressCached(body, ContentEncoding::kGzip, 1, cache);
+  ASSERT_NE(first, nullptr);
+  const std::string compressed = *first;
+  const std::string* second =
+      compressor.CompressCached(body, ContentEncoding::kGzip, 1, cache);
+  ASSERT_NE(second, nullptr);
+  EXPECT_EQ(*second, compressed);
+  EXPECT_EQ(compressor.CompressedCount(), 1);
+  EXPECT_EQ(compressor.CacheHits(), 1);
+}
+
+TEST(ResponseCompressor, CacheIsInvalidatedByANewVersion) {
+  ResponseCompressor compressor;
+  CompressedBodyCache cache;
+  const std::string body = LongBody();
+  ASSERT_NE(compressor.CompressCached(body, ContentEncoding::kGzip, 1, cache),
+            nullptr);
+  const std::string changed = body + "{\"guess\":\"tight\"}";
+  const std::string* compressed =
+      compressor.CompressCached(changed, ContentEncoding::kGzip, 2, cache);
+  ASSERT_NE(compressed, nullptr);
+  EXPECT_EQ(Inflate(*compressed), changed);
+  EXPECT_EQ(compressor.CompressedCount(), 2);
+  EXPECT_EQ(compressor.CacheHits(), 0);
+}
+
+TEST(ResponseCompressor, CacheKeepsOneBodyPerEncoding) {
+  ResponseCompressor compressor;
+  CompressedBodyCache cache;
+  const std::string body = LongBody();
+  ASSERT_NE(compressor.CompressCached(body, ContentEncoding::kGzip, 1, cache),
+            nullptr);
+  const std::string* deflated =
+      compressor.CompressCached(body, ContentEncoding::kDeflate, 1, cache);
+  ASSERT_NE(deflated, nullptr);
+  EXPECT_EQ(Inflate(*deflated), body);
+  EXPECT_NE(deflated->substr(0, 2), "\x1f\x8b");
+  ASSERT_NE(compressor.CompressCached(body, ContentEncoding::kGzip, 1, cache),
+            nullptr);
+  EXPECT_EQ(compressor.CompressedCount(), 2);
+  EXPECT_EQ(compressor.CacheHits(), 1);
+}
+
+int main(int argc, char** argv) {
+  testing::InitGoogleTest(&argc, argv);
+  testing::UnitTest::GetInstance()->listeners().Append(new SkipListener());
+  return RUN_ALL_TESTS();
+}
@@ -5,6 +5,7 @@
 #include <algorithm>
 #include <memory>
 #include <nlohmann/json.hpp>
+#include <sstream>
 #include <string>
 #include <vector>
 
@@ -128,6 +129,124 @@ TEST(HurdleGame, NoErrorWhenSubmitThenErrorAfterTooFewLetters) {
   CheckErrorMessage(game_state_json);
 }
 
+TEST(HurdleGame, HardModeErrorWhenGreenLetterIsMoved) {
+  HurdleWords hurdlewords("tools/settings/data/light.txt",
+                          "data/valid_guesses.txt");
+  HurdleGame game(hurdlewords);
+  game.SetHardMode(true);
+  SubmitWord(game, "tight");
+  SubmitWord(game, "moist");
+  json game_state_json = json::parse(game.JsonFromHurdleState().dump());
+  CheckErrorMessage(game_state_json);
+  std::string error = game_state_json.at("errorMessage");
+  ASSERT_THAT(error, HasSubstr("Hard mode"))
+      << "errorMessage should say the guess was rejected by hard mode.";
+  ASSERT_THAT(error, HasSubstr("2nd letter must be I"));
+  ASSERT_TRUE(game_state_json.at("hardMode"));
+}
+
+TEST(HurdleGame, HardModeErrorWhenYellowLetterIsMissing) {
+  HurdleWords hurdlewords("tools/settings/data/light.txt",
+                          "data/valid_guesses.txt");
+  HurdleGame game(hurdlewords);
+  game.SetHardMode(true);
+  SubmitWord(game, "hotel");
+  SubmitWord(game, "crane");
+  json game_state_json = json::parse(game.JsonFromHurdleState().dump());
+  CheckErrorMessage(game_state_json);
+  std::string error = game_state_json.at("errorMessage");
+  ASSERT_THAT(error, HasSubstr("Hard mode"));
+  ASSERT_THAT(error, HasSubstr("Guess must contain H"));
+  for (int i = 0; i < 5; i++) {
+    game.LetterDeleted();
+  }
+  SubmitWord(game, "light");
+  game_state_json = json::parse(game.JsonFromHurdleState().dump());
+  CheckEmptyOrNoErrorMessage(game_state_json);
+}
+
+TEST(HurdleGame, HardModeRejectedRowIsNotAppliedOrSkipped) {
+  HurdleWords hurdlewords("data/valid_hurdles.txt", "data/valid_guesses.txt");
+  HurdleGame game(hurdlewords);
+  game.StartHurdle("crane");
+  game.SetHardMode(true);
+  SubmitWord(game, "crony");
+  const size_t remaining = game.Candidates().Count();
+  SubmitWord(game, "adieu");
+  json game_state_json = json::parse(game.JsonFromHurdleState().dump());
+  ASSERT_THAT(std::string(game_state_json.at("errorMessage")),
+              HasSubstr("1st letter must be C"));
+  // Typing on does not move past the rejected row.
+  for (char letter : std::string("lumps")) {
+    game.LetterEntered(letter);
+  }
+  game_state_json = json::parse(game.JsonFromHurdleState().dump());
+  ASSERT_EQ(game_state_json.at("guessedWords"),
+            json::array({"crony", "adieu"}))
+      << "A row rejected by hard mode should be edited before the next one.";
+  ASSERT_THAT(std::string(game_state_json.at("errorMessage")),
+              HasSubstr("1st letter must be C"));
+  ASSERT_EQ(game_state_json.at("remainingHurdles"), remaining)
+      << "A rejected row should not narrow down the remaining hurdles.";
+  ASSERT_EQ(game_state_json.at("gameStatus"), "active");
+}
+
+TEST(HurdleGame, NoHardModeErrorWhenHardModeIsOff) {
+  HurdleWords hurdlewords("tools/settings/data/light.txt",
+                          "data/valid_guesses.txt");
+  HurdleGame game(hurdlewords);
+  SubmitWord(game, "tight");
+  SubmitWord(game, "moist");
+  json game_state_json = json::parse(game.JsonFromHurdleState().dump());
+  CheckEmptyOrNoErrorMessage(game_state_json);
+  ASSERT_FALSE(game_state_json.at("hardMode"));
+}
+
+TEST(HurdleGame, HardModeSurvivesSaveAndLoad) {
+  HurdleWords hurdlewords("tools/settings/data/light.txt",
+                          "data/valid_guesses.txt");
+  HurdleGame game(hurdlewords);
+  game.SetHardMode(true);
+  SubmitWord(game, "tight");
+  std::ostringstream out;
+  game.SaveState(out);
+
+  HurdleGame loaded(hurdlewords);
+  std::istringstream in(out.str());
+  ASSERT_TRUE(loaded.LoadState(in));
+  ASSERT_TRUE(loaded.HardMode());
+  SubmitWord(loaded, "moist");
+  json game_state_json = json::parse(loaded.JsonFromHurdleState().dump());
+  std::string error = game_state_json.at("errorMessage");
+  ASSERT_THAT(error, HasSubstr("2nd letter must be I"))
+      << "A loaded game should keep the rules of its submitted rows.";
+}
+
+TEST(HurdleGame, RejectedRowIsStillRejectedAfterSaveAndLoad) {
+  HurdleWords hurdlewords("tools/settings/data/light.txt",
+                          "data/valid_guesses.txt");
+  for (const std::string& rejected : {"zzzzz", "moist"}) {
+    HurdleGame game(hurdlewords);
+    game.SetHardMode(true);
+    SubmitWord(game, "tight");
+    SubmitWord(game, rejected);
+    std::ostringstream out;
+    game.SaveState(out);
+
+    HurdleGame loaded(hurdlewords);
+    std::istringstream in(out.str());
+    ASSERT_TRUE(loaded.LoadState(in));
+    loaded.WordSubmitted();
+    json game_state_json = json::parse(loaded.JsonFromHurdleState().dump());
+    CheckErrorMessage(game_state_json);
+    loaded.LetterEntered('a');
+    game_state_json = json::parse(loaded.JsonFromHurdleState().dump());
+    ASSERT_EQ(game_state_json.at("guessedWords").size(), 2)
+        << "A loaded game should not move past its rejected row " << rejected;
+    ASSERT_EQ(loaded.Candidates().Count(), game.Candidates().Count());
+  }
+}
+
 int main(int argc, char** argv) {
   testing::InitGoogleTest(&argc, argv);
   testing::UnitTest::GetInstance()->listeners().Append(new SkipListener());
@@ -3,21 +3,42 @@
 #include <gtest/gtest.h>
 
 #include <algorithm>
+#include <chrono>
 #include <memory>
+#include <sstream>
 #include <nlohmann/json.hpp>
 #include <string>
+#include <thread>
 #include <vector>
 
 #include "../../hurdlewords.h"
 #include "../../hurdlestate.h"
 #include "../../server_utils/crow_all.h"
 #include "../../hurdle.h"
+#include "../../leaderboard.h"
+#include "../../stats.h"
+#include "../../threadpool.h"
 #include "../cppaudit/gtest_ext.h"
 
 using ::testing::HasSubstr;
 using ::testing::Not;
 using json = nlohmann::json;
 
+// Records the games reported to it.
+class RecordingObserver : public HurdleObserver {
+ public:
+  void GameFinished(const std::string &player,
+                    const HurdleState &state) override {
+    finished.push_back(state.GetStatus());
+  }
+  void GameAbandoned(const std::string &player, const HurdleState &state,
+                     size_t submitted_rows) override {
+    abandoned.push_back(submitted_rows);
+  }
+  std::vector<std::string> finished;
+  std::vector<size_t> abandoned;
+};
+
 // Check that the "gameStatus" key exists in `game_state_json` with the given
 // value.
 void CheckGameStatus(json game_state_json, const std::string &expected,
@@ -147,6 +168,263 @@ TEST(HurdleGame,
                   "when the user correctly guesses the secret Hurdle.");
 }
 
+
+TEST(HurdleGame, ObserverIsToldOnceWhenGameIsWon) {
+  HurdleWords hurdlewords("tools/settings/data/light.txt",
+                        "data/valid_guesses.txt");
+  HurdleGame game(hurdlewords);
+  RecordingObserver observer;
+  game.AddObserver(&observer);
+  SubmitWord(game, "hello");
+  EXPECT_TRUE(observer.finished.empty());
+  SubmitWord(game, "light");
+  ASSERT_EQ(observer.finished, std::vector<std::string>{"win"});
+  // Editing the winning row and winning again is the same game.
+  game.LetterDeleted();
+  SubmitWord(game, "t");
+  EXPECT_EQ(observer.finished.size(), 1);
+  game.NewHurdle();
+  EXPECT_TRUE(observer.abandoned.empty())
+      << "A finished game should not be reported as abandoned.";
+}
+
+TEST(HurdleGame, ObserverIsToldWhenGameIsLost) {
+  HurdleWords hurdlewords("tools/settings/data/light.txt",
+                        "data/valid_guesses.txt");
+  HurdleGame game(hurdlewords);
+  RecordingObserver observer;
+  game.AddObserver(&observer);
+  for (int i = 0; i < 6; i++) {
+    SubmitWord(game, "hello");
+  }
+  EXPECT_EQ(observer.finished, std::vector<std::string>{"lose"});
+}
+
+TEST(HurdleGame, RejectedSixthRowDoesNotEndTheGame) {
+  HurdleWords hurdlewords("tools/settings/data/light.txt",
+                        "data/valid_guesses.txt");
+  HurdleGame game(hurdlewords);
+  RecordingObserver observer;
+  game.AddObserver(&observer);
+  for (int i = 0; i < 5; i++) {
+    SubmitWord(game, "hello");
+  }
+  SubmitWord(game, "l");
+  json game_state_json = json::parse(game.JsonFromHurdleState().dump());
+  CheckGameStatus(game_state_json, "active",
+                  "when the sixth guess was rejected.");
+  EXPECT_TRUE(observer.finished.empty())
+      << "A rejected guess should not finish the game.";
+  SubmitWord(game, "ight");
+  game_state_json = json::parse(game.JsonFromHurdleState().dump());
+  CheckGameStatus(game_state_json, "win",
+                  "when the sixth guess is the secret Hurdle.");
+  EXPECT_EQ(observer.finished, std::vector<std::string>{"win"});
+}
+
+TEST(HurdleGame, ObserverIsToldWhenGameIsAbandoned) {
+  HurdleWords hurdlewords("tools/settings/data/light.txt",
+                        "data/valid_guesses.txt");
+  HurdleGame game(hurdlewords);
+  RecordingObserver observer;
+  game.AddObserver(&observer);
+  game.NewHurdle();
+  EXPECT_TRUE(observer.abandoned.empty())
+      << "A game with an empty board should not count as abandoned.";
+  SubmitWord(game, "hello");
+  game.LetterEntered('w');
+  game.NewHurdle();
+  EXPECT_EQ(observer.abandoned, std::vector<size_t>{1});
+  EXPECT_TRUE(observer.finished.empty());
+}
+
+TEST(HurdleGame, ObserverIsNotToldOfGamesWithoutSubmittedGuesses) {
+  HurdleWords hurdlewords("tools/settings/data/light.txt",
+                        "data/valid_guesses.txt");
+  HurdleGame game(hurdlewords);
+  RecordingObserver observer;
+  game.AddObserver(&observer);
+  game.NewHurdle();
+  game.LetterEntered('h');
+  game.LetterEntered('e');
+  game.NewHurdle();
+  EXPECT_TRUE(observer.abandoned.empty())
+      << "A game with letters but no submitted guess should not count as "
+         "abandoned.";
+}
+
+TEST(HurdleGame, SavedStateKeepsThePlayer) {
+  HurdleWords hurdlewords("tools/settings/data/light.txt",
+                        "data/valid_guesses.txt");
+  HurdleGame game(hurdlewords);
+  game.SetPlayer("alice");
+  game.NewHurdle();
+  SubmitWord(game, "hello");
+  std::stringstream state;
+  game.SaveState(state);
+
+  HurdleGame restored(hurdlewords);
+  ASSERT_TRUE(restored.LoadState(state));
+  EXPECT_EQ(restored.Player(), "alice");
+}
+
+TEST(GameStats, AggregatesGamesFromEveryThread) {
+  HurdleWords hurdlewords("tools/settings/data/light.txt",
+                        "data/valid_guesses.txt");
+  GameStats stats(hurdlewords);
+  EXPECT_EQ(stats.Snapshot()->generation, 0);
+  EXPECT_EQ(stats.HurdleIndex("light"), 0);
+  EXPECT_EQ(stats.HurdleIndex("hello"), -1);
+
+  ThreadPool pool(4);
+  pool.ParallelFor(0, 40, 1, [&](size_t begin, size_t end) {
+    for (size_t i = begin; i < end; i++) {
+      HurdleGame game(hurdlewords);
+      game.AddObserver(&stats);
+      if (i % 4 == 0) {
+        SubmitWord(game, "hello");
+        game.NewHurdle();
+      } else {
+        SubmitWord(game, i % 2 == 0 ? "hello" : "fight");
+        SubmitWord(game, "light");
+      }
+    }
+  });
+  stats.Aggregate();
+
+  std::shared_ptr<const StatsSnapshot> snapshot = stats.Snapshot();
+  EXPECT_EQ(snapshot->generation, 1);
+  EXPECT_EQ(snapshot->total.Wins(), 30);
+  EXPECT_EQ(snapshot->total.guesses[1], 30);
+  EXPECT_EQ(snapshot->total.losses, 0);
+  EXPECT_EQ(snapshot->total.abandoned, 10);
+  EXPECT_DOUBLE_EQ(snapshot->total.WinRate(), 1);
+  ASSERT_EQ(snapshot->hurdles.size(), 1);
+  EXPECT_EQ(snapshot->hurdles[0].Wins(), 30);
+
+  // The count-min sketch never underestimates, and with so few guesses it
+  // should be exact.
+  ASSERT_EQ(snapshot->first_guesses.size(), 2);
+  EXPECT_EQ(snapshot->first_guesses[0],
+            std::make_pair(std::string("fight"), uint64_t{20}));
+  EXPECT_EQ(snapshot->first_guesses[1],
+            std::make_pair(std::string("hello"), uint64_t{20}));
+}
+
+TEST(GameStats, BackgroundAggregatorPublishesSnapshots) {
+  HurdleWords hurdlewords("tools/settings/data/light.txt",
+                        "data/valid_guesses.txt");
+  GameStats stats(hurdlewords);
+  stats.interval = std::chrono::milliseconds(5);
+  HurdleGame game(hurdlewords);
+  game.AddObserver(&stats);
+  SubmitWord(game, "light");
+  stats.Start();
+  for (int i = 0; i < 400 && stats.Snapshot()->total.Wins() == 0; i++) {
+    std::this_thread::sleep_for(std::chrono::milliseconds(5));
+  }
+  stats.Stop();
+  EXPECT_EQ(stats.Snapshot()->total.guesses[0], 1);
+  EXPECT_EQ(stats.Snapshot()->first_guesses.size(), 1);
+}
+
+// Returns the ids of `records`, in order.
+std::vector<std::string> PlayerIds(const std::vector<PlayerRecord> &records) {
+  std::vector<std::string> ids;
+  for (const PlayerRecord &record : records) {
+    ids.push_back(record.player);
+  }
+  return ids;
+}
+
+TEST(Leaderboard, RanksPlayersByStreakAndAverageGuesses) {
+  HurdleWords hurdlewords("tools/settings/data/light.txt",
+                        "data/valid_guesses.txt");
+  Leaderboard leaderboard;
+  leaderboard.min_wins = 2;
+  HurdleGame game(hurdlewords);
+  game.AddObserver(&leaderboard);
+  auto play = [&](const std::string &player, int misses) {
+    game.SetPlayer(player);
+    game.NewHurdle();
+    for (int i = 0; i < misses; i++) {
+      SubmitWord(game, "hello");
+    }
+    if (misses < 6) {
+      SubmitWord(game, "light");
+    }
+  };
+  play("ann", 0);
+  play("ann", 1);
+  play("bob", 2);
+  play("bob", 2);
+  play("bob", 2);
+  play("cid", 0);
+  play("cid", 6);
+  play("dee", 3);
+  play("", 0);
+
+  EXPECT_EQ(PlayerIds(leaderboard.Top(Leaderboard::Ranking::kStreak, 10)),
+            std::vector<std::string>({"bob", "ann", "dee"}));
+  EXPECT_EQ(
+      PlayerIds(leaderboard.Top(Leaderboard::Ranking::kAverageGuesses, 10)),
+      std::vector<std::string>({"ann", "bob"}));
+  EXPECT_EQ(PlayerIds(leaderboard.Top(Leaderboard::Ranking::kStreak, 1)),
+            std::vector<std::string>({"bob"}));
+
+  PlayerRecord cid = leaderboard.Find("cid");
+  EXPECT_EQ(cid.played, 2);
+  EXPECT_EQ(cid.wins, 1);
+  EXPECT_EQ(cid.streak, 0);
+  EXPECT_EQ(cid.best_streak, 1);
+  EXPECT_DOUBLE_EQ(leaderboard.Find("bob").AverageGuesses(), 3);
+  EXPECT_EQ(leaderboard.Find("nobody").played, 0);
+
+  // Abandoning a game with a submitted guess ends the streak.
+  game.SetPlayer("bob");
+  game.NewHurdle();
+  SubmitWord(game, "hello");
+  game.NewHurdle();
+  EXPECT_EQ(leaderboard.Find("bob").streak, 0);
+  EXPECT_EQ(PlayerIds(leaderboard.Top(Leaderboard::Ranking::kStreak, 10)),
+            std::vector<std::string>({"ann", "dee"}));
+}
+
+TEST(Leaderboard, MergesShardsFromManyThreads) {
+  Leaderboard leaderboard;
+  leaderboard.top_k = 5;
+  HurdleState won;
+  won.SetStatus("win");
+  won.SetGuesses({"hello", "light"});
+  HurdleState lost;
+  lost.SetStatus("lose");
+
+  // Player i wins i % 50 games in a row, then loses one if i is odd.
+  ThreadPool pool(4);
+  pool.ParallelFor(0, 1000, 10, [&](size_t begin, size_t end) {
+    for (size_t i = begin; i < end; i++) {
+      const std::string player = "p" + std::to_string(i);
+      for (size_t game = 0; game < i % 50; game++) {
+        leaderboard.GameFinished(player, won);
+      }
+      if (i % 2 == 1) {
+        leaderboard.GameFinished(player, lost);
+      }
+    }
+  });
+
+  // The longest streaks are 48, by players 48, 98, ..., 998, which tie and
+  // are ordered by id. At most top_k players are returned.
+  std::vector<PlayerRecord> top =
+      leaderboard.Top(Leaderboard::Ranking::kStreak, 100);
+  EXPECT_EQ(PlayerIds(top), std::vector<std::string>(
+                                {"p148", "p198", "p248", "p298", "p348"}));
+  for (const PlayerRecord &record : top) {
+    EXPECT_EQ(record.streak, 48);
+    EXPECT_EQ(record.wins, 48);
+  }
+}
+
 int main(int argc, char **argv) {
   testing::InitGoogleTest(&argc, argv);
   testing::UnitTest::GetInstance()->listeners().Append(new SkipListener());
@@ -0,0 +1,327 @@
+#include <gmock/gmock-matchers.h>
+#include <gmock/gmock.h>
+#include <gtest/gtest.h>
+
+#include <algorithm>
+#include <atomic>
+#include <chrono>
+#include <cstring>
+#include <fstream>
+#include <memory>
+#include <nlohmann/json.hpp>
+#include <sstream>
+#include <string>
+#include <thread>
+#include <vector>
+
+#include "../../hint.h"
+#include "../../hurdle.h"
+#include "../../hurdlewords.h"
+#include "../../patterns.h"
+#include "../../strategy.h"
+#include "../../threadpool.h"
+#include "../cppaudit/gtest_ext.h"
+
+using json = nlohmann::json;
+
+TEST(Patterns, ScorePatternMatchesBoardColors) {
+  HurdleWords hurdlewords("tools/settings/data/light.txt",
+                          "data/valid_guesses.txt");
+  HurdleGame game(hurdlewords);
+  std::vector<std::string> guesses = {"drawn", "tight", "hello", "lilts",
+                                      "light"};
+  for (const std::string& guess : guesses) {
+    SubmitWord(game, guess);
+  }
+  json game_state_json = json::parse(game.JsonFromHurdleState().dump());
+  for (size_t i = 0; i < guesses.size(); i++) {
+    std::string expected = game_state_json.at("boardColors").at(i);
+    ASSERT_EQ(ColorsFromPattern(
+                  ScorePattern(PackWord(guesses[i]), PackWord("light"))),
+              expected)
+        << "ScorePattern should give the same colors as boardColors for "
+        << guesses[i];
+  }
+}
+
+TEST(Patterns, PatternFromColorsRoundTrips) {
+  for (int p = 0; p < kPatternCount; p++) {
+    Pattern pattern;
+    ASSERT_TRUE(PatternFromColors(ColorsFromPattern(p), &pattern));
+    ASSERT_EQ(pattern, p);
+  }
+  Pattern pattern;
+  ASSERT_FALSE(PatternFromColors("GGG", &pattern));
+  ASSERT_FALSE(PatternFromColors("GGGGX", &pattern));
+}
+
+TEST(ThreadPool, ParallelForVisitsEveryIndexOnce) {
+  ThreadPool pool(4);
+  std::vector<std::atomic<int>> visits(10000);
+  pool.ParallelFor(0, visits.size(), 37, [&](size_t begin, size_t end) {
+    for (size_t i = begin; i < end; i++) {
+      visits[i]++;
+    }
+  });
+  for (size_t i = 0; i < visits.size(); i++) {
+    ASSERT_EQ(visits[i].load(), 1) << "Index " << i << " visited wrongly.";
+  }
+}
+
+TEST(ThreadPool, ParallelForCallerRunsOnlyItsOwnChunks) {
+  ThreadPool pool(2);
+  std::atomic<bool> release{false};
+  std::atomic<int> busy{0};
+  // Keeps both workers busy, with an unrelated task queued behind them.
+  for (int i = 0; i < 2; i++) {
+    pool.Submit([&] {
+      busy++;
+      while (!release) {
+        std::this_thread::yield();
+      }
+    });
+  }
+  while (busy < 2) {
+    std::this_thread::yield();
+  }
+  std::atomic<int> unrelated{0};
+  pool.Submit([&] { unrelated++; });
+  std::atomic<int> chunks{0};
+  pool.ParallelFor(0, 8, 1, [&](size_t, size_t) { chunks++; });
+  EXPECT_EQ(chunks.load(), 8);
+  EXPECT_EQ(unrelated.load(), 0)
+      << "ParallelFor ran a task that was not one of its chunks.";
+  release = true;
+}
+
+TEST(ThreadPool, DestructorRunsQueuedTasks) {
+  std::atomic<int> ran{0};
+  {
+    ThreadPool pool(2);
+    for (int i = 0; i < 100; i++) {
+      pool.Submit([&] { ran++; });
+    }
+  }
+  EXPECT_EQ(ran.load(), 100);
+}
+
+// Starts `game` over with `hurdle` as the answer.
+void LoadHurdle(HurdleGame& game, const std::string& hurdle) {
+  std::istringstream in("1 " + hurdle + " active 0");
+  ASSERT_TRUE(game.LoadState(in));
+}
+
+TEST(CandidateSet, CountsAndListsCandidates) {
+  CandidateSet candidates(130);
+  ASSERT_EQ(candidates.Count(), 130);
+  CandidateIndex index({"light", "might", "tight", "crane"});
+  Pattern pattern;
+  ASSERT_TRUE(PatternFromColors("BGGGG", &pattern));
+  std::shared_ptr<const CandidateSet> mask = index.Mask("night", pattern);
+  ASSERT_EQ(mask->Indices(), std::vector<uint32_t>({0, 1, 2}));
+  CandidateSet all = index.All();
+  ASSERT_TRUE(PatternFromColors("GGGGG", &pattern));
+  all.Intersect(*index.Mask("tight", pattern));
+  ASSERT_EQ(all.Count(), 1);
+  ASSERT_TRUE(all.Contains(2));
+}
+
+TEST(HurdleGame, CandidatesNarrowWithEverySubmittedGuess) {
+  HurdleWords hurdlewords("data/valid_hurdles.txt", "data/valid_guesses.txt");
+  ThreadPool pool(1);
+  HintEngine engine(hurdlewords, pool);
+  HurdleGame game(hurdlewords);
+  LoadHurdle(game, "light");
+  ASSERT_EQ(game.Candidates().Count(), hurdlewords.Hurdles().size());
+
+  size_t previous = game.Candidates().Count();
+  for (const std::string& guess : {"crane", "tight"}) {
+    SubmitWord(game, guess);
+    const HurdleState& state = game.GetHurdleState();
+    ASSERT_EQ(game.Candidates().Indices(),
+              engine.FilterCandidates(state.GetGuesses(), state.GetColors()))
+        << "Candidates should match the hurdles consistent with the board "
+           "after submitting "
+        << guess;
+    ASSERT_LT(game.Candidates().Count(), previous);
+    previous = game.Candidates().Count();
+  }
+  json game_state_json = json::parse(game.JsonFromHurdleState().dump());
+  ASSERT_EQ(game_state_json.at("remainingHurdles"), previous);
+}
+
+TEST(HurdleGame, CandidatesAreRebuiltWhenASubmittedRowIsDeleted) {
+  HurdleWords hurdlewords("data/valid_hurdles.txt", "data/valid_guesses.txt");
+  HurdleGame game(hurdlewords);
+  LoadHurdle(game, "light");
+  SubmitWord(game, "crane");
+  const size_t after_crane = game.Candidates().Count();
+  SubmitWord(game, "tight");
+  game.LetterDeleted();
+  ASSERT_EQ(game.Candidates().Count(), after_crane)
+      << "Deleting from a submitted row should drop it from the candidates.";
+  game.LetterEntered('t');
+  game.WordSubmitted();
+  game.LetterDeleted();
+  game.LetterDeleted();
+  ASSERT_EQ(game.Candidates().Count(), after_crane);
+  game.NewHurdle();
+  ASSERT_EQ(game.Candidates().Count(), hurdlewords.Hurdles().size());
+}
+
+TEST(HintEngine, FilterCandidatesKeepsHurdlesConsistentWithBoard) {
+  HurdleWords hurdlewords("data/valid_hurdles.txt", "data/valid_guesses.txt");
+  ThreadPool pool(2);
+  HintEngine engine(hurdlewords, pool);
+  std::vector<std::string> guesses = {"crane"};
+  std::vector<std::string> colors = {ColorsFromPattern(
+      ScorePattern(PackWord("crane"), PackWord("light")))};
+  std::vector<uint32_t> candidates = engine.FilterCandidates(guesses, colors);
+  ASSERT_FALSE(candidates.empty());
+  bool has_light = false;
+  for (uint32_t h : candidates) {
+    const std::string& hurdle = hurdlewords.Hurdles()[h];
+    has_light = has_light || hurdle == "light";
+    ASSERT_EQ(ColorsFromPattern(
+                  ScorePattern(PackWord("crane"), PackWord(hurdle))),
+              colors[0]);
+  }
+  ASSERT_TRUE(has_light) << "The answer should remain a candidate.";
+}
+
+TEST(HintEngine, HintNarrowsDownToTheAnswer) {
+  HurdleWords hurdlewords("data/valid_hurdles.txt", "data/valid_guesses.txt");
+  ThreadPool pool(2);
+  HintEngine engine(hurdlewords, pool);
+  engine.budget = std::chrono::seconds(60);
+  std::vector<std::string> guesses;
+  std::vector<std::string> colors;
+  for (int turn = 0; turn < 6; turn++) {
+    Hint hint = engine.HintFor(guesses, colors);
+    ASSERT_TRUE(hint.complete);
+    ASSERT_GT(hint.candidates, 0);
+    if (hint.guess == "light") {
+      return;
+    }
+    guesses.push_back(hint.guess);
+    colors.push_back(ColorsFromPattern(
+        ScorePattern(PackWord(hint.guess), PackWord("light"))));
+  }
+  FAIL() << "Following the hints should find the answer within six guesses.";
+}
+
+TEST(HintEngine, HintReturnsBestSoFarWhenBudgetRunsOut) {
+  HurdleWords hurdlewords("data/valid_hurdles.txt", "data/valid_guesses.txt");
+  ThreadPool pool(1);
+  HintEngine engine(hurdlewords, pool);
+  engine.budget = std::chrono::milliseconds(0);
+  Hint hint = engine.HintFor({}, {});
+  ASSERT_FALSE(hint.complete);
+  ASSERT_FALSE(hint.guess.empty())
+      << "An interrupted hint should still suggest a guess.";
+}
+
+// Writes a strategy table that opens with `opening` and, if the feedback is
+// the one `opening` gets against `answer`, follows up with `answer`.
+std::string WriteStrategy(const HurdleWords& words, const std::string& opening,
+                          const std::string& answer) {
+  auto index_of = [&words](const std::string& word) {
+    const std::vector<std::string>& guesses = words.Guesses();
+    return static_cast<uint32_t>(
+        std::find(guesses.begin(), guesses.end(), word) - guesses.begin());
+  };
+  StrategyHeader header{};
+  std::memcpy(header.magic, kStrategyMagic, sizeof(kStrategyMagic));
+  header.version = kStrategyVersion;
+  header.node_count = 2;
+  header.edge_count = 1;
+  header.hurdle_count = words.Hurdles().size();
+  header.guess_count = words.Guesses().size();
+  header.words_checksum = WordsChecksum(words);
+  StrategyNode nodes[2] = {{index_of(opening), 0, 1, 100, 5.5f, 3.5f},
+                           {index_of(answer), 1, 0, 1, 0, 1}};
+  StrategyEdge edge = {1, ScorePattern(PackWord(opening), PackWord(answer))};
+
+  const std::string path = testing::TempDir() + "strategy_test.bin";
+  std::ofstream out(path, std::ios::binary | std::ios::trunc);
+  out.write(reinterpret_cast<const char*>(&header), sizeof(header));
+  out.write(reinterpret_cast<const char*>(nodes), sizeof(nodes));
+  out.write(reinterpret_cast<const char*>(&edge), sizeof(edge));
+  return path;
+}
+
+TEST(StrategyTable, LookupFollowsTheBoardDownTheTree) {
+  HurdleWords hurdlewords("data/valid_hurdles.txt", "data/valid_guesses.txt");
+  StrategyTable strategy;
+  ASSERT_TRUE(strategy.Open(WriteStrategy(hurdlewords, "crane", "light"),
+                            hurdlewords));
+  const StrategyNode* node = strategy.Lookup({}, {});
+  ASSERT_NE(node, nullptr);
+  ASSERT_EQ(strategy.Guess(*node), "crane");
+
+  const std::string colors =
+      ColorsFromPattern(ScorePattern(PackWord("crane"), PackWord("light")));
+  node = strategy.Lookup({"crane", "lig"}, {colors, "GGG"});
+  ASSERT_NE(node, nullptr) << "Incomplete rows should be ignored.";
+  ASSERT_EQ(strategy.Guess(*node), "light");
+  ASSERT_EQ(strategy.Lookup({"slate"}, {"BBBBB"}), nullptr)
+      << "A board that left the tree should not be found.";
+
+  ThreadPool pool(1);
+  HintEngine engine(hurdlewords, pool);
+  engine.strategy = &strategy;
+  Hint hint = engine.HintFor({"crane"}, {colors});
+  ASSERT_EQ(hint.guess, "light");
+  ASSERT_EQ(hint.expected_guesses, 1);
+}
+
+TEST(StrategyTable, HintFollowsOnlySubmittedRows) {
+  HurdleWords hurdlewords("data/valid_hurdles.txt", "data/valid_guesses.txt");
+  StrategyTable strategy;
+  ASSERT_TRUE(strategy.Open(WriteStrategy(hurdlewords, "tight", "light"),
+                            hurdlewords));
+  ThreadPool pool(1);
+  HintEngine engine(hurdlewords, pool);
+  engine.strategy = &strategy;
+  HurdleGame game(hurdlewords);
+  LoadHurdle(game, "light");
+  game.SetHardMode(true);
+  auto hint = [&] {
+    return engine.HintFor(game.SubmittedGuesses(), game.SubmittedColors(),
+                          game.Candidates());
+  };
+
+  for (char letter : std::string("tight")) {
+    game.LetterEntered(letter);
+  }
+  ASSERT_EQ(hint().guess, "tight")
+      << "A row that was typed but not submitted should not be followed.";
+
+  game.WordSubmitted();
+  ASSERT_EQ(hint().guess, "light");
+  SubmitWord(game, "moist");
+  ASSERT_THAT(game.GetHurdleState().GetErrorMessage(),
+              testing::HasSubstr("Hard mode"));
+  Hint after_rejection = hint();
+  ASSERT_EQ(after_rejection.guess, "light")
+      << "A row rejected by hard mode should not be followed.";
+  ASSERT_EQ(after_rejection.expected_guesses, 1);
+}
+
+TEST(StrategyTable, OpenRejectsTablesForOtherWordLists) {
+  HurdleWords hurdlewords("data/valid_hurdles.txt", "data/valid_guesses.txt");
+  HurdleWords light("tools/settings/data/light.txt", "data/valid_guesses.txt");
+  const std::string path = WriteStrategy(hurdlewords, "crane", "light");
+  StrategyTable strategy;
+  ASSERT_FALSE(strategy.Open(path, light));
+  ASSERT_FALSE(strategy.Loaded());
+  ASSERT_FALSE(strategy.Open(path + ".missing", hurdlewords));
+  std::ofstream(path, std::ios::app) << "trailing bytes";
+  ASSERT_FALSE(strategy.Open(path, hurdlewords));
+}
+
+int main(int argc, char** argv) {
+  testing::InitGoogleTest(&argc, argv);
+  testing::UnitTest::GetInstance()->listeners().Append(new SkipListener());
+  return RUN_ALL_TESTS();
+}
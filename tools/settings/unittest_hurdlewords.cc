@@ -2,12 +2,21 @@
 #include <gmock/gmock.h>
 #include <gtest/gtest.h>
 
+#include <algorithm>
+#include <cstdio>
+#include <fstream>
 #include <memory>
+#include <set>
 #include <string>
+#include <vector>
 
+#include "../../daily.h"
 #include "../../hurdlewords.h"
 #include "../../hurdlestate.h"
 #include "../../hurdle.h"
+#include "../../random.h"
+#include "../../threadpool.h"
+#include "../../wordsearch.h"
 #include "../cppaudit/gtest_ext.h"
 
 using ::testing::HasSubstr;
@@ -54,6 +63,45 @@ TEST(HurdleWords, IsGuessValidFalseForTooLongGuess) {
       << "A guess is invalid if it's more than 5 characters long.";
 }
 
+TEST(HurdleWords, LoadsTheSameWordsAsStreamExtraction) {
+  HurdleWords hurdlewords("data/valid_hurdles.txt", "data/valid_guesses.txt");
+  std::vector<std::string> hurdles;
+  std::ifstream hurdles_file("data/valid_hurdles.txt");
+  for (std::string word; hurdles_file >> word;) {
+    hurdles.push_back(word);
+  }
+  std::vector<std::string> guesses;
+  std::set<std::string> seen;
+  std::ifstream guesses_file("data/valid_guesses.txt");
+  for (std::string word; guesses_file >> word;) {
+    if (seen.insert(word).second) {
+      guesses.push_back(word);
+    }
+  }
+  ASSERT_EQ(hurdlewords.Hurdles(), hurdles);
+  ASSERT_EQ(hurdlewords.Guesses(), guesses);
+}
+
+TEST(HurdleWords, SplitsWordsOnAnyWhitespace) {
+  const std::string hurdles_path = testing::TempDir() + "hurdles.txt";
+  const std::string guesses_path = testing::TempDir() + "guesses.txt";
+  std::ofstream(hurdles_path) << "  crane\r\nslate\t\n\nbrick";
+  std::ofstream(guesses_path) << "crane slate\r\ncrane\fbrick\v\n";
+  HurdleWords hurdlewords(hurdles_path, guesses_path);
+  std::remove(hurdles_path.c_str());
+  std::remove(guesses_path.c_str());
+  const std::vector<std::string> words = {"crane", "slate", "brick"};
+  ASSERT_EQ(hurdlewords.Hurdles(), words);
+  ASSERT_EQ(hurdlewords.Guesses(), words)
+      << "Duplicate guesses should be listed once, in file order.";
+}
+
+TEST(HurdleWords, MissingFilesLoadNoWords) {
+  HurdleWords hurdlewords("data/missing_hurdles.txt", "data/missing.txt");
+  ASSERT_TRUE(hurdlewords.Hurdles().empty());
+  ASSERT_FALSE(hurdlewords.IsGuessValid("hello"));
+}
+
 TEST(HurdleWords, GetRandomHurdleValidLength) {
   HurdleWords hurdlewords("data/valid_hurdles.txt", "data/valid_guesses.txt");
   std::string hurdle1 = hurdlewords.GetRandomHurdle();
@@ -79,6 +127,223 @@ TEST(HurdleWords, RandomHurdleIsGuessValid) {
       << "The word " << hurdle << " should be a valid guess.";
 }
 
+TEST(HurdleWords, LookupCountIsSharedAcrossThreadsAndCopies) {
+  HurdleWords hurdlewords("data/valid_hurdles.txt", "data/valid_guesses.txt");
+  HurdleWords copy = hurdlewords;
+  ThreadPool pool(4);
+  pool.ParallelFor(0, 1000, 10, [&](size_t begin, size_t end) {
+    for (size_t i = begin; i < end; i++) {
+      copy.IsGuessValid("light");
+    }
+  });
+  EXPECT_EQ(hurdlewords.LookupCount(), 1000);
+}
+
+TEST(HurdleWords, SubmittedGuessIsLookedUpOnce) {
+  HurdleWords hurdlewords("tools/settings/data/light.txt",
+                          "data/valid_guesses.txt");
+  HurdleGame game(hurdlewords);
+  const uint64_t before = hurdlewords.LookupCount();
+  SubmitWord(game, "tight");
+  EXPECT_EQ(hurdlewords.LookupCount() - before, 1)
+      << "An accepted guess should only be looked up in the dictionary once.";
+}
+
+TEST(HurdleWords, DifficultyScoresEveryHurdle) {
+  HurdleWords hurdlewords("data/valid_hurdles.txt", "data/valid_guesses.txt");
+  ThreadPool pool(2);
+  hurdlewords.Difficulties().Compute(pool);
+  ASSERT_TRUE(hurdlewords.Difficulties().Ready());
+  for (size_t h = 0; h < hurdlewords.Hurdles().size(); h++) {
+    ASSERT_GE(hurdlewords.Difficulties().Guesses(h), 1)
+        << hurdlewords.Hurdles()[h] << " should take at least one guess.";
+    ASSERT_LE(hurdlewords.Difficulties().Guesses(h), 10)
+        << hurdlewords.Hurdles()[h] << " should not take that many guesses.";
+  }
+}
+
+TEST(HurdleWords, HardHurdlesTakeMoreGuessesThanEasyOnes) {
+  HurdleWords hurdlewords("data/valid_hurdles.txt", "data/valid_guesses.txt");
+  ThreadPool pool(2);
+  hurdlewords.Difficulties().Compute(pool);
+  const std::vector<std::string>& hurdles = hurdlewords.Hurdles();
+  auto average_guesses = [&](Difficulty difficulty) {
+    double total = 0;
+    for (int i = 0; i < 2000; i++) {
+      const std::string& hurdle = hurdlewords.GetRandomHurdle(difficulty);
+      const size_t h =
+          std::find(hurdles.begin(), hurdles.end(), hurdle) - hurdles.begin();
+      total += hurdlewords.Difficulties().Guesses(h);
+    }
+    return total / 2000;
+  };
+  const double easy = average_guesses(Difficulty::kEasy);
+  const double medium = average_guesses(Difficulty::kMedium);
+  const double hard = average_guesses(Difficulty::kHard);
+  ASSERT_LT(easy, medium) << "Easy hurdles should take fewer guesses.";
+  ASSERT_LT(medium, hard) << "Hard hurdles should take more guesses.";
+}
+
+TEST(HurdleGame, NewHurdleWithDifficultyPicksValidHurdle) {
+  HurdleWords hurdlewords("data/valid_hurdles.txt", "data/valid_guesses.txt");
+  ThreadPool pool(2);
+  hurdlewords.Difficulties().Compute(pool);
+  HurdleGame game(hurdlewords);
+  game.NewHurdle(Difficulty::kHard);
+  ASSERT_TRUE(hurdlewords.IsGuessValid(game.GetHurdleState().GetHurdle()))
+      << "A hard hurdle should still be a valid guess.";
+}
+
+TEST(Random, RandomBelowIsInRangeAndCoversIt) {
+  std::vector<int> counts(7);
+  for (int i = 0; i < 7000; i++) {
+    const uint64_t value = RandomBelow(7);
+    ASSERT_LT(value, 7);
+    counts[value]++;
+  }
+  for (int count : counts) {
+    ASSERT_GT(count, 800) << "RandomBelow should be close to uniform.";
+  }
+}
+
+TEST(Random, SeedThreadRandomReplaysTheSameHurdles) {
+  HurdleWords hurdlewords("data/valid_hurdles.txt", "data/valid_guesses.txt");
+  std::vector<std::string> first;
+  SeedThreadRandom(42);
+  for (int i = 0; i < 10; i++) {
+    first.push_back(hurdlewords.GetRandomHurdle());
+  }
+  SeedThreadRandom(42);
+  for (int i = 0; i < 10; i++) {
+    ASSERT_EQ(hurdlewords.GetRandomHurdle(), first[i])
+        << "The same seed should give the same hurdles.";
+  }
+}
+
+TEST(DailySchedule, ParseDate) {
+  int64_t day;
+  ASSERT_TRUE(DailySchedule::ParseDate("1970-01-01", &day));
+  ASSERT_EQ(day, 0);
+  ASSERT_TRUE(DailySchedule::ParseDate("2026-10-18", &day));
+  ASSERT_EQ(day, 20744);
+  ASSERT_TRUE(DailySchedule::ParseDate("2000-02-29", &day));
+  ASSERT_FALSE(DailySchedule::ParseDate("2001-02-29", &day));
+  ASSERT_FALSE(DailySchedule::ParseDate("2026-13-01", &day));
+  ASSERT_FALSE(DailySchedule::ParseDate("2026-10-18x", &day));
+  ASSERT_FALSE(DailySchedule::ParseDate("yesterday", &day));
+}
+
+TEST(DailySchedule, EveryServerAgreesOnTheDailyHurdle) {
+  HurdleWords hurdlewords("data/valid_hurdles.txt", "data/valid_guesses.txt");
+  DailySchedule one(hurdlewords, 1234);
+  DailySchedule other(hurdlewords, 1234);
+  DailySchedule rekeyed(hurdlewords, 5678);
+  int differences = 0;
+  for (int64_t day = 20700; day < 20800; day++) {
+    ASSERT_EQ(one.Hurdle(day, "us"), other.Hurdle(day, "us"));
+    differences += one.Hurdle(day, "us") != one.Hurdle(day, "eu");
+    differences += one.Hurdle(day, "us") != rekeyed.Hurdle(day, "us");
+  }
+  ASSERT_GT(differences, 150)
+      << "Regions and keys should get different daily hurdles.";
+}
+
+TEST(DailySchedule, DailyHurdleDoesNotDependOnTheBuild) {
+  HurdleWords hurdlewords("data/valid_hurdles.txt", "data/valid_guesses.txt");
+  DailySchedule daily(hurdlewords, 1234);
+  // Pinned, so that a change to the hashing, which would give servers built
+  // differently different puzzles, fails here.
+  ASSERT_EQ(HashBytes("us"), 0x08c43d07b566de99ull);
+  ASSERT_EQ(daily.Hurdle(20744, "us"), "spied");
+  ASSERT_EQ(daily.Hurdle(20744, ""), "wooly");
+}
+
+TEST(DailySchedule, NoHurdlesGivesAnEmptyHurdle) {
+  HurdleWords hurdlewords("/dev/null", "data/valid_guesses.txt");
+  ASSERT_TRUE(hurdlewords.Hurdles().empty());
+  DailySchedule daily(hurdlewords, 1234);
+  ASSERT_EQ(daily.Hurdle(20744, "us"), "");
+}
+
+TEST(DailySchedule, HurdlesRepeatOnlyAfterEveryHurdleWasPlayed) {
+  HurdleWords hurdlewords("data/valid_hurdles.txt", "data/valid_guesses.txt");
+  DailySchedule daily(hurdlewords, 1234);
+  const int64_t n = hurdlewords.Hurdles().size();
+  std::multiset<std::string> played;
+  std::multiset<std::string> all(hurdlewords.Hurdles().begin(),
+                                 hurdlewords.Hurdles().end());
+  for (int64_t day = 0; day < n; day++) {
+    played.insert(daily.Hurdle(day, "us"));
+  }
+  ASSERT_EQ(played, all) << "One pass of days should play every hurdle once.";
+  ASSERT_TRUE(hurdlewords.IsGuessValid(daily.Hurdle(-1, "us")));
+}
+
+// Returns the words matching a query, checking every word one by one.
+std::vector<std::string> NaiveSearch(const std::vector<std::string> &words,
+                                     const std::string &pattern,
+                                     const std::string &include,
+                                     const std::string &exclude) {
+  std::vector<std::string> matches;
+  for (const std::string &word : words) {
+    bool match = true;
+    for (size_t i = 0; i < pattern.size(); i++) {
+      match = match && (pattern[i] == '?' || pattern[i] == word[i]);
+    }
+    for (char letter : include) {
+      match = match && std::count(word.begin(), word.end(), letter) >=
+                           std::count(include.begin(), include.end(), letter);
+    }
+    for (char letter : exclude) {
+      match = match && word.find(letter) == std::string::npos;
+    }
+    if (match) {
+      matches.push_back(word);
+    }
+  }
+  return matches;
+}
+
+TEST(WordSearch, MatchesEveryWordANaiveSearchMatches) {
+  HurdleWords hurdlewords("data/valid_hurdles.txt", "data/valid_guesses.txt");
+  const std::vector<std::string> &guesses = hurdlewords.Guesses();
+  const std::vector<std::vector<std::string>> queries = {
+      {"?a??e", "rt", "so"}, {"", "", ""},        {"s????", "", "aeiou"},
+      {"", "ee", ""},        {"?????", "xyz", ""}, {"crane", "", ""},
+      {"", "", "etaoin"},    {"?l???", "aa", "s"}};
+  for (const std::vector<std::string> &query : queries) {
+    std::vector<uint32_t> indices;
+    ASSERT_TRUE(hurdlewords.Search().Search(query[0], query[1], query[2],
+                                            &indices));
+    std::vector<std::string> matches;
+    for (uint32_t index : indices) {
+      matches.push_back(guesses[index]);
+    }
+    EXPECT_EQ(matches, NaiveSearch(guesses, query[0], query[1], query[2]))
+        << "pattern=" << query[0] << " include=" << query[1]
+        << " exclude=" << query[2];
+  }
+}
+
+TEST(WordSearch, AcceptsCommasAndUppercase) {
+  WordSearch search({"later", "water", "hater", "taler"});
+  std::vector<uint32_t> matches;
+  ASSERT_TRUE(search.Search("?A??.", "r,T", "H,w", &matches));
+  EXPECT_EQ(matches, std::vector<uint32_t>({0, 3}));
+}
+
+TEST(WordSearch, RejectsMalformedQueries) {
+  WordSearch search({"later", "LATER", "late", "water"});
+  std::vector<uint32_t> matches;
+  EXPECT_FALSE(search.Search("?a??", "", "", &matches));
+  EXPECT_FALSE(search.Search("?a?!e", "", "", &matches));
+  EXPECT_FALSE(search.Search("", "r1", "", &matches));
+  EXPECT_FALSE(search.Search("", "", "-", &matches));
+  // Words that are not five lowercase letters never match.
+  ASSERT_TRUE(search.Search("", "", "", &matches));
+  EXPECT_EQ(matches, std::vector<uint32_t>({0, 3}));
+}
+
 int main(int argc, char** argv) {
   testing::InitGoogleTest(&argc, argv);
   ::testing::UnitTest::GetInstance()->listeners().Append(new SkipListener());
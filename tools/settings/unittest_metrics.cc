@@ -0,0 +1,146 @@
+#include <gmock/gmock-matchers.h>
+#include <gmock/gmock.h>
+#include <gtest/gtest.h>
+
+#include <algorithm>
+#include <chrono>
+#include <cstdint>
+#include <cstdlib>
+#include <sstream>
+#include <string>
+#include <vector>
+
+#include "../../server_utils/metrics.h"
+#include "../cppaudit/gtest_ext.h"
+
+using ::testing::HasSubstr;
+
+// Returns the lines of `text` that start with `prefix`.
+std::vector<std::string> LinesStartingWith(const std::string& text,
+                                           const std::string& prefix) {
+  std::vector<std::string> lines;
+  std::istringstream in(text);
+  std::string line;
+  while (std::getline(in, line)) {
+    if (line.compare(0, prefix.size(), prefix) == 0) {
+      lines.push_back(line);
+    }
+  }
+  return lines;
+}
+
+// Returns the number of times `needle` occurs in `text`.
+size_t Occurrences(const std::string& text, const std::string& needle) {
+  size_t count = 0;
+  for (size_t at = text.find(needle); at != std::string::npos;
+       at = text.find(needle, at + 1)) {
+    count++;
+  }
+  return count;
+}
+
+TEST(LatencyHistogram, BucketEdges) {
+  EXPECT_EQ(LatencyHistogram::Bucket(0), 0);
+  EXPECT_EQ(LatencyHistogram::Bucket(3), 3);
+  EXPECT_EQ(LatencyHistogram::Bucket(4), 4);
+  EXPECT_EQ(LatencyHistogram::Bucket(7), 7);
+  EXPECT_EQ(LatencyHistogram::Bucket(8), 8);
+  EXPECT_EQ(LatencyHistogram::Bucket(9), 8);
+  EXPECT_EQ(LatencyHistogram::Bucket(10), 9);
+  EXPECT_EQ(LatencyHistogram::Bucket(UINT64_MAX),
+            LatencyHistogram::kBuckets - 1)
+      << "Latencies past the last bound should land in the last bucket.";
+}
+
+TEST(LatencyHistogram, EveryLatencyIsBelowTheBoundOfItsBucket) {
+  const uint64_t last = uint64_t{1} << 26;
+  for (uint64_t micros = 0; micros < last; micros += 1 + micros / 7) {
+    const size_t bucket = LatencyHistogram::Bucket(micros);
+    ASSERT_LT(micros, LatencyHistogram::UpperBoundMicros(bucket))
+        << micros << " us is past the bound of bucket " << bucket;
+    if (bucket > 0) {
+      ASSERT_GE(micros, LatencyHistogram::UpperBoundMicros(bucket - 1))
+          << micros << " us belongs in an earlier bucket than " << bucket;
+    }
+  }
+}
+
+TEST(LatencyHistogram, BoundsOnlyIncrease) {
+  for (size_t i = 1; i + 1 < LatencyHistogram::kBuckets; i++) {
+    ASSERT_GT(LatencyHistogram::UpperBoundMicros(i),
+              LatencyHistogram::UpperBoundMicros(i - 1))
+        << "bucket " << i;
+    // Every bucket is at most 25% wide.
+    const uint64_t low = LatencyHistogram::UpperBoundMicros(i - 1);
+    ASSERT_LE(LatencyHistogram::UpperBoundMicros(i) - low,
+              std::max<uint64_t>(1, low / 4))
+        << "bucket " << i;
+  }
+}
+
+TEST(MetricsRegistry, ExportsCumulativeHistogramBuckets) {
+  MetricsRegistry metrics;
+  LatencyHistogram& histogram =
+      metrics.AddHistogram("latency_seconds", "Latency.", "route=\"/game\"");
+  histogram.Record(std::chrono::microseconds(2));
+  histogram.Record(std::chrono::microseconds(5));
+  histogram.Record(std::chrono::microseconds(5));
+  histogram.Record(std::chrono::hours(1));
+  const std::string text = metrics.Export();
+
+  std::vector<std::string> buckets =
+      LinesStartingWith(text, "latency_seconds_bucket{");
+  ASSERT_EQ(buckets.size(), LatencyHistogram::kBuckets);
+  double previous_le = -1;
+  uint64_t previous_count = 0;
+  for (size_t i = 0; i < buckets.size(); i++) {
+    const std::string& line = buckets[i];
+    ASSERT_THAT(line, HasSubstr("route=\"/game\",le=\""));
+    const size_t le_start = line.find("le=\"") + 4;
+    const std::string le =
+        line.substr(le_start, line.find('"', le_start) - le_start);
+    const uint64_t count = std::strtoull(line.c_str() + line.rfind(' ') + 1,
+                                         nullptr, 10);
+    ASSERT_GE(count, previous_count) << line;
+    previous_count = count;
+    if (i + 1 == buckets.size()) {
+      ASSERT_EQ(le, "+Inf");
+      continue;
+    }
+    const double bound = std::strtod(le.c_str(), nullptr);
+    ASSERT_GT(bound, previous_le) << line;
+    previous_le = bound;
+    // Latencies are below the bound of their bucket.
+    const uint64_t expected = (bound > 2e-6) + 2 * (bound > 5e-6);
+    ASSERT_EQ(count, expected) << line;
+  }
+  EXPECT_EQ(previous_count, 4);
+  EXPECT_EQ(LinesStartingWith(text, "latency_seconds_count{route=\"/game\"} 4")
+                .size(),
+            1);
+  EXPECT_EQ(LinesStartingWith(text, "latency_seconds_sum{").size(), 1);
+}
+
+TEST(MetricsRegistry, WritesHelpAndTypeOncePerName) {
+  MetricsRegistry metrics;
+  metrics.AddCounter("requests_total", "Requests.", "route=\"/game\"").Add(3);
+  metrics.AddGauge("in_flight", "Requests being handled.", [] { return 2; });
+  metrics.AddCounter("requests_total", "Requests.", "route=\"/hint\"").Add();
+  const std::string text = metrics.Export();
+
+  EXPECT_EQ(Occurrences(text, "# HELP requests_total "), 1);
+  EXPECT_EQ(Occurrences(text, "# TYPE requests_total counter\n"), 1);
+  EXPECT_EQ(Occurrences(text, "# TYPE in_flight gauge\n"), 1);
+  EXPECT_THAT(text, HasSubstr("# TYPE requests_total counter\n"
+                              "requests_total{route=\"/game\"} 3\n"
+                              "requests_total{route=\"/hint\"} 1\n"))
+      << "Metrics sharing a name should be written together, after their "
+         "HELP and TYPE.";
+  EXPECT_THAT(text, HasSubstr("in_flight 2\n"));
+}
+
+int main(int argc, char** argv) {
+  testing::InitGoogleTest(&argc, argv);
+  testing::UnitTest::GetInstance()->listeners().Append(new SkipListener());
+  return RUN_ALL_TESTS();
+}
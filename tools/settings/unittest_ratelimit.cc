@@ -0,0 +1,211 @@
+#include <gmock/gmock-matchers.h>
+#include <gmock/gmock.h>
+#include <gtest/gtest.h>
+
+#include <chrono>
+#include <string>
+#include <thread>
+
+#include "../../server_utils/ratelimit.h"
+#include "../cppaudit/gtest_ext.h"
+
+constexpr int64_t kSecond = 1000000000;
+
+TEST(BucketTable, AllowsTheBurstThenRejects) {
+  BucketTable buckets;
+  for (int i = 0; i < 3; i++) {
+    EXPECT_TRUE(buckets.TryTake("10.0.0.1", 1, 3, 0)) << "request " << i;
+  }
+  EXPECT_FALSE(buckets.TryTake("10.0.0.1", 1, 3, 0));
+}
+
+TEST(BucketTable, RefillsAtTheRate) {
+  BucketTable buckets;
+  EXPECT_TRUE(buckets.TryTake("10.0.0.1", 2, 1, 0));
+  EXPECT_FALSE(buckets.TryTake("10.0.0.1", 2, 1, kSecond / 4));
+  EXPECT_TRUE(buckets.TryTake("10.0.0.1", 2, 1, kSecond * 3 / 4));
+  // Refills stop at the burst.
+  EXPECT_TRUE(buckets.TryTake("10.0.0.1", 2, 1, 100 * kSecond));
+  EXPECT_FALSE(buckets.TryTake("10.0.0.1", 2, 1, 100 * kSecond));
+}
+
+TEST(BucketTable, KeepsOneBucketPerKey) {
+  BucketTable buckets;
+  EXPECT_TRUE(buckets.TryTake("10.0.0.1", 1, 1, 0));
+  EXPECT_FALSE(buckets.TryTake("10.0.0.1", 1, 1, 0));
+  EXPECT_TRUE(buckets.TryTake("10.0.0.2", 1, 1, 0));
+}
+
+TEST(BucketTable, EvictsTheLeastRecentlyUsedBuckets) {
+  BucketTable buckets(16);
+  EXPECT_TRUE(buckets.TryTake("victim", 1, 1, 0));
+  EXPECT_FALSE(buckets.TryTake("victim", 1, 1, 0));
+  // Far more keys than the table holds, each used later than the victim.
+  for (int i = 0; i < 10000; i++) {
+    buckets.TryTake("key" + std::to_string(i), 1, 1, i + 1);
+  }
+  // The victim's empty bucket was evicted, so it starts from a full one.
+  EXPECT_TRUE(buckets.TryTake("victim", 1, 1, 10001));
+}
+
+// Runs requests through a RateLimitMiddleware, as Crow would.
+class RateLimit : public testing::Test {
+ protected:
+  // Returns the status of a request from `ip` with the session token
+  // `session`: 0 if it was admitted, which completes it at once.
+  int Request(const std::string& ip, const std::string& session = "") {
+    crow::request req;
+    req.remote_ip_address = ip;
+    if (!session.empty()) {
+      req.add_header(middleware_.header_name, session);
+    }
+    crow::response res;
+    RateLimitMiddleware::context ctx;
+    middleware_.before_handle(req, res, ctx);
+    if (!ctx.admitted) {
+      EXPECT_EQ(res.get_header_value("Retry-After"), "1");
+      return res.code;
+    }
+    middleware_.after_handle(req, res, ctx);
+    return 0;
+  }
+
+  // Admits a request for `url` that took `latency`, and returns its status.
+  int SlowRequest(std::chrono::milliseconds latency,
+                  const std::string& url = "/game") {
+    crow::request req;
+    req.url = url;
+    req.remote_ip_address = "10.0.0.1";
+    crow::response res;
+    RateLimitMiddleware::context ctx;
+    middleware_.before_handle(req, res, ctx);
+    if (!ctx.admitted) {
+      return res.code;
+    }
+    ctx.start -= latency;
+    middleware_.after_handle(req, res, ctx);
+    return 0;
+  }
+
+  // Admits three requests of 2 s, which raise the average latency to about
+  // 285 ms.
+  void SlowRequests() {
+    for (int i = 0; i < 3; i++) {
+      ASSERT_EQ(SlowRequest(std::chrono::seconds(2)), 0) << "request " << i;
+    }
+  }
+
+  RateLimitMiddleware middleware_;
+};
+
+TEST_F(RateLimit, RejectsFloodsFromOneIpWith429) {
+  middleware_.ip_burst = 3;
+  middleware_.ip_rate = 0.001;
+  middleware_.new_session_burst = 100;
+  for (int i = 0; i < 3; i++) {
+    EXPECT_EQ(Request("10.0.0.1"), 0) << "request " << i;
+  }
+  EXPECT_EQ(Request("10.0.0.1"), 429);
+  EXPECT_EQ(Request("10.0.0.2"), 0);
+  EXPECT_EQ(middleware_.RateLimitedCount(), 1);
+  EXPECT_EQ(middleware_.ShedCount(), 0);
+}
+
+TEST_F(RateLimit, LimitsRequestsOfOneSession) {
+  middleware_.session_burst = 2;
+  middleware_.session_rate = 0.001;
+  middleware_.is_live_session = [](const std::string& token) {
+    return token == "live";
+  };
+  EXPECT_EQ(Request("10.0.0.1", "live"), 0);
+  EXPECT_EQ(Request("10.0.0.2", "live"), 0);
+  EXPECT_EQ(Request("10.0.0.3", "live"), 429);
+}
+
+TEST_F(RateLimit, ChargesUnknownTokensAsNewSessions) {
+  middleware_.new_session_burst = 2;
+  middleware_.new_session_rate = 0.001;
+  middleware_.is_live_session = [](const std::string& token) {
+    return token == "live";
+  };
+  EXPECT_EQ(Request("10.0.0.1"), 0);
+  // A made-up token would get a new session too.
+  EXPECT_EQ(Request("10.0.0.1", "made-up"), 0);
+  EXPECT_EQ(Request("10.0.0.1", "another"), 429);
+  EXPECT_EQ(Request("10.0.0.1"), 429);
+  // Live sessions are only limited by their own bucket.
+  EXPECT_EQ(Request("10.0.0.1", "live"), 0);
+}
+
+TEST_F(RateLimit, ShedsWith503WhenTooManyRequestsAreInFlight) {
+  middleware_.max_in_flight = 1;
+  crow::request req;
+  req.remote_ip_address = "10.0.0.1";
+  crow::response res;
+  RateLimitMiddleware::context ctx;
+  middleware_.before_handle(req, res, ctx);
+  ASSERT_TRUE(ctx.admitted);
+  EXPECT_EQ(middleware_.InFlight(), 1);
+  EXPECT_EQ(Request("10.0.0.2"), 503);
+  EXPECT_EQ(middleware_.ShedCount(), 1);
+  middleware_.after_handle(req, res, ctx);
+  EXPECT_EQ(middleware_.InFlight(), 0);
+  EXPECT_EQ(Request("10.0.0.2"), 0);
+}
+
+TEST_F(RateLimit, ShedsWith503WhenHandlersAreSlow) {
+  middleware_.max_latency = std::chrono::milliseconds(250);
+  middleware_.latency_half_life = std::chrono::minutes(1);
+  SlowRequests();
+  EXPECT_EQ(Request("10.0.0.1"), 503);
+  EXPECT_EQ(middleware_.ShedCount(), 1);
+}
+
+TEST_F(RateLimit, SheddingDoesNotEndByItself) {
+  middleware_.latency_half_life = std::chrono::minutes(1);
+  SlowRequests();
+  // Shedding requests does not lower the average, only time does.
+  for (int i = 0; i < 1000; i++) {
+    ASSERT_EQ(Request("10.0.0.1"), 503) << "request " << i;
+  }
+}
+
+TEST_F(RateLimit, SheddingEndsOnceTheLatencyHasDecayed) {
+  middleware_.latency_half_life = std::chrono::milliseconds(10);
+  SlowRequests();
+  // Eight half-lives bring the average below 2 ms.
+  std::this_thread::sleep_for(std::chrono::milliseconds(80));
+  EXPECT_EQ(Request("10.0.0.1"), 0);
+}
+
+TEST_F(RateLimit, LeavesUnmeasuredPathsOutOfTheLatency) {
+  middleware_.latency_half_life = std::chrono::minutes(1);
+  middleware_.unmeasured_prefixes = {"/debug/"};
+  for (int i = 0; i < 3; i++) {
+    ASSERT_EQ(SlowRequest(std::chrono::seconds(60), "/debug/pprof/profile"),
+              0)
+        << "request " << i;
+  }
+  EXPECT_EQ(Request("10.0.0.1"), 0);
+  SlowRequests();
+  EXPECT_EQ(Request("10.0.0.1"), 503);
+}
+
+TEST_F(RateLimit, IgnoresPreflights) {
+  middleware_.ip_burst = 0;
+  crow::request req;
+  req.method = crow::HTTPMethod::OPTIONS;
+  req.remote_ip_address = "10.0.0.1";
+  crow::response res;
+  RateLimitMiddleware::context ctx;
+  middleware_.before_handle(req, res, ctx);
+  EXPECT_FALSE(ctx.admitted);
+  EXPECT_EQ(res.code, 200);
+  EXPECT_EQ(middleware_.RateLimitedCount(), 0);
+}
+
+int main(int argc, char** argv) {
+  testing::InitGoogleTest(&argc, argv);
+  testing::UnitTest::GetInstance()->listeners().Append(new SkipListener());
+  return RUN_ALL_TESTS();
+}
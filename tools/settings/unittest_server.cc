@@ -0,0 +1,146 @@
+#include <gmock/gmock-matchers.h>
+#include <gmock/gmock.h>
+#include <gtest/gtest.h>
+
+#include <nlohmann/json.hpp>
+#include <string>
+#include <utility>
+#include <vector>
+
+#include "../../hurdleserver.h"
+#include "../cppaudit/gtest_ext.h"
+
+using json = nlohmann::json;
+
+// Runs requests through a HurdleServer in-process, as tools/replay does. The
+// only hurdle is "light", and every request carries the session token of the
+// first response.
+class Server : public testing::Test {
+ protected:
+  Server()
+      : hurdlewords_("tools/settings/data/light.txt",
+                     "data/valid_guesses.txt"),
+        server_(hurdlewords_, 1, startup_) {
+    server_.DisableClientRateLimits();
+    server_.app.validate();
+  }
+
+  crow::response Get(const std::string& url, const std::string& player = "",
+                     std::vector<std::pair<std::string, std::string>>
+                         headers = {}) {
+    crow::request req;
+    req.method = crow::HTTPMethod::GET;
+    req.raw_url = url;
+    req.url = url.substr(0, url.find('?'));
+    req.url_params = crow::query_string(url);
+    req.remote_ip_address = "127.0.0.1";
+    if (!session_.empty()) {
+      headers.emplace_back("X-Hurdle-Game-ID", session_);
+    }
+    if (!player.empty()) {
+      headers.emplace_back("X-Hurdle-Player-ID", player);
+    }
+    for (const auto& [name, value] : headers) {
+      req.add_header(name, value);
+    }
+    crow::response res;
+    server_.app.handle_in_process(req, res);
+    if (session_.empty()) {
+      session_ = res.get_header_value("X-Hurdle-Game-ID");
+    }
+    return res;
+  }
+
+  // Types `word` one key at a time.
+  void Type(const std::string& word, const std::string& player) {
+    for (char letter : word) {
+      ASSERT_EQ(Get("/wordle_key_pressed/" + std::string(1, letter), player)
+                    .code,
+                200);
+    }
+  }
+
+  HurdleWords hurdlewords_;
+  StartupTimer startup_;
+  HurdleServer server_;
+  std::string session_;
+};
+
+TEST_F(Server, KeystrokeThatEndsTheGameIsCreditedToThePlayer) {
+  // The session only ever types, so the keystrokes must bind the player.
+  Type("lighta", "alice");
+  json game_state_json = json::parse(Get("/game", "alice").body);
+  ASSERT_EQ(game_state_json.at("gameStatus"), "win")
+      << "Typing past the winning row should submit it.";
+  json leaderboard_json = json::parse(Get("/leaderboard", "alice").body);
+  EXPECT_EQ(leaderboard_json.at("you").at("wins"), 1)
+      << "A win ended by a keystroke should be recorded for the player.";
+}
+
+TEST_F(Server, KeystrokeWithAnotherPlayerIdIsRejected) {
+  Get("/new_game", "alice");
+  EXPECT_EQ(Get("/wordle_key_pressed/l", "mallory").code, 403);
+  json game_state_json = json::parse(Get("/game").body);
+  EXPECT_TRUE(game_state_json.at("guessedWords").empty());
+}
+
+TEST(ETagMatches, ComparesEveryListedTag) {
+  const std::string etag = "\"token-3\"";
+  EXPECT_TRUE(ETagMatches("\"token-3\"", etag));
+  EXPECT_TRUE(ETagMatches("*", etag));
+  EXPECT_TRUE(ETagMatches("W/\"token-3\"", etag))
+      << "If-None-Match should compare weak validators too.";
+  EXPECT_TRUE(ETagMatches("\"token-1\", W/\"token-2\",\"token-3\"", etag));
+  EXPECT_TRUE(ETagMatches(" \"token-1\" ,  \"token-3\" ", etag));
+  EXPECT_FALSE(ETagMatches("", etag));
+  EXPECT_FALSE(ETagMatches("\"token-33\"", etag));
+  EXPECT_FALSE(ETagMatches("\"token-3-gzip\"", etag))
+      << "The tag of another encoding should not match.";
+  EXPECT_FALSE(ETagMatches("\"token-1\", \"token-2\"", etag));
+  EXPECT_FALSE(ETagMatches("token-3", etag));
+}
+
+TEST_F(Server, UnchangedGameStateIsNotModified) {
+  crow::response res = Get("/game");
+  ASSERT_EQ(res.code, 200);
+  const std::string etag = res.get_header_value("ETag");
+  ASSERT_FALSE(etag.empty());
+
+  res = Get("/game", "", {{"If-None-Match", etag}});
+  EXPECT_EQ(res.code, 304);
+  EXPECT_TRUE(res.body.empty());
+  EXPECT_EQ(res.get_header_value("ETag"), etag);
+  EXPECT_EQ(Get("/game", "", {{"If-None-Match", "W/" + etag}}).code, 304);
+
+  Get("/wordle_key_pressed/l");
+  res = Get("/game", "", {{"If-None-Match", etag}});
+  EXPECT_EQ(res.code, 200) << "A changed game should be sent again.";
+  EXPECT_NE(res.get_header_value("ETag"), etag);
+}
+
+TEST_F(Server, CompressedGameStateHasItsOwnETag) {
+  Type("tightmoistcrane", "");
+  crow::response plain = Get("/game");
+  crow::response gzip = Get("/game", "", {{"Accept-Encoding", "gzip"}});
+  ASSERT_EQ(gzip.get_header_value("Content-Encoding"), "gzip")
+      << "The game state should be large enough to be compressed.";
+  const std::string etag = plain.get_header_value("ETag");
+  const std::string gzip_etag = gzip.get_header_value("ETag");
+  EXPECT_EQ(gzip_etag, etag.substr(0, etag.size() - 1) + "-gzip\"");
+  EXPECT_EQ(Get("/game", "", {{"If-None-Match", etag}}).code, 304);
+  EXPECT_EQ(Get("/game", "",
+                {{"Accept-Encoding", "gzip"}, {"If-None-Match", etag}})
+                .code,
+            200)
+      << "An identity ETag should not validate the gzip body.";
+  EXPECT_EQ(Get("/game", "",
+                {{"Accept-Encoding", "gzip"}, {"If-None-Match", gzip_etag}})
+                .code,
+            304);
+}
+
+int main(int argc, char** argv) {
+  testing::InitGoogleTest(&argc, argv);
+  testing::UnitTest::GetInstance()->listeners().Append(new SkipListener());
+  return RUN_ALL_TESTS();
+}
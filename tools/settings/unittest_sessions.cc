@@ -0,0 +1,192 @@
+#include <gmock/gmock-matchers.h>
+#include <gmock/gmock.h>
+#include <gtest/gtest.h>
+
+#include <nlohmann/json.hpp>
+#include <sstream>
+#include <string>
+
+#include "../../hurdle.h"
+#include "../../hurdlewords.h"
+#include "../../server_utils/sessions.h"
+#include "../cppaudit/gtest_ext.h"
+
+using ::testing::HasSubstr;
+using json = nlohmann::json;
+
+// Runs requests through a SessionMiddleware whose sessions hold a string,
+// saved and loaded as a single word.
+class Sessions : public testing::Test {
+ protected:
+  typedef SessionMiddleware<std::string> Middleware;
+
+  Sessions() { middleware_.constructor = [] { return std::string("new"); }; }
+
+  // Sends a request with the session token `token`, and returns its
+  // response. The session's data, if any, is copied to `data`.
+  crow::response Request(const std::string& token,
+                         std::string* data = nullptr) {
+    crow::request req;
+    if (!token.empty()) {
+      req.add_header(middleware_.header_name, token);
+    }
+    crow::response res;
+    Middleware::context ctx;
+    middleware_.before_handle(req, res, ctx);
+    if (res.is_completed()) {
+      return res;
+    }
+    if (data != nullptr) {
+      *data = ctx.GetData();
+    }
+    middleware_.after_handle(req, res, ctx);
+    return res;
+  }
+
+  // Returns the token of a new session holding `data`.
+  std::string NewSession(const std::string& data) {
+    crow::request req;
+    crow::response res;
+    Middleware::context ctx;
+    middleware_.before_handle(req, res, ctx);
+    ctx.GetData() = data;
+    middleware_.after_handle(req, res, ctx);
+    return res.get_header_value(middleware_.header_name);
+  }
+
+  std::string Save() {
+    std::ostringstream out;
+    middleware_.SaveSessions(
+        out, [](const std::string& data, std::ostream& out) { out << data; });
+    return out.str();
+  }
+
+  size_t Load(const std::string& saved) {
+    std::istringstream in(saved);
+    return middleware_.LoadSessions(
+        in, [](std::istream& in, std::string& data) {
+          return static_cast<bool>(in >> data);
+        });
+  }
+
+  Middleware middleware_;
+};
+
+TEST_F(Sessions, LoadRestoresSavedSessions) {
+  const std::string alice = NewSession("alice");
+  const std::string bob = NewSession("bob");
+  std::istringstream saved(Save());
+
+  // The next server starts with no sessions of its own.
+  Middleware next;
+  next.constructor = middleware_.constructor;
+  ASSERT_EQ(next.LoadSessions(saved,
+                              [](std::istream& in, std::string& data) {
+                                return static_cast<bool>(in >> data);
+                              }),
+            2);
+  std::ostringstream resaved;
+  next.SaveSessions(resaved, [](const std::string& data, std::ostream& out) {
+    out << data;
+  });
+  EXPECT_THAT(resaved.str(), HasSubstr(alice + " 0 alice\n"));
+  EXPECT_THAT(resaved.str(), HasSubstr(bob + " 0 bob\n"));
+  EXPECT_EQ(next.SessionCount(), 2);
+}
+
+TEST_F(Sessions, LoadSkipsMalformedLines) {
+  EXPECT_EQ(Load("token-1 5 alice\n"
+                 "token-2\n"
+                 "token-3 old bob\n"
+                 "token-4 5\n"
+                 "\n"
+                 "token-5 0 carol\n"),
+            2);
+  EXPECT_TRUE(middleware_.Has("token-1"));
+  EXPECT_TRUE(middleware_.Has("token-5"));
+  EXPECT_EQ(middleware_.SessionCount(), 2);
+}
+
+TEST_F(Sessions, LoadKeepsLiveSessionsWithTheSameToken) {
+  const std::string token = NewSession("live");
+  EXPECT_EQ(Load(token + " 5 handed-over\nother 5 other\n"), 1);
+  std::string data;
+  Request(token, &data);
+  EXPECT_EQ(data, "live")
+      << "A live session should not be replaced by a loaded one.";
+}
+
+TEST_F(Sessions, LoadedSessionsKeepTheirAge) {
+  middleware_.max_age = std::chrono::seconds(60);
+  Load("fresh 10 a\nstale 120 b\n");
+  // Saving sweeps the sessions older than max_age.
+  EXPECT_THAT(Save(), testing::StartsWith("fresh 10 a\n"));
+  EXPECT_FALSE(middleware_.Has("stale"));
+}
+
+TEST_F(Sessions, UnknownTokensWaitForTheHandoff) {
+  middleware_.AwaitSessions();
+  crow::response res = Request("handed-over");
+  EXPECT_EQ(res.code, 503)
+      << "A token that may still be handed over should be retried.";
+  EXPECT_EQ(res.get_header_value("Retry-After"), "1");
+  EXPECT_EQ(middleware_.SessionCount(), 0);
+  EXPECT_EQ(Request("").get_header_value("Retry-After"), "")
+      << "Requests without a token should start a session at once.";
+  EXPECT_EQ(middleware_.SessionCount(), 1);
+
+  Load("handed-over 0 alice\n");
+  std::string data;
+  res = Request("handed-over", &data);
+  EXPECT_NE(res.code, 503);
+  EXPECT_EQ(data, "alice");
+  Request("unknown", &data);
+  EXPECT_EQ(data, "new")
+      << "Once the sessions are loaded, unknown tokens start a session.";
+}
+
+TEST(SessionHandoff, GameWithARejectedRowSurvivesTheHandoff) {
+  HurdleWords hurdlewords("tools/settings/data/light.txt",
+                          "data/valid_guesses.txt");
+  auto save = [](const HurdleGame& game, std::ostream& out) {
+    game.SaveState(out);
+  };
+  auto load = [](std::istream& in, HurdleGame& game) {
+    return game.LoadState(in);
+  };
+  SessionMiddleware<HurdleGame> previous;
+  SessionMiddleware<HurdleGame> next;
+  previous.constructor = next.constructor = [&] {
+    return HurdleGame(hurdlewords);
+  };
+
+  crow::request req;
+  crow::response res;
+  SessionMiddleware<HurdleGame>::context ctx;
+  previous.before_handle(req, res, ctx);
+  SubmitWord(ctx.GetData(), "tight");
+  SubmitWord(ctx.GetData(), "zzzzz");
+  previous.after_handle(req, res, ctx);
+  const std::string token = res.get_header_value(previous.header_name);
+  std::stringstream saved;
+  previous.SaveSessions(saved, save);
+  ASSERT_EQ(next.LoadSessions(saved, load), 1);
+
+  crow::request resumed;
+  resumed.add_header(next.header_name, token);
+  crow::response resumed_res;
+  SessionMiddleware<HurdleGame>::context resumed_ctx;
+  next.before_handle(resumed, resumed_res, resumed_ctx);
+  HurdleGame& game = resumed_ctx.GetData();
+  game.WordSubmitted();
+  json game_state_json = json::parse(game.JsonFromHurdleState().dump());
+  EXPECT_EQ(game_state_json.at("errorMessage"), "Not a valid guess")
+      << "The rejected row should still be rejected after the handoff.";
+  EXPECT_EQ(game.SubmittedGuesses().size(), 1);
+}
+
+int main(int argc, char** argv) {
+  testing::InitGoogleTest(&argc, argv);
+  testing::UnitTest::GetInstance()->listeners().Append(new SkipListener());
+  return RUN_ALL_TESTS();
+}
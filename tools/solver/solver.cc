@@ -0,0 +1,588 @@
+// Computes a decision tree for Hurdle over the hurdle and guess lists and
+// writes it as a strategy table (see strategy.h) for the server to map.
+//
+// Usage: solver [--openings N] [--breadth N] [--checkpoint FILE]
+//               HURDLES_FILE GUESSES_FILE OUTPUT_FILE
+//
+// Every node tries the `breadth` guesses with the most expected information
+// (`openings` at the root) and keeps the one that needs the fewest guesses
+// in total, within six guesses per hurdle. Subtrees are memoized by their
+// set of hurdles and pruned once they can no longer beat the best guess
+// found so far. Solved subtrees are appended to the checkpoint file, so an
+// interrupted run picks up where it left off. Subtrees are solved in
+// parallel below each opening.
+
+#include <algorithm>
+#include <atomic>
+#include <chrono>
+#include <cmath>
+#include <cstdint>
+#include <cstdio>
+#include <cstring>
+#include <fstream>
+#include <iostream>
+#include <mutex>
+#include <sstream>
+#include <string>
+#include <unordered_map>
+#include <vector>
+
+#include "../../hurdlewords.h"
+#include "../../patterns.h"
+#include "../../strategy.h"
+#include "../../threadpool.h"
+
+namespace {
+
+constexpr int kMaxGuesses = 6;
+constexpr uint32_t kInfeasible = UINT32_MAX;
+
+struct Options {
+  size_t openings = 8;
+  size_t breadth = 3;
+  std::string checkpoint;
+  std::string hurdles_file;
+  std::string guesses_file;
+  std::string output_file;
+};
+
+// A set of hurdles, as sorted indices into HurdleWords::Hurdles().
+typedef std::vector<uint16_t> HurdleSet;
+
+struct Key {
+  uint64_t hash[2];
+  uint32_t depth;
+
+  bool operator==(const Key& other) const {
+    return hash[0] == other.hash[0] && hash[1] == other.hash[1] &&
+           depth == other.depth;
+  }
+};
+
+struct KeyHash {
+  size_t operator()(const Key& key) const { return key.hash[0] ^ key.depth; }
+};
+
+// The total number of guesses a subtree needs over all of its hurdles, and
+// the guess to play at its root.
+struct Result {
+  uint32_t cost = kInfeasible;
+  uint32_t guess = 0;
+};
+
+uint64_t Mix(uint64_t x) {
+  x += 0x9e3779b97f4a7c15ull;
+  x = (x ^ (x >> 30)) * 0xbf58476d1ce4e5b9ull;
+  x = (x ^ (x >> 27)) * 0x94d049bb133111ebull;
+  return x ^ (x >> 31);
+}
+
+Key MakeKey(const HurdleSet& set, int depth) {
+  Key key{{set.size(), ~uint64_t{set.size()}}, static_cast<uint32_t>(depth)};
+  for (uint16_t hurdle : set) {
+    key.hash[0] = Mix(key.hash[0] ^ hurdle);
+    key.hash[1] = Mix(key.hash[1] + hurdle * 0x2545f4914f6cdd1dull);
+  }
+  return key;
+}
+
+// The fewest guesses `size` hurdles can take: one of them guessed right
+// away, and every other one on the next guess.
+uint32_t LowerBound(size_t size) {
+  return size == 0 ? 0 : 2 * size - 1;
+}
+
+class Solver {
+ public:
+  Solver(const HurdleWords& words, ThreadPool& pool, const Options& options)
+      : words_(words),
+        pool_(pool),
+        options_(options),
+        hurdle_count_(words.Hurdles().size()),
+        guess_count_(words.Guesses().size()) {
+    std::unordered_map<std::string, uint32_t> guess_index;
+    for (uint32_t g = 0; g < guess_count_; g++) {
+      guess_index[words.Guesses()[g]] = g;
+    }
+    for (const std::string& hurdle : words.Hurdles()) {
+      hurdle_guess_.push_back(guess_index.at(hurdle));
+    }
+
+    // patterns_[g * hurdle_count_ + h] is the feedback of guess g against
+    // hurdle h.
+    const std::vector<PackedWord> guesses = PackWords(words.Guesses());
+    const std::vector<PackedWord> hurdles = PackWords(words.Hurdles());
+    patterns_.resize(guess_count_ * hurdle_count_);
+    pool_.ParallelFor(0, guess_count_, 64, [&](size_t begin, size_t end) {
+      for (size_t g = begin; g < end; g++) {
+        for (size_t h = 0; h < hurdle_count_; h++) {
+          patterns_[g * hurdle_count_ + h] =
+              ScorePattern(guesses[g], hurdles[h]);
+        }
+      }
+    });
+    xlogx_.resize(hurdle_count_ + 1);
+    for (size_t n = 1; n <= hurdle_count_; n++) {
+      xlogx_[n] = n * std::log2(static_cast<double>(n));
+    }
+  }
+
+  HurdleSet AllHurdles() const {
+    HurdleSet all(hurdle_count_);
+    for (size_t h = 0; h < hurdle_count_; h++) {
+      all[h] = h;
+    }
+    return all;
+  }
+
+  // Solves the whole tree, trying the openings one after the other so the
+  // subtrees of each opening can be solved in parallel.
+  Result SolveRoot() {
+    const HurdleSet all = AllHurdles();
+    const Key key = MakeKey(all, 0);
+    if (Result cached; Find(key, &cached)) {
+      return cached;
+    }
+    Result best;
+    for (uint32_t guess : RankGuesses(all, options_.openings)) {
+      const auto start = std::chrono::steady_clock::now();
+      const uint32_t cost = Evaluate(guess, all, 0, best.cost, true);
+      const double seconds = std::chrono::duration<double>(
+                                 std::chrono::steady_clock::now() - start)
+                                 .count();
+      std::cerr << words_.Guesses()[guess] << ": ";
+      if (cost == kInfeasible) {
+        std::cerr << (best.cost == kInfeasible
+                          ? "fails within six guesses"
+                          : "no better than the best opening so far");
+      } else {
+        std::cerr << static_cast<double>(cost) / all.size()
+                  << " guesses on average";
+      }
+      std::cerr << " (" << seconds << " s, " << MemoSize()
+                << " subtrees solved)" << std::endl;
+      if (cost < best.cost) {
+        best = {cost, guess};
+      }
+      FlushCheckpoint();
+    }
+    Store(key, best);
+    FlushCheckpoint();
+    return best;
+  }
+
+  // Writes the solved tree to `path`. SolveRoot must have succeeded.
+  bool WriteTable(const std::string& path) {
+    std::vector<StrategyNode> nodes;
+    std::vector<StrategyEdge> edges;
+    BuildNode(AllHurdles(), 0, &nodes, &edges);
+
+    StrategyHeader header{};
+    std::memcpy(header.magic, kStrategyMagic, sizeof(kStrategyMagic));
+    header.version = kStrategyVersion;
+    header.node_count = nodes.size();
+    header.edge_count = edges.size();
+    header.hurdle_count = hurdle_count_;
+    header.guess_count = guess_count_;
+    header.words_checksum = WordsChecksum(words_);
+
+    // Write a new file and rename it over the old one, so a server that has
+    // the old table mapped keeps a consistent copy.
+    const std::string temp_path = path + ".tmp";
+    std::ofstream out(temp_path, std::ios::binary | std::ios::trunc);
+    out.write(reinterpret_cast<const char*>(&header), sizeof(header));
+    out.write(reinterpret_cast<const char*>(nodes.data()),
+              nodes.size() * sizeof(StrategyNode));
+    out.write(reinterpret_cast<const char*>(edges.data()),
+              edges.size() * sizeof(StrategyEdge));
+    out.close();
+    if (!out || std::rename(temp_path.c_str(), path.c_str()) != 0) {
+      return false;
+    }
+    std::cerr << "Wrote " << nodes.size() << " nodes and " << edges.size()
+              << " edges to " << path << std::endl;
+    return true;
+  }
+
+  // Loads the subtrees solved by an earlier run with the same word lists
+  // and options. Returns how many were read. A checkpoint from another run
+  // is discarded.
+  size_t LoadCheckpoint() {
+    if (options_.checkpoint.empty()) {
+      return 0;
+    }
+    std::ostringstream header;
+    header << WordsChecksum(words_) << ' ' << options_.openings << ' '
+           << options_.breadth;
+    std::ifstream in(options_.checkpoint);
+    std::string line;
+    if (!std::getline(in, line) || line != header.str()) {
+      in.close();
+      std::ofstream out(options_.checkpoint, std::ios::trunc);
+      out << header.str() << '\n';
+      return 0;
+    }
+    Key key;
+    Result result;
+    size_t loaded = 0;
+    while (in >> key.hash[0] >> key.hash[1] >> key.depth >> result.cost >>
+           result.guess) {
+      if (result.guess < guess_count_) {
+        Insert(key, result);
+        loaded++;
+      }
+    }
+    return loaded;
+  }
+
+  size_t MemoSize() {
+    size_t size = 0;
+    for (Shard& shard : memo_) {
+      std::lock_guard<std::mutex> lock(shard.mutex);
+      size += shard.results.size();
+    }
+    return size;
+  }
+
+ private:
+  static constexpr size_t kShards = 64;
+  static constexpr size_t kCheckpointBatch = 4096;
+
+  struct Shard {
+    std::mutex mutex;
+    std::unordered_map<Key, Result, KeyHash> results;
+  };
+
+  const HurdleWords& words_;
+  ThreadPool& pool_;
+  Options options_;
+  const size_t hurdle_count_;
+  const size_t guess_count_;
+  std::vector<uint32_t> hurdle_guess_;
+  std::vector<Pattern> patterns_;
+  std::vector<double> xlogx_;
+  Shard memo_[kShards];
+  std::mutex checkpoint_mutex_;
+  std::vector<std::pair<Key, Result>> unsaved_;
+
+  Pattern PatternOf(uint32_t guess, uint16_t hurdle) const {
+    return patterns_[guess * hurdle_count_ + hurdle];
+  }
+
+  bool Find(const Key& key, Result* result) {
+    Shard& shard = memo_[key.hash[1] % kShards];
+    std::lock_guard<std::mutex> lock(shard.mutex);
+    auto it = shard.results.find(key);
+    if (it == shard.results.end()) {
+      return false;
+    }
+    *result = it->second;
+    return true;
+  }
+
+  void Insert(const Key& key, const Result& result) {
+    Shard& shard = memo_[key.hash[1] % kShards];
+    std::lock_guard<std::mutex> lock(shard.mutex);
+    shard.results[key] = result;
+  }
+
+  void Store(const Key& key, const Result& result) {
+    Insert(key, result);
+    if (options_.checkpoint.empty()) {
+      return;
+    }
+    std::lock_guard<std::mutex> lock(checkpoint_mutex_);
+    unsaved_.emplace_back(key, result);
+    if (unsaved_.size() >= kCheckpointBatch) {
+      WriteUnsaved();
+    }
+  }
+
+  void FlushCheckpoint() {
+    if (options_.checkpoint.empty()) {
+      return;
+    }
+    std::lock_guard<std::mutex> lock(checkpoint_mutex_);
+    WriteUnsaved();
+  }
+
+  // Must be called with checkpoint_mutex_ held.
+  void WriteUnsaved() {
+    std::ofstream out(options_.checkpoint, std::ios::app);
+    for (const auto& [key, result] : unsaved_) {
+      out << key.hash[0] << ' ' << key.hash[1] << ' ' << key.depth << ' '
+          << result.cost << ' ' << result.guess << '\n';
+    }
+    unsaved_.clear();
+  }
+
+  // Splits `set` by the feedback `guess` gets. Returns the hurdles grouped
+  // by pattern in `sorted`, with pattern p at [offsets[p], offsets[p + 1]).
+  void Partition(uint32_t guess, const HurdleSet& set, HurdleSet* sorted,
+                 uint32_t offsets[kPatternCount + 1]) const {
+    uint32_t counts[kPatternCount] = {};
+    for (uint16_t hurdle : set) {
+      counts[PatternOf(guess, hurdle)]++;
+    }
+    offsets[0] = 0;
+    for (int p = 0; p < kPatternCount; p++) {
+      offsets[p + 1] = offsets[p] + counts[p];
+    }
+    uint32_t next[kPatternCount];
+    std::copy(offsets, offsets + kPatternCount, next);
+    sorted->resize(set.size());
+    for (uint16_t hurdle : set) {
+      (*sorted)[next[PatternOf(guess, hurdle)]++] = hurdle;
+    }
+  }
+
+  double Entropy(uint32_t guess, const HurdleSet& set) const {
+    uint16_t counts[kPatternCount] = {};
+    for (uint16_t hurdle : set) {
+      counts[PatternOf(guess, hurdle)]++;
+    }
+    double sum = 0;
+    for (int p = 0; p < kPatternCount; p++) {
+      sum += xlogx_[counts[p]];
+    }
+    const double n = set.size();
+    // A guess that may be the answer wins ties.
+    return std::log2(n) - sum / n + (counts[kAllGreen] > 0 ? 1e-9 : 0);
+  }
+
+  // Returns the `count` guesses with the most expected information on `set`.
+  std::vector<uint32_t> RankGuesses(const HurdleSet& set, size_t count) {
+    std::vector<double> scores(guess_count_);
+    auto score = [&](size_t begin, size_t end) {
+      for (size_t g = begin; g < end; g++) {
+        scores[g] = Entropy(g, set);
+      }
+    };
+    if (set.size() >= 256) {
+      pool_.ParallelFor(0, guess_count_, 256, score);
+    } else {
+      score(0, guess_count_);
+    }
+    std::vector<uint32_t> order(guess_count_);
+    for (uint32_t g = 0; g < guess_count_; g++) {
+      order[g] = g;
+    }
+    count = std::min(count, order.size());
+    std::partial_sort(order.begin(), order.begin() + count, order.end(),
+                      [&](uint32_t a, uint32_t b) {
+                        return scores[a] > scores[b] ||
+                               (scores[a] == scores[b] && a < b);
+                      });
+    order.resize(count);
+    return order;
+  }
+
+  // Returns the total cost of playing `guess` on `set` with `depth` guesses
+  // already made, or kInfeasible if it can't beat `bound`. Subtrees are
+  // solved in parallel when `parallel` is set, without pruning.
+  uint32_t Evaluate(uint32_t guess, const HurdleSet& set, int depth,
+                    uint32_t bound, bool parallel) {
+    HurdleSet sorted;
+    uint32_t offsets[kPatternCount + 1];
+    Partition(guess, set, &sorted, offsets);
+    std::vector<HurdleSet> subsets;
+    uint32_t lower_bound = set.size();
+    for (int p = 0; p < kPatternCount; p++) {
+      if (p != kAllGreen && offsets[p + 1] > offsets[p]) {
+        subsets.emplace_back(sorted.begin() + offsets[p],
+                             sorted.begin() + offsets[p + 1]);
+        lower_bound += LowerBound(subsets.back().size());
+      }
+    }
+    if (subsets.size() == 1 && subsets[0].size() == set.size()) {
+      return kInfeasible;  // The guess tells nothing apart.
+    }
+    if (lower_bound >= bound) {
+      return kInfeasible;
+    }
+
+    if (parallel) {
+      std::vector<uint32_t> costs(subsets.size());
+      pool_.ParallelFor(0, subsets.size(), 1, [&](size_t begin, size_t end) {
+        for (size_t i = begin; i < end; i++) {
+          costs[i] = Solve(subsets[i], depth + 1).cost;
+        }
+      });
+      uint64_t total = set.size();
+      for (uint32_t cost : costs) {
+        if (cost == kInfeasible) {
+          return kInfeasible;
+        }
+        total += cost;
+      }
+      return total < bound ? total : kInfeasible;
+    }
+
+    // Solve the largest subsets first: they decide most of the cost, so a
+    // losing guess is pruned sooner.
+    std::sort(subsets.begin(), subsets.end(),
+              [](const HurdleSet& a, const HurdleSet& b) {
+                return a.size() > b.size();
+              });
+    uint32_t total = lower_bound;
+    for (const HurdleSet& subset : subsets) {
+      const uint32_t cost = Solve(subset, depth + 1).cost;
+      if (cost == kInfeasible) {
+        return kInfeasible;
+      }
+      total += cost - LowerBound(subset.size());
+      if (total >= bound) {
+        return kInfeasible;
+      }
+    }
+    return total;
+  }
+
+  Result Solve(const HurdleSet& set, int depth) {
+    const int guesses_left = kMaxGuesses - depth;
+    if (set.size() == 1) {
+      return {1, hurdle_guess_[set[0]]};
+    }
+    if (guesses_left <= 1) {
+      return {};
+    }
+    const Key key = MakeKey(set, depth);
+    Result result;
+    if (Find(key, &result)) {
+      return result;
+    }
+
+    // A hurdle that tells every other one apart reaches the lower bound.
+    for (uint16_t hurdle : set) {
+      const uint32_t guess = hurdle_guess_[hurdle];
+      bool seen[kPatternCount] = {};
+      bool splits = true;
+      for (uint16_t other : set) {
+        const Pattern pattern = PatternOf(guess, other);
+        splits = splits && !seen[pattern];
+        seen[pattern] = true;
+      }
+      if (splits) {
+        result = {LowerBound(set.size()), guess};
+        Store(key, result);
+        return result;
+      }
+    }
+
+    for (uint32_t guess : RankGuesses(set, options_.breadth)) {
+      const uint32_t cost = Evaluate(guess, set, depth, result.cost, false);
+      if (cost < result.cost) {
+        result = {cost, guess};
+      }
+    }
+    Store(key, result);
+    return result;
+  }
+
+  uint32_t BuildNode(const HurdleSet& set, int depth,
+                     std::vector<StrategyNode>* nodes,
+                     std::vector<StrategyEdge>* edges) {
+    const Result result = depth == 0 ? SolveRoot() : Solve(set, depth);
+    const uint32_t index = nodes->size();
+    nodes->push_back(StrategyNode{});
+
+    HurdleSet sorted;
+    uint32_t offsets[kPatternCount + 1];
+    Partition(result.guess, set, &sorted, offsets);
+    std::vector<int> patterns;
+    for (int p = 0; p < kPatternCount; p++) {
+      if (p != kAllGreen && offsets[p + 1] > offsets[p]) {
+        patterns.push_back(p);
+      }
+    }
+    StrategyNode node;
+    node.guess = result.guess;
+    node.first_edge = edges->size();
+    node.edge_count = patterns.size();
+    node.candidates = set.size();
+    node.expected_info = std::max(0.0, Entropy(result.guess, set));
+    node.expected_guesses = static_cast<float>(result.cost) / set.size();
+    (*nodes)[index] = node;
+
+    // Reserve the edges first so they stay contiguous.
+    edges->resize(edges->size() + patterns.size());
+    for (size_t i = 0; i < patterns.size(); i++) {
+      const int p = patterns[i];
+      const HurdleSet subset(sorted.begin() + offsets[p],
+                             sorted.begin() + offsets[p + 1]);
+      const uint32_t child = BuildNode(subset, depth + 1, nodes, edges);
+      (*edges)[node.first_edge + i] =
+          StrategyEdge{child, static_cast<uint32_t>(p)};
+    }
+    return index;
+  }
+};
+
+bool ParseOptions(int argc, char** argv, Options* options) {
+  std::vector<std::string> files;
+  for (int i = 1; i < argc; i++) {
+    const std::string arg = argv[i];
+    if (arg == "--openings" && i + 1 < argc) {
+      options->openings = std::max(1, std::atoi(argv[++i]));
+    } else if (arg == "--breadth" && i + 1 < argc) {
+      options->breadth = std::max(1, std::atoi(argv[++i]));
+    } else if (arg == "--checkpoint" && i + 1 < argc) {
+      options->checkpoint = argv[++i];
+    } else if (arg.rfind("--", 0) == 0) {
+      return false;
+    } else {
+      files.push_back(arg);
+    }
+  }
+  if (files.size() != 3) {
+    return false;
+  }
+  options->hurdles_file = files[0];
+  options->guesses_file = files[1];
+  options->output_file = files[2];
+  return true;
+}
+
+}  // namespace
+
+int main(int argc, char** argv) {
+  Options options;
+  if (!ParseOptions(argc, argv, &options)) {
+    std::cerr << "Usage: " << argv[0]
+              << " [--openings N] [--breadth N] [--checkpoint FILE]"
+                 " HURDLES_FILE GUESSES_FILE OUTPUT_FILE"
+              << std::endl;
+    return 2;
+  }
+
+  HurdleWords words(options.hurdles_file, options.guesses_file);
+  if (words.Hurdles().empty() || words.Hurdles().size() > UINT16_MAX) {
+    std::cerr << "Expected between 1 and " << UINT16_MAX << " hurdles."
+              << std::endl;
+    return 1;
+  }
+  for (const std::string& hurdle : words.Hurdles()) {
+    if (!words.IsGuessValid(hurdle)) {
+      std::cerr << "Hurdle " << hurdle << " is not a valid guess." << std::endl;
+      return 1;
+    }
+  }
+
+  ThreadPool pool;
+  Solver solver(words, pool, options);
+  const size_t resumed = solver.LoadCheckpoint();
+  if (resumed > 0) {
+    std::cerr << "Resuming with " << resumed << " solved subtrees."
+              << std::endl;
+  }
+  const Result root = solver.SolveRoot();
+  if (root.cost == kInfeasible) {
+    std::cerr << "No opening solves every hurdle within " << kMaxGuesses
+              << " guesses." << std::endl;
+    return 1;
+  }
+  std::cerr << "Best opening: " << words.Guesses()[root.guess] << ", "
+            << static_cast<double>(root.cost) / words.Hurdles().size()
+            << " guesses on average." << std::endl;
+  return solver.WriteTable(options.output_file) ? 0 : 1;
+}
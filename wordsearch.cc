@@ -0,0 +1,137 @@
+#include "wordsearch.h"
+
+#include <algorithm>
+
+#if defined(__SSE2__)
+#include <emmintrin.h>
+#endif
+
+namespace {
+
+// Sets `out` to the lowercase letters of `letters`, skipping commas.
+// Returns false if any other character is found.
+bool ParseLetters(const std::string& letters, std::vector<uint8_t>* out) {
+  for (char c : letters) {
+    if (c == ',') {
+      continue;
+    }
+    if (c >= 'A' && c <= 'Z') {
+      c += 'a' - 'A';
+    }
+    if (c < 'a' || c > 'z') {
+      return false;
+    }
+    out->push_back(c - 'a');
+  }
+  return true;
+}
+
+// result &= bits, over `size` uint64_t, a multiple of 2.
+void And(uint64_t* result, const uint64_t* bits, size_t size) {
+#if defined(__SSE2__)
+  for (size_t i = 0; i < size; i += 2) {
+    __m128i* out = reinterpret_cast<__m128i*>(result + i);
+    const __m128i in =
+        _mm_loadu_si128(reinterpret_cast<const __m128i*>(bits + i));
+    _mm_storeu_si128(out, _mm_and_si128(_mm_loadu_si128(out), in));
+  }
+#else
+  for (size_t i = 0; i < size; i++) {
+    result[i] &= bits[i];
+  }
+#endif
+}
+
+// result &= ~bits, over `size` uint64_t, a multiple of 2.
+void AndNot(uint64_t* result, const uint64_t* bits, size_t size) {
+#if defined(__SSE2__)
+  for (size_t i = 0; i < size; i += 2) {
+    __m128i* out = reinterpret_cast<__m128i*>(result + i);
+    const __m128i in =
+        _mm_loadu_si128(reinterpret_cast<const __m128i*>(bits + i));
+    // _mm_andnot_si128(a, b) computes ~a & b.
+    _mm_storeu_si128(out, _mm_andnot_si128(in, _mm_loadu_si128(out)));
+  }
+#else
+  for (size_t i = 0; i < size; i++) {
+    result[i] &= ~bits[i];
+  }
+#endif
+}
+
+}  // namespace
+
+WordSearch::WordSearch(const std::vector<std::string>& words)
+    : stride_((words.size() + 127) / 128 * 2),
+      all_(stride_, 0),
+      bitsets_(2 * kLength * kLetters * stride_, 0) {
+  for (size_t i = 0; i < words.size(); i++) {
+    const std::string& word = words[i];
+    if (word.size() != kLength ||
+        !std::all_of(word.begin(), word.end(),
+                     [](char c) { return c >= 'a' && c <= 'z'; })) {
+      continue;
+    }
+    const uint64_t bit = uint64_t{1} << (i % 64);
+    all_[i / 64] |= bit;
+    size_t counts[kLetters] = {};
+    for (size_t position = 0; position < kLength; position++) {
+      const size_t letter = word[position] - 'a';
+      MutableBitset(position * kLetters + letter)[i / 64] |= bit;
+      counts[letter]++;
+      const size_t at_least = (kLength + counts[letter] - 1) * kLetters;
+      MutableBitset(at_least + letter)[i / 64] |= bit;
+    }
+  }
+}
+
+bool WordSearch::Search(const std::string& pattern, const std::string& include,
+                        const std::string& exclude,
+                        std::vector<uint32_t>* matches) const {
+  std::vector<uint8_t> included;
+  std::vector<uint8_t> excluded;
+  if ((!pattern.empty() && pattern.size() != kLength) ||
+      !ParseLetters(include, &included) || !ParseLetters(exclude, &excluded)) {
+    return false;
+  }
+
+  std::vector<uint64_t> result = all_;
+  for (size_t position = 0; position < pattern.size(); position++) {
+    char c = pattern[position];
+    if (c == '?' || c == '.') {
+      continue;
+    }
+    if (c >= 'A' && c <= 'Z') {
+      c += 'a' - 'A';
+    }
+    if (c < 'a' || c > 'z') {
+      return false;
+    }
+    And(result.data(), At(position, c - 'a'), stride_);
+  }
+
+  size_t counts[kLetters] = {};
+  for (uint8_t letter : included) {
+    counts[letter]++;
+  }
+  for (size_t letter = 0; letter < kLetters; letter++) {
+    if (counts[letter] > kLength) {
+      return true;
+    }
+    if (counts[letter] > 0) {
+      And(result.data(), AtLeast(counts[letter], letter), stride_);
+    }
+  }
+  for (uint8_t letter : excluded) {
+    AndNot(result.data(), AtLeast(1, letter), stride_);
+  }
+
+  for (size_t i = 0; i < result.size(); i++) {
+    uint64_t word = result[i];
+    while (word != 0) {
+      matches->push_back(i * 64 + __builtin_ctzll(word));
+      word &= word - 1;
+    }
+  }
+  return true;
+}
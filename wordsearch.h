@@ -0,0 +1,50 @@
+#include <cstdint>
+#include <string>
+#include <vector>
+
+#ifndef WORDSEARCH_H
+#define WORDSEARCH_H
+
+// WordSearch answers pattern queries over a word list, such as "words
+// matching ?a??e that contain r and t but no s or o". It keeps a bitset over
+// the words for every (position, letter) pair, and one for every letter and
+// minimum number of occurrences, so a query is a handful of ANDs over
+// bitsets, done 128 bits at a time.
+class WordSearch {
+ public:
+  explicit WordSearch(const std::vector<std::string>& words);
+
+  // Finds the words that have the letters of `pattern` in place, where '?'
+  // or '.' matches any letter, contain every letter of `include` (a letter
+  // listed twice must appear twice) and none of `exclude`. An empty pattern
+  // matches every word. Commas in `include` and `exclude` are ignored.
+  // Appends the indices of the matching words, in increasing order, to
+  // `matches`. Returns false if a parameter is malformed.
+  bool Search(const std::string& pattern, const std::string& include,
+              const std::string& exclude,
+              std::vector<uint32_t>* matches) const;
+
+ private:
+  static constexpr size_t kLength = 5;
+  static constexpr size_t kLetters = 26;
+
+  // Number of uint64_t per bitset, rounded up to whole 128-bit lanes.
+  size_t stride_ = 0;
+  // Words of kLength lowercase letters; other words never match.
+  std::vector<uint64_t> all_;
+  // at_[position * kLetters + letter] and, following them,
+  // at_least_[(count - 1) * kLetters + letter], stored back to back.
+  std::vector<uint64_t> bitsets_;
+
+  const uint64_t* At(size_t position, size_t letter) const {
+    return &bitsets_[(position * kLetters + letter) * stride_];
+  }
+  const uint64_t* AtLeast(size_t count, size_t letter) const {
+    return &bitsets_[((kLength + count - 1) * kLetters + letter) * stride_];
+  }
+  uint64_t* MutableBitset(size_t index) {
+    return &bitsets_[index * stride_];
+  }
+};
+
+#endif  // WORDSEARCH_H